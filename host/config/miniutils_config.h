@@ -0,0 +1,35 @@
+/*
+ * miniutils_config.h
+ *
+ * Miniutils configuration of the host target. Printing to an io goes to
+ * host stdout through host_putc/host_putb, see tests/host_test.h.
+ */
+
+#ifndef MINIUTILS_CONFIG_H_
+#define MINIUTILS_CONFIG_H_
+
+#include "system.h"
+
+// enable formatted float printing support
+#define MINIUTILS_PRINT_FLOAT
+// enable formatted longlong printing support
+#define MINIUTILS_PRINT_LONGLONG
+
+void host_putc(int io, char c);
+void host_putb(int io, const void *b, int len);
+
+#define PUTC(p, c)  \
+  if ((p) < 256) \
+    host_putc((int)(p), (c)); \
+  else \
+    *((char*)(p)++) = (c);
+#define PUTB(p, b, l)  \
+  if ((p) < 256) \
+    host_putb((int)(p), (b), (int)(l)); \
+  else { \
+    int ____l = (l); \
+    memcpy((char*)(p),(b),____l); \
+    (p)+=____l; \
+  }
+
+#endif /* MINIUTILS_CONFIG_H_ */
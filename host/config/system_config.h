@@ -0,0 +1,26 @@
+/*
+ * system_config.h
+ *
+ * System configuration of the host target. Module configs such as
+ * CONFIG_TASK_POOL are given per program in its .mk file.
+ */
+
+#ifndef SYSTEM_CONFIG_H_
+#define SYSTEM_CONFIG_H_
+
+#include "types.h"
+
+// ios, there are none on host, output goes to stdout by PUTC
+#define IODBG                     0
+#define IOSTD                     0
+
+// virtual clock, 10 timer ticks per ms
+#define SYS_MAIN_TIMER_FREQ       10000
+#define SYS_TIMER_TICK_FREQ       1000
+
+#define CONFIG_DEFAULT_DEBUG_MASK 0
+
+#define VALID_DATA(x)             ((x) != 0)
+#define VALID_RAM(x)              ((x) != 0)
+
+#endif /* SYSTEM_CONFIG_H_ */
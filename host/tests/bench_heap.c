@@ -0,0 +1,96 @@
+/*
+ * bench_heap.c
+ *
+ * Sleep queue operations on the pairing heap against a list kept sorted
+ * by list_sort_insert, as os.c did, for growing queue lengths: the
+ * earliest sleeper waking and sleeping again, and an arbitrary sleeper
+ * being signalled before its timeout and sleeping again.
+ */
+
+#include "host_test.h"
+#include "list.h"
+
+#define MAX_ELEMENTS  1024
+#define OPS           500000
+
+typedef struct {
+  element_t e;
+} item;
+
+static item items[MAX_ELEMENTS];
+static heap_t h;
+static list_t l;
+
+static sys_time delay(void) {
+  return 1 + host_test_rand() % 1000;
+}
+
+static void fill(u32_t n, bool heap) {
+  u32_t i;
+  heap_init(&h);
+  list_init(&l);
+  for (i = 0; i < n; i++) {
+    list_set_order(&items[i], delay());
+    if (heap) heap_insert(&h, &items[i]);
+    else list_sort_insert(&l, &items[i]);
+  }
+}
+
+// Earliest wakes and sleeps again, returns ns per wake and sleep.
+static double wake_first(u32_t n, bool heap) {
+  u32_t i;
+  u64_t t;
+  host_test_seed(1);
+  fill(n, heap);
+  t = host_test_ns();
+  for (i = 0; i < OPS; i++) {
+    element_t *e;
+    if (heap) {
+      e = heap_pop(&h);
+      list_set_order(e, list_get_order(e) + delay());
+      heap_insert(&h, e);
+    } else {
+      e = list_first(&l);
+      list_delete(&l, e);
+      list_set_order(e, list_get_order(e) + delay());
+      list_sort_insert(&l, e);
+    }
+  }
+  return (double)(host_test_ns() - t) / OPS;
+}
+
+// Any sleeper is signalled and sleeps again, returns ns per signal and
+// sleep.
+static double wake_any(u32_t n, bool heap) {
+  u32_t i;
+  u64_t t;
+  sys_time now = 0;
+  host_test_seed(2);
+  fill(n, heap);
+  t = host_test_ns();
+  for (i = 0; i < OPS; i++) {
+    element_t *e = &items[host_test_rand() % n].e;
+    now++;
+    if (heap) {
+      heap_update(&h, e, now + delay());
+    } else {
+      list_delete(&l, e);
+      list_set_order(e, now + delay());
+      list_sort_insert(&l, e);
+    }
+  }
+  return (double)(host_test_ns() - t) / OPS;
+}
+
+int main(void) {
+  u32_t n;
+  host_test_init();
+  printf("ns per operation       wake first, sleep      signal any, sleep\n");
+  printf("sleepers                 heap    list           heap    list\n");
+  for (n = 4; n <= MAX_ELEMENTS; n *= 4) {
+    printf("%8i             %7.1f %7.1f        %7.1f %7.1f\n", n,
+        wake_first(n, TRUE), wake_first(n, FALSE),
+        wake_any(n, TRUE), wake_any(n, FALSE));
+  }
+  return EXIT_SUCCESS;
+}
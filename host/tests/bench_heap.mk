@@ -0,0 +1 @@
+CFILES += list.c
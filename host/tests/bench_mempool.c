@@ -0,0 +1,148 @@
+/*
+ * bench_mempool.c
+ *
+ * Fixed block pools against host malloc: alloc/free time for one size and
+ * for a random mix of sizes over size classes, and a fragmentation report
+ * of what each way costs in memory for the same live data.
+ */
+
+#include "host_test.h"
+#include "mempool.h"
+#include "miniutils.h"
+#include <malloc.h>
+
+#define PAIRS         20000000
+#define LIVE          1024
+#define CHURN_OPS     2000000
+#define CLASSES       5
+
+static const u16_t class_size[CLASSES] = {16, 32, 64, 128, 256};
+
+static u8_t mem_fixed[MEMPOOL_MEM_SIZE(32, 64)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+// each class may hold all live blocks, as sizes are random
+static u8_t mem_class[CLASSES][MEMPOOL_MEM_SIZE(256, LIVE)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+
+static void *live[LIVE];
+static u16_t live_size[LIVE];
+// keeps the compiler from dropping allocations
+static volatile uintptr_t sink;
+
+// Random size 1 to 256, mostly small as typical for driver buffers.
+static u32_t rand_size(void) {
+  u32_t r = host_test_rand();
+  u32_t bits = 4 + (r & 3) + ((r >> 2) & 1);
+  return 1 + ((r >> 8) & ((1 << bits) - 1));
+}
+
+static void bench_fixed(void) {
+  mempool p;
+  u32_t i;
+  mempool_init(&p, mem_fixed, sizeof(mem_fixed), 32, 0);
+  u64_t t0 = host_test_ns();
+  for (i = 0; i < PAIRS; i++) {
+    void *b = mempool_alloc(&p);
+    sink += (uintptr_t)b;
+    mempool_free(&p, b);
+  }
+  double pool_ns = (double)(host_test_ns() - t0) / PAIRS;
+
+  mempool_init(&p, mem_fixed, sizeof(mem_fixed), 32, MEMPOOL_ATTR_IRQ_SAFE);
+  t0 = host_test_ns();
+  for (i = 0; i < PAIRS; i++) {
+    void *b = mempool_alloc(&p);
+    sink += (uintptr_t)b;
+    mempool_free(&p, b);
+  }
+  double pool_irq_ns = (double)(host_test_ns() - t0) / PAIRS;
+
+  t0 = host_test_ns();
+  for (i = 0; i < PAIRS; i++) {
+    void *b = malloc(32);
+    sink += (uintptr_t)b;
+    free(b);
+  }
+  double malloc_ns = (double)(host_test_ns() - t0) / PAIRS;
+
+  printf("32 bytes alloc+free:  mempool %5.1f ns  irq safe %5.1f ns  malloc %5.1f ns\n",
+      pool_ns, pool_irq_ns, malloc_ns);
+}
+
+static void bench_churn(void) {
+  mempool pools[CLASSES];
+  mempool_group g;
+  u32_t i, req = 0, req_peak = 0;
+  for (i = 0; i < CLASSES; i++) {
+    mempool_init(&pools[i], mem_class[i], MEMPOOL_MEM_SIZE(class_size[i], LIVE), class_size[i], 0);
+  }
+  mempool_group_init(&g, pools, CLASSES);
+
+  // same size sequence for both, replacing a random live block each op
+  host_test_seed(0x5173);
+  for (i = 0; i < LIVE; i++) {
+    live_size[i] = rand_size();
+    live[i] = mempool_group_alloc(&g, live_size[i]);
+  }
+  // report the churn only
+  mempool_group_stats_reset(&g);
+  u64_t t0 = host_test_ns();
+  for (i = 0; i < CHURN_OPS; i++) {
+    u32_t k = host_test_rand() % LIVE;
+    mempool_group_free(&g, live[k]);
+    live_size[k] = rand_size();
+    live[k] = mempool_group_alloc(&g, live_size[k]);
+  }
+  double pool_ns = (double)(host_test_ns() - t0) / CHURN_OPS;
+  u32_t blk_peak = 0, reserved = 0;
+  for (i = 0; i < CLASSES; i++) {
+    blk_peak += pools[i].peak * pools[i].block_size;
+    reserved += pools[i].blocks * pools[i].block_size;
+  }
+  for (i = 0; i < LIVE; i++) {
+    req += live_size[i];
+    mempool_group_free(&g, live[i]);
+  }
+
+  host_test_seed(0x5173);
+  struct mallinfo2 mi0 = mallinfo2();
+  for (i = 0; i < LIVE; i++) {
+    live_size[i] = rand_size();
+    live[i] = malloc(live_size[i]);
+  }
+  t0 = host_test_ns();
+  for (i = 0; i < CHURN_OPS; i++) {
+    u32_t k = host_test_rand() % LIVE;
+    free(live[k]);
+    live_size[k] = rand_size();
+    live[k] = malloc(live_size[k]);
+  }
+  double malloc_ns = (double)(host_test_ns() - t0) / CHURN_OPS;
+  struct mallinfo2 mi = mallinfo2();
+  u32_t malloc_req = 0;
+  for (i = 0; i < LIVE; i++) {
+    malloc_req += live_size[i];
+  }
+  req_peak = malloc_req;
+
+  printf("1..256 bytes, %i live, free+alloc:  mempool group %5.1f ns  malloc %5.1f ns\n",
+      LIVE, pool_ns, malloc_ns);
+  printf("\nfragmentation, %i live blocks of %i requested bytes at end:\n", LIVE, req);
+  mempool_group_dump(IOSTD, &g);
+  printf("mempool: %i bytes reserved in %i classes, peak %i bytes in blocks, "
+      "%i%% of reserved never used\n",
+      reserved, CLASSES, blk_peak, ((reserved - blk_peak) * 100) / reserved);
+  printf("malloc:  %i bytes in use for %i requested, %i%% overhead; heap %i bytes, "
+      "%i bytes free in heap holes\n",
+      (u32_t)(mi.uordblks - mi0.uordblks), req_peak,
+      (u32_t)(((mi.uordblks - mi0.uordblks) - req_peak) * 100 / req_peak),
+      (u32_t)mi.arena, (u32_t)mi.fordblks);
+  for (i = 0; i < LIVE; i++) {
+    free(live[i]);
+  }
+}
+
+int main(void) {
+  host_test_init();
+  bench_fixed();
+  bench_churn();
+  return EXIT_SUCCESS;
+}
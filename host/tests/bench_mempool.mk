@@ -0,0 +1 @@
+CONFIG_MEMPOOL = 1
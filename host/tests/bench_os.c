@@ -0,0 +1,162 @@
+/*
+ * bench_os.c
+ *
+ * OS benchmarks: context switches, mutex handoffs and cond round trips
+ * per second of host time, and wakeup latency of sleeping threads under
+ * load on the virtual clock.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define SWITCHES      200000
+#define HANDOFFS      100000
+#define ROUND_TRIPS   100000
+#define SLEEPERS      16
+#define SLEEPS        200
+
+static os_thread thr[SLEEPERS + 2];
+static u8_t stacks[SLEEPERS + 2][256];
+static os_mutex mutex;
+static os_cond cond;
+static volatile u32_t turn;
+
+// Creates threads from kernel at given priorities and runs until all
+// are done, returning host time taken in s.
+static double run(u32_t count, void *(**f)(void *), const u8_t *prio) {
+  u32_t i;
+  u64_t t0 = host_test_ns();
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    OS_thread_create(&thr[i], 0, f[i], (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "bench");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  exit_critical();
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+  return (host_test_ns() - t0) / 1e9;
+}
+
+static void *yield_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < SWITCHES / 2; i++) {
+    OS_thread_yield();
+  }
+  return NULL;
+}
+
+static void *handoff_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < HANDOFFS / 2; i++) {
+    OS_mutex_lock(&mutex);
+    // other thread runs and blocks on the mutex
+    OS_thread_yield();
+    OS_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+static void *ping_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  OS_mutex_lock(&mutex);
+  for (i = 0; i < ROUND_TRIPS; i++) {
+    while (turn != me) {
+      OS_cond_wait(&cond, &mutex);
+    }
+    turn = me ^ 1;
+    OS_cond_signal(&cond);
+  }
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void bench_throughput(void) {
+  void *(*f[2])(void *);
+  const u8_t prio[] = {10, 10};
+
+  f[0] = f[1] = yield_f;
+  double dt = run(2, f, prio);
+  printf("context switches, yield:     %10.0f /s\n", SWITCHES / dt);
+
+  OS_mutex_init(&mutex, 0);
+  f[0] = f[1] = handoff_f;
+  dt = run(2, f, prio);
+  printf("mutex handoffs:              %10.0f /s\n", HANDOFFS / dt);
+
+  OS_mutex_init(&mutex, 0);
+  OS_cond_init(&cond);
+  turn = 0;
+  f[0] = f[1] = ping_f;
+  dt = run(2, f, prio);
+  printf("cond ping-pong round trips:  %10.0f /s\n", ROUND_TRIPS / dt);
+}
+
+static u64_t lat_sum;
+static u32_t lat_max, lat_count;
+static volatile bool loaded;
+
+static void *sleeper_f(void *arg) {
+  u32_t i;
+  u32_t period = 1 + ((u32_t)(intptr_t)arg * 7) % 23;
+  for (i = 0; i < SLEEPS; i++) {
+    sys_time wake = SYS_get_time_ms() + period;
+    OS_thread_sleep(period);
+    // in main timer ticks, the ms wakeup being on a tick
+    u32_t lat = (u32_t)(SYS_get_tick() - wake * (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ));
+    lat_sum += lat;
+    lat_count++;
+    lat_max = MAX(lat_max, lat);
+    // some work, for wakeups to collide
+    SYS_hardsleep_us(50 + (i % 5) * 100);
+  }
+  return NULL;
+}
+
+static void *load_f(void *arg) {
+  while (loaded) {
+    SYS_hardsleep_us(100);
+  }
+  return NULL;
+}
+
+static void *stop_f(void *arg) {
+  OS_thread_sleep(SLEEPS * 25);
+  loaded = FALSE;
+  return NULL;
+}
+
+static void bench_latency(bool load) {
+  void *(*f[SLEEPERS + 2])(void *);
+  u8_t prio[SLEEPERS + 2];
+  u32_t i;
+  for (i = 0; i < SLEEPERS; i++) {
+    f[i] = sleeper_f;
+    prio[i] = 100 + i;
+  }
+  f[SLEEPERS] = load_f;
+  prio[SLEEPERS] = 10;
+  f[SLEEPERS + 1] = stop_f;
+  prio[SLEEPERS + 1] = 200;
+  lat_sum = 0;
+  lat_max = 0;
+  lat_count = 0;
+  loaded = load;
+  sys_time t0 = SYS_get_time_ms();
+  run(load ? SLEEPERS + 2 : SLEEPERS, f, prio);
+  printf("wakeup latency, %i threads%s: %i wakeups, avg %.1f us, max %i us, %i virtual ms\n",
+      SLEEPERS, load ? " and busy low prio thread" : "", lat_count,
+      (double)lat_sum * 1000000 / SYS_MAIN_TIMER_FREQ / lat_count,
+      lat_max * (1000000 / SYS_MAIN_TIMER_FREQ), SYS_get_time_ms() - t0);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  bench_throughput();
+  bench_latency(FALSE);
+  bench_latency(TRUE);
+  return EXIT_SUCCESS;
+}
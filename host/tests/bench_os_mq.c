@@ -0,0 +1,153 @@
+/*
+ * bench_os_mq.c
+ *
+ * Messages per second of host time from a producer to a consumer thread
+ * through os_mq, copying or passing pointers, against the hand rolled
+ * pattern of a ringbuf guarded by a mutex with two conds, for a few
+ * message sizes and queue depths.
+ */
+
+#include "host_test.h"
+#include "os.h"
+#include "ringbuf.h"
+
+#define MSGS      200000
+#define MAX_SIZE  64
+#define MAX_DEPTH 32
+
+static os_thread thr[2];
+static u8_t stacks[2][256];
+static os_mq mq;
+static u8_t arena[MAX_DEPTH * MAX_SIZE];
+static ringbuf rb;
+static os_mutex mutex;
+static os_cond c_data, c_room;
+static u32_t msg_size;
+static u8_t bufs[MAX_DEPTH + 1][MAX_SIZE];
+static os_mq mq_free;
+static void *free_arena[MAX_DEPTH + 1];
+static volatile u32_t sum;
+
+static double run(void *(*prod)(void *), void *(*cons)(void *)) {
+  u64_t t0 = host_test_ns();
+  enter_critical();
+  OS_thread_create(&thr[0], 0, prod, NULL, stacks[0], sizeof(stacks[0]), "prod");
+  OS_thread_set_prio(&thr[0], 10);
+  OS_thread_create(&thr[1], 0, cons, NULL, stacks[1], sizeof(stacks[1]), "cons");
+  OS_thread_set_prio(&thr[1], 10);
+  exit_critical();
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+  return MSGS / ((host_test_ns() - t0) / 1e9);
+}
+
+static void *mq_prod_f(void *arg) {
+  u8_t m[MAX_SIZE];
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    m[0] = (u8_t)i;
+    OS_mq_send(&mq, m, OS_WAIT_FOREVER);
+  }
+  return NULL;
+}
+
+static void *mq_cons_f(void *arg) {
+  u8_t m[MAX_SIZE];
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    OS_mq_recv(&mq, m, OS_WAIT_FOREVER);
+    sum += m[0];
+  }
+  return NULL;
+}
+
+static void *ptr_prod_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    u8_t *b;
+    OS_mq_recv_ptr(&mq_free, (void **)&b, OS_WAIT_FOREVER);
+    b[0] = (u8_t)i;
+    OS_mq_send_ptr(&mq, b, OS_WAIT_FOREVER);
+  }
+  return NULL;
+}
+
+static void *ptr_cons_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    u8_t *b;
+    OS_mq_recv_ptr(&mq, (void **)&b, OS_WAIT_FOREVER);
+    sum += b[0];
+    OS_mq_send_ptr(&mq_free, b, OS_WAIT_FOREVER);
+  }
+  return NULL;
+}
+
+static void *rb_prod_f(void *arg) {
+  u8_t m[MAX_SIZE];
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    m[0] = (u8_t)i;
+    OS_mutex_lock(&mutex);
+    while (ringbuf_free(&rb) < msg_size) {
+      OS_cond_wait(&c_room, &mutex);
+    }
+    ringbuf_put(&rb, m, msg_size);
+    OS_cond_signal(&c_data);
+    OS_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+static void *rb_cons_f(void *arg) {
+  u8_t m[MAX_SIZE];
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    OS_mutex_lock(&mutex);
+    while (ringbuf_available(&rb) < msg_size) {
+      OS_cond_wait(&c_data, &mutex);
+    }
+    ringbuf_get(&rb, m, msg_size);
+    OS_cond_signal(&c_room);
+    OS_mutex_unlock(&mutex);
+    sum += m[0];
+  }
+  return NULL;
+}
+
+static void bench(u32_t size, u32_t depth) {
+  u32_t i;
+  double mq_rate, ptr_rate, rb_rate;
+  msg_size = size;
+
+  OS_mq_init(&mq, arena, depth, size);
+  mq_rate = run(mq_prod_f, mq_cons_f);
+
+  OS_mq_init(&mq, arena, depth, sizeof(void *));
+  OS_mq_init(&mq_free, free_arena, depth + 1, sizeof(void *));
+  for (i = 0; i < depth + 1; i++) {
+    OS_mq_send_ptr(&mq_free, bufs[i], OS_NOWAIT);
+  }
+  ptr_rate = run(ptr_prod_f, ptr_cons_f);
+
+  // ringbuf holds one byte less than its size
+  ringbuf_init(&rb, arena, depth * size + 1);
+  OS_mutex_init(&mutex, 0);
+  OS_cond_init(&c_data);
+  OS_cond_init(&c_room);
+  rb_rate = run(rb_prod_f, rb_cons_f);
+
+  printf("%4i byte messages, depth %2i:  os_mq %8.0f /s, pointers %8.0f /s, "
+      "mutex+cond+ringbuf %8.0f /s\n", size, depth, mq_rate, ptr_rate, rb_rate);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  bench(4, 1);
+  bench(16, 8);
+  bench(64, 8);
+  bench(16, 32);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,2 @@
+CONFIG_OS = 1
+CONFIG_RINGBUFFER = 1
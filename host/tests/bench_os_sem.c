@@ -0,0 +1,141 @@
+/*
+ * bench_os_sem.c
+ *
+ * Signalling rates of os_sem and os_flags against a mutex and cond,
+ * in host time: uncontended post and wait pairs in one thread, where
+ * the semaphore takes its fast path, and ping-pong between two threads,
+ * where every signal wakes the other.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define PAIRS         5000000
+#define ROUND_TRIPS   100000
+
+static os_thread thr[2];
+static u8_t stacks[2][256];
+static os_sem sems[2];
+static os_flags flags;
+static os_mutex mutex;
+static os_cond cond;
+static volatile u32_t turn;
+static u32_t avail;
+
+static double run(u32_t count, void *(*f)(void *), u32_t ops) {
+  u32_t i;
+  u64_t t0 = host_test_ns();
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    OS_thread_create(&thr[i], 0, f, (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "bench");
+    OS_thread_set_prio(&thr[i], 10);
+  }
+  exit_critical();
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+  return ops / ((host_test_ns() - t0) / 1e9);
+}
+
+static void *sem_pair_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < PAIRS; i++) {
+    OS_sem_post(&sems[0]);
+    OS_sem_wait(&sems[0], OS_WAIT_FOREVER);
+  }
+  return NULL;
+}
+
+static void *flags_pair_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < PAIRS; i++) {
+    OS_flags_set(&flags, 1);
+    OS_flags_wait(&flags, 1, OS_FLAGS_CLEAR, OS_WAIT_FOREVER);
+  }
+  return NULL;
+}
+
+static void *cond_pair_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < PAIRS; i++) {
+    OS_mutex_lock(&mutex);
+    avail++;
+    OS_cond_signal(&cond);
+    OS_mutex_unlock(&mutex);
+    OS_mutex_lock(&mutex);
+    while (avail == 0) {
+      OS_cond_wait(&cond, &mutex);
+    }
+    avail--;
+    OS_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+static void *sem_ping_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  for (i = 0; i < ROUND_TRIPS; i++) {
+    if (me == 0) OS_sem_post(&sems[1]);
+    OS_sem_wait(&sems[me], OS_WAIT_FOREVER);
+    if (me == 1) OS_sem_post(&sems[0]);
+  }
+  return NULL;
+}
+
+static void *flags_ping_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  for (i = 0; i < ROUND_TRIPS; i++) {
+    if (me == 0) OS_flags_set(&flags, 2);
+    OS_flags_wait(&flags, 1 << me, OS_FLAGS_CLEAR, OS_WAIT_FOREVER);
+    if (me == 1) OS_flags_set(&flags, 1);
+  }
+  return NULL;
+}
+
+static void *cond_ping_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  OS_mutex_lock(&mutex);
+  for (i = 0; i < ROUND_TRIPS; i++) {
+    while (turn != me) {
+      OS_cond_wait(&cond, &mutex);
+    }
+    turn = me ^ 1;
+    OS_cond_signal(&cond);
+  }
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void init(void) {
+  OS_sem_init(&sems[0], 0);
+  OS_sem_init(&sems[1], 0);
+  OS_flags_init(&flags, 0);
+  OS_mutex_init(&mutex, 0);
+  OS_cond_init(&cond);
+  turn = 0;
+  avail = 0;
+}
+
+int main(void) {
+  double sem, fl, cnd;
+  host_test_init();
+  OS_init();
+  init();
+  sem = run(1, sem_pair_f, PAIRS);
+  fl = run(1, flags_pair_f, PAIRS);
+  cnd = run(1, cond_pair_f, PAIRS);
+  printf("uncontended signal and wait:  sem %10.0f /s, flags %10.0f /s, mutex+cond %10.0f /s\n",
+      sem, fl, cnd);
+  init();
+  sem = run(2, sem_ping_f, ROUND_TRIPS);
+  fl = run(2, flags_ping_f, ROUND_TRIPS);
+  init();
+  cnd = run(2, cond_ping_f, ROUND_TRIPS);
+  printf("ping-pong round trips:        sem %10.0f /s, flags %10.0f /s, mutex+cond %10.0f /s\n",
+      sem, fl, cnd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+/*
+ * bench_print.c
+ *
+ * Formatted printing to an io: bytes per second and io output calls per
+ * print for some format strings. Built as bench_print with output put
+ * per piece, and as bench_print_buffered with MINIUTILS_PRINT_BUFFER
+ * staging it on stack. Output is counted, not written, so times are the
+ * formatting cost alone; on target each call adds a driver call with its
+ * irq toggling.
+ */
+
+#include "host_test.h"
+#include "miniutils.h"
+
+#define ROUNDS  200000
+
+static void bench(const char *name, const char *fmt, ...) {
+  va_list ap;
+  u32_t i;
+  u32_t calls = host_putc_calls + host_putb_calls;
+  u32_t bytes = host_put_bytes;
+  u64_t t = host_test_ns();
+  for (i = 0; i < ROUNDS; i++) {
+    va_start(ap, fmt);
+    vioprint(IOSTD, fmt, ap);
+    va_end(ap);
+  }
+  t = host_test_ns() - t;
+  calls = host_putc_calls + host_putb_calls - calls;
+  bytes = host_put_bytes - bytes;
+  printf("  %-10s %3i bytes %6.1f calls %7.1f ns per print, %6.1f MB/s\n",
+      name, bytes / ROUNDS, (double)calls / ROUNDS, (double)t / ROUNDS,
+      (double)bytes * 1000 / t);
+}
+
+int main(void) {
+  host_test_init();
+#ifdef MINIUTILS_PRINT_BUFFER
+  printf("print staged in %i byte buffer:\n", MINIUTILS_PRINT_BUFFER);
+#else
+  printf("print put per piece:\n");
+#endif
+  host_put_mute = TRUE;
+  bench("literal", "the quick brown fox jumps over the lazy dog\n");
+  bench("ints", "%i %i %i %i\n", 1, -22, 333, 4444);
+  bench("padded", "%08x %5i|%-5s|\n", 0xbeef, 42, "ab");
+  bench("log line", "[%08i] %s: value %i, state %s\n", 123456, "sensor", -17, "ok");
+  bench("float", "%.3f %.3f\n", 3.14159, -2.5);
+  bench("long", "%s\n", "a string longer than the staging buffer, put directly after flushing");
+  host_put_mute = FALSE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,2 @@
+SRC = bench_print.c
+PROG_FLAGS += -DMINIUTILS_PRINT_BUFFER=32
@@ -0,0 +1,111 @@
+/*
+ * bench_ringbuf.c
+ *
+ * Throughput of a producer and a consumer thread streaming bytes through
+ * the lock free ringbuf_spsc, against the legacy ringbuf put/get which
+ * needs a lock, here a mutex, around each call.
+ */
+
+#include "host_test.h"
+#include "ringbuf.h"
+#include "ringbuf_spsc.h"
+#include "miniutils.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define SIZE    1024
+#define STREAM  (16 * 1024 * 1024)
+
+static u8_t mem[SIZE];
+static ringbuf rb;
+static ringbuf_spsc rbs;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static u32_t chunk;
+static bool spsc;
+
+static int put(const u8_t *buf, u32_t len) {
+  int res;
+  if (spsc) {
+    if (len == 1) return ringbuf_spsc_putc(&rbs, buf[0]) == RB_OK ? 1 : 0;
+    return ringbuf_spsc_put(&rbs, buf, len);
+  }
+  pthread_mutex_lock(&lock);
+  if (len == 1) {
+    res = ringbuf_putc(&rb, buf[0]) == RB_OK ? 1 : 0;
+  } else {
+    res = ringbuf_put(&rb, (u8_t *)buf, len);
+  }
+  pthread_mutex_unlock(&lock);
+  return res;
+}
+
+static int get(u8_t *buf, u32_t len) {
+  int res;
+  if (spsc) {
+    if (len == 1) return ringbuf_spsc_getc(&rbs, buf) == RB_OK ? 1 : 0;
+    return ringbuf_spsc_get(&rbs, buf, len);
+  }
+  pthread_mutex_lock(&lock);
+  if (len == 1) {
+    res = ringbuf_getc(&rb, buf) == RB_OK ? 1 : 0;
+  } else {
+    res = ringbuf_get(&rb, buf, len);
+  }
+  pthread_mutex_unlock(&lock);
+  return res;
+}
+
+static void *producer(void *arg) {
+  u8_t buf[SIZE];
+  u32_t sent = 0;
+  memset(buf, 0x55, sizeof(buf));
+  while (sent < STREAM) {
+    int res = put(buf, chunk);
+    if (res > 0) {
+      sent += res;
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void measure(bool use_spsc, u32_t use_chunk) {
+  pthread_t thr;
+  u8_t buf[SIZE];
+  u32_t got = 0;
+  u32_t empty = 0;
+  spsc = use_spsc;
+  chunk = use_chunk;
+  ringbuf_init(&rb, mem, SIZE);
+  ringbuf_spsc_init(&rbs, mem, SIZE);
+  u64_t t0 = host_test_ns();
+  pthread_create(&thr, NULL, producer, NULL);
+  while (got < STREAM) {
+    int res = get(buf, chunk);
+    if (res > 0) {
+      got += res;
+    } else {
+      empty++;
+      sched_yield();
+    }
+  }
+  pthread_join(thr, NULL);
+  u64_t ns = host_test_ns() - t0;
+  printf("%-16s chunk %4u: %8.1f MB/s, %6.1f Mcalls/s, %u empty polls\n",
+      use_spsc ? "ringbuf_spsc" : "ringbuf+mutex", use_chunk,
+      (double)STREAM * 1000.0 / ns, (double)STREAM / use_chunk * 1000.0 / ns,
+      empty);
+}
+
+int main(void) {
+  host_test_init();
+  // on one cpu, threads only alternate and locks are never contended
+  printf("streaming %u bytes between two threads through %u byte buffers, "
+      "%li cpus\n", STREAM, SIZE, sysconf(_SC_NPROCESSORS_ONLN));
+  measure(FALSE, 1);
+  measure(TRUE, 1);
+  measure(FALSE, 64);
+  measure(TRUE, 64);
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * bench_spi_flash_log.c
+ *
+ * Flash log throughput and wear on the simulated flash, on the virtual
+ * clock: bytes taken per second against offered rate with 1 ms page
+ * writes and 40 ms sector erases, with and without a reader, and erases
+ * per sector for an hour of logging.
+ */
+
+#include "host_test.h"
+#include "host_flash.h"
+#include "spi_flash_log.h"
+#include "miniutils.h"
+
+#define FLASH_SIZE    (1024*1024)
+#define SECTOR        4096
+#define REGION_SIZE   (1024*1024)
+#define RUN_MS        20000
+#define WEAR_MS       (3600*1000)
+#define ENDURANCE     100000
+
+static spi_flash_dev sfd;
+static spi_flash_log lg;
+static task_timer prod_timer, cons_timer;
+static task *prod_task, *cons_task;
+static u32_t chunk;
+static u32_t read_bytes;
+
+static void prod_f(u32_t arg, void *arg_p) {
+  static u8_t buf[256];
+  SFL_write(&lg, buf, chunk);
+}
+
+static void cons_f(u32_t arg, void *arg_p) {
+  u8_t *p;
+  s32_t n;
+  while ((n = SFL_peek_linear(&lg, &p)) > 0) {
+    SFL_consume(&lg, n);
+    read_bytes += n;
+  }
+}
+
+static void idle(sys_time ms) {
+  sys_time end = SYS_get_time_ms() + ms;
+  while (SYS_get_time_ms() < end) {
+    while (TASK_tick());
+    arch_sleep();
+  }
+}
+
+// Logs chunk bytes every ms for given time, returning taken bytes/s.
+static double run(u32_t bytes_per_ms, bool reader, sys_time ms) {
+  host_flash_init(&sfd, FLASH_SIZE, 256, SECTOR, 1, 40);
+  SFL_init(&lg, &sfd, 0, REGION_SIZE);
+  idle(100);
+  chunk = bytes_per_ms;
+  read_bytes = 0;
+  TASK_start_timer(prod_task, &prod_timer, 0, NULL, 0, 1, "prod");
+  if (reader) {
+    TASK_start_timer(cons_task, &cons_timer, 0, NULL, 0, 5, "cons");
+  }
+  idle(ms);
+  TASK_stop_timer(&prod_timer);
+  TASK_stop_timer(&cons_timer);
+  // no flash operation left going
+  idle(1000);
+  return (double)lg.bytes * 1000 / ms;
+}
+
+int main(void) {
+  u32_t rate, s;
+  host_test_init();
+  TASK_init();
+  prod_task = TASK_create(prod_f, TASK_STATIC);
+  cons_task = TASK_create(cons_f, TASK_STATIC);
+
+  printf("throughput, 1 ms page writes, 40 ms sector erases, %i bytes staged:\n",
+      2 * CONFIG_SPI_FLASH_LOG_PAGE);
+  for (rate = 4; rate <= 128; rate *= 2) {
+    double taken = run(rate, FALSE, RUN_MS);
+    double dropped = (double)lg.dropped * 100 / (lg.bytes + lg.dropped);
+    double taken_r = run(rate, TRUE, RUN_MS);
+    double dropped_r = (double)lg.dropped * 100 / (lg.bytes + lg.dropped);
+    printf("  offered %6i B/s:  taken %6.0f B/s (%4.1f%% dropped), "
+        "with reader %6.0f B/s (%4.1f%% dropped) reading %6.0f B/s\n",
+        rate * 1000, taken, dropped, taken_r, dropped_r, (double)read_bytes * 1000 / RUN_MS);
+  }
+
+  run(8, FALSE, WEAR_MS);
+  u32_t min = 0xffffffff, max = 0;
+  for (s = 0; s < REGION_SIZE / SECTOR; s++) {
+    min = MIN(min, host_flash_sim.wear[s]);
+    max = MAX(max, host_flash_sim.wear[s]);
+  }
+  printf("wear, 8000 B/s for an hour over %i sectors: %i..%i erases per sector, "
+      "%i erases per sector per GB, %.1f years to %i cycles\n",
+      REGION_SIZE / SECTOR, min, max,
+      (u32_t)((double)max * (1 << 30) / lg.bytes),
+      (double)ENDURANCE / max / (24 * 365), ENDURANCE);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,3 @@
+CONFIG_TASK_QUEUE = 1
+PROG_FLAGS += -DCONFIG_SPI_FLASH_LOG
+CFILES += spi_flash_log.c host_flash.c
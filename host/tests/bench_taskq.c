@@ -0,0 +1,299 @@
+/*
+ * bench_taskq.c
+ *
+ * Task queue benchmarks: task throughput and mutex handoffs per second of
+ * host time, dispatch by TASK_tick against TASK_tick_batch in tasks per
+ * second and host time with interrupts disabled per task, timer accuracy under load on the virtual clock, and host time
+ * of starting, running and stopping many timers, mostly laps of the timer
+ * wheel away. Built with the timer list here and with the timer wheel by
+ * bench_taskq_wheel.mk; the list holds less than 128 timers, so only the
+ * wheel runs 10000.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+
+#define THROUGHPUT_TASKS    2000000
+#define BATCH_TASKS         32
+#define TIMERS              50
+#define TIMER_RUN_MS        20000
+#define HANDOFFS            1000000
+#define MANY_TIMERS         10000
+#define LIST_TIMERS         100
+#define MANY_TIMER_TASKS    32
+#define MANY_TIMER_RUN_MS   20000
+
+static volatile u32_t count;
+
+static void count_f(u32_t arg, void *arg_p) {
+  count++;
+}
+
+static void bench_throughput(void) {
+  u32_t i, j;
+  u64_t t0;
+
+  // one task at a time
+  count = 0;
+  t0 = host_test_ns();
+  for (i = 0; i < THROUGHPUT_TASKS; i++) {
+    task *t = TASK_create(count_f, 0);
+    TASK_run(t, 0, NULL);
+    TASK_tick();
+  }
+  double dt = (host_test_ns() - t0) / 1e9;
+  printf("throughput, create/run/free one by one:  %10.0f tasks/s\n", count / dt);
+
+  // queue filled before dispatch
+  count = 0;
+  t0 = host_test_ns();
+  for (i = 0; i < THROUGHPUT_TASKS / 32; i++) {
+    for (j = 0; j < 32; j++) {
+      task *t = TASK_create(count_f, 0);
+      TASK_run(t, 0, NULL);
+    }
+    while (TASK_tick());
+  }
+  dt = (host_test_ns() - t0) / 1e9;
+  printf("throughput, create/run/free 32 queued:   %10.0f tasks/s\n", count / dt);
+
+  // static task rescheduled
+  count = 0;
+  task *s = TASK_create(count_f, TASK_STATIC);
+  t0 = host_test_ns();
+  for (i = 0; i < THROUGHPUT_TASKS; i++) {
+    TASK_run(s, 0, NULL);
+    TASK_tick();
+  }
+  dt = (host_test_ns() - t0) / 1e9;
+  printf("throughput, static task run:              %10.0f tasks/s\n", count / dt);
+  TASK_free(s);
+}
+
+// Dispatches all queued tasks by TASK_tick or TASK_tick_batch
+static void batch_dispatch(bool batch) {
+  if (batch) {
+    while (TASK_tick_batch(0, 0));
+  } else {
+    while (TASK_tick());
+  }
+}
+
+static void bench_batch(bool batch) {
+  task *tasks[BATCH_TASKS];
+  u32_t i, j;
+  u64_t t0, crit_ns = 0;
+  u32_t crit_sections = 0;
+  for (i = 0; i < BATCH_TASKS; i++) {
+    tasks[i] = TASK_create(count_f, TASK_STATIC);
+  }
+  count = 0;
+  t0 = host_test_ns();
+  for (i = 0; i < THROUGHPUT_TASKS / BATCH_TASKS; i++) {
+    for (j = 0; j < BATCH_TASKS; j++) {
+      TASK_run(tasks[j], 0, NULL);
+    }
+    batch_dispatch(batch);
+  }
+  double dt = (host_test_ns() - t0) / 1e9;
+  double rate = count / dt;
+
+  // again, timing critical sections of dispatch only
+  count = 0;
+  for (i = 0; i < THROUGHPUT_TASKS / BATCH_TASKS; i++) {
+    for (j = 0; j < BATCH_TASKS; j++) {
+      TASK_run(tasks[j], 0, NULL);
+    }
+    u32_t sections;
+    arch_host_crit_timing(TRUE);
+    batch_dispatch(batch);
+    arch_host_crit_timing(FALSE);
+    crit_ns += arch_host_crit_ns(&sections);
+    crit_sections += sections;
+  }
+  for (i = 0; i < BATCH_TASKS; i++) {
+    TASK_free(tasks[i]);
+  }
+  printf("dispatch, %s %i queued:  %10.0f tasks/s, irq off %5.1f ns in %.2f sections per task\n",
+      batch ? "TASK_tick_batch" : "TASK_tick      ", BATCH_TASKS, rate,
+      (double)crit_ns / count, (double)crit_sections / count);
+}
+
+static task_timer timers[TIMERS];
+static task *timer_tasks[TIMERS];
+static sys_time timer_expect[TIMERS];
+static sys_time timer_period[TIMERS];
+static u32_t timer_runs;
+static u32_t timer_skips;
+static sys_time late_max;
+static u64_t late_sum;
+
+static void timer_f(u32_t arg, void *arg_p) {
+  sys_time now = SYS_get_tick();
+  sys_time late = now - timer_expect[arg];
+  late_sum += late;
+  late_max = MAX(late_max, late);
+  timer_runs++;
+  timer_expect[arg] += timer_period[arg];
+  // periods missed entirely are skipped by the timer
+  while (timer_expect[arg] + timer_period[arg] <= now) {
+    timer_expect[arg] += timer_period[arg];
+    timer_skips++;
+  }
+}
+
+// busy for given us of virtual time each run
+static void load_f(u32_t arg, void *arg_p) {
+  SYS_hardsleep_us(arg);
+}
+
+static void bench_timers(u32_t load_us) {
+  u32_t i;
+  const sys_time ticks_per_ms = SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ;
+  timer_runs = 0;
+  timer_skips = 0;
+  late_max = 0;
+  late_sum = 0;
+  sys_time start = SYS_get_time_ms();
+  for (i = 0; i < TIMERS; i++) {
+    timer_tasks[i] = TASK_create(timer_f, TASK_STATIC);
+    timer_period[i] = (5 + i) * ticks_per_ms;
+    timer_expect[i] = (start + 1 + i % 7) * ticks_per_ms;
+    TASK_start_timer(timer_tasks[i], &timers[i], i, NULL, 1 + i % 7, 5 + i, "bench");
+  }
+  task *load = NULL;
+  if (load_us) {
+    load = TASK_create(load_f, TASK_STATIC);
+    TASK_loop(load, load_us, NULL);
+  }
+  while (SYS_get_time_ms() < start + TIMER_RUN_MS) {
+    if (!TASK_tick()) {
+      TASK_wait();
+    }
+  }
+  for (i = 0; i < TIMERS; i++) {
+    TASK_stop_timer(&timers[i]);
+  }
+  if (load) {
+    TASK_free(load);
+  }
+  while (TASK_tick());
+  for (i = 0; i < TIMERS; i++) {
+    TASK_free(timer_tasks[i]);
+  }
+  printf("timers, %i timers %i s, load task %4i us/run: "
+      "%6i runs, lateness avg %.3f ms max %.1f ms, %i periods skipped\n",
+      TIMERS, TIMER_RUN_MS / 1000, load_us, timer_runs,
+      (double)late_sum / timer_runs / ticks_per_ms,
+      (double)late_max / ticks_per_ms, timer_skips);
+}
+
+static task_timer many_timers[MANY_TIMERS];
+
+static void bench_many_timers(u32_t timers) {
+  task *tasks[MANY_TIMER_TASKS];
+  u32_t i;
+  u64_t t0;
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  const char *impl = "wheel";
+#else
+  const char *impl = "list";
+#endif
+  for (i = 0; i < MANY_TIMER_TASKS; i++) {
+    tasks[i] = TASK_create(count_f, TASK_STATIC);
+  }
+  host_test_seed(3);
+  // recurrent every 1 to 30 s, first expiry within a period
+  t0 = host_test_ns();
+  for (i = 0; i < timers; i++) {
+    sys_time period = 1000 + host_test_rand() % 29000;
+    TASK_start_timer(tasks[i % MANY_TIMER_TASKS], &many_timers[i], i, NULL,
+        1 + host_test_rand() % period, period, "many");
+  }
+  double start_ns = (double)(host_test_ns() - t0) / timers;
+
+  // idling between expiries asks for next wakeup each time
+  count = 0;
+  sys_time end = SYS_get_time_ms() + MANY_TIMER_RUN_MS;
+  t0 = host_test_ns();
+  while (SYS_get_time_ms() < end) {
+    if (!TASK_tick()) {
+      TASK_wait();
+    }
+  }
+  double run_ns = (double)(host_test_ns() - t0) / count;
+
+  t0 = host_test_ns();
+  for (i = 0; i < timers; i++) {
+    TASK_stop_timer(&many_timers[i]);
+  }
+  double stop_ns = (double)(host_test_ns() - t0) / timers;
+  while (TASK_tick());
+  for (i = 0; i < MANY_TIMER_TASKS; i++) {
+    TASK_free(tasks[i]);
+  }
+  printf("timers, %5i timers %5s: start %8.0f ns, stop %8.0f ns, "
+      "%6i runs in %i s, %8.0f ns per run\n",
+      timers, impl, start_ns, stop_ns, count, MANY_TIMER_RUN_MS / 1000, run_ns);
+}
+
+#ifdef CONFIG_TASKQ_MUTEX
+static task_mutex mutex = TASK_MUTEX_INIT;
+static task *hand[2];
+static task *release[2];
+
+// Takes the mutex while the other task waits for it, releasing it to the
+// other from a separate task.
+static void hand_f(u32_t arg, void *arg_p) {
+  if (!TASK_mutex_lock(&mutex)) {
+    // rerun on unlock
+    return;
+  }
+  if (++count < HANDOFFS) {
+    TASK_run(hand[arg ^ 1], arg ^ 1, NULL);
+  }
+  TASK_run(release[arg], arg, NULL);
+}
+
+static void release_f(u32_t arg, void *arg_p) {
+  TASK_mutex_unlock(&mutex);
+}
+
+static void bench_mutex(void) {
+  u32_t i;
+  for (i = 0; i < 2; i++) {
+    hand[i] = TASK_create(hand_f, TASK_STATIC);
+    release[i] = TASK_create(release_f, TASK_STATIC);
+  }
+  count = 0;
+  u64_t t0 = host_test_ns();
+  TASK_run(hand[0], 0, NULL);
+  while (TASK_tick());
+  double dt = (host_test_ns() - t0) / 1e9;
+  printf("mutex, handoff between two tasks:        %10.0f handoffs/s\n", count / dt);
+  for (i = 0; i < 2; i++) {
+    TASK_free(hand[i]);
+    TASK_free(release[i]);
+  }
+}
+#endif
+
+int main(void) {
+  host_test_init();
+  TASK_init();
+  bench_throughput();
+  bench_batch(FALSE);
+  bench_batch(TRUE);
+  bench_timers(0);
+  bench_timers(200);
+  bench_timers(2000);
+  bench_many_timers(LIST_TIMERS);
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  bench_many_timers(MANY_TIMERS);
+#endif
+#ifdef CONFIG_TASKQ_MUTEX
+  bench_mutex();
+#endif
+  return host_test_result("bench_taskq");
+}
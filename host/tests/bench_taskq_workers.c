@@ -0,0 +1,124 @@
+/*
+ * bench_taskq_workers.c
+ *
+ * Task queue worker scaling with CONFIG_ARCH_HOST_SMP: throughput of
+ * cpu bound and of empty tasks for 1 to CONFIG_TASK_WORKERS workers, each
+ * worker being a host thread. Scaling is bounded by host cpus, printed
+ * along.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define CPU_TASKS           2000
+#define CPU_TASK_ROUNDS     100000
+#define EMPTY_TASKS         200000
+
+static pthread_mutex_t gate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+// workers below this index take tasks
+static volatile u32_t active;
+static volatile u32_t done;
+static volatile u32_t sum;
+
+// Keeps worker parked while not part of the run.
+static void gate(u32_t w) {
+  pthread_mutex_lock(&gate_mutex);
+  while (w >= active) {
+    pthread_cond_wait(&gate_cond, &gate_mutex);
+  }
+  pthread_mutex_unlock(&gate_mutex);
+}
+
+static void *worker_thread(void *arg) {
+  u32_t w = (u32_t)(intptr_t)arg;
+  TASK_worker_register(w);
+  while (TRUE) {
+    gate(w);
+    while (w < active && TASK_tick());
+    TASK_wait();
+  }
+  return NULL;
+}
+
+static void cpu_f(u32_t arg, void *arg_p) {
+  u32_t x = arg + 1;
+  u32_t i;
+  for (i = 0; i < CPU_TASK_ROUNDS; i++) {
+    // xorshift32, not foldable by the compiler
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+  }
+  __atomic_add_fetch(&sum, x & 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&done, 1, __ATOMIC_RELEASE);
+}
+
+static void empty_f(u32_t arg, void *arg_p) {
+  __atomic_add_fetch(&done, 1, __ATOMIC_RELEASE);
+}
+
+// Runs given number of tasks on given number of workers, returning tasks
+// per second of host time.
+static double run(u32_t workers, task_f f, u32_t count, u32_t *res_sum) {
+  u32_t posted = 0;
+  done = 0;
+  sum = 0;
+  pthread_mutex_lock(&gate_mutex);
+  active = workers;
+  pthread_cond_broadcast(&gate_cond);
+  pthread_mutex_unlock(&gate_mutex);
+  u64_t t0 = host_test_ns();
+  while (posted < count) {
+    task *t = TASK_create(f, 0);
+    if (t == NULL) {
+      // pool exhausted, let workers catch up
+      sched_yield();
+      continue;
+    }
+    TASK_run(t, posted++, NULL);
+  }
+  while (__atomic_load_n(&done, __ATOMIC_ACQUIRE) < count) {
+    sched_yield();
+  }
+  double dt = (host_test_ns() - t0) / 1e9;
+  pthread_mutex_lock(&gate_mutex);
+  active = 0;
+  pthread_mutex_unlock(&gate_mutex);
+  if (res_sum) *res_sum = sum;
+  return count / dt;
+}
+
+int main(void) {
+  u32_t w;
+  pthread_t threads[CONFIG_TASK_WORKERS];
+  host_test_init();
+  TASK_init();
+  for (w = 0; w < CONFIG_TASK_WORKERS; w++) {
+    pthread_create(&threads[w], NULL, worker_thread, (void *)(intptr_t)w);
+  }
+
+  printf("host cpus online: %li\n", sysconf(_SC_NPROCESSORS_ONLN));
+  double cpu_base = 0, empty_base = 0;
+  u32_t ref_sum = 0;
+  for (w = 1; w <= CONFIG_TASK_WORKERS; w++) {
+    u32_t s;
+    double cpu = run(w, cpu_f, CPU_TASKS, &s);
+    double empty = run(w, empty_f, EMPTY_TASKS, NULL);
+    if (w == 1) {
+      cpu_base = cpu;
+      empty_base = empty;
+      ref_sum = s;
+    } else if (s != ref_sum) {
+      printf("result mismatch with %i workers\n", w);
+      return EXIT_FAILURE;
+    }
+    printf("workers %i:  cpu bound %8.0f tasks/s (x%.2f)  empty %9.0f tasks/s (x%.2f)\n",
+        w, cpu, cpu / cpu_base, empty, empty / empty_base);
+  }
+  TASK_dump(IOSTD);
+  return EXIT_SUCCESS;
+}
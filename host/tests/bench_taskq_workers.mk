@@ -0,0 +1,3 @@
+CONFIG_TASK_QUEUE = 1
+CONFIG_ARCH_HOST_SMP = 1
+PROG_FLAGS += -DCONFIG_TASK_WORKERS=8 -DCONFIG_TASK_POOL=256
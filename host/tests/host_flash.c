@@ -0,0 +1,115 @@
+/*
+ * host_flash.c
+ *
+ * Simulated spi flash for host programs.
+ */
+
+#include "host_flash.h"
+#include "miniutils.h"
+
+host_flash host_flash_sim;
+
+static struct {
+  spi_flash_callback cb;
+  task *task;
+  task_timer timer;
+  int res;
+} flash_op;
+
+static void host_flash_done(u32_t arg, void *arg_p) {
+  spi_flash_dev *sfd = (spi_flash_dev *)arg_p;
+  sfd->busy = FALSE;
+  flash_op.cb(sfd, flash_op.res);
+}
+
+// Starts an operation completing after given time.
+static int host_flash_start(spi_flash_dev *sfd, spi_flash_callback cb, sys_time ms, int res) {
+  flash_op.cb = cb;
+  flash_op.res = res;
+  sfd->busy = TRUE;
+  TASK_start_timer(flash_op.task, &flash_op.timer, 0, sfd, ms, 0, "flash");
+  return SPI_OK;
+}
+
+// Returns SPI_FLASH_ERR_BUSY if operation cannot start, else SPI_OK.
+static int host_flash_check(spi_flash_dev *sfd) {
+  if (sfd->busy) {
+    host_flash_sim.overlapping_ops++;
+    return SPI_FLASH_ERR_BUSY;
+  }
+  if (host_flash_sim.busy_replies) {
+    host_flash_sim.busy_replies--;
+    return SPI_FLASH_ERR_BUSY;
+  }
+  return SPI_OK;
+}
+
+void host_flash_init(spi_flash_dev *sfd, u32_t size, u32_t page, u32_t sector,
+    u16_t page_write_ms, u16_t sector_erase_ms) {
+  ASSERT(size / sector <= HOST_FLASH_MAX_SECTORS);
+  free(host_flash_sim.mem);
+  memset(&host_flash_sim, 0, sizeof(host_flash_sim));
+  host_flash_sim.mem = malloc(size);
+  memset(host_flash_sim.mem, 0xff, size);
+  memset(sfd, 0, sizeof(spi_flash_dev));
+  sfd->flash_conf.size_total = size;
+  sfd->flash_conf.size_page_write_max = page;
+  sfd->flash_conf.size_sector_erase_min = sector;
+  sfd->flash_conf.time_page_write_ms = page_write_ms;
+  sfd->flash_conf.time_sector_erase_ms = sector_erase_ms;
+  sfd->open = TRUE;
+  if (flash_op.task == NULL) {
+    flash_op.task = TASK_create(host_flash_done, TASK_STATIC);
+  }
+}
+
+int SPI_FLASH_read(spi_flash_dev *sfd, spi_flash_callback cb, u32_t addr, u16_t size, u8_t *dest) {
+  int res = host_flash_check(sfd);
+  if (res != SPI_OK) return res;
+  if (addr + size > sfd->flash_conf.size_total) return SPI_FLASH_ERR_ADDRESS;
+  memcpy(dest, &host_flash_sim.mem[addr], size);
+  host_flash_sim.bytes_read += size;
+  // transfer at some 20 MHz is well below a ms
+  return host_flash_start(sfd, cb, 0, SPI_OK);
+}
+
+int SPI_FLASH_write(spi_flash_dev *sfd, spi_flash_callback cb, u32_t addr, u16_t size, u8_t *src) {
+  u32_t page = sfd->flash_conf.size_page_write_max;
+  u32_t i;
+  int res = host_flash_check(sfd);
+  if (res != SPI_OK) return res;
+  if (addr + size > sfd->flash_conf.size_total) return SPI_FLASH_ERR_ADDRESS;
+  if (addr / page != (addr + size - 1) / page) {
+    host_flash_sim.page_crossings++;
+  }
+  for (i = 0; i < size; i++) {
+    if (host_flash_sim.mem[addr + i] != 0xff) {
+      host_flash_sim.bad_programs++;
+    }
+    host_flash_sim.mem[addr + i] &= src[i];
+  }
+  host_flash_sim.bytes_written += size;
+  return host_flash_start(sfd, cb, sfd->flash_conf.time_page_write_ms, SPI_OK);
+}
+
+int SPI_FLASH_erase(spi_flash_dev *sfd, spi_flash_callback cb, u32_t addr, u32_t size) {
+  u32_t sector = sfd->flash_conf.size_sector_erase_min;
+  u32_t a;
+  int res = host_flash_check(sfd);
+  if (res != SPI_OK) return res;
+  if ((addr % sector) || (size % sector) || addr + size > sfd->flash_conf.size_total) {
+    return SPI_FLASH_ERR_ADDRESS;
+  }
+  res = SPI_OK;
+  for (a = addr; a < addr + size; a += sector) {
+    host_flash_sim.wear[a / sector]++;
+    if (host_flash_sim.failing[a / sector]) {
+      // worn out, left partially erased
+      memset(&host_flash_sim.mem[a], 0x5a, sector / 2);
+      res = SPI_ERR_BUS_PHY;
+    } else {
+      memset(&host_flash_sim.mem[a], 0xff, sector);
+    }
+  }
+  return host_flash_start(sfd, cb, (size / sector) * sfd->flash_conf.time_sector_erase_ms, res);
+}
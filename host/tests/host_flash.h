@@ -0,0 +1,44 @@
+/*
+ * host_flash.h
+ *
+ * Simulated spi flash for host programs, implementing SPI_FLASH_read,
+ * SPI_FLASH_write and SPI_FLASH_erase on ram with NOR semantics:
+ * programming only clears bits, erasing sets a whole sector. Operations
+ * complete on the virtual clock after the page write and sector erase
+ * times of the flash configuration, one at a time.
+ * Misuse is counted: programming bytes not erased, writes crossing a page,
+ * and operations started while busy. Erase counts are kept per sector, and
+ * erase failures and busy replies may be injected.
+ */
+
+#ifndef HOST_FLASH_H_
+#define HOST_FLASH_H_
+
+#include "spi_flash.h"
+
+#define HOST_FLASH_MAX_SECTORS    256
+
+typedef struct {
+  u8_t *mem;
+  // erases per sector
+  u32_t wear[HOST_FLASH_MAX_SECTORS];
+  // sectors failing to erase
+  bool failing[HOST_FLASH_MAX_SECTORS];
+  // number of next operations replying SPI_FLASH_ERR_BUSY
+  u32_t busy_replies;
+  // misuse
+  u32_t bad_programs;
+  u32_t page_crossings;
+  u32_t overlapping_ops;
+  // traffic
+  u32_t bytes_read;
+  u32_t bytes_written;
+} host_flash;
+
+extern host_flash host_flash_sim;
+
+/* Initiates a simulated flash of given geometry and timings, all erased */
+void host_flash_init(spi_flash_dev *sfd, u32_t size, u32_t page, u32_t sector,
+    u16_t page_write_ms, u16_t sector_erase_ms);
+
+#endif /* HOST_FLASH_H_ */
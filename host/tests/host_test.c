@@ -0,0 +1,73 @@
+/*
+ * host_test.c
+ *
+ * Support for host test and benchmark programs.
+ */
+
+#include "host_test.h"
+#include <unistd.h>
+
+u32_t host_test_failures = 0;
+u32_t host_putc_calls = 0;
+u32_t host_putb_calls = 0;
+u32_t host_put_bytes = 0;
+bool host_put_mute = FALSE;
+
+static u32_t g_rand = 1;
+
+void host_putc(int io, char c) {
+  host_putc_calls++;
+  host_put_bytes++;
+  if (!host_put_mute) {
+    fflush(stdout);
+    (void)write(STDOUT_FILENO, &c, 1);
+  }
+}
+
+void host_putb(int io, const void *b, int len) {
+  host_putb_calls++;
+  host_put_bytes += len;
+  if (!host_put_mute) {
+    fflush(stdout);
+    (void)write(STDOUT_FILENO, b, len);
+  }
+}
+
+static void host_test_assert(void) {
+  fflush(stdout);
+  fprintf(stderr, "assert in system, aborting\n");
+}
+
+void host_test_init(void) {
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  SYS_init();
+  SYS_set_assert_callback(host_test_assert);
+}
+
+int host_test_result(const char *name) {
+  fflush(stdout);
+  if (host_test_failures) {
+    printf("%s: %u checks FAILED\n", name, host_test_failures);
+    return EXIT_FAILURE;
+  }
+  printf("%s: OK\n", name);
+  return EXIT_SUCCESS;
+}
+
+u64_t host_test_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+u32_t host_test_rand(void) {
+  // xorshift32
+  g_rand ^= g_rand << 13;
+  g_rand ^= g_rand >> 17;
+  g_rand ^= g_rand << 5;
+  return g_rand;
+}
+
+void host_test_seed(u32_t seed) {
+  g_rand = seed ? seed : 1;
+}
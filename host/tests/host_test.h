@@ -0,0 +1,55 @@
+/*
+ * host_test.h
+ *
+ * Support for host test and benchmark programs: checks, host time and
+ * io output counting.
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "system.h"
+
+/* Counts a failure and prints the check if it does not hold */
+#define CHECK(x) \
+  do { \
+    if (!(x)) { \
+      printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #x); \
+      host_test_failures++; \
+    } \
+  } while (0)
+
+/* Same as CHECK, also printing two values */
+#define CHECK_EQ(a, b) \
+  do { \
+    long long __a = (long long)(a), __b = (long long)(b); \
+    if (__a != __b) { \
+      printf("%s:%i: check failed: %s == %s, %lld != %lld\n", \
+          __FILE__, __LINE__, #a, #b, __a, __b); \
+      host_test_failures++; \
+    } \
+  } while (0)
+
+extern u32_t host_test_failures;
+
+/* Output calls made by PUTC/PUTB to ios, see miniutils_config.h */
+extern u32_t host_putc_calls;
+extern u32_t host_putb_calls;
+extern u32_t host_put_bytes;
+/* When TRUE, io output is only counted, not written to stdout */
+extern bool host_put_mute;
+
+/* Initiates system and makes asserts abort the program */
+void host_test_init(void);
+/* Prints result of checks and returns exit code for main */
+int host_test_result(const char *name);
+/* Host monotonic time in ns, for benchmarks */
+u64_t host_test_ns(void);
+/* Deterministic pseudo random numbers */
+u32_t host_test_rand(void);
+void host_test_seed(u32_t seed);
+
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,130 @@
+/*
+ * test_heap.c
+ *
+ * Randomized test of the pairing heap in list.c against a plain array:
+ * inserts, deletes of any element, pops and order updates, with equal
+ * orders and wrapping sizes, checking heap order, links and contents
+ * after each operation.
+ */
+
+#include "host_test.h"
+#include "list.h"
+
+#define ELEMENTS  97
+#define OPS       200000
+
+typedef struct {
+  element_t e;
+  bool in;
+} item;
+
+static item items[ELEMENTS];
+static heap_t h;
+static u32_t members;
+
+// checks heap order and links of subtree, returns its size
+static u32_t subtree_check(element_t *e, element_t *parent) {
+  u32_t n = 0;
+  element_t *left = parent;
+  while (e) {
+    CHECK(list_get_order(e) >= list_get_order(parent));
+    CHECK(e->prev == left);
+    CHECK(((item *)e)->in);
+    n += 1 + subtree_check(e->child, e);
+    left = e;
+    e = e->next;
+    if (n > ELEMENTS) break;
+  }
+  return n;
+}
+
+static void heap_check(void) {
+  u32_t i, n = 0;
+  sys_time min = (sys_time)-1;
+  element_t *e;
+  CHECK_EQ(heap_count(&h), members);
+  for (i = 0; i < ELEMENTS; i++) {
+    if (items[i].in && list_get_order(&items[i]) < min) {
+      min = list_get_order(&items[i]);
+    }
+  }
+  if (members == 0) {
+    CHECK(heap_is_empty(&h));
+    return;
+  }
+  e = heap_first(&h);
+  CHECK(e != NULL && e->prev == NULL && e->next == NULL);
+  if (e == NULL) return;
+  CHECK_EQ(list_get_order(e), min);
+  CHECK_EQ(1 + subtree_check(e->child, e), members);
+  // traversal visits every element once
+  for (; e; e = heap_next(e)) {
+    n++;
+    if (n > ELEMENTS) break;
+  }
+  CHECK_EQ(n, members);
+}
+
+static sys_time rand_order(void) {
+  // small range gives many equal orders
+  return (host_test_rand() & 1) ? host_test_rand() % 16 : host_test_rand();
+}
+
+static void test_fuzz(void) {
+  u32_t op, i;
+  heap_init(&h);
+  host_test_seed(11);
+  for (op = 0; op < OPS; op++) {
+    u32_t r = host_test_rand() % 100;
+    item *it = &items[host_test_rand() % ELEMENTS];
+    if (r < 40) {
+      if (!it->in) {
+        list_set_order(it, rand_order());
+        heap_insert(&h, it);
+        it->in = TRUE;
+        members++;
+      }
+    } else if (r < 60) {
+      if (it->in) {
+        heap_delete(&h, it);
+        it->in = FALSE;
+        members--;
+      }
+    } else if (r < 80) {
+      item *p = (item *)heap_pop(&h);
+      CHECK((p == NULL) == (members == 0));
+      if (p) {
+        CHECK(p->in);
+        p->in = FALSE;
+        members--;
+      }
+    } else {
+      if (it->in) {
+        heap_update(&h, it, rand_order());
+      }
+    }
+    heap_check();
+    if (host_test_failures) {
+      printf("failed at op %u\n", op);
+      return;
+    }
+  }
+  // drains in order
+  sys_time last = 0;
+  for (i = 0; i < members + 1; i++) {
+    item *p = (item *)heap_pop(&h);
+    if (p == NULL) break;
+    CHECK(list_get_order(p) >= last);
+    last = list_get_order(p);
+    p->in = FALSE;
+  }
+  members = 0;
+  CHECK(heap_is_empty(&h));
+  CHECK_EQ(heap_count(&h), 0);
+}
+
+int main(void) {
+  host_test_init();
+  test_fuzz();
+  return host_test_result("heap");
+}
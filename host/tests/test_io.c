@@ -0,0 +1,240 @@
+/*
+ * test_io.c
+ *
+ * Io on ringbuffer and memory media: vectored writes, all or nothing on a
+ * ringbuffer, zero copy reads by peek and consume across the ringbuffer
+ * wrap, mixed with the plain char and buffer calls, checked against a
+ * reference fifo in random sequences. Memory io gets framed writes and
+ * reads back in place.
+ */
+
+#include "host_test.h"
+#include "io.h"
+#include "ringbuf.h"
+#include "miniutils.h"
+
+#define IO_RB     1
+#define IO_MEM    2
+#define SIZE      100
+#define OPS       200000
+
+static u8_t mem[SIZE];
+static ringbuf rb;
+
+// reference fifo
+static u8_t ref[SIZE];
+static u32_t ref_r, ref_w;
+static u8_t next_w = 0;
+static u32_t iov_full, peeks_wrapped;
+
+static u32_t ref_len(void) {
+  return ref_w - ref_r;
+}
+
+static void ref_put(u8_t c) {
+  ref[ref_w++ % SIZE] = c;
+}
+
+static u8_t ref_get(void) {
+  return ref[ref_r++ % SIZE];
+}
+
+static void check_avail(void) {
+  CHECK_EQ(IO_rx_available(IO_RB), ref_len());
+  // ringbuffer keeps one byte empty
+  CHECK_EQ(IO_tx_available(IO_RB), SIZE - 1 - ref_len());
+}
+
+static void op_put_iov(void) {
+  u8_t parts[4][40];
+  io_iov iov[4];
+  u8_t cnt = host_test_rand() % 5;
+  u32_t i, j, total = 0;
+  for (i = 0; i < cnt; i++) {
+    iov[i].buf = parts[i];
+    iov[i].len = host_test_rand() % 41;
+    for (j = 0; j < iov[i].len; j++) {
+      parts[i][j] = next_w + total + j;
+    }
+    total += iov[i].len;
+  }
+  s32_t res = IO_put_iov(IO_RB, iov, cnt);
+  if (total > SIZE - 1 - ref_len()) {
+    // nothing of a vector not fitting is written
+    CHECK_EQ(res, RB_ERR_FULL);
+    iov_full++;
+  } else {
+    CHECK_EQ(res, total);
+    for (i = 0; i < total; i++) {
+      ref_put(next_w++);
+    }
+  }
+}
+
+static void op_put(void) {
+  u8_t buf[16];
+  u32_t i, len = host_test_rand() % sizeof(buf);
+  if (host_test_rand() & 1) {
+    if (IO_put_char(IO_RB, next_w) == RB_OK) {
+      CHECK(ref_len() < SIZE - 1);
+      ref_put(next_w++);
+    } else {
+      CHECK_EQ(ref_len(), SIZE - 1);
+    }
+    return;
+  }
+  for (i = 0; i < len; i++) {
+    buf[i] = next_w + i;
+  }
+  s32_t res = IO_put_buf(IO_RB, buf, len);
+  if (res < 0) {
+    CHECK_EQ(res, RB_ERR_FULL);
+    CHECK_EQ(ref_len(), SIZE - 1);
+    return;
+  }
+  CHECK_EQ(res, MIN(len, SIZE - 1 - ref_len()));
+  for (i = 0; i < (u32_t)res; i++) {
+    ref_put(next_w++);
+  }
+}
+
+static void op_peek_consume(void) {
+  u8_t *p = NULL;
+  s32_t len = IO_peek_linear(IO_RB, &p);
+  s32_t i;
+  CHECK(len >= 0 && len <= (s32_t)ref_len());
+  if (len < (s32_t)ref_len()) {
+    // rest is at the start of the buffer after the wrap
+    CHECK_EQ(len, &mem[SIZE] - p);
+    peeks_wrapped++;
+  }
+  if (len == 0) {
+    CHECK_EQ(ref_len(), 0);
+    return;
+  }
+  s32_t use = 1 + host_test_rand() % len;
+  for (i = 0; i < use; i++) {
+    CHECK_EQ(p[i], ref[(ref_r + i) % SIZE]);
+  }
+  // peeking again gives the same
+  u8_t *p2 = NULL;
+  CHECK_EQ(IO_peek_linear(IO_RB, &p2), len);
+  CHECK(p2 == p);
+  CHECK_EQ(IO_consume(IO_RB, use), use);
+  ref_r += use;
+}
+
+static void op_get(void) {
+  u8_t buf[16];
+  s32_t i, res;
+  if (host_test_rand() & 1) {
+    res = IO_get_char(IO_RB);
+    if (ref_len()) {
+      CHECK_EQ(res, ref_get());
+    } else {
+      CHECK_EQ(res, RB_ERR_EMPTY);
+    }
+    return;
+  }
+  res = IO_get_buf(IO_RB, buf, 1 + host_test_rand() % sizeof(buf));
+  if (ref_len() == 0) {
+    CHECK_EQ(res, RB_ERR_EMPTY);
+    return;
+  }
+  CHECK(res > 0);
+  for (i = 0; i < res; i++) {
+    CHECK_EQ(buf[i], ref_get());
+  }
+}
+
+static void test_ringbuffer(void) {
+  u32_t op;
+  ringbuf_init(&rb, mem, SIZE);
+  IO_define(IO_RB, io_ringbuffer, (uintptr_t)&rb);
+  host_test_seed(23);
+  for (op = 0; op < OPS && host_test_failures == 0; op++) {
+    u32_t r = host_test_rand() % 10;
+    if (r < 3) {
+      op_put_iov();
+    } else if (r < 5) {
+      op_put();
+    } else if (r < 8) {
+      op_peek_consume();
+    } else {
+      op_get();
+    }
+    check_avail();
+  }
+  CHECK(iov_full > 0);
+  CHECK(peeks_wrapped > 0);
+
+  // drained by peeks, no more than two per fill
+  while (ref_len() < SIZE - 1) {
+    ref_put(next_w);
+    CHECK_EQ(IO_put_char(IO_RB, next_w++), RB_OK);
+  }
+  u32_t peeks = 0;
+  while (ref_len()) {
+    u8_t *p;
+    s32_t len = IO_peek_linear(IO_RB, &p);
+    CHECK(len > 0);
+    CHECK_EQ(*p, ref[ref_r % SIZE]);
+    CHECK_EQ(IO_consume(IO_RB, len), len);
+    ref_r += len;
+    peeks++;
+  }
+  CHECK(peeks <= 2);
+  u8_t *p;
+  CHECK_EQ(IO_peek_linear(IO_RB, &p), 0);
+  // empty vector of a full size frame fits exactly
+  u8_t frame[SIZE - 1];
+  io_iov iov[2] = {{frame, SIZE - 2}, {frame, 1}};
+  CHECK_EQ(IO_put_iov(IO_RB, iov, 2), SIZE - 1);
+  CHECK_EQ(IO_put_iov(IO_RB, iov, 0), 0);
+  CHECK_EQ(IO_put_iov(IO_RB, &iov[1], 1), RB_ERR_FULL);
+  printf("%u ops, %u vectors not fitting, %u wrapped peeks\n", OPS, iov_full, peeks_wrapped);
+}
+
+static void test_memory(void) {
+  u8_t buf[64];
+  u8_t hdr[3] = {0x7e, 0x01, 0x04};
+  u8_t payload[4] = {'d', 'a', 't', 'a'};
+  u8_t crc[2] = {0xa5, 0x5a};
+  io_iov iov[3] = {{hdr, sizeof(hdr)}, {payload, sizeof(payload)}, {crc, sizeof(crc)}};
+  u8_t *p;
+  memset(buf, 0, sizeof(buf));
+
+  // framed writes land back to back, after what is already written
+  IO_define(IO_MEM, io_memory, (uintptr_t)buf);
+  CHECK_EQ(IO_put_char(IO_MEM, 0x55), 0x55);
+  CHECK_EQ(IO_put_iov(IO_MEM, iov, 3), 9);
+  CHECK_EQ(IO_put_iov(IO_MEM, &iov[1], 1), 4);
+  CHECK_EQ(IO_put_buf(IO_MEM, crc, 2), 2);
+  const u8_t expect[] = {0x55, 0x7e, 0x01, 0x04, 'd', 'a', 't', 'a', 0xa5, 0x5a,
+      'd', 'a', 't', 'a', 0xa5, 0x5a};
+  CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+  CHECK_EQ(buf[sizeof(expect)], 0);
+  // next write goes after the last
+  CHECK_EQ(IO_peek_linear(IO_MEM, &p), 0xffff);
+  CHECK(p == &buf[sizeof(expect)]);
+
+  // read in place from the start
+  IO_define(IO_MEM, io_memory, (uintptr_t)buf);
+  CHECK_EQ(IO_get_char(IO_MEM), 0x55);
+  CHECK_EQ(IO_peek_linear(IO_MEM, &p), 0xffff);
+  CHECK(p == &buf[1]);
+  CHECK_EQ(p[0], 0x7e);
+  CHECK_EQ(IO_consume(IO_MEM, sizeof(hdr)), sizeof(hdr));
+  u8_t rd[4];
+  CHECK_EQ(IO_get_buf(IO_MEM, rd, sizeof(rd)), sizeof(rd));
+  CHECK(memcmp(rd, payload, sizeof(rd)) == 0);
+  CHECK_EQ(IO_peek_linear(IO_MEM, &p), 0xffff);
+  CHECK(p == &buf[8]);
+}
+
+int main(void) {
+  host_test_init();
+  test_ringbuffer();
+  test_memory();
+  return host_test_result("io");
+}
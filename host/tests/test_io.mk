@@ -0,0 +1,2 @@
+CONFIG_IO = 1
+CONFIG_RINGBUFFER = 1
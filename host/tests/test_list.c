@@ -0,0 +1,120 @@
+/*
+ * test_list.c
+ *
+ * Regression test of the linked list: all operations, checking links,
+ * length and sort order after each.
+ */
+
+#include "host_test.h"
+#include "list.h"
+
+#define ELEMENTS  64
+
+typedef struct {
+  element_t e;
+  u32_t id;
+} item;
+
+static item items[ELEMENTS];
+
+// checks links both ways and length, returns length
+static u32_t list_check(list_t *l) {
+  u32_t n = 0;
+  element_t *prev = NULL;
+  element_t *e = list_first(l);
+  while (e) {
+    CHECK(list_prev(e) == prev);
+    prev = e;
+    e = list_next(e);
+    n++;
+    if (n > ELEMENTS) break;
+  }
+  CHECK(list_last(l) == prev);
+  CHECK_EQ(list_count(l), n);
+  return n;
+}
+
+static u32_t id_at(list_t *l, u32_t ix) {
+  element_t *e = list_first(l);
+  while (ix-- && e) {
+    e = list_next(e);
+  }
+  return e ? ((item *)e)->id : (u32_t)-1;
+}
+
+static void test_ops(void) {
+  list_t l, m;
+  u32_t i;
+  list_init(&l);
+  list_init(&m);
+  CHECK(list_is_empty(&l));
+  for (i = 0; i < 8; i++) {
+    items[i].id = i;
+    list_add(&l, &items[i]);
+  }
+  CHECK_EQ(list_check(&l), 8);
+  CHECK_EQ(id_at(&l, 0), 0);
+  CHECK_EQ(id_at(&l, 7), 7);
+
+  list_delete(&l, &items[0]);
+  list_delete(&l, &items[7]);
+  list_delete(&l, &items[4]);
+  CHECK_EQ(list_check(&l), 5);
+  CHECK_EQ(id_at(&l, 0), 1);
+  CHECK_EQ(id_at(&l, 3), 5);
+
+  list_add_first(&l, &items[0]);
+  list_insert_before(&l, &items[4], &items[5]);
+  CHECK_EQ(list_check(&l), 7);
+  CHECK_EQ(id_at(&l, 0), 0);
+  CHECK_EQ(id_at(&l, 4), 4);
+  CHECK_EQ(id_at(&l, 5), 5);
+
+  list_move_last(&l, &items[0]);
+  CHECK_EQ(list_check(&l), 7);
+  CHECK_EQ(id_at(&l, 6), 0);
+
+  items[7].id = 7;
+  list_add(&m, &items[7]);
+  list_move_all_first(&l, &m);
+  CHECK(list_is_empty(&m));
+  CHECK_EQ(list_check(&l), 8);
+  CHECK_EQ(id_at(&l, 0), 7);
+
+  list_move_all(&m, &l);
+  CHECK(list_is_empty(&l));
+  CHECK_EQ(list_check(&l), 0);
+  CHECK_EQ(list_check(&m), 8);
+  CHECK_EQ(id_at(&m, 0), 7);
+}
+
+static void test_sort_insert(void) {
+  list_t l;
+  u32_t i;
+  list_init(&l);
+  host_test_seed(42);
+  for (i = 0; i < ELEMENTS; i++) {
+    items[i].id = i;
+    // few distinct orders, to check placement among equal orders
+    list_set_order(&items[i], host_test_rand() % 16);
+    list_sort_insert(&l, &items[i]);
+  }
+  CHECK_EQ(list_check(&l), ELEMENTS);
+  element_t *e = list_first(&l);
+  while (list_next(e)) {
+    element_t *n = list_next(e);
+    CHECK(list_get_order(e) <= list_get_order(n));
+    if (list_get_order(e) == list_get_order(n)) {
+      // inserted before elements of same order
+      CHECK(((item *)e)->id > ((item *)n)->id);
+    }
+    e = n;
+  }
+}
+
+int main(void) {
+  host_test_init();
+  test_ops();
+  test_sort_insert();
+  return host_test_result("list");
+}
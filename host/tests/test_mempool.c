@@ -0,0 +1,130 @@
+/*
+ * test_mempool.c
+ *
+ * Fixed block pools: exhaustion, ownership, statistics and size class
+ * fallback, and a random alloc/free run checked against block contents.
+ */
+
+#include "host_test.h"
+#include "mempool.h"
+#include "miniutils.h"
+
+#define BLOCKS        32
+#define RANDOM_OPS    200000
+
+static u8_t mem_a[MEMPOOL_MEM_SIZE(20, BLOCKS)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+static u8_t mem_s[MEMPOOL_MEM_SIZE(16, 8)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+static u8_t mem_m[MEMPOOL_MEM_SIZE(64, 4)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+static u8_t mem_l[MEMPOOL_MEM_SIZE(256, 2)] __attribute__ (( aligned(CONFIG_MEMPOOL_ALIGN) ));
+
+static void test_pool(void) {
+  mempool p;
+  void *b[BLOCKS + 1];
+  u32_t i, j;
+  mempool_init(&p, mem_a, sizeof(mem_a), 20, MEMPOOL_ATTR_IRQ_SAFE);
+  CHECK_EQ(p.block_size, 24);
+  CHECK_EQ(p.blocks, BLOCKS);
+  for (i = 0; i < BLOCKS; i++) {
+    b[i] = mempool_alloc(&p);
+    CHECK(b[i] != NULL);
+    CHECK(mempool_owns(&p, b[i]));
+    CHECK_EQ(((uintptr_t)b[i]) & (CONFIG_MEMPOOL_ALIGN - 1), 0);
+    for (j = 0; j < i; j++) {
+      CHECK(b[i] != b[j]);
+    }
+  }
+  // first block first
+  CHECK(b[0] == (void *)mem_a);
+  CHECK_EQ(mempool_available(&p), 0);
+  CHECK(mempool_alloc(&p) == NULL);
+  CHECK_EQ(p.fails, 1);
+  CHECK(!mempool_owns(&p, mem_a + sizeof(mem_a)));
+  for (i = 0; i < BLOCKS / 2; i++) {
+    mempool_free(&p, b[i]);
+  }
+  mempool_free(&p, NULL);
+  CHECK_EQ(p.used, BLOCKS / 2);
+  CHECK_EQ(p.peak, BLOCKS);
+  CHECK_EQ(p.allocs, BLOCKS);
+  // last freed is reused first
+  CHECK(mempool_alloc(&p) == b[BLOCKS / 2 - 1]);
+  mempool_stats_reset(&p);
+  CHECK_EQ(p.peak, BLOCKS / 2 + 1);
+  CHECK_EQ(p.allocs, 0);
+  CHECK_EQ(p.fails, 0);
+}
+
+static void test_group(void) {
+  mempool pools[3];
+  mempool_group g;
+  void *b[16];
+  u32_t i;
+  mempool_init(&pools[0], mem_s, sizeof(mem_s), 16, 0);
+  mempool_init(&pools[1], mem_m, sizeof(mem_m), 64, 0);
+  mempool_init(&pools[2], mem_l, sizeof(mem_l), 256, 0);
+  mempool_group_init(&g, pools, 3);
+
+  // smallest fitting class
+  b[0] = mempool_group_alloc(&g, 1);
+  CHECK(mempool_owns(&pools[0], b[0]));
+  b[1] = mempool_group_alloc(&g, 17);
+  CHECK(mempool_owns(&pools[1], b[1]));
+  b[2] = mempool_group_alloc(&g, 256);
+  CHECK(mempool_owns(&pools[2], b[2]));
+  CHECK(mempool_group_alloc(&g, 257) == NULL);
+  CHECK_EQ(g.req_bytes, 1 + 17 + 256);
+  CHECK_EQ(g.blk_bytes, 16 + 64 + 256);
+  mempool_group_free(&g, b[0]);
+  mempool_group_free(&g, b[1]);
+  mempool_group_free(&g, b[2]);
+
+  // exhausted class falls back to next larger
+  for (i = 0; i < 8; i++) {
+    b[i] = mempool_group_alloc(&g, 16);
+    CHECK(mempool_owns(&pools[0], b[i]));
+  }
+  b[8] = mempool_group_alloc(&g, 16);
+  CHECK(mempool_owns(&pools[1], b[8]));
+  for (i = 0; i <= 8; i++) {
+    mempool_group_free(&g, b[i]);
+  }
+  CHECK_EQ(pools[0].used + pools[1].used + pools[2].used, 0);
+}
+
+static void test_random(void) {
+  mempool p;
+  void *live[BLOCKS];
+  u32_t n = 0, i, j;
+  mempool_init(&p, mem_a, sizeof(mem_a), 20, 0);
+  host_test_seed(0x3e3);
+  for (i = 0; i < RANDOM_OPS; i++) {
+    u32_t r = host_test_rand();
+    if ((r & 1) && n < BLOCKS) {
+      u8_t *b = mempool_alloc(&p);
+      CHECK(b != NULL);
+      // tag whole block, so overlapping blocks would be caught
+      for (j = 0; j < p.block_size; j++) {
+        b[j] = (u8_t)(uintptr_t)b;
+      }
+      live[n++] = b;
+    } else if (n > 0) {
+      u32_t k = (r >> 1) % n;
+      u8_t *b = live[k];
+      for (j = 0; j < p.block_size; j++) {
+        if (b[j] != (u8_t)(uintptr_t)b) break;
+      }
+      CHECK_EQ(j, p.block_size);
+      mempool_free(&p, b);
+      live[k] = live[--n];
+    }
+    CHECK_EQ(p.used, n);
+  }
+}
+
+int main(void) {
+  host_test_init();
+  test_pool();
+  test_group();
+  test_random();
+  return host_test_result("mempool");
+}
@@ -0,0 +1,80 @@
+/*
+ * test_miniutils.c
+ *
+ * Regression test of miniutils formatting and string functions.
+ */
+
+#include "host_test.h"
+#include "miniutils.h"
+
+static char out[256];
+
+#define CHECK_FMT(exp, ...) \
+  do { \
+    memset(out, 0, sizeof(out)); \
+    sprint(out, __VA_ARGS__); \
+    if (mu_strcmp(out, (exp)) != 0) { \
+      printf("%s:%i: sprint gave \"%s\", expected \"%s\"\n", \
+          __FILE__, __LINE__, out, (exp)); \
+      host_test_failures++; \
+    } \
+  } while (0)
+
+static void test_format(void) {
+  CHECK_FMT("plain", "plain");
+  CHECK_FMT("100%", "100%%");
+  CHECK_FMT("-42 42 4294967254", "%i %d %u", -42, 42, -42);
+  CHECK_FMT("ff FF 377 101", "%x %X %o %b", 255, 255, 255, 5);
+  CHECK_FMT("   42|00042", "%5i|%05i", 42, 42);
+  CHECK_FMT("x abc|  abc|abc  ", "%c %s|%5s|%-5s", 'x', "abc", "abc", "abc");
+  CHECK_FMT("0000beef", "%08x", 0xbeef);
+  CHECK_FMT("1.50 -2.25 0.001", "%.2f %.2f %.3f", 1.5, -2.25, 0.001);
+  CHECK_FMT("12345678901234", "%lli", 12345678901234LL);
+}
+
+static void test_strings(void) {
+  char buf[16];
+  CHECK_EQ(strlen("hello"), 5);
+  CHECK_EQ(strnlen("hello", 3), 3);
+  CHECK(strcmp("abc", "abc") == 0);
+  CHECK(strcmp("abc", "abd") != 0);
+  CHECK(strncmp("abcx", "abcy", 3) == 0);
+  CHECK_EQ(atoi("-123"), -123);
+  CHECK_EQ(atoin("ff", 16, 2), 255);
+  itoa(-77, buf, 10);
+  CHECK(strcmp(buf, "-77") == 0);
+  CHECK(strchr("hello", 'l') == &"hello"[2] || *strchr("hello", 'l') == 'l');
+  CHECK(strstr("find the needle", "needle") != NULL);
+  CHECK(strstr("find the needle", "pin") == NULL);
+}
+
+static void test_print(void) {
+  // print to an io goes by PUTC/PUTB
+  u32_t bytes = host_put_bytes;
+  u32_t calls = host_putc_calls + host_putb_calls;
+  host_put_mute = TRUE;
+  ioprint(IOSTD, "%s %i\n", "counted", 12345);
+  host_put_mute = FALSE;
+  CHECK_EQ(host_put_bytes - bytes, 14);
+#ifdef MINIUTILS_PRINT_BUFFER
+  // staged and put in one go
+  CHECK_EQ(host_putc_calls + host_putb_calls - calls, 1);
+  // longer than staging buffer, put in several
+  bytes = host_put_bytes;
+  host_put_mute = TRUE;
+  ioprint(IOSTD, "%032i|%s|%c\n", 7,
+      "a string longer than a small staging buffer, put directly", 'z');
+  host_put_mute = FALSE;
+  CHECK_EQ(host_put_bytes - bytes, 32 + 1 + 57 + 1 + 1 + 1);
+#else
+  CHECK(host_putc_calls + host_putb_calls - calls > 1);
+#endif
+}
+
+int main(void) {
+  host_test_init();
+  test_format();
+  test_strings();
+  test_print();
+  return host_test_result("miniutils");
+}
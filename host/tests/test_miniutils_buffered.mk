@@ -0,0 +1,2 @@
+SRC = test_miniutils.c
+PROG_FLAGS += -DMINIUTILS_PRINT_BUFFER=32
@@ -0,0 +1,388 @@
+/*
+ * test_os.c
+ *
+ * OS API on the virtual clock: sleep and join wakeup times, mutual
+ * exclusion and try lock, priority inheritance, also through a chain of
+ * mutexes and to threads taking a mutex others block on, priority ordered
+ * mutex wakeup, cond signal, broadcast and timed wait, and next wakeup
+ * reporting. All times are exact, as the
+ * clock only moves when every thread waits or busy waits.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define THREADS       8
+#define COUNTS        1000
+#define ITEMS         2000
+#define SLOTS         4
+
+static os_thread thr[THREADS];
+static u8_t stacks[THREADS][256];
+static os_mutex mutex;
+static os_mutex mutex_b;
+static os_cond cond;
+static os_cond cond_free;
+static sys_time t0;
+static sys_time at[THREADS];
+static u8_t prio_at[THREADS];
+static char trace[THREADS + 1];
+static u32_t trace_len;
+
+// Creates threads from kernel with given priorities and runs until all
+// are done.
+static void run(u32_t count, void *(**f)(void *), const u8_t *prio) {
+  u32_t i;
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    OS_thread_create(&thr[i], 0, f[i], (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "thr");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  t0 = SYS_get_time_ms();
+  exit_critical();
+  while (OS_get_running_threads()) {
+    arch_sleep();
+  }
+  // let sleepers left behind by a failing test finish
+  while (OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+}
+
+static void busy_ms(u32_t ms) {
+  sys_time until = SYS_get_time_ms() + ms;
+  while (SYS_get_time_ms() < until) {
+    SYS_hardsleep_ms(1);
+  }
+}
+
+static void *sleep_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  OS_thread_sleep(3 + i * 7);
+  at[i] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void *join_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  sys_time next;
+  // others are sleeping, thread 0 first
+  CHECK_EQ(OS_get_next_wakeup(&next), OS_WUP_SLEEP_RUNNING);
+  CHECK_EQ(next, t0 + 3);
+  OS_thread_join(&thr[2]);
+  at[i] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void test_sleep_join(void) {
+  void *(*f[])(void *) = {sleep_f, sleep_f, sleep_f, join_f};
+  const u8_t prio[] = {10, 10, 10, 5};
+  run(4, f, prio);
+  CHECK_EQ(at[0], 3);
+  CHECK_EQ(at[1], 10);
+  CHECK_EQ(at[2], 17);
+  CHECK_EQ(at[3], 17);
+}
+
+static volatile u32_t counter;
+static volatile bool inside;
+
+static void *count_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < COUNTS; i++) {
+    OS_mutex_lock(&mutex);
+    CHECK(!inside);
+    inside = TRUE;
+    u32_t c = counter;
+    // give others a go while holding the mutex
+    if ((i & 7) == 0) OS_thread_yield();
+    if ((i & 63) == 0) OS_thread_sleep(1);
+    counter = c + 1;
+    inside = FALSE;
+    OS_mutex_unlock(&mutex);
+    if (i & 1) OS_thread_yield();
+  }
+  return NULL;
+}
+
+static void *try_f(void *arg) {
+  u32_t got = 0, busy = 0;
+  while (counter < 4 * COUNTS) {
+    if (OS_mutex_try_lock(&mutex)) {
+      CHECK(!inside);
+      got++;
+      OS_mutex_unlock(&mutex);
+      OS_thread_yield();
+    } else {
+      // holder may be sleeping, and polling alone does not move the clock
+      busy++;
+      SYS_hardsleep_us(300);
+      OS_thread_yield();
+    }
+  }
+  CHECK(got > 0);
+  CHECK(busy > 0);
+  return NULL;
+}
+
+static void test_mutex(void) {
+  void *(*f[])(void *) = {count_f, count_f, count_f, count_f, try_f};
+  const u8_t prio[] = {20, 20, 20, 20, 20};
+  OS_mutex_init(&mutex, 0);
+  counter = 0;
+  run(5, f, prio);
+  CHECK_EQ(counter, 4 * COUNTS);
+}
+
+static void *pi_low_f(void *arg) {
+  OS_mutex_lock(&mutex);
+  busy_ms(5);
+  at[0] = SYS_get_time_ms() - t0;
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void *pi_high_f(void *arg) {
+  OS_thread_sleep(1);
+  OS_mutex_lock(&mutex);
+  at[1] = SYS_get_time_ms() - t0;
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void *pi_mid_f(void *arg) {
+  OS_thread_sleep(2);
+  busy_ms(20);
+  at[2] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void test_prio_inheritance(void) {
+  void *(*f[])(void *) = {pi_low_f, pi_high_f, pi_mid_f};
+  const u8_t prio[] = {10, 200, 100};
+  OS_mutex_init(&mutex, 0);
+  run(3, f, prio);
+  // low holds mutex at high's priority, so mid cannot starve it
+  CHECK_EQ(at[0], 5);
+  CHECK_EQ(at[1], 5);
+  CHECK_EQ(at[2], 25);
+}
+
+// low holds A, mid holds B and blocks on A, high blocks on B
+static void *chain_low_f(void *arg) {
+  OS_mutex_lock(&mutex);
+  busy_ms(10);
+  at[0] = SYS_get_time_ms() - t0;
+  prio_at[0] = OS_thread_get_prio(OS_thread_self());
+  OS_mutex_unlock(&mutex);
+  prio_at[3] = OS_thread_get_prio(OS_thread_self());
+  return NULL;
+}
+
+static void *chain_mid_f(void *arg) {
+  OS_thread_sleep(1);
+  OS_mutex_lock(&mutex_b);
+  OS_mutex_lock(&mutex);
+  prio_at[1] = OS_thread_get_prio(OS_thread_self());
+  OS_mutex_unlock(&mutex);
+  OS_mutex_unlock(&mutex_b);
+  return NULL;
+}
+
+static void *chain_high_f(void *arg) {
+  OS_thread_sleep(2);
+  OS_mutex_lock(&mutex_b);
+  at[2] = SYS_get_time_ms() - t0;
+  OS_mutex_unlock(&mutex_b);
+  return NULL;
+}
+
+static void *chain_noise_f(void *arg) {
+  OS_thread_sleep(3);
+  busy_ms(30);
+  at[4] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void test_prio_chain(void) {
+  void *(*f[])(void *) = {chain_low_f, chain_mid_f, chain_high_f, chain_noise_f};
+  const u8_t prio[] = {10, 50, 200, 100};
+  OS_mutex_init(&mutex, 0);
+  OS_mutex_init(&mutex_b, 0);
+  run(4, f, prio);
+  // high's priority reaches low through mid, so noise cannot starve low
+  CHECK_EQ(prio_at[0], 200);
+  CHECK_EQ(at[0], 10);
+  // mid still holds B wanted by high when getting A
+  CHECK_EQ(prio_at[1], 200);
+  CHECK_EQ(at[2], 10);
+  CHECK_EQ(prio_at[3], 10);
+  // noise only starts once the chain is through
+  CHECK_EQ(at[4], 40);
+}
+
+// owner holds A and B, three waiters block on A, one on B
+static void *order_owner_f(void *arg) {
+  OS_mutex_lock(&mutex);
+  OS_mutex_lock(&mutex_b);
+  busy_ms(10);
+  prio_at[0] = OS_thread_get_prio(OS_thread_self());
+  OS_mutex_unlock(&mutex_b);
+  // left with priority of first thread blocked on A
+  prio_at[1] = OS_thread_get_prio(OS_thread_self());
+  busy_ms(5);
+  OS_mutex_unlock(&mutex);
+  prio_at[2] = OS_thread_get_prio(OS_thread_self());
+  return NULL;
+}
+
+static void *order_waiter_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  OS_thread_sleep(i);
+  OS_mutex_lock(i == 4 ? &mutex_b : &mutex);
+  at[i] = SYS_get_time_ms() - t0;
+  trace[trace_len++] = '0' + i;
+  trace[trace_len] = 0;
+  OS_mutex_unlock(i == 4 ? &mutex_b : &mutex);
+  return NULL;
+}
+
+static void *order_raise_f(void *arg) {
+  OS_thread_sleep(6);
+  // first and lowest waiter on A overtakes the others while blocked
+  OS_thread_set_prio(&thr[1], 90);
+  return NULL;
+}
+
+static void test_block_order(void) {
+  void *(*f[])(void *) = {order_owner_f, order_waiter_f, order_waiter_f,
+      order_waiter_f, order_waiter_f, order_raise_f};
+  const u8_t prio[] = {10, 50, 70, 60, 200, 250};
+  OS_mutex_init(&mutex, 0);
+  OS_mutex_init(&mutex_b, 0);
+  trace_len = 0;
+  run(6, f, prio);
+  CHECK_EQ(prio_at[0], 200);
+  CHECK_EQ(prio_at[1], 90);
+  CHECK_EQ(prio_at[2], 10);
+  CHECK_EQ(at[4], 10);
+  CHECK_EQ(at[1], 15);
+  CHECK(strcmp(trace, "4123") == 0);
+  if (host_test_failures) printf("trace %s\n", trace);
+}
+
+static u32_t buf[SLOTS];
+static u32_t buf_count, buf_head;
+static u32_t consumed_sum, consumed_next;
+
+static void *producer_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < ITEMS; i++) {
+    OS_mutex_lock(&mutex);
+    while (buf_count == SLOTS) {
+      OS_cond_wait(&cond_free, &mutex);
+    }
+    buf[(buf_head + buf_count) % SLOTS] = i;
+    buf_count++;
+    OS_cond_signal(&cond);
+    OS_mutex_unlock(&mutex);
+    if ((i % 100) == 0) OS_thread_sleep(1);
+  }
+  return NULL;
+}
+
+static void *consumer_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < ITEMS; i++) {
+    OS_mutex_lock(&mutex);
+    while (buf_count == 0) {
+      OS_cond_wait(&cond, &mutex);
+    }
+    u32_t v = buf[buf_head];
+    buf_head = (buf_head + 1) % SLOTS;
+    buf_count--;
+    OS_cond_signal(&cond_free);
+    OS_mutex_unlock(&mutex);
+    CHECK_EQ(v, consumed_next);
+    consumed_next = v + 1;
+    consumed_sum += v;
+    if ((i % 300) == 0) OS_thread_sleep(2);
+  }
+  return NULL;
+}
+
+static void test_producer_consumer(void) {
+  void *(*f[])(void *) = {producer_f, consumer_f};
+  const u8_t prio[] = {30, 31};
+  OS_mutex_init(&mutex, 0);
+  OS_cond_init(&cond);
+  OS_cond_init(&cond_free);
+  run(2, f, prio);
+  CHECK_EQ(consumed_next, ITEMS);
+  CHECK_EQ(consumed_sum, ITEMS * (ITEMS - 1) / 2);
+  CHECK_EQ(buf_count, 0);
+}
+
+static u32_t woken;
+
+static void *bc_wait_f(void *arg) {
+  OS_mutex_lock(&mutex);
+  OS_cond_wait(&cond, &mutex);
+  woken++;
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void *bc_timed_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  OS_mutex_lock(&mutex);
+  // TRUE when timed out, as on target
+  at[i] = OS_cond_timed_wait(&cond, &mutex, 50) ? 1000 : SYS_get_time_ms() - t0;
+  woken++;
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void *bc_timeout_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  OS_mutex_lock(&mutex);
+  at[i] = OS_cond_timed_wait(&cond_free, &mutex, 7) ? SYS_get_time_ms() - t0 : 1000;
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void *bc_f(void *arg) {
+  OS_thread_sleep(10);
+  OS_mutex_lock(&mutex);
+  OS_cond_broadcast(&cond);
+  OS_mutex_unlock(&mutex);
+  return NULL;
+}
+
+static void test_broadcast(void) {
+  void *(*f[])(void *) = {bc_wait_f, bc_wait_f, bc_timed_f, bc_timed_f, bc_timeout_f, bc_f};
+  const u8_t prio[] = {40, 40, 40, 41, 40, 39};
+  OS_mutex_init(&mutex, 0);
+  OS_cond_init(&cond);
+  OS_cond_init(&cond_free);
+  woken = 0;
+  run(6, f, prio);
+  CHECK_EQ(woken, 4);
+  CHECK_EQ(at[2], 10);
+  CHECK_EQ(at[3], 10);
+  CHECK_EQ(at[4], 7);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_sleep_join();
+  test_mutex();
+  test_prio_inheritance();
+  test_prio_chain();
+  test_block_order();
+  test_producer_consumer();
+  test_broadcast();
+  return host_test_result("os");
+}
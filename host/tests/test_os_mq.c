@@ -0,0 +1,268 @@
+/*
+ * test_os_mq.c
+ *
+ * os_mq on the virtual clock: ordering, full and empty queues, exact
+ * timeouts, pointer passing, and a stress of several producers and
+ * consumers with random sleeps, plus posts from kernel context standing
+ * in for interrupts, checking every message arrives once and in order
+ * per sender.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define THREADS     8
+#define SLOTS       4
+#define PRODUCERS   3
+#define CONSUMERS   3
+#define MSGS        3000
+#define POSTS       2000
+#define BUFS        6
+
+typedef struct {
+  u16_t from;
+  u16_t check;
+  u32_t seq;
+  u8_t pad[8];
+} msg;
+
+static os_thread thr[THREADS];
+static u8_t stacks[THREADS][256];
+static os_mq mq, mq_free;
+static msg arena[SLOTS];
+static void *ptr_arena[BUFS];
+static void *free_arena[BUFS];
+static sys_time t0;
+static u32_t at[THREADS];
+
+// Creates threads from kernel with given priorities and runs until all
+// are done, calling poll in between if given.
+static void run(u32_t count, void *(**f)(void *), const u8_t *prio, void (*poll)(void)) {
+  u32_t i;
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    OS_thread_create(&thr[i], 0, f[i], (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "thr");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  t0 = SYS_get_time_ms();
+  exit_critical();
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    if (poll) poll();
+    arch_sleep();
+  }
+}
+
+static u16_t check_of(u16_t from, u32_t seq) {
+  return (u16_t)(from * 0x9e37 ^ seq * 0x79b9 ^ (seq >> 16));
+}
+
+static void test_basic(void) {
+  msg m;
+  u32_t i;
+  OS_mq_init(&mq, arena, SLOTS, sizeof(msg));
+  CHECK(!OS_mq_recv(&mq, &m, OS_NOWAIT));
+  for (i = 0; i < SLOTS; i++) {
+    m.seq = i;
+    CHECK(OS_mq_send(&mq, &m, OS_NOWAIT));
+  }
+  CHECK(!OS_mq_send(&mq, &m, OS_NOWAIT));
+  CHECK(!OS_mq_post(&mq, &m));
+  CHECK_EQ(OS_mq_count(&mq), SLOTS);
+  // wraps
+  for (i = 0; i < 3 * SLOTS; i++) {
+    CHECK(OS_mq_recv(&mq, &m, OS_NOWAIT));
+    CHECK_EQ(m.seq, i);
+    m.seq = i + SLOTS;
+    CHECK(OS_mq_post(&mq, &m));
+  }
+  CHECK_EQ(OS_mq_count(&mq), SLOTS);
+}
+
+static void *full_send_f(void *arg) {
+  msg m;
+  m.seq = 99;
+  // queue is full from test_basic
+  at[0] = OS_mq_send(&mq, &m, 7) ? 1000 : SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void *empty_recv_f(void *arg) {
+  msg m;
+  u32_t i;
+  OS_thread_sleep(10);
+  for (i = 0; i < SLOTS; i++) {
+    CHECK(OS_mq_recv(&mq, &m, OS_NOWAIT));
+  }
+  at[1] = OS_mq_recv(&mq, &m, 5) ? 1000 : SYS_get_time_ms() - t0;
+  // a message sent in the meantime ends the wait early
+  at[2] = OS_mq_recv(&mq, &m, 50) ? SYS_get_time_ms() - t0 : 1000;
+  CHECK_EQ(m.seq, 1234);
+  return NULL;
+}
+
+static void *late_send_f(void *arg) {
+  msg m;
+  m.seq = 1234;
+  OS_thread_sleep(20);
+  CHECK(OS_mq_send(&mq, &m, OS_WAIT_FOREVER));
+  return NULL;
+}
+
+static void test_timeouts(void) {
+  void *(*f[])(void *) = {full_send_f, empty_recv_f, late_send_f};
+  const u8_t prio[] = {10, 10, 10};
+  run(3, f, prio, NULL);
+  CHECK_EQ(at[0], 7);
+  CHECK_EQ(at[1], 15);
+  CHECK_EQ(at[2], 20);
+  CHECK_EQ(OS_mq_count(&mq), 0);
+}
+
+// Buffers go round from a free queue to the full queue and back, the
+// data never being copied.
+static u8_t bufs[BUFS][64];
+
+static void *ptr_prod_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < MSGS; i++) {
+    u8_t *b;
+    CHECK(OS_mq_recv_ptr(&mq_free, (void **)&b, OS_WAIT_FOREVER));
+    memset(b, (u8_t)i, sizeof(bufs[0]));
+    CHECK(OS_mq_send_ptr(&mq, b, OS_WAIT_FOREVER));
+    if ((i % 97) == 0) OS_thread_sleep(1);
+  }
+  return NULL;
+}
+
+static void *ptr_cons_f(void *arg) {
+  u32_t i, j;
+  for (i = 0; i < MSGS; i++) {
+    u8_t *b;
+    CHECK(OS_mq_recv_ptr(&mq, (void **)&b, OS_WAIT_FOREVER));
+    CHECK(b >= bufs[0] && b <= bufs[BUFS - 1]);
+    for (j = 0; j < sizeof(bufs[0]); j++) {
+      if (b[j] != (u8_t)i) {
+        CHECK_EQ(b[j], (u8_t)i);
+        break;
+      }
+    }
+    CHECK(OS_mq_send_ptr(&mq_free, b, OS_NOWAIT));
+    if ((i % 131) == 0) OS_thread_sleep(2);
+  }
+  return NULL;
+}
+
+static void test_ptr(void) {
+  void *(*f[])(void *) = {ptr_prod_f, ptr_cons_f};
+  const u8_t prio[] = {10, 11};
+  u32_t i;
+  OS_mq_init(&mq, ptr_arena, BUFS, sizeof(void *));
+  OS_mq_init(&mq_free, free_arena, BUFS, sizeof(void *));
+  for (i = 0; i < BUFS; i++) {
+    CHECK(OS_mq_send_ptr(&mq_free, bufs[i], OS_NOWAIT));
+  }
+  run(2, f, prio, NULL);
+  CHECK_EQ(OS_mq_count(&mq), 0);
+  CHECK_EQ(OS_mq_count(&mq_free), BUFS);
+}
+
+static u32_t next_seq[PRODUCERS + 1];
+static u32_t received;
+static u32_t posted, post_full;
+static u32_t seeds[THREADS];
+
+static u32_t rnd(u32_t *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+static void *stress_prod_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  msg m;
+  for (i = 0; i < MSGS; i++) {
+    m.from = me;
+    m.seq = i;
+    m.check = check_of(me, i);
+    u32_t r = rnd(&seeds[me]) % 16;
+    if (r == 0) {
+      // retry timed sends until through
+      while (!OS_mq_send(&mq, &m, 1 + rnd(&seeds[me]) % 3));
+    } else {
+      CHECK(OS_mq_send(&mq, &m, OS_WAIT_FOREVER));
+    }
+    if (r == 1) OS_thread_sleep(1 + rnd(&seeds[me]) % 4);
+    else if (r < 6) OS_thread_yield();
+  }
+  return NULL;
+}
+
+static void *stress_cons_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  msg m;
+  while (received < PRODUCERS * MSGS + POSTS) {
+    // timed, for the clock to move on to kernel posts when all wait
+    if (!OS_mq_recv(&mq, &m, 1 + rnd(&seeds[me]) % 5)) {
+      continue;
+    }
+    CHECK(m.from <= PRODUCERS);
+    CHECK_EQ(m.check, check_of(m.from, m.seq));
+    // one consumer at a time gets a message, so order holds per sender
+    CHECK_EQ(m.seq, next_seq[m.from]);
+    next_seq[m.from] = m.seq + 1;
+    received++;
+    u32_t r = rnd(&seeds[me]) % 16;
+    if (r == 0) OS_thread_sleep(1 + rnd(&seeds[me]) % 4);
+    else if (r < 4) OS_thread_yield();
+    else if (r < 5) SYS_hardsleep_us(200);
+  }
+  return NULL;
+}
+
+// Posts from kernel context, as an interrupt would, whenever all threads
+// wait, until the queue is full.
+static void stress_post(void) {
+  msg m;
+  while (posted < POSTS) {
+    m.from = PRODUCERS;
+    m.seq = posted;
+    m.check = check_of(PRODUCERS, posted);
+    if (!OS_mq_post(&mq, &m)) {
+      post_full++;
+      break;
+    }
+    posted++;
+  }
+}
+
+static void test_stress(void) {
+  void *(*f[PRODUCERS + CONSUMERS])(void *);
+  u8_t prio[PRODUCERS + CONSUMERS];
+  u32_t i;
+  OS_mq_init(&mq, arena, SLOTS, sizeof(msg));
+  for (i = 0; i < PRODUCERS + CONSUMERS; i++) {
+    f[i] = i < PRODUCERS ? stress_prod_f : stress_cons_f;
+    prio[i] = 20 + i % 3;
+    seeds[i] = 100 + i;
+  }
+  run(PRODUCERS + CONSUMERS, f, prio, stress_post);
+  CHECK_EQ(posted, POSTS);
+  CHECK(post_full > 0);
+  for (i = 0; i < PRODUCERS; i++) {
+    CHECK_EQ(next_seq[i], MSGS);
+  }
+  CHECK_EQ(next_seq[PRODUCERS], POSTS);
+  CHECK_EQ(received, PRODUCERS * MSGS + POSTS);
+  CHECK_EQ(OS_mq_count(&mq), 0);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_basic();
+  test_timeouts();
+  test_ptr();
+  test_stress();
+  return host_test_result("os_mq");
+}
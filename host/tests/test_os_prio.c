@@ -0,0 +1,125 @@
+/*
+ * test_os_prio.c
+ *
+ * Thread scheduling on all 256 priorities, on the virtual clock: threads of
+ * close but different priority must not share the cpu, threads of equal
+ * priority are round-robin scheduled, and a thread of only slightly higher
+ * priority preempts the running one when woken.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define MAX_THREADS   8
+#define TURNS         4
+
+static os_thread thr[MAX_THREADS];
+static u8_t stacks[MAX_THREADS][256];
+static char trace[MAX_THREADS * TURNS * 2 + 1];
+static u32_t trace_len;
+
+static void mark(u32_t ix) {
+  trace[trace_len++] = 'a' + ix;
+  trace[trace_len] = 0;
+}
+
+static void *yield_f(void *arg) {
+  u32_t i;
+  for (i = 0; i < TURNS; i++) {
+    mark((u32_t)(intptr_t)arg);
+    OS_thread_yield();
+  }
+  return NULL;
+}
+
+// Creates threads of given priorities from kernel, all getting ready at once
+static void run(u32_t count, const u8_t *prio, void *(*f)(void *)) {
+  u32_t i;
+  trace_len = 0;
+  trace[0] = 0;
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    OS_thread_create(&thr[i], 0, f, (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "thr");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  exit_critical();
+  while (OS_get_running_threads()) {
+    arch_sleep();
+  }
+}
+
+static void test_distinct_prio(void) {
+  // previously one level, spanning 128..135
+  const u8_t prio[] = {128, 135, 129, 134};
+  run(4, prio, yield_f);
+  CHECK(strcmp(trace, "bbbbddddccccaaaa") == 0);
+  if (host_test_failures) printf("trace %s\n", trace);
+}
+
+static void test_round_robin(void) {
+  const u8_t prio[] = {40, 200, 200, 40, 200};
+  run(5, prio, yield_f);
+  CHECK(strcmp(trace, "bcebcebcebceadadadad") == 0);
+  if (host_test_failures) printf("trace %s\n", trace);
+}
+
+static void test_extremes(void) {
+  const u8_t prio[] = {0, 255, 31, 32, 224, 223};
+  run(6, prio, yield_f);
+  CHECK(strcmp(trace, "bbbbeeeeffffddddccccaaaa") == 0);
+  if (host_test_failures) printf("trace %s\n", trace);
+}
+
+static sys_time woken_at;
+static sys_time busy_until;
+
+static void *sleeper_f(void *arg) {
+  OS_thread_sleep(5);
+  woken_at = SYS_get_time_ms();
+  mark(1);
+  return NULL;
+}
+
+static void *busy_f(void *arg) {
+  sys_time start = SYS_get_time_ms();
+  mark(0);
+  while (SYS_get_time_ms() < start + 20) {
+    SYS_hardsleep_ms(1);
+  }
+  busy_until = SYS_get_time_ms();
+  mark(0);
+  return NULL;
+}
+
+static void test_preempt(void) {
+  // sleeper is one priority above, previously same level
+  const u8_t prio[] = {128, 129};
+  void *(*f[])(void *) = {busy_f, sleeper_f};
+  u32_t i;
+  sys_time start = SYS_get_time_ms();
+  trace_len = 0;
+  enter_critical();
+  for (i = 0; i < 2; i++) {
+    OS_thread_create(&thr[i], 0, f[i], NULL, stacks[i], sizeof(stacks[i]), "thr");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  exit_critical();
+  while (OS_get_running_threads()) {
+    arch_sleep();
+  }
+  CHECK(strcmp(trace, "aba") == 0);
+  CHECK_EQ(woken_at, start + 5);
+  CHECK_EQ(busy_until, start + 20);
+  if (host_test_failures) printf("trace %s\n", trace);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_distinct_prio();
+  test_round_robin();
+  test_extremes();
+  test_preempt();
+  return host_test_result("os_prio");
+}
@@ -0,0 +1,239 @@
+/*
+ * test_os_sem.c
+ *
+ * os_sem and os_flags on the host OS and virtual clock: exact timeouts,
+ * wait any, all and clear, a semaphore guarding a pool under random
+ * load, and posts and flag sets from kernel context standing in for
+ * interrupts, none of which may be lost.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define THREADS     8
+#define POOL        3
+#define TAKES       500
+#define POSTS       3000
+
+static os_thread thr[THREADS];
+static u8_t stacks[THREADS][256];
+static os_sem sem, sem_evt;
+static os_flags flags;
+static sys_time t0;
+static u32_t at[THREADS];
+static u32_t seeds[THREADS];
+static void *(*funcs[THREADS])(void *);
+static volatile u32_t done;
+
+static u32_t rnd(u32_t *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+static void *thread_f(void *arg) {
+  funcs[(intptr_t)arg](arg);
+  done++;
+  return NULL;
+}
+
+// Creates threads from kernel with given priorities and runs until all
+// are done, calling poll in between if given.
+static void run(u32_t count, void *(**f)(void *), const u8_t *prio, void (*poll)(void)) {
+  u32_t i;
+  done = 0;
+  enter_critical();
+  for (i = 0; i < count; i++) {
+    seeds[i] = 1000 + i;
+    funcs[i] = f[i];
+    OS_thread_create(&thr[i], 0, thread_f, (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "thr");
+    OS_thread_set_prio(&thr[i], prio[i]);
+  }
+  t0 = SYS_get_time_ms();
+  exit_critical();
+  // a thread left blocked fails the test after a virtual minute
+  while (done < count || OS_get_running_threads()) {
+    if (poll) poll();
+    arch_sleep();
+    if (SYS_get_time_ms() - t0 > 60000) {
+      CHECK(done == count);
+      break;
+    }
+  }
+}
+
+static void *sem_timeout_f(void *arg) {
+  CHECK(OS_sem_wait(&sem, OS_NOWAIT));
+  CHECK(!OS_sem_wait(&sem, OS_NOWAIT));
+  at[0] = OS_sem_wait(&sem, 9) ? 1000 : SYS_get_time_ms() - t0;
+  at[1] = OS_sem_wait(&sem, 100) ? SYS_get_time_ms() - t0 : 1000;
+  return NULL;
+}
+
+static void *sem_late_post_f(void *arg) {
+  OS_thread_sleep(30);
+  OS_sem_post(&sem);
+  return NULL;
+}
+
+static void *flags_any_f(void *arg) {
+  // any of 0x3, not cleared
+  at[2] = OS_flags_wait(&flags, 0x3, OS_FLAGS_ANY, 100);
+  at[3] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void *flags_all_f(void *arg) {
+  // all of 0x6, cleared; times out first with only 0x2 set
+  at[4] = OS_flags_wait(&flags, 0x6, OS_FLAGS_ALL, 15);
+  at[5] = SYS_get_time_ms() - t0;
+  at[6] = OS_flags_wait(&flags, 0x6, OS_FLAGS_ALL | OS_FLAGS_CLEAR, 100);
+  at[7] = SYS_get_time_ms() - t0;
+  return NULL;
+}
+
+static void *flags_set_f(void *arg) {
+  OS_thread_sleep(10);
+  OS_flags_set(&flags, 0x2);
+  OS_thread_sleep(10);
+  OS_flags_set(&flags, 0x4 | 0x8);
+  return NULL;
+}
+
+static void test_timeouts(void) {
+  void *(*f[])(void *) = {sem_timeout_f, sem_late_post_f, flags_any_f, flags_all_f, flags_set_f};
+  const u8_t prio[] = {10, 10, 10, 10, 10};
+  OS_sem_init(&sem, 1);
+  OS_flags_init(&flags, 0);
+  run(5, f, prio, NULL);
+  CHECK_EQ(at[0], 9);
+  CHECK_EQ(at[1], 30);
+  CHECK_EQ(at[2], 0x2);
+  CHECK_EQ(at[3], 10);
+  CHECK_EQ(at[4], 0);
+  CHECK_EQ(at[5], 15);
+  CHECK_EQ(at[6], 0x6);
+  CHECK_EQ(at[7], 20);
+  // only the waited flags were cleared
+  CHECK_EQ(OS_flags_get(&flags), 0x8);
+  CHECK_EQ(OS_sem_count(&sem), 0);
+}
+
+static u32_t in_use, max_in_use, taken;
+
+static void *pool_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t i;
+  for (i = 0; i < TAKES; i++) {
+    u32_t r = rnd(&seeds[me]) % 8;
+    if (!OS_sem_wait(&sem, r < 2 ? OS_NOWAIT : (r < 4 ? 1 + r : OS_WAIT_FOREVER))) {
+      continue;
+    }
+    in_use++;
+    max_in_use = MAX(max_in_use, in_use);
+    taken++;
+    if (r & 1) OS_thread_sleep(1 + rnd(&seeds[me]) % 3);
+    else OS_thread_yield();
+    in_use--;
+    OS_sem_post(&sem);
+  }
+  return NULL;
+}
+
+static void test_pool(void) {
+  void *(*f[THREADS])(void *);
+  u8_t prio[THREADS];
+  u32_t i;
+  for (i = 0; i < THREADS; i++) {
+    f[i] = pool_f;
+    prio[i] = 20 + i % 2;
+  }
+  OS_sem_init(&sem, POOL);
+  run(THREADS, f, prio, NULL);
+  CHECK_EQ(max_in_use, POOL);
+  CHECK(taken > TAKES * THREADS / 2);
+  CHECK_EQ(OS_sem_count(&sem), POOL);
+}
+
+static u32_t posted, received, flag_sets, flag_fresh;
+static u32_t flag_got[4];
+static volatile bool flags_done;
+
+// Posts and sets flags from kernel context, as an interrupt would,
+// whenever all threads wait.
+static void evt_post(void) {
+  u32_t burst = 1 + posted % 7;
+  while (burst-- && posted < POSTS) {
+    OS_sem_post(&sem_evt);
+    posted++;
+  }
+  if (flag_sets < POSTS) {
+    u32_t bit = 1 << (flag_sets % 4);
+    // a set of a bit still set merges with it
+    if ((OS_flags_get(&flags) & bit) == 0) flag_fresh++;
+    OS_flags_set(&flags, bit);
+    flag_sets++;
+  } else {
+    flags_done = TRUE;
+    // let flag waiters see the end
+    OS_flags_set(&flags, 0x10);
+  }
+}
+
+static void *evt_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  while (received < POSTS) {
+    if (OS_sem_wait(&sem_evt, 1 + rnd(&seeds[me]) % 4)) {
+      received++;
+      if ((rnd(&seeds[me]) % 4) == 0) OS_thread_yield();
+    }
+  }
+  return NULL;
+}
+
+static void *flag_f(void *arg) {
+  u32_t me = (u32_t)(intptr_t)arg;
+  u32_t bit = 1 << (me % 4);
+  while (TRUE) {
+    u32_t got = OS_flags_wait(&flags, bit | 0x10, OS_FLAGS_ANY, OS_WAIT_FOREVER);
+    CHECK(got != 0);
+    if (got & bit) {
+      // clear own bit only, other waiter of same bit may have
+      if (OS_flags_wait(&flags, bit, OS_FLAGS_CLEAR, OS_NOWAIT)) {
+        flag_got[me % 4]++;
+      }
+    }
+    if (flags_done && (OS_flags_get(&flags) & 0xf) == 0) break;
+    if (got & 0x10 && !(got & bit)) break;
+  }
+  return NULL;
+}
+
+static void test_events(void) {
+  void *(*f[])(void *) = {evt_f, evt_f, evt_f, flag_f, flag_f, flag_f, flag_f};
+  const u8_t prio[] = {30, 31, 30, 30, 31, 30, 31};
+  u32_t i, total = 0;
+  OS_sem_init(&sem_evt, 0);
+  OS_flags_init(&flags, 0);
+  run(7, f, prio, evt_post);
+  CHECK_EQ(posted, POSTS);
+  CHECK_EQ(received, POSTS);
+  CHECK_EQ(OS_sem_count(&sem_evt), 0);
+  for (i = 0; i < 4; i++) {
+    CHECK(flag_got[i] > 0);
+    total += flag_got[i];
+  }
+  // every bit set was taken once
+  CHECK_EQ(OS_flags_get(&flags) & 0xf, 0);
+  CHECK_EQ(total, flag_fresh);
+  printf("%u posts, %u of %u flag sets taken\n", posted, total, flag_sets);
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_timeouts();
+  test_pool();
+  test_events();
+  return host_test_result("os_sem");
+}
@@ -0,0 +1 @@
+CONFIG_OS = 1
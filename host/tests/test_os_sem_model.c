@@ -0,0 +1,248 @@
+/*
+ * test_os_sem_model.c
+ *
+ * Model of the lock free fast paths of os_sem and os_flags in the cortex
+ * OS, run under random interleavings. Waiting threads, posting threads
+ * and posting interrupts are state machines stepped one at a time in
+ * random order, each step being what the target runs atomically: an
+ * LDREX/STREX loop, which an interrupt restarts rather than splits, or a
+ * critical section. Threads also time out at random.
+ *
+ * After every run, once nothing can step, no waiter may be blocked on a
+ * semaphore with units left or on flags satisfying its wait, units and
+ * flags must all be accounted for, and every waiter must be done.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define RUNS        20000
+#define MAX_ACTORS  8
+
+typedef enum {
+  // fast path try, outside critical
+  W_TRY = 0,
+  // critical: register as waiter, try, block on cond if not taken
+  W_SLOW,
+  // blocked on cond, until signalled or timed out
+  W_BLOCKED,
+  // critical after wakeup: try again, block again unless timed out
+  W_RECHECK,
+  W_DONE,
+  // atomic update, then waiters check and signal as separate step
+  P_UPDATE,
+  P_SIGNAL,
+  P_DONE,
+} state;
+
+typedef struct {
+  state st;
+  bool poster;
+  bool timed_out;
+  bool got;
+  // flags model: wait mask and opts, or flags to set
+  u32_t mask;
+  u32_t opts;
+} actor;
+
+static actor actors[MAX_ACTORS];
+static u32_t n_actors;
+// modelled os_sem or os_flags state
+static u32_t count;
+static u32_t flags;
+static u32_t waiters;
+static bool model_flags;
+static u32_t steps, lost_signals, timeouts, slow_takes;
+
+// Mirrors __os_sem_try_take or __os_flags_try.
+static bool try_take(actor *a) {
+  if (!model_flags) {
+    if (count == 0) return FALSE;
+    count--;
+    return TRUE;
+  }
+  u32_t m = flags & a->mask;
+  if ((a->opts & OS_FLAGS_ALL) ? m != a->mask : m == 0) return FALSE;
+  if (a->opts & OS_FLAGS_CLEAR) flags &= ~a->mask;
+  return TRUE;
+}
+
+// OS_cond_signal wakes first blocked waiter, OS_cond_broadcast all.
+static void cond_signal(bool all) {
+  u32_t i;
+  bool woke = FALSE;
+  for (i = 0; i < n_actors; i++) {
+    if (actors[i].st == W_BLOCKED) {
+      actors[i].st = W_RECHECK;
+      woke = TRUE;
+      if (!all) return;
+    }
+  }
+  if (!woke) lost_signals++;
+}
+
+static void step(actor *a) {
+  steps++;
+  switch (a->st) {
+  case W_TRY:
+    if (try_take(a)) {
+      a->got = TRUE;
+      a->st = W_DONE;
+    } else {
+      a->st = W_SLOW;
+    }
+    break;
+  case W_SLOW:
+    waiters++;
+    if (try_take(a)) {
+      a->got = TRUE;
+      waiters--;
+      a->st = W_DONE;
+      slow_takes++;
+    } else {
+      a->st = W_BLOCKED;
+    }
+    break;
+  case W_RECHECK:
+    if (try_take(a)) {
+      a->got = TRUE;
+      waiters--;
+      a->st = W_DONE;
+      slow_takes++;
+    } else if (a->timed_out) {
+      waiters--;
+      a->st = W_DONE;
+    } else {
+      a->st = W_BLOCKED;
+    }
+    break;
+  case P_UPDATE:
+    if (model_flags) flags |= a->mask;
+    else count++;
+    a->st = P_SIGNAL;
+    break;
+  case P_SIGNAL:
+    if (waiters) cond_signal(model_flags);
+    a->st = P_DONE;
+    break;
+  default:
+    break;
+  }
+}
+
+static bool runnable(actor *a) {
+  return a->st != W_BLOCKED && a->st != W_DONE && a->st != P_DONE;
+}
+
+// Runs one random interleaving of actors already set up.
+static void run_model(bool may_time_out) {
+  u32_t i;
+  while (TRUE) {
+    u32_t r = host_test_rand() % 32;
+    actor *a = &actors[host_test_rand() % n_actors];
+    if (may_time_out && r == 0 && a->st == W_BLOCKED) {
+      // timer wakes it, its timeout passed
+      a->timed_out = TRUE;
+      a->st = W_RECHECK;
+      timeouts++;
+      continue;
+    }
+    if (runnable(a)) {
+      step(a);
+      continue;
+    }
+    for (i = 0; i < n_actors; i++) {
+      if (runnable(&actors[i])) break;
+    }
+    if (i == n_actors) {
+      // nothing can step but blocked waiters timing out
+      if (!may_time_out) break;
+      for (i = 0; i < n_actors; i++) {
+        if (actors[i].st == W_BLOCKED) break;
+      }
+      if (i == n_actors) break;
+    }
+  }
+}
+
+static void check_quiescent(u32_t initial, u32_t posts) {
+  u32_t i, got = 0;
+  for (i = 0; i < n_actors; i++) {
+    actor *a = &actors[i];
+    CHECK(a->st == W_DONE || a->st == P_DONE || a->st == W_BLOCKED);
+    if (a->st == W_BLOCKED) {
+      // lost wakeup if it could take
+      if (model_flags) {
+        u32_t m = flags & a->mask;
+        CHECK((a->opts & OS_FLAGS_ALL) ? m != a->mask : m == 0);
+      } else {
+        CHECK_EQ(count, 0);
+      }
+    }
+    if (a->got) got++;
+  }
+  if (!model_flags) {
+    CHECK_EQ(got + count, initial + posts);
+  }
+}
+
+static void setup(u32_t n_waiters, u32_t n_posters) {
+  u32_t i;
+  memset(actors, 0, sizeof(actors));
+  n_actors = n_waiters + n_posters;
+  waiters = 0;
+  for (i = 0; i < n_actors; i++) {
+    actors[i].poster = i >= n_waiters;
+    actors[i].st = actors[i].poster ? P_UPDATE : W_TRY;
+  }
+}
+
+static void test_sem(void) {
+  u32_t run;
+  model_flags = FALSE;
+  for (run = 0; run < RUNS; run++) {
+    u32_t w = 1 + host_test_rand() % 4;
+    u32_t p = 1 + host_test_rand() % 4;
+    u32_t initial = host_test_rand() % 2;
+    setup(w, p);
+    count = initial;
+    run_model(run & 1);
+    check_quiescent(initial, p);
+    if (host_test_failures) {
+      printf("sem model failed in run %u\n", run);
+      return;
+    }
+  }
+}
+
+static void test_flags(void) {
+  u32_t run, i;
+  model_flags = TRUE;
+  for (run = 0; run < RUNS; run++) {
+    u32_t w = 1 + host_test_rand() % 4;
+    u32_t p = 1 + host_test_rand() % 4;
+    setup(w, p);
+    flags = 0;
+    for (i = 0; i < n_actors; i++) {
+      // few flags, so waits overlap
+      actors[i].mask = 1 + host_test_rand() % 7;
+      actors[i].opts = host_test_rand() % 4;
+    }
+    run_model(run & 1);
+    check_quiescent(0, p);
+    if (host_test_failures) {
+      printf("flags model failed in run %u\n", run);
+      return;
+    }
+  }
+}
+
+int main(void) {
+  host_test_init();
+  host_test_seed(13);
+  test_sem();
+  test_flags();
+  printf("%u steps, %u slow path takes, %u timeouts, %u signals finding no blocked waiter\n",
+      steps, slow_takes, timeouts, lost_signals);
+  return host_test_result("os_sem_model");
+}
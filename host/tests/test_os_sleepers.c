@@ -0,0 +1,106 @@
+/*
+ * test_os_sleepers.c
+ *
+ * Stress of the OS sleep queue on the virtual clock: many threads doing
+ * short random sleeps and timed cond waits while a signaller wakes some
+ * waiters early. Every timeout must happen exactly at its deadline and
+ * every early wakeup before it.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define SLEEPERS    40
+#define ROUNDS      300
+#define CONDS       4
+
+static os_thread thr[SLEEPERS + 1];
+static u8_t stacks[SLEEPERS + 1][256];
+static os_mutex mutex;
+static os_cond conds[CONDS];
+static u32_t seeds[SLEEPERS];
+static u32_t sleeps, timeouts, signalled;
+static volatile u32_t done;
+
+static u32_t rnd(u32_t *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+static void *sleeper_f(void *arg) {
+  u32_t i = (u32_t)(intptr_t)arg;
+  u32_t r;
+  for (r = 0; r < ROUNDS; r++) {
+    sys_time d = 1 + rnd(&seeds[i]) % 20;
+    sys_time t = SYS_get_time_ms();
+    if (rnd(&seeds[i]) & 1) {
+      OS_thread_sleep(d);
+      CHECK_EQ(SYS_get_time_ms() - t, d);
+      sleeps++;
+    } else {
+      OS_mutex_lock(&mutex);
+      if (OS_cond_timed_wait(&conds[rnd(&seeds[i]) % CONDS], &mutex, d)) {
+        CHECK_EQ(SYS_get_time_ms() - t, d);
+        timeouts++;
+      } else {
+        CHECK(SYS_get_time_ms() - t <= d);
+        signalled++;
+      }
+      OS_mutex_unlock(&mutex);
+    }
+  }
+  done++;
+  return NULL;
+}
+
+static void *signaller_f(void *arg) {
+  u32_t seed = 77;
+  while (done < SLEEPERS) {
+    OS_thread_sleep(1 + rnd(&seed) % 5);
+    OS_mutex_lock(&mutex);
+    if (rnd(&seed) % 8) {
+      OS_cond_signal(&conds[rnd(&seed) % CONDS]);
+    } else {
+      OS_cond_broadcast(&conds[rnd(&seed) % CONDS]);
+    }
+    OS_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+static void test_sleepers(void) {
+  u32_t i;
+  OS_mutex_init(&mutex, 0);
+  for (i = 0; i < CONDS; i++) {
+    OS_cond_init(&conds[i]);
+  }
+  enter_critical();
+  for (i = 0; i < SLEEPERS; i++) {
+    seeds[i] = i + 1;
+    OS_thread_create(&thr[i], 0, sleeper_f, (void *)(intptr_t)i,
+        stacks[i], sizeof(stacks[i]), "sleeper");
+    OS_thread_set_prio(&thr[i], 10 + i % 3);
+  }
+  OS_thread_create(&thr[SLEEPERS], 0, signaller_f, NULL,
+      stacks[SLEEPERS], sizeof(stacks[SLEEPERS]), "signaller");
+  OS_thread_set_prio(&thr[SLEEPERS], 20);
+  exit_critical();
+  // clock only moves here when all threads wait
+  while (done < SLEEPERS || OS_get_running_threads() ||
+      OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+  CHECK_EQ(sleeps + timeouts + signalled, SLEEPERS * ROUNDS);
+  CHECK(sleeps > 0);
+  CHECK(timeouts > 0);
+  CHECK(signalled > 0);
+  printf("%u sleeps, %u timeouts, %u signalled by %u ms\n",
+      sleeps, timeouts, signalled, (u32_t)SYS_get_time_ms());
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_sleepers();
+  return host_test_result("os_sleepers");
+}
@@ -0,0 +1,141 @@
+/*
+ * test_os_stack.c
+ *
+ * Stack watermark scans over synthetic stacks: a used region holding words
+ * equal to the mark, repeated scans only moving the watermark down, and a
+ * fully used stack. Threads run on host stacks, so the given stack is only
+ * written by the test, which scans it before the thread runs.
+ */
+
+#include "host_test.h"
+#include "os.h"
+#include "os_core.h"
+
+#define STACK_WORDS   256
+#define TRIALS        2000
+
+static os_thread thr;
+static u32_t stack[STACK_WORDS];
+
+static void *nop_f(void *arg) {
+  return NULL;
+}
+
+// Creates thread in critical, marking its stack, to be run by done().
+static void create(void) {
+  enter_critical();
+  OS_thread_create(&thr, 0, nop_f, NULL, stack, sizeof(stack), "stack");
+}
+
+static void done(void) {
+  exit_critical();
+  while (OS_get_running_threads()) {
+    arch_sleep();
+  }
+}
+
+static u32_t used_word(void) {
+  u32_t v = host_test_rand();
+  return v == _STACK_USAGE_MARK_32 ? v ^ 1 : v;
+}
+
+// Writes used words from given depth in words up to stack end, with runs
+// of marks shorter than the scan takes as untouched, keeping deepest word
+// used.
+static void use(u32_t depth) {
+  u32_t i;
+  for (i = STACK_WORDS - depth; i < STACK_WORDS; i++) {
+    stack[i] = used_word();
+  }
+  for (i = STACK_WORDS - depth + 1; i < STACK_WORDS; i++) {
+    if ((host_test_rand() % 4) == 0) {
+      u32_t run = 1 + host_test_rand() % (OS_STACK_MARK_RUN - 1);
+      while (run-- && i < STACK_WORDS) {
+        stack[i++] = _STACK_USAGE_MARK_32;
+      }
+      // run ends with a used word
+      if (i < STACK_WORDS) {
+        stack[i] = used_word();
+      }
+    }
+  }
+}
+
+static u32_t scan(void) {
+  u32_t size;
+  OS_thread_stack_scan(&thr);
+  u32_t used = OS_thread_stack_usage(&thr, &size);
+  CHECK_EQ(size, sizeof(stack));
+  return used;
+}
+
+static void test_fresh(void) {
+  create();
+  CHECK_EQ(scan(), 0);
+  CHECK_EQ(scan(), 0);
+  done();
+}
+
+static void test_marks_in_used(void) {
+  u32_t i;
+  for (i = 0; i < TRIALS; i++) {
+    u32_t depth = 1 + host_test_rand() % STACK_WORDS;
+    create();
+    use(depth);
+    CHECK_EQ(scan(), depth * 4);
+    done();
+  }
+}
+
+static void test_repeated(void) {
+  u32_t i;
+  for (i = 0; i < TRIALS / 20; i++) {
+    u32_t depth = 0, max = 0;
+    create();
+    while (depth < STACK_WORDS) {
+      // deeper or shallower than before, words below a shallower use
+      // keep what deeper use left
+      u32_t d = 1 + host_test_rand() % STACK_WORDS;
+      if (d > max) {
+        use(d);
+        max = d;
+      } else {
+        u32_t j;
+        for (j = STACK_WORDS - d; j < STACK_WORDS; j++) {
+          stack[j] = used_word();
+        }
+      }
+      CHECK_EQ(scan(), max * 4);
+      depth += 1 + host_test_rand() % 16;
+    }
+    // marks written back do not move watermark up
+    memset(stack, _STACK_USAGE_MARK, sizeof(stack));
+    CHECK_EQ(scan(), max * 4);
+    done();
+  }
+}
+
+static void test_full(void) {
+  create();
+  use(STACK_WORDS);
+  CHECK_EQ(scan(), sizeof(stack));
+  CHECK_EQ(scan(), sizeof(stack));
+  done();
+
+  // deepest word holding the mark is not told from untouched stack
+  create();
+  use(STACK_WORDS);
+  stack[0] = _STACK_USAGE_MARK_32;
+  CHECK_EQ(scan(), sizeof(stack) - 4);
+  done();
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_fresh();
+  test_marks_in_used();
+  test_repeated();
+  test_full();
+  return host_test_result("os_stack");
+}
@@ -0,0 +1,2 @@
+CONFIG_OS = 1
+PROG_FLAGS += -DOS_STACK_USAGE_CHECK=1
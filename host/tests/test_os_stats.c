@@ -0,0 +1,203 @@
+/*
+ * test_os_stats.c
+ *
+ * OS statistics as taken by the scheduler on the virtual clock: per thread
+ * and system load of each window and their averages over the last
+ * windows, decay of the average after a load step, cpu time, switch,
+ * preemption and yield counters, counters of threads created again, reset
+ * and dump.
+ *
+ * Threads run periodically, aligned with the load windows, and burn cpu
+ * in whole ms of busy wait, so loads and cpu times are exact. The high
+ * priority thread wakes in the middle of the low one's burst each period,
+ * preempting it exactly once.
+ */
+
+#include "host_test.h"
+#include "os.h"
+
+#define WINDOW        1000
+#define LO_PERIOD     100
+#define LO_BUSY       30
+#define HI_PERIOD     20
+#define HI_BUSY       2
+#define RR_LOOPS      50
+#define TICKS_PER_MS  (SYS_MAIN_TIMER_FREQ / 1000)
+
+static os_thread thr_lo, thr_hi, thr_rr[2];
+static u8_t stacks[4][256];
+static sys_time t0;
+static volatile bool stop_lo, stop_hi;
+
+static void burn_ms(u32_t ms) {
+  // each ms of busy wait is spent in calling thread
+  while (ms--) {
+    SYS_hardsleep_ms(1);
+  }
+}
+
+// Runs a burst each period from t0, leaving when woken after stop is set.
+static void *periodic_f(void *arg) {
+  bool lo = arg != NULL;
+  sys_time next = t0;
+  while (TRUE) {
+    OS_thread_sleep(next - SYS_get_time_ms());
+    if (lo ? stop_lo : stop_hi) {
+      break;
+    }
+    burn_ms(lo ? LO_BUSY : HI_BUSY);
+    next += lo ? LO_PERIOD : HI_PERIOD;
+  }
+  return NULL;
+}
+
+static void *rr_f(void *arg) {
+  u32_t i;
+  (void)arg;
+  for (i = 0; i < RR_LOOPS; i++) {
+    burn_ms(1);
+    (void)OS_thread_yield();
+  }
+  return NULL;
+}
+
+static void run_until(sys_time t) {
+  while (SYS_get_time_ms() < t) {
+    arch_sleep();
+  }
+}
+
+static void run_all(void) {
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    arch_sleep();
+  }
+}
+
+static u32_t stat_threads(void) {
+  u32_t n = 0;
+  os_thread *t = NULL;
+  while ((t = OS_stats_next_thread(t)) != NULL) {
+    n++;
+  }
+  return n;
+}
+
+static void create(os_thread *t, u32_t ix, void *(*f)(void *), void *arg, u8_t prio) {
+  enter_critical();
+  OS_thread_create(t, 0, f, arg, stacks[ix], sizeof(stacks[ix]), "stat");
+  OS_thread_set_prio(t, prio);
+  exit_critical();
+}
+
+static void test_load(void) {
+  u32_t w;
+  u16_t l1, l10;
+  // first window is idle, threads start with the second
+  t0 = WINDOW;
+  stop_lo = stop_hi = FALSE;
+  create(&thr_lo, 0, periodic_f, (void *)1, 10);
+  create(&thr_hi, 1, periodic_f, NULL, 20);
+  CHECK_EQ(stat_threads(), 2);
+
+  for (w = 1; w <= OS_STATS_HISTORY + 2; w++) {
+    // sample mid window, loads are those of last closed window, averages
+    // are over the windows so far, the idle one included
+    run_until(t0 + w * WINDOW + WINDOW / 2);
+    u32_t n = MIN(w + 1, OS_STATS_HISTORY);
+    u32_t busy = MIN(w, OS_STATS_HISTORY);
+    OS_stats_load(&l1, &l10);
+    CHECK_EQ(thr_lo.load_1s, 300);
+    CHECK_EQ(thr_lo.load_10s, 300 * busy / n);
+    CHECK_EQ(thr_hi.load_1s, 100);
+    CHECK_EQ(thr_hi.load_10s, 100 * busy / n);
+    CHECK_EQ(l1, 400);
+    CHECK_EQ(l10, 400 * busy / n);
+  }
+
+  // lo is switched out by hi once per period and sleeps once per period,
+  // after sleeping until t0 first
+  u32_t lo_periods = thr_lo.yields - 1;
+  CHECK(lo_periods >= (OS_STATS_HISTORY + 2) * WINDOW / LO_PERIOD);
+  CHECK_EQ(thr_lo.preempted, lo_periods);
+  CHECK_EQ(thr_lo.switches, thr_lo.yields + thr_lo.preempted);
+  CHECK_EQ(thr_lo.run_time, lo_periods * LO_BUSY * TICKS_PER_MS);
+  // hi outranks all, only sleeps
+  u32_t hi_periods = thr_hi.yields - 1;
+  CHECK_EQ(thr_hi.preempted, 0);
+  CHECK_EQ(thr_hi.switches, thr_hi.yields);
+  CHECK_EQ(thr_hi.run_time, hi_periods * HI_BUSY * TICKS_PER_MS);
+
+  // counters restart from zero on reset, lo sleeping mid window
+  OS_stats_reset();
+  CHECK_EQ(thr_lo.switches, 0);
+  CHECK_EQ(thr_lo.run_time, 0);
+  run_until(t0 + w * WINDOW + WINDOW / 2);
+  CHECK_EQ(thr_lo.yields, WINDOW / LO_PERIOD);
+  CHECK_EQ(thr_lo.preempted, WINDOW / LO_PERIOD);
+  CHECK_EQ(thr_lo.switches, 2 * WINDOW / LO_PERIOD);
+  CHECK_EQ(thr_lo.run_time, WINDOW / LO_PERIOD * LO_BUSY * TICKS_PER_MS);
+  CHECK_EQ(thr_hi.run_time, WINDOW / HI_PERIOD * HI_BUSY * TICKS_PER_MS);
+
+  // dump reads counters while threads run
+  host_put_mute = TRUE;
+  u32_t bytes = host_put_bytes;
+  OS_stats_dump(IOSTD);
+  host_put_mute = FALSE;
+  CHECK(host_put_bytes > bytes);
+
+  stop_lo = stop_hi = TRUE;
+  run_all();
+  CHECK_EQ(stat_threads(), 0);
+}
+
+static void test_step(void) {
+  u32_t w;
+  u16_t l1, l10;
+  // lo alone from a window start, for a full history of windows
+  t0 = (SYS_get_time_ms() / WINDOW + 1) * WINDOW;
+  stop_lo = FALSE;
+  create(&thr_lo, 0, periodic_f, (void *)1, 10);
+  // idling jumps to next wakeup, this returns after last burst of the
+  // history, lo leaves when woken at start of next window without running
+  run_until(t0 + OS_STATS_HISTORY * WINDOW - LO_PERIOD - LO_PERIOD / 2);
+  stop_lo = TRUE;
+  for (w = 0; w <= OS_STATS_HISTORY; w++) {
+    run_until(t0 + (OS_STATS_HISTORY + w) * WINDOW + WINDOW / 2);
+    OS_stats_load(&l1, &l10);
+    CHECK_EQ(l1, w == 0 ? 300 : 0);
+    // each idle window replaces a busy one in the average
+    CHECK_EQ(l10, 300 * (OS_STATS_HISTORY - w) / OS_STATS_HISTORY);
+  }
+  CHECK_EQ(stat_threads(), 0);
+}
+
+static void test_yield_recreate(void) {
+  u32_t i;
+  // same priority threads yielding to each other are never preempted,
+  // created again on same structs, counters restart
+  for (i = 0; i < 2; i++) {
+    enter_critical();
+    create(&thr_rr[0], 2, rr_f, NULL, 5);
+    create(&thr_rr[1], 3, rr_f, NULL, 5);
+    CHECK_EQ(stat_threads(), 2);
+    exit_critical();
+    run_all();
+    CHECK_EQ(stat_threads(), 0);
+    CHECK_EQ(thr_rr[0].yields, RR_LOOPS);
+    CHECK_EQ(thr_rr[1].yields, RR_LOOPS);
+    CHECK_EQ(thr_rr[0].preempted, 0);
+    CHECK_EQ(thr_rr[1].preempted, 0);
+    CHECK_EQ(thr_rr[0].switches, RR_LOOPS + 1);
+    CHECK_EQ(thr_rr[1].switches, RR_LOOPS + 1);
+    CHECK_EQ(thr_rr[0].run_time, RR_LOOPS * TICKS_PER_MS);
+  }
+}
+
+int main(void) {
+  host_test_init();
+  OS_init();
+  test_load();
+  test_step();
+  test_yield_recreate();
+  return host_test_result("os_stats");
+}
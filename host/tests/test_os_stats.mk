@@ -0,0 +1,2 @@
+CONFIG_OS = 1
+CONFIG_OS_STATS = 1
@@ -0,0 +1,159 @@
+/*
+ * test_ringbuf.c
+ *
+ * Regression test of the ring buffer: random sequences of all operations
+ * checked against a reference fifo, on a size that is not a power of two.
+ */
+
+#include "host_test.h"
+#include "ringbuf.h"
+#include "miniutils.h"
+
+#define SIZE    100
+#define OPS     200000
+
+static u8_t mem[SIZE];
+static ringbuf rb;
+
+// reference fifo
+static u8_t ref[SIZE];
+static u32_t ref_r, ref_w;
+static u8_t next_w = 0;
+
+static u32_t ref_len(void) {
+  return ref_w - ref_r;
+}
+
+static void ref_put(u8_t c) {
+  ref[ref_w++ % SIZE] = c;
+}
+
+static u8_t ref_get(void) {
+  return ref[ref_r++ % SIZE];
+}
+
+static void check_get(u8_t c) {
+  CHECK(ref_len() > 0);
+  CHECK_EQ(c, ref_get());
+}
+
+static void test_basic(void) {
+  u8_t c;
+  u8_t buf[SIZE];
+  ringbuf_init(&rb, mem, SIZE);
+  CHECK_EQ(ringbuf_available(&rb), 0);
+  CHECK_EQ(ringbuf_getc(&rb, &c), RB_ERR_EMPTY);
+  // legacy ringbuffer keeps one byte empty
+  CHECK_EQ(ringbuf_free(&rb), SIZE - 1);
+  memset(buf, 0xaa, sizeof(buf));
+  CHECK_EQ(ringbuf_put(&rb, buf, SIZE), SIZE - 1);
+  CHECK_EQ(ringbuf_putc(&rb, 1), RB_ERR_FULL);
+  CHECK_EQ(ringbuf_put(&rb, buf, 1), RB_ERR_FULL);
+  CHECK_EQ(ringbuf_available(&rb), SIZE - 1);
+  // returns number of bytes cleared
+  CHECK_EQ(ringbuf_clear(&rb), SIZE - 1);
+  CHECK_EQ(ringbuf_available(&rb), 0);
+  CHECK_EQ(ringbuf_get(&rb, buf, 1), RB_ERR_EMPTY);
+}
+
+static void test_random(void) {
+  u32_t i, j;
+  u8_t buf[SIZE];
+  ringbuf_init(&rb, mem, SIZE);
+  ref_r = ref_w = 0;
+  host_test_seed(0x1234);
+  for (i = 0; i < OPS; i++) {
+    u32_t op = host_test_rand() % 7;
+    u32_t len = host_test_rand() % (SIZE / 3) + 1;
+    int res;
+    switch (op) {
+    case 0: // putc
+      res = ringbuf_putc(&rb, next_w);
+      if (ref_len() < SIZE - 1) {
+        CHECK_EQ(res, RB_OK);
+        ref_put(next_w++);
+      } else {
+        CHECK_EQ(res, RB_ERR_FULL);
+      }
+      break;
+    case 1: { // put
+      for (j = 0; j < len; j++) {
+        buf[j] = next_w + j;
+      }
+      res = ringbuf_put(&rb, buf, len);
+      u32_t exp = MIN(len, SIZE - 1 - ref_len());
+      CHECK_EQ(res, exp == 0 ? RB_ERR_FULL : (int)exp);
+      for (j = 0; j < exp; j++) {
+        ref_put(next_w++);
+      }
+      break;
+    }
+    case 2: { // getc
+      u8_t c;
+      res = ringbuf_getc(&rb, &c);
+      if (ref_len()) {
+        CHECK_EQ(res, RB_OK);
+        check_get(c);
+      } else {
+        CHECK_EQ(res, RB_ERR_EMPTY);
+      }
+      break;
+    }
+    case 3: { // get
+      res = ringbuf_get(&rb, buf, len);
+      u32_t exp = MIN(len, ref_len());
+      CHECK_EQ(res, exp == 0 ? RB_ERR_EMPTY : (int)exp);
+      for (j = 0; j < exp; j++) {
+        check_get(buf[j]);
+      }
+      break;
+    }
+    case 4: { // peek linear and skip
+      u8_t *p;
+      res = ringbuf_available_linear(&rb, &p);
+      CHECK(res <= (int)ref_len());
+      CHECK(ref_len() == 0 || res > 0);
+      u32_t n = MIN((u32_t)res, len);
+      for (j = 0; j < n; j++) {
+        CHECK_EQ(p[j], ref[(ref_r + j) % SIZE]);
+      }
+      if (n) {
+        CHECK_EQ(ringbuf_get(&rb, NULL, n), n);
+        ref_r += n;
+      }
+      break;
+    }
+    case 5: { // reserve and commit
+      u8_t *p;
+      res = ringbuf_reserve_linear(&rb, &p);
+      CHECK(res <= (int)(SIZE - 1 - ref_len()));
+      u32_t n = MIN((u32_t)res, len);
+      for (j = 0; j < n; j++) {
+        p[j] = next_w + j;
+      }
+      if (n) {
+        CHECK_EQ(ringbuf_commit(&rb, n), n);
+        for (j = 0; j < n; j++) {
+          ref_put(next_w++);
+        }
+      }
+      break;
+    }
+    case 6: // counts
+      CHECK_EQ(ringbuf_available(&rb), ref_len());
+      CHECK_EQ(ringbuf_free(&rb), SIZE - 1 - ref_len());
+      break;
+    }
+    if (host_test_failures) {
+      printf("failed at op %i\n", i);
+      break;
+    }
+  }
+}
+
+int main(void) {
+  host_test_init();
+  test_basic();
+  test_random();
+  return host_test_result("ringbuf");
+}
@@ -0,0 +1 @@
+CONFIG_RINGBUFFER = 1
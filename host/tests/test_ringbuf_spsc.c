@@ -0,0 +1,271 @@
+/*
+ * test_ringbuf_spsc.c
+ *
+ * Regression test of the lock free ring buffer: random sequences of all
+ * operations checked against a reference fifo, and a producer and a
+ * consumer thread streaming a known sequence through it.
+ */
+
+#include "host_test.h"
+#include "ringbuf_spsc.h"
+#include "miniutils.h"
+#include <pthread.h>
+
+#define SIZE    64
+#define OPS     200000
+#define STREAM  (16 * 1024 * 1024)
+
+static u8_t mem[SIZE];
+static ringbuf_spsc rb;
+
+// reference fifo
+static u8_t ref[SIZE];
+static u32_t ref_r, ref_w;
+static u8_t next_w = 0;
+
+static u32_t ref_len(void) {
+  return ref_w - ref_r;
+}
+
+static void ref_put(u8_t c) {
+  ref[ref_w++ % SIZE] = c;
+}
+
+static u8_t ref_get(void) {
+  return ref[ref_r++ % SIZE];
+}
+
+static void check_get(u8_t c) {
+  CHECK(ref_len() > 0);
+  CHECK_EQ(c, ref_get());
+}
+
+static void test_basic(void) {
+  u8_t c;
+  u8_t buf[SIZE + 1];
+  ringbuf_spsc_init(&rb, mem, SIZE);
+  CHECK_EQ(ringbuf_spsc_available(&rb), 0);
+  CHECK_EQ(ringbuf_spsc_getc(&rb, &c), RB_ERR_EMPTY);
+  // all of the buffer is usable
+  CHECK_EQ(ringbuf_spsc_free(&rb), SIZE);
+  memset(buf, 0xaa, sizeof(buf));
+  CHECK_EQ(ringbuf_spsc_put(&rb, buf, SIZE + 1), SIZE);
+  CHECK_EQ(ringbuf_spsc_putc(&rb, 1), RB_ERR_FULL);
+  CHECK_EQ(ringbuf_spsc_put(&rb, buf, 1), RB_ERR_FULL);
+  CHECK_EQ(ringbuf_spsc_available(&rb), SIZE);
+  CHECK_EQ(ringbuf_spsc_clear(&rb), SIZE);
+  CHECK_EQ(ringbuf_spsc_available(&rb), 0);
+  CHECK_EQ(ringbuf_spsc_free(&rb), SIZE);
+  CHECK_EQ(ringbuf_spsc_get(&rb, buf, 1), RB_ERR_EMPTY);
+}
+
+static void test_random(void) {
+  u32_t i, j;
+  u8_t buf[SIZE];
+  ringbuf_spsc_init(&rb, mem, SIZE);
+  // start indices close to wrapping
+  rb.r_ix = rb.w_ix = 0xffffff00;
+  ref_r = ref_w = 0;
+  host_test_seed(0x4321);
+  for (i = 0; i < OPS; i++) {
+    u32_t op = host_test_rand() % 8;
+    u32_t len = host_test_rand() % (SIZE / 3) + 1;
+    int res;
+    switch (op) {
+    case 0: // putc
+      res = ringbuf_spsc_putc(&rb, next_w);
+      if (ref_len() < SIZE) {
+        CHECK_EQ(res, RB_OK);
+        ref_put(next_w++);
+      } else {
+        CHECK_EQ(res, RB_ERR_FULL);
+      }
+      break;
+    case 1: { // put
+      for (j = 0; j < len; j++) {
+        buf[j] = next_w + j;
+      }
+      res = ringbuf_spsc_put(&rb, buf, len);
+      u32_t exp = MIN(len, SIZE - ref_len());
+      CHECK_EQ(res, exp == 0 ? RB_ERR_FULL : (int)exp);
+      for (j = 0; j < exp; j++) {
+        ref_put(next_w++);
+      }
+      break;
+    }
+    case 2: { // getc
+      u8_t c;
+      res = ringbuf_spsc_getc(&rb, &c);
+      if (ref_len()) {
+        CHECK_EQ(res, RB_OK);
+        check_get(c);
+      } else {
+        CHECK_EQ(res, RB_ERR_EMPTY);
+      }
+      break;
+    }
+    case 3: { // get
+      res = ringbuf_spsc_get(&rb, buf, len);
+      u32_t exp = MIN(len, ref_len());
+      CHECK_EQ(res, exp == 0 ? RB_ERR_EMPTY : (int)exp);
+      for (j = 0; j < exp; j++) {
+        check_get(buf[j]);
+      }
+      break;
+    }
+    case 4: { // peek linear and skip
+      u8_t *p;
+      res = ringbuf_spsc_available_linear(&rb, &p);
+      CHECK(res <= (int)ref_len());
+      CHECK(ref_len() == 0 || res > 0);
+      u32_t n = MIN((u32_t)res, len);
+      for (j = 0; j < n; j++) {
+        CHECK_EQ(p[j], ref[(ref_r + j) % SIZE]);
+      }
+      if (n) {
+        CHECK_EQ(ringbuf_spsc_get(&rb, NULL, n), n);
+        ref_r += n;
+      }
+      break;
+    }
+    case 5: { // reserve and commit
+      u8_t *p;
+      res = ringbuf_spsc_reserve_linear(&rb, &p);
+      CHECK(res <= (int)(SIZE - ref_len()));
+      CHECK(ref_len() == SIZE || res > 0);
+      u32_t n = MIN((u32_t)res, len);
+      for (j = 0; j < n; j++) {
+        p[j] = next_w + j;
+      }
+      if (n) {
+        CHECK_EQ(ringbuf_spsc_commit(&rb, n), n);
+        for (j = 0; j < n; j++) {
+          ref_put(next_w++);
+        }
+      }
+      break;
+    }
+    case 6: // counts
+      CHECK_EQ(ringbuf_spsc_available(&rb), ref_len());
+      CHECK_EQ(ringbuf_spsc_free(&rb), SIZE - ref_len());
+      CHECK_EQ(ringbuf_spsc_commit(&rb, SIZE - ref_len() + 1), RB_ERR_FULL);
+      break;
+    case 7: // rarely clear
+      if ((host_test_rand() % 64) == 0) {
+        CHECK_EQ(ringbuf_spsc_clear(&rb), ref_len());
+        ref_r = ref_w;
+      }
+      break;
+    }
+    if (host_test_failures) {
+      printf("failed at op %i\n", i);
+      break;
+    }
+  }
+}
+
+// Thread local xorshift, host_test_rand is not thread safe
+static u32_t xrand(u32_t *s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+static void *producer(void *arg) {
+  u32_t seed = 0x1111;
+  u32_t sent = 0;
+  u8_t buf[SIZE];
+  while (sent < STREAM) {
+    u32_t len = MIN(xrand(&seed) % SIZE + 1, STREAM - sent);
+    u32_t j;
+    int res;
+    switch (xrand(&seed) % 3) {
+    case 0:
+      res = ringbuf_spsc_putc(&rb, (u8_t)sent) == RB_OK ? 1 : 0;
+      break;
+    case 1:
+      for (j = 0; j < len; j++) {
+        buf[j] = (u8_t)(sent + j);
+      }
+      res = ringbuf_spsc_put(&rb, buf, len);
+      break;
+    default: {
+      u8_t *p;
+      res = MIN((u32_t)ringbuf_spsc_reserve_linear(&rb, &p), len);
+      for (j = 0; j < (u32_t)res; j++) {
+        p[j] = (u8_t)(sent + j);
+      }
+      if (res) {
+        ringbuf_spsc_commit(&rb, res);
+      }
+      break;
+    }
+    }
+    if (res > 0) {
+      sent += res;
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void test_threads(void) {
+  pthread_t thr;
+  u32_t seed = 0x2222;
+  u32_t got = 0;
+  u32_t bad = 0;
+  u8_t buf[SIZE];
+  ringbuf_spsc_init(&rb, mem, SIZE);
+  pthread_create(&thr, NULL, producer, NULL);
+  while (got < STREAM) {
+    u32_t len = xrand(&seed) % SIZE + 1;
+    u32_t j;
+    int res;
+    switch (xrand(&seed) % 3) {
+    case 0: {
+      u8_t c;
+      res = ringbuf_spsc_getc(&rb, &c) == RB_OK ? 1 : 0;
+      if (res) {
+        bad += c != (u8_t)got;
+      }
+      break;
+    }
+    case 1:
+      res = ringbuf_spsc_get(&rb, buf, len);
+      for (j = 0; res > 0 && j < (u32_t)res; j++) {
+        bad += buf[j] != (u8_t)(got + j);
+      }
+      break;
+    default: {
+      u8_t *p;
+      res = MIN((u32_t)ringbuf_spsc_available_linear(&rb, &p), len);
+      for (j = 0; j < (u32_t)res; j++) {
+        bad += p[j] != (u8_t)(got + j);
+      }
+      if (res) {
+        ringbuf_spsc_get(&rb, NULL, res);
+      }
+      break;
+    }
+    }
+    if (res > 0) {
+      got += res;
+    } else {
+      sched_yield();
+    }
+  }
+  pthread_join(thr, NULL);
+  CHECK_EQ(got, STREAM);
+  CHECK_EQ(bad, 0);
+  CHECK_EQ(ringbuf_spsc_available(&rb), 0);
+}
+
+int main(void) {
+  host_test_init();
+  test_basic();
+  test_random();
+  test_threads();
+  return host_test_result("ringbuf_spsc");
+}
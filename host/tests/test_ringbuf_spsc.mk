@@ -0,0 +1,2 @@
+CONFIG_RINGBUFFER = 1
+CONFIG_RINGBUF_SPSC = 1
@@ -0,0 +1,240 @@
+/*
+ * test_spi_flash_log.c
+ *
+ * Flash log on the simulated flash: a record stream written at random
+ * sizes must read back intact over many laps of the region, through
+ * offset wraparound, with a lagging reader losing only whole oldest
+ * sectors, with busy flash and with sectors failing to erase, which must
+ * be skipped from then on. Flash must never be misused.
+ */
+
+#include "host_test.h"
+#include "host_flash.h"
+#include "spi_flash_log.h"
+#include "miniutils.h"
+
+#define FLASH_SIZE    (64*1024)
+#define SECTOR        4096
+#define REGION_ADDR   (8*1024)
+#define REGION_SIZE   (48*1024)
+#define RECORD        8
+
+static spi_flash_dev sfd;
+static spi_flash_log lg;
+static task_timer prod_timer, cons_timer;
+static task *prod_task, *cons_task;
+
+// writer stream position, bytes
+static u32_t w_pos;
+// reader state
+static u8_t r_rec[RECORD];
+static u32_t r_fill, r_seq, r_records, r_bad, r_gaps, r_lost;
+
+static void record_byte(u32_t pos, u8_t *b) {
+  u32_t seq = pos / RECORD;
+  u32_t v = (pos % RECORD) < 4 ? seq : ~seq;
+  *b = (u8_t)(v >> (8 * (pos % 4)));
+}
+
+static void prod_f(u32_t arg, void *arg_p) {
+  u8_t buf[64];
+  u32_t n = 1 + host_test_rand() % sizeof(buf);
+  u32_t i;
+  for (i = 0; i < n; i++) {
+    record_byte(w_pos + i, &buf[i]);
+  }
+  // dropped tail is written next time, keeping the stream contiguous
+  w_pos += SFL_write(&lg, buf, n);
+}
+
+static void cons_record(void) {
+  u32_t a = r_rec[0] | (r_rec[1] << 8) | (r_rec[2] << 16) | (r_rec[3] << 24);
+  u32_t b = r_rec[4] | (r_rec[5] << 8) | (r_rec[6] << 16) | (r_rec[7] << 24);
+  if (a != ~b) {
+    r_bad++;
+  } else {
+    if (r_records && a != r_seq + 1) {
+      r_gaps++;
+      CHECK(a > r_seq);
+    }
+    r_seq = a;
+    r_records++;
+  }
+}
+
+static void cons_f(u32_t arg, void *arg_p) {
+  u8_t *p;
+  s32_t n, i;
+  while ((n = SFL_peek_linear(&lg, &p)) > 0) {
+    if (lg.lost != r_lost) {
+      // oldest data was erased under the reader, which restarts at a
+      // sector and thus record boundary
+      r_lost = lg.lost;
+      r_fill = 0;
+      continue;
+    }
+    for (i = 0; i < n; i++) {
+      r_rec[r_fill++] = p[i];
+      if (r_fill == RECORD) {
+        cons_record();
+        r_fill = 0;
+      }
+    }
+    SFL_consume(&lg, n);
+  }
+}
+
+static void setup(void) {
+  host_flash_init(&sfd, FLASH_SIZE, 256, SECTOR, 1, 40);
+  SFL_init(&lg, &sfd, REGION_ADDR, REGION_SIZE);
+  w_pos = 0;
+  r_fill = r_seq = r_records = r_bad = r_gaps = r_lost = 0;
+  host_test_seed(0xf1a5);
+}
+
+static void idle(sys_time ms) {
+  sys_time end = SYS_get_time_ms() + ms;
+  while (SYS_get_time_ms() < end) {
+    while (TASK_tick());
+    arch_sleep();
+  }
+}
+
+// Runs producer every prod_ms and consumer every cons_ms, if any, for
+// given time. Then flushes, rewinds if there was no consumer, and lets
+// the consumer catch up.
+static void run(sys_time prod_ms, sys_time cons_ms, sys_time ms) {
+  TASK_start_timer(prod_task, &prod_timer, 0, NULL, 0, prod_ms, "prod");
+  if (cons_ms) {
+    TASK_start_timer(cons_task, &cons_timer, 0, NULL, 0, cons_ms, "cons");
+  }
+  idle(ms);
+  TASK_stop_timer(&prod_timer);
+  TASK_stop_timer(&cons_timer);
+  SFL_flush(&lg);
+  if (cons_ms == 0) {
+    SFL_rewind(&lg);
+  }
+  TASK_start_timer(cons_task, &cons_timer, 0, NULL, 0, 1, "cons");
+  idle(5000);
+  TASK_stop_timer(&cons_timer);
+  // no flash operation left going
+  idle(1000);
+}
+
+static void check_flash(void) {
+  u32_t s;
+  CHECK_EQ(host_flash_sim.bad_programs, 0);
+  CHECK_EQ(host_flash_sim.page_crossings, 0);
+  CHECK_EQ(host_flash_sim.overlapping_ops, 0);
+  for (s = 0; s < FLASH_SIZE / SECTOR; s++) {
+    if (s < REGION_ADDR / SECTOR || s >= (REGION_ADDR + REGION_SIZE) / SECTOR) {
+      CHECK_EQ(host_flash_sim.wear[s], 0);
+    }
+  }
+}
+
+// Checks erases are even over good sectors of region.
+static void check_wear(void) {
+  u32_t s, min = 0xffffffff, max = 0;
+  for (s = REGION_ADDR / SECTOR; s < (REGION_ADDR + REGION_SIZE) / SECTOR; s++) {
+    if (host_flash_sim.failing[s]) continue;
+    min = MIN(min, host_flash_sim.wear[s]);
+    max = MAX(max, host_flash_sim.wear[s]);
+  }
+  CHECK(max - min <= 1);
+}
+
+static void test_stream(void) {
+  setup();
+  host_flash_sim.busy_replies = 5;
+  // some 4 kB/s for 120 s, the two staging pages taking all that comes
+  // during a 40 ms erase
+  run(8, 3, 120000);
+  check_flash();
+  check_wear();
+  // many laps, offsets wrapping at twice the region
+  CHECK(w_pos > 8 * REGION_SIZE);
+  CHECK_EQ(lg.dropped, 0);
+  CHECK_EQ(lg.lost, 0);
+  CHECK_EQ(r_bad, 0);
+  CHECK_EQ(r_gaps, 0);
+  CHECK_EQ(r_fill, w_pos % RECORD);
+  CHECK_EQ(r_records, w_pos / RECORD);
+  CHECK(lg.wr < 2 * REGION_SIZE && lg.rd < 2 * REGION_SIZE && lg.erased < 2 * REGION_SIZE);
+}
+
+static void test_lagging_reader(void) {
+  setup();
+  // reader far too slow, losing oldest data
+  run(8, 200, 30000);
+  check_flash();
+  CHECK(lg.lost > 0);
+  CHECK_EQ(r_bad, 0);
+  CHECK(r_gaps > 0);
+  // ends with the newest record
+  CHECK_EQ(r_seq, w_pos / RECORD - 1);
+}
+
+static void test_rewind(void) {
+  setup();
+  // no reader until rewound, then all of the region but the sectors
+  // erased ahead is read back
+  run(8, 0, 20000);
+  check_flash();
+  CHECK_EQ(r_bad, 0);
+  CHECK_EQ(r_gaps, 0);
+  CHECK_EQ(r_seq, w_pos / RECORD - 1);
+  CHECK(r_records * RECORD >= REGION_SIZE - 2 * SECTOR);
+  CHECK(r_records * RECORD <= REGION_SIZE);
+}
+
+static void test_bad_sectors(void) {
+  u32_t s, wear_at_fail[2];
+  const u32_t bad[2] = {REGION_ADDR / SECTOR + 3, REGION_ADDR / SECTOR + 4};
+  setup();
+  run(8, 3, 5000);
+  for (s = 0; s < 2; s++) {
+    host_flash_sim.failing[bad[s]] = TRUE;
+    wear_at_fail[s] = host_flash_sim.wear[bad[s]];
+  }
+  run(8, 3, 60000);
+  check_flash();
+  check_wear();
+  CHECK_EQ(lg.bad_sectors, 2);
+  CHECK_EQ(lg.erase_fails, 2);
+  for (s = 0; s < 2; s++) {
+    // failed once, never tried again
+    CHECK_EQ(host_flash_sim.wear[bad[s]], wear_at_fail[s] + 1);
+  }
+  // writes wait for the failed erase and the one replacing it
+  CHECK(lg.dropped < lg.bytes / 100);
+  CHECK_EQ(lg.lost, 0);
+  CHECK_EQ(r_bad, 0);
+  CHECK_EQ(r_gaps, 0);
+  CHECK_EQ(r_records, w_pos / RECORD);
+
+  // all but two sectors failing, the last two are kept and retried
+  for (s = REGION_ADDR / SECTOR; s < (REGION_ADDR + REGION_SIZE) / SECTOR; s++) {
+    host_flash_sim.failing[s] = TRUE;
+  }
+  run(8, 3, 5000);
+  CHECK_EQ(lg.bad_sectors, REGION_SIZE / SECTOR - 2);
+  CHECK_EQ(host_flash_sim.bad_programs, 0);
+  CHECK_EQ(r_bad, 0);
+}
+
+int main(void) {
+  host_test_init();
+  TASK_init();
+  prod_task = TASK_create(prod_f, TASK_STATIC);
+  cons_task = TASK_create(cons_f, TASK_STATIC);
+  test_stream();
+  test_lagging_reader();
+  test_rewind();
+  test_bad_sectors();
+  if (host_test_failures) {
+    SFL_dump(IOSTD, &lg);
+  }
+  return host_test_result("spi_flash_log");
+}
@@ -0,0 +1,283 @@
+/*
+ * test_taskq.c
+ *
+ * Regression tests of the task queue on the virtual clock: dispatch order,
+ * loop tasks, pool reuse, timer accuracy, timers many laps of the timer
+ * wheel away and mutex handoff. Also built with the timer wheel, see
+ * test_taskq_wheel.mk.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+
+#define LOG_LEN   64
+
+static u32_t log_buf[LOG_LEN];
+static u32_t log_len;
+static sys_time log_time[LOG_LEN];
+
+static void log_clear(void) {
+  log_len = 0;
+}
+
+static void log_f(u32_t arg, void *arg_p) {
+  if (log_len < LOG_LEN) {
+    log_time[log_len] = SYS_get_time_ms();
+    log_buf[log_len++] = arg;
+  }
+}
+
+// Runs tasks and timers until given time, a ms at a time
+static void run_until(sys_time t) {
+  while (SYS_get_time_ms() < t) {
+    while (TASK_tick());
+    SYS_hardsleep_ms(1);
+  }
+  while (TASK_tick());
+}
+
+static void test_fifo(void) {
+  u32_t i;
+  log_clear();
+  for (i = 0; i < 10; i++) {
+    task *t = TASK_create(log_f, 0);
+    CHECK(t != NULL);
+    TASK_run(t, i, NULL);
+  }
+  while (TASK_tick());
+  CHECK_EQ(log_len, 10);
+  for (i = 0; i < 10; i++) {
+    CHECK_EQ(log_buf[i], i);
+  }
+  CHECK(!TASK_got_active_tasks());
+}
+
+static u32_t loops;
+static void loop_f(u32_t arg, void *arg_p) {
+  log_f(arg, arg_p);
+  if (++loops == arg) {
+    TASK_stop();
+  }
+}
+
+static void test_loop(void) {
+  log_clear();
+  loops = 0;
+  task *l = TASK_create(loop_f, 0);
+  TASK_loop(l, 5, NULL);
+  task *t = TASK_create(log_f, 0);
+  TASK_run(t, 100, NULL);
+  while (TASK_tick());
+  // loop task is requeued after the other task
+  CHECK_EQ(loops, 5);
+  CHECK_EQ(log_len, 6);
+  CHECK_EQ(log_buf[0], 5);
+  CHECK_EQ(log_buf[1], 100);
+  CHECK_EQ(log_buf[5], 5);
+  CHECK(!TASK_got_active_tasks());
+}
+
+static void test_pool_reuse(void) {
+  u32_t i;
+  // dynamic tasks are freed after execution
+  log_clear();
+  for (i = 0; i < CONFIG_TASK_POOL * 10; i++) {
+    task *t = TASK_create(log_f, 0);
+    CHECK(t != NULL);
+    if (t == NULL) break;
+    TASK_run(t, i, NULL);
+    while (TASK_tick());
+  }
+  CHECK_EQ(log_len, LOG_LEN);
+  // static tasks are kept
+  task *s = TASK_create(log_f, TASK_STATIC);
+  for (i = 0; i < 3; i++) {
+    TASK_run(s, i, NULL);
+    while (TASK_tick());
+  }
+  TASK_free(s);
+}
+
+static void test_timers(void) {
+  static task_timer tim[3];
+  task *tasks[3];
+  u32_t i;
+  sys_time now = SYS_get_time_ms();
+  log_clear();
+  // one shot at +5, recurrent from +3 every 10, recurrent from +7 every 25
+  for (i = 0; i < 3; i++) {
+    tasks[i] = TASK_create(log_f, TASK_STATIC);
+  }
+  TASK_start_timer(tasks[0], &tim[0], 0, NULL, 5, 0, "once");
+  TASK_start_timer(tasks[1], &tim[1], 1, NULL, 3, 10, "rec10");
+  TASK_start_timer(tasks[2], &tim[2], 2, NULL, 7, 25, "rec25");
+  run_until(now + 60);
+  TASK_stop_timer(&tim[1]);
+  TASK_stop_timer(&tim[2]);
+  run_until(now + 100);
+
+  // on the virtual clock, each expiry is dispatched on its exact ms
+  u32_t n[3] = {0, 0, 0};
+  for (i = 0; i < log_len; i++) {
+    u32_t a = log_buf[i];
+    sys_time rel = log_time[i] - now;
+    switch (a) {
+    case 0: CHECK_EQ(rel, 5); break;
+    case 1: CHECK_EQ(rel, 3 + 10 * n[1]); break;
+    case 2: CHECK_EQ(rel, 7 + 25 * n[2]); break;
+    }
+    n[a]++;
+  }
+  CHECK_EQ(n[0], 1);
+  CHECK_EQ(n[1], 6);
+  CHECK_EQ(n[2], 3);
+  for (i = 0; i < 3; i++) {
+    TASK_free(tasks[i]);
+  }
+}
+
+static void test_timer_restart(void) {
+  static task_timer tim;
+  task *t = TASK_create(log_f, TASK_STATIC);
+  sys_time now = SYS_get_time_ms();
+  log_clear();
+  TASK_start_timer(t, &tim, 1, NULL, 20, 0, "restart");
+  run_until(now + 10);
+  TASK_stop_timer(&tim);
+  TASK_start_timer(t, &tim, 2, NULL, 20, 0, "restart");
+  run_until(now + 50);
+  CHECK_EQ(log_len, 1);
+  CHECK_EQ(log_buf[0], 2);
+  CHECK_EQ(log_time[0] - now, 30);
+  TASK_free(t);
+}
+
+#define LAP_TIMERS  40
+#define LAP_STEPS   3000
+
+static task_timer lap_tim[LAP_TIMERS];
+// next expiry of each timer, 0 if stopped
+static sys_time lap_next[LAP_TIMERS];
+static sys_time lap_rec[LAP_TIMERS];
+static u32_t lap_runs;
+
+static void lap_f(u32_t arg, void *arg_p) {
+  CHECK_EQ(SYS_get_time_ms(), lap_next[arg]);
+  lap_next[arg] = lap_rec[arg] ? lap_next[arg] + lap_rec[arg] : 0;
+  lap_runs++;
+}
+
+static void test_timer_laps(void) {
+  task *tasks[LAP_TIMERS];
+  u32_t i, j, step;
+  // timers up to many wheel laps away, started and stopped at random, each
+  // expiring on its exact ms, next wakeup being the earliest of them
+  host_test_seed(3);
+  for (i = 0; i < LAP_TIMERS; i++) {
+    tasks[i] = TASK_create(lap_f, TASK_STATIC);
+  }
+  for (step = 0; step < LAP_STEPS && host_test_failures == 0; step++) {
+    sys_time now = SYS_get_time_ms();
+    i = host_test_rand() % LAP_TIMERS;
+    if (lap_next[i]) {
+      TASK_stop_timer(&lap_tim[i]);
+      lap_next[i] = 0;
+    } else {
+      sys_time start = 1 + host_test_rand() % 3000;
+      lap_rec[i] = host_test_rand() % 3 ? 0 : 1 + host_test_rand() % 500;
+      lap_next[i] = now + start;
+      TASK_start_timer(tasks[i], &lap_tim[i], i, NULL, start, lap_rec[i], "lap");
+    }
+    sys_time t, first = 0;
+    for (j = 0; j < LAP_TIMERS; j++) {
+      if (lap_next[j] && (first == 0 || lap_next[j] < first)) {
+        first = lap_next[j];
+      }
+    }
+    if (first) {
+      CHECK_EQ(TASK_next_wakeup_ms(&t, NULL), 0);
+      CHECK_EQ(t, first);
+    } else {
+      CHECK_EQ(TASK_next_wakeup_ms(&t, NULL), -1);
+    }
+    run_until(now + host_test_rand() % 200);
+  }
+  CHECK(lap_runs > LAP_STEPS / 4);
+  for (i = 0; i < LAP_TIMERS; i++) {
+    TASK_stop_timer(&lap_tim[i]);
+    TASK_free(tasks[i]);
+  }
+  sys_time t;
+  CHECK_EQ(TASK_next_wakeup_ms(&t, NULL), -1);
+}
+
+#ifdef CONFIG_TASKQ_MUTEX
+static task_mutex mutex = TASK_MUTEX_INIT;
+static task *holder;
+
+// takes mutex, returns without unlocking
+static void mutex_hold_f(u32_t arg, void *arg_p) {
+  CHECK(TASK_mutex_lock(&mutex));
+  log_f(arg, arg_p);
+}
+
+// takes mutex when available, then unlocks
+static void mutex_take_f(u32_t arg, void *arg_p) {
+  if (!TASK_mutex_lock(&mutex)) {
+    // rescheduled on unlock
+    return;
+  }
+  log_f(arg, arg_p);
+  TASK_mutex_unlock(&mutex);
+}
+
+static void mutex_release_f(u32_t arg, void *arg_p) {
+  log_f(arg, arg_p);
+  TASK_mutex_unlock(&mutex);
+}
+
+static void test_mutex_handoff(void) {
+  u32_t i;
+  log_clear();
+  holder = TASK_create(mutex_hold_f, TASK_STATIC);
+  TASK_run(holder, 0, NULL);
+  while (TASK_tick());
+  CHECK(mutex.taken);
+  // waiters queue up while mutex is held
+  for (i = 1; i <= 3; i++) {
+    task *t = TASK_create(mutex_take_f, 0);
+    TASK_run(t, i, NULL);
+  }
+  while (TASK_tick());
+  CHECK_EQ(log_len, 1);
+  CHECK(TASK_mutex_try_lock(&mutex) == FALSE);
+  // owner releases, waiters get mutex in order of waiting
+  task *r = TASK_create(mutex_release_f, 0);
+  TASK_run(r, 10, NULL);
+  while (TASK_tick());
+  CHECK_EQ(log_len, 5);
+  CHECK_EQ(log_buf[1], 10);
+  for (i = 1; i <= 3; i++) {
+    CHECK_EQ(log_buf[i + 1], i);
+  }
+  CHECK(!mutex.taken);
+  CHECK(!TASK_got_active_tasks());
+  TASK_free(holder);
+}
+#endif
+
+int main(void) {
+  host_test_init();
+  TASK_init();
+  test_fifo();
+  test_loop();
+  test_pool_reuse();
+  test_timers();
+  test_timer_restart();
+  test_timer_laps();
+#ifdef CONFIG_TASKQ_MUTEX
+  test_mutex_handoff();
+#endif
+  return host_test_result("taskq");
+}
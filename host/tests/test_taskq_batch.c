@@ -0,0 +1,366 @@
+/*
+ * test_taskq_batch.c
+ *
+ * TASK_tick_batch against TASK_tick on the virtual clock. A random workload
+ * of priority levels, loop tasks, tasks scheduling others and themselves
+ * while being dispatched, dynamic tasks and timers runs once dispatched by
+ * TASK_tick and once by TASK_tick_batch with random max_tasks and
+ * budget_ticks. Both must run the same tasks in the same order at the same
+ * ticks. Then each way a batch is cut is checked on its own: max_tasks,
+ * budget_ticks, a higher priority level getting ready and, with
+ * CONFIG_TASK_EDF, an earlier deadline getting ready, where the remainder
+ * is merged with the live queue on deadline. Built with priority levels
+ * here and with EDF as well by test_taskq_batch_edf.mk.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+
+#define TASKS         16
+#define TIMERS        3
+#define DYN_MAX       8
+#define LOOP_MAX      6
+#define ROUNDS        3000
+#define LOG_MAX       100000
+#define LEVELS        CONFIG_TASK_PRIO_LEVELS
+#define TICKS_PER_MS  (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+#define ID_LOOP       50
+#define ID_DYN        100
+#define ID_TIMER      200
+
+static task *tasks[TASKS];
+// runs left of each loop task, 0 if slot is free
+static u8_t loops_left[LOOP_MAX];
+static task *timer_tasks[TIMERS];
+static task_timer timers[TIMERS];
+static u32_t dyn_live;
+
+// execution log, ids and ticks from start of run
+static u16_t log_id[LOG_MAX];
+static sys_time log_tick[LOG_MAX];
+static u32_t log_len;
+static u16_t ref_id[LOG_MAX];
+static sys_time ref_tick[LOG_MAX];
+static u32_t ref_len;
+static sys_time t0_tick;
+
+// workload random, same sequence in both runs as long as order is same
+static u32_t wl_seed;
+
+static u32_t wl_rand(void) {
+  wl_seed = wl_seed * 1103515245 + 12345;
+  return wl_seed >> 16;
+}
+
+static void log_run(u32_t id) {
+  if (log_len < LOG_MAX) {
+    log_id[log_len] = id;
+    log_tick[log_len] = SYS_get_tick() - t0_tick;
+    log_len++;
+  }
+}
+
+static void align_ms(void) {
+  while (SYS_get_tick() % TICKS_PER_MS) {
+    SYS_hardsleep_us(1000 / TICKS_PER_MS);
+  }
+}
+
+static void work(u32_t id);
+
+static void dyn_f(u32_t arg, void *arg_p) {
+  log_run(arg);
+  dyn_live--;
+}
+
+// Loop tasks are dynamic, as a task stopped by TASK_stop is killed
+static void loop_f(u32_t arg, void *arg_p) {
+  work(ID_LOOP + arg);
+  if (--loops_left[arg] == 0) {
+    TASK_stop();
+  }
+}
+
+static void start_loop(void) {
+  u32_t i;
+  for (i = 0; i < LOOP_MAX; i++) {
+    if (loops_left[i] == 0) {
+      task *l = TASK_create_prio(loop_f, 0, wl_rand() % LEVELS);
+      CHECK(l != NULL);
+      loops_left[i] = 1 + wl_rand() % 4;
+      TASK_loop(l, i, NULL);
+      return;
+    }
+  }
+}
+
+static void try_run(u32_t i) {
+  if (!TASK_is_running(tasks[i])) {
+    TASK_run(tasks[i], i, NULL);
+  }
+}
+
+static void work(u32_t id) {
+  log_run(id);
+  u32_t r = wl_rand();
+  if (r % 4 == 0) {
+    // time passes, timers expire meanwhile
+    SYS_hardsleep_us(100 * (1 + wl_rand() % 5));
+  }
+  if (r % 3 == 0) {
+    // another one, maybe already dispatched in this batch, any level
+    try_run(wl_rand() % TASKS);
+  }
+  if (r % 11 == 0 && id < TASKS) {
+    // self, runs again at once and is queued again
+    try_run(id);
+  }
+  if (r % 7 == 0) {
+    start_loop();
+  }
+  if (r % 13 == 0 && dyn_live < DYN_MAX) {
+    task *d = TASK_create_prio(dyn_f, 0, wl_rand() % LEVELS);
+    CHECK(d != NULL);
+    dyn_live++;
+    TASK_run(d, ID_DYN + id, NULL);
+  }
+}
+
+static void work_f(u32_t arg, void *arg_p) {
+  work(arg);
+}
+
+static void timer_f(u32_t arg, void *arg_p) {
+  log_run(ID_TIMER + arg);
+}
+
+static u32_t batches, cut_max, cut_budget;
+
+static void dispatch(bool batch) {
+  if (!batch) {
+    while (TASK_tick());
+    return;
+  }
+  while (TRUE) {
+    u32_t max = host_test_rand() % 6;
+    sys_time budget = host_test_rand() % 3 ? 0 : 1 + host_test_rand() % 8;
+    sys_time start = SYS_get_tick();
+    u32_t n = TASK_tick_batch(max, budget);
+    if (n == 0) {
+      break;
+    }
+    CHECK(max == 0 || n <= max);
+    batches++;
+    if (max && n == max) {
+      cut_max++;
+    } else if (budget && SYS_get_tick() - start >= budget) {
+      cut_budget++;
+    }
+  }
+}
+
+static void run_workload(bool batch) {
+  u32_t i, round;
+  wl_seed = 6;
+  log_len = 0;
+  dyn_live = 0;
+  memset(loops_left, 0, sizeof(loops_left));
+  align_ms();
+  t0_tick = SYS_get_tick();
+  for (i = 0; i < TIMERS; i++) {
+    TASK_start_timer(timer_tasks[i], &timers[i], i, NULL, 1 + i, 3 + 4 * i, "batch");
+#ifdef CONFIG_TASK_EDF
+    TASK_set_timer_deadline(&timers[i], i);
+#endif
+  }
+  for (round = 0; round < ROUNDS; round++) {
+    u32_t n = 1 + wl_rand() % 4;
+    while (n--) {
+      if (wl_rand() % 4) {
+        try_run(wl_rand() % TASKS);
+      } else {
+        start_loop();
+      }
+    }
+    dispatch(batch);
+    SYS_hardsleep_us(100 * (1 + wl_rand() % 10));
+  }
+  for (i = 0; i < TIMERS; i++) {
+    TASK_stop_timer(&timers[i]);
+  }
+  dispatch(batch);
+  CHECK(!TASK_got_active_tasks());
+  CHECK_EQ(dyn_live, 0);
+  for (i = 0; i < LOOP_MAX; i++) {
+    CHECK_EQ(loops_left[i], 0);
+  }
+  CHECK(log_len < LOG_MAX);
+}
+
+static void test_same_order(void) {
+  u32_t i;
+  for (i = 0; i < TASKS; i++) {
+    tasks[i] = TASK_create_prio(work_f, TASK_STATIC, i % LEVELS);
+  }
+  for (i = 0; i < TIMERS; i++) {
+    timer_tasks[i] = TASK_create_prio(timer_f, TASK_STATIC, (LEVELS - 1 + i) % LEVELS);
+  }
+  run_workload(FALSE);
+  memcpy(ref_id, log_id, sizeof(ref_id));
+  memcpy(ref_tick, log_tick, sizeof(ref_tick));
+  ref_len = log_len;
+  host_test_seed(6);
+  run_workload(TRUE);
+  CHECK_EQ(log_len, ref_len);
+  for (i = 0; i < MIN(log_len, ref_len); i++) {
+    if (log_id[i] != ref_id[i] || log_tick[i] != ref_tick[i]) {
+      printf("run %u differs: %u at tick %u, was %u at tick %u\n",
+          i, log_id[i], (u32_t)log_tick[i], ref_id[i], (u32_t)ref_tick[i]);
+      CHECK(FALSE);
+      break;
+    }
+  }
+  CHECK(cut_max > 0);
+  CHECK(cut_budget > 0);
+  for (i = 0; i < TASKS; i++) {
+    TASK_free(tasks[i]);
+  }
+  for (i = 0; i < TIMERS; i++) {
+    TASK_free(timer_tasks[i]);
+  }
+  printf("%u runs in %u batches, %u cut by max_tasks, %u by budget_ticks\n",
+      ref_len, batches, cut_max, cut_budget);
+}
+
+// ids logged by the cut tests
+static u32_t cut_log[16];
+static u32_t cut_len;
+static task *cut_tasks[6];
+
+static void cut_f(u32_t arg, void *arg_p) {
+  cut_log[cut_len++] = arg;
+  // arg_p is us to be busy
+  SYS_hardsleep_us((u32_t)(uintptr_t)arg_p);
+}
+
+static void cut_run_f(u32_t arg, void *arg_p) {
+  cut_log[cut_len++] = arg;
+  // schedules task 4, then is busy for a ms
+  TASK_run(cut_tasks[4], 4, NULL);
+  SYS_hardsleep_ms(1);
+}
+
+static void cut_setup(u8_t prio_first) {
+  u32_t i;
+  cut_len = 0;
+  align_ms();
+  for (i = 0; i < 6; i++) {
+    cut_tasks[i] = TASK_create_prio(i == 0 ? cut_run_f : cut_f, TASK_STATIC, 0);
+  }
+  TASK_free(cut_tasks[0]);
+  cut_tasks[0] = TASK_create_prio(cut_run_f, TASK_STATIC, prio_first);
+}
+
+static void cut_free(void) {
+  u32_t i;
+  // nothing left behind
+  CHECK_EQ(TASK_tick(), 0);
+  for (i = 0; i < 6; i++) {
+    TASK_free(cut_tasks[i]);
+  }
+}
+
+static void check_cut_log(const u32_t *ids, u32_t len) {
+  u32_t i;
+  CHECK_EQ(cut_len, len);
+  for (i = 0; i < MIN(cut_len, len); i++) {
+    CHECK_EQ(cut_log[i], ids[i]);
+  }
+}
+
+static void test_cut_max(void) {
+  u32_t i;
+  cut_setup(0);
+  for (i = 1; i <= 3; i++) {
+    TASK_run(cut_tasks[i], i, NULL);
+  }
+  CHECK_EQ(TASK_tick_batch(2, 0), 2);
+  // task scheduled after the cut goes after the remainder
+  TASK_run(cut_tasks[5], 5, NULL);
+  CHECK_EQ(TASK_tick_batch(0, 0), 2);
+  const u32_t ids[] = {1, 2, 3, 5};
+  check_cut_log(ids, 4);
+  cut_free();
+}
+
+static void test_cut_budget(void) {
+  u32_t i;
+  cut_setup(0);
+  // each busy for 3 ticks, budget is spent after the second
+  for (i = 1; i <= 3; i++) {
+    TASK_run(cut_tasks[i], i, (void *)(uintptr_t)(3 * 1000 / TICKS_PER_MS));
+  }
+  CHECK_EQ(TASK_tick_batch(0, 5), 2);
+  CHECK_EQ(TASK_tick_batch(0, 5), 1);
+  const u32_t ids[] = {1, 2, 3};
+  check_cut_log(ids, 3);
+  cut_free();
+}
+
+static void test_cut_prio(void) {
+  u32_t i;
+  // first task schedules task 4 on a higher level while the batch runs
+  cut_setup(0);
+  TASK_set_prio(cut_tasks[4], 1);
+  TASK_run(cut_tasks[0], 0, NULL);
+  for (i = 1; i <= 2; i++) {
+    TASK_run(cut_tasks[i], i, NULL);
+  }
+  CHECK_EQ(TASK_tick_batch(0, 0), 1);
+  CHECK_EQ(TASK_tick_batch(0, 0), 1);
+  CHECK_EQ(TASK_tick_batch(0, 0), 2);
+  const u32_t ids[] = {0, 4, 1, 2};
+  check_cut_log(ids, 4);
+  cut_free();
+}
+
+#ifdef CONFIG_TASK_EDF
+static void test_cut_edf(void) {
+  u32_t i;
+  static task_timer tim;
+  cut_setup(0);
+  sys_time now = SYS_get_time_ms();
+  // 0, 1, 2 get deadline now + CONFIG_TASK_EDF_DEADLINE. While 0 is busy,
+  // timer task 5 gets deadline now + 1 and 4 is scheduled with same
+  // deadline as 1 and 2 at now, then time passes
+  TASK_run(cut_tasks[0], 0, NULL);
+  for (i = 1; i <= 2; i++) {
+    TASK_run(cut_tasks[i], i, NULL);
+  }
+  TASK_start_timer(cut_tasks[5], &tim, 5, NULL, 1, 0, "edf");
+  TASK_set_timer_deadline(&tim, 0);
+  CHECK_EQ(TASK_tick_batch(0, 0), 1);
+  CHECK_EQ(SYS_get_time_ms(), now + 1);
+  // remainder merged with live queue: 5 is earliest, 1 and 2 go before 4 on
+  // same deadline, being scheduled earlier
+  CHECK_EQ(TASK_tick_batch(0, 0), 4);
+  const u32_t ids[] = {0, 5, 1, 2, 4};
+  check_cut_log(ids, 5);
+  CHECK_EQ(tim.missed, 0);
+  cut_free();
+}
+#endif
+
+int main(void) {
+  host_test_init();
+  TASK_init();
+  test_same_order();
+  test_cut_max();
+  test_cut_budget();
+  test_cut_prio();
+#ifdef CONFIG_TASK_EDF
+  test_cut_edf();
+#endif
+  return host_test_result("taskq_batch");
+}
@@ -0,0 +1,3 @@
+SRC = test_taskq_batch.c
+CONFIG_TASK_QUEUE = 1
+PROG_FLAGS += -DCONFIG_TASK_PRIO_LEVELS=4 -DCONFIG_TASK_EDF
@@ -0,0 +1,255 @@
+/*
+ * test_taskq_edf.c
+ *
+ * Timer tasks of a mixed periodic workload on one priority level, on the
+ * virtual clock: a fast task with a tight deadline, a medium one, and a
+ * bulk of slow tasks all expiring on the same ms as the others every
+ * BULK_PERIOD_MS. Reports start latency, jitter and deadline misses of
+ * each, and reruns of tasks scheduled again while running. Built with
+ * CONFIG_TASK_EDF here and without by test_taskq_edf_off.mk.
+ *
+ * With EDF, expired timers are sorted in on deadline, at the head, in the
+ * middle and at the tail of the queue, and no deadline is missed. The timer
+ * miss and overrun counters follow what is measured. Without EDF, tasks
+ * run in order of expiry, the fast one waiting behind the bulk and missing.
+ * Then a long task hogs the queue, making the fast timer overrun and miss,
+ * which the counters must show.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+
+#define BULK            8
+#define BULK_PERIOD_MS  20
+#define BULK_US         1000
+#define MID_PERIOD_MS   20
+#define MID_DEADLINE_MS 5
+#define MID_US          500
+#define FAST_PERIOD_MS  10
+#define FAST_DEADLINE_MS 2
+#define FAST_US         300
+#define HOG_US          25000
+#define RUN_MS          10000
+#define TICKS_PER_MS    (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+
+#define ID_FAST         0
+#define ID_MID          1
+#define ID_BULK         2
+#define IDS             (ID_BULK + BULK)
+
+typedef struct {
+  const char *name;
+  sys_time period;
+  sys_time deadline;
+  u32_t busy_us;
+  task *t;
+  task_timer timer;
+  // expiry of next run in ticks
+  sys_time expiry;
+  u32_t runs;
+  u32_t reruns;
+  u32_t misses;
+  sys_time lat_min, lat_max;
+  u64_t lat_sum;
+} periodic;
+
+static periodic per[IDS];
+// ids in order of start for the first common expiry
+static u32_t order[IDS];
+static u32_t order_len;
+static sys_time common_ms;
+
+static void periodic_f(u32_t arg, void *arg_p) {
+  periodic *p = &per[arg];
+  sys_time now = SYS_get_tick();
+  sys_time expiry = p->expiry;
+  // expiries while pending are overruns, one while running schedules again,
+  // so next run is for first expiry after this one started
+  while (p->expiry <= now) {
+    p->expiry += p->period * TICKS_PER_MS;
+  }
+  SYS_hardsleep_us(p->busy_us);
+  if (expiry > now) {
+    // scheduled while running, ran again and was queued again for same expiry
+    p->reruns++;
+    return;
+  }
+  if (expiry / TICKS_PER_MS == common_ms && order_len < IDS) {
+    order[order_len++] = arg;
+  }
+  sys_time lat = now - expiry;
+  p->lat_min = MIN(p->lat_min, lat);
+  p->lat_max = MAX(p->lat_max, lat);
+  p->lat_sum += lat;
+  // late if finished after the ms of the deadline, as the scheduler counts
+  if (SYS_get_time_ms() > expiry / TICKS_PER_MS + p->deadline) {
+    p->misses++;
+  }
+  p->runs++;
+}
+
+static void hog_f(u32_t arg, void *arg_p) {
+  SYS_hardsleep_us(HOG_US);
+}
+
+static void setup(periodic *p, const char *name, sys_time period, sys_time deadline, u32_t busy_us) {
+  p->name = name;
+  p->period = period;
+  p->deadline = deadline;
+  p->busy_us = busy_us;
+  p->t = TASK_create(periodic_f, TASK_STATIC);
+}
+
+static void start(u32_t id, sys_time t0) {
+  periodic *p = &per[id];
+  p->expiry = (t0 + p->period) * TICKS_PER_MS;
+  p->runs = p->reruns = p->misses = 0;
+  p->lat_min = (sys_time)-1;
+  p->lat_max = p->lat_sum = 0;
+  TASK_start_timer(p->t, &p->timer, id, NULL, p->period, p->period, p->name);
+#ifdef CONFIG_TASK_EDF
+  TASK_set_timer_deadline(&p->timer, p->deadline);
+#endif
+}
+
+static void run_until(sys_time t) {
+  while (SYS_get_time_ms() < t) {
+    if (!TASK_tick()) {
+      TASK_wait();
+    }
+  }
+}
+
+static void report(const char *phase) {
+  u32_t id;
+  u32_t runs = 0, reruns = 0, misses = 0, lat_max = 0;
+  sys_time lat_min = (sys_time)-1;
+  u64_t lat_sum = 0;
+  for (id = 0; id < ID_BULK + 1; id++) {
+    periodic *p = &per[id];
+    if (id == ID_BULK) {
+      // bulk together
+      u32_t b;
+      for (b = ID_BULK; b < IDS; b++) {
+        runs += per[b].runs;
+        reruns += per[b].reruns;
+        misses += per[b].misses;
+        lat_sum += per[b].lat_sum;
+        lat_min = MIN(lat_min, per[b].lat_min);
+        lat_max = MAX(lat_max, per[b].lat_max);
+      }
+    } else {
+      runs = p->runs;
+      reruns = p->reruns;
+      misses = p->misses;
+      lat_sum = p->lat_sum;
+      lat_min = p->lat_min;
+      lat_max = p->lat_max;
+    }
+    printf("%s %s, %-4s %2i/%2i ms: %5i runs %3i reruns, latency avg %5.2f max %5.2f ms, "
+        "jitter %5.2f ms, %5.1f%% missed\n",
+#ifdef CONFIG_TASK_EDF
+        "edf ",
+#else
+        "fifo",
+#endif
+        phase, p->name, p->period, p->deadline, runs, reruns,
+        (double)lat_sum / runs / TICKS_PER_MS, (double)lat_max / TICKS_PER_MS,
+        (double)(lat_max - lat_min) / TICKS_PER_MS, 100.0 * misses / runs);
+  }
+}
+
+static void stop_all(void) {
+  u32_t id;
+  for (id = 0; id < IDS; id++) {
+    TASK_stop_timer(&per[id].timer);
+  }
+  while (TASK_tick());
+}
+
+#ifdef CONFIG_TASK_EDF
+static void check_counters(void) {
+  u32_t id;
+  for (id = 0; id < IDS; id++) {
+    CHECK_EQ(per[id].timer.missed, per[id].misses);
+  }
+}
+#endif
+
+static void test_mixed(void) {
+  u32_t id;
+  // start on a ms, no timer to wait for yet
+  while (SYS_get_tick() % TICKS_PER_MS) {
+    SYS_hardsleep_us(1000 / TICKS_PER_MS);
+  }
+  sys_time t0 = SYS_get_time_ms();
+  // bulk first, fast last, so expiry order is worst for the fast one
+  for (id = IDS; id-- > 0;) {
+    start(id, t0);
+  }
+  common_ms = t0 + BULK_PERIOD_MS;
+  order_len = 0;
+  run_until(t0 + RUN_MS);
+  report("mixed");
+
+  CHECK_EQ(order_len, IDS);
+  CHECK(per[ID_FAST].runs >= RUN_MS / FAST_PERIOD_MS - 1);
+#ifdef CONFIG_TASK_EDF
+  // sorted in at head, middle and tail, ties in order of expiry
+  CHECK_EQ(order[0], ID_FAST);
+  CHECK_EQ(order[1], ID_MID);
+  for (id = ID_BULK; id < IDS; id++) {
+    CHECK_EQ(order[id], IDS - 1 - (id - ID_BULK));
+  }
+  for (id = 0; id < IDS; id++) {
+    CHECK_EQ(per[id].misses, 0);
+    CHECK_EQ(per[id].timer.overruns, 0);
+  }
+  check_counters();
+#else
+  // fast one runs last, behind the bulk
+  CHECK_EQ(order[IDS - 1], ID_FAST);
+  CHECK(per[ID_FAST].misses > 0);
+#endif
+
+  // a long task hogs the queue each bulk period for a while
+  task *hog = TASK_create(hog_f, TASK_STATIC);
+  for (id = 0; id < IDS; id++) {
+    per[id].runs = per[id].reruns = per[id].misses = 0;
+    per[id].lat_min = (sys_time)-1;
+    per[id].lat_max = per[id].lat_sum = 0;
+#ifdef CONFIG_TASK_EDF
+    per[id].timer.missed = 0;
+#endif
+  }
+  sys_time t1 = SYS_get_time_ms();
+  while (SYS_get_time_ms() < t1 + RUN_MS / 10) {
+    TASK_run(hog, 0, NULL);
+    run_until(SYS_get_time_ms() + 5 * BULK_PERIOD_MS);
+  }
+  report("hog  ");
+  CHECK(per[ID_FAST].misses > 0);
+#ifdef CONFIG_TASK_EDF
+  CHECK(per[ID_FAST].timer.overruns > 0);
+  check_counters();
+#endif
+  stop_all();
+  TASK_free(hog);
+}
+
+int main(void) {
+  u32_t id;
+  host_test_init();
+  TASK_init();
+  setup(&per[ID_FAST], "fast", FAST_PERIOD_MS, FAST_DEADLINE_MS, FAST_US);
+  setup(&per[ID_MID], "mid", MID_PERIOD_MS, MID_DEADLINE_MS, MID_US);
+  for (id = ID_BULK; id < IDS; id++) {
+    setup(&per[id], "bulk", BULK_PERIOD_MS, BULK_PERIOD_MS, BULK_US);
+  }
+  test_mixed();
+  for (id = 0; id < IDS; id++) {
+    TASK_free(per[id].t);
+  }
+  return host_test_result("taskq_edf");
+}
@@ -0,0 +1,2 @@
+CONFIG_TASK_QUEUE = 1
+PROG_FLAGS += -DCONFIG_TASK_EDF
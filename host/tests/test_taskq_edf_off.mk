@@ -0,0 +1,2 @@
+SRC = test_taskq_edf.c
+CONFIG_TASK_QUEUE = 1
@@ -0,0 +1,93 @@
+/*
+ * test_taskq_prio.c
+ *
+ * Worst case dispatch latency of a high priority timer task under a flood
+ * of low priority loop tasks, on the virtual clock. Each low priority task
+ * is busy for a while on each run. With its own priority level, the timer
+ * task must run within one low priority task execution of its expiry. At
+ * the low priority level, it waits for the whole flood.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+
+#define FLOOD_TASKS   32
+#define FLOOD_US      300
+#define FLOOD_STEP_US 100
+#define PERIOD_MS     11
+#define RUN_MS        5000
+#define TICKS_PER_MS  (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+
+static task_timer timer;
+static sys_time expect;
+static sys_time lat_max;
+static u64_t lat_sum;
+static u32_t runs;
+
+static void high_f(u32_t arg, void *arg_p) {
+  sys_time lat = SYS_get_tick() - expect;
+  lat_max = MAX(lat_max, lat);
+  lat_sum += lat;
+  runs++;
+  expect += PERIOD_MS * TICKS_PER_MS;
+}
+
+// busy in steps, so timers expire while it executes. Not a divisor of the
+// period, so expiries hit different points of the flood task
+static void flood_f(u32_t arg, void *arg_p) {
+  u32_t us;
+  for (us = 0; us < FLOOD_US; us += FLOOD_STEP_US) {
+    SYS_hardsleep_us(FLOOD_STEP_US);
+  }
+}
+
+static void measure(u8_t prio) {
+  u32_t i;
+  task *flood[FLOOD_TASKS];
+  for (i = 0; i < FLOOD_TASKS; i++) {
+    flood[i] = TASK_create_prio(flood_f, TASK_STATIC, 0);
+    TASK_loop(flood[i], 0, NULL);
+  }
+  task *high = TASK_create_prio(high_f, TASK_STATIC, prio);
+  lat_max = 0;
+  lat_sum = 0;
+  runs = 0;
+  sys_time start = SYS_get_time_ms();
+  expect = (start + PERIOD_MS) * TICKS_PER_MS;
+  TASK_start_timer(high, &timer, 0, NULL, PERIOD_MS, PERIOD_MS, "high");
+  while (SYS_get_time_ms() < start + RUN_MS) {
+    if (!TASK_tick()) {
+      TASK_wait();
+    }
+  }
+  TASK_stop_timer(&timer);
+  for (i = 0; i < FLOOD_TASKS; i++) {
+    TASK_free(flood[i]);
+  }
+  while (TASK_tick());
+  TASK_free(high);
+  printf("timer task at priority %i among %i low priority tasks of %i us: "
+      "%i runs, latency avg %.2f ms max %.2f ms\n",
+      prio, FLOOD_TASKS, FLOOD_US, runs,
+      (double)lat_sum / runs / TICKS_PER_MS, (double)lat_max / TICKS_PER_MS);
+}
+
+int main(void) {
+  const sys_time flood_ticks = FLOOD_US * TICKS_PER_MS / 1000;
+  host_test_init();
+  TASK_init();
+
+  measure(0);
+  // same level, waits behind most of the flood
+  CHECK(lat_max >= (FLOOD_TASKS - 1) * flood_ticks);
+  CHECK(runs >= RUN_MS / PERIOD_MS - 1);
+
+  measure(CONFIG_TASK_PRIO_LEVELS - 1);
+  // own level, waits at most for the low priority task executing
+  CHECK(lat_max > 0);
+  CHECK(lat_max <= flood_ticks);
+  CHECK(runs >= RUN_MS / PERIOD_MS - 1);
+
+  return host_test_result("taskq_prio");
+}
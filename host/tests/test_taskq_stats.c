@@ -0,0 +1,84 @@
+/*
+ * test_taskq_stats.c
+ *
+ * Execution statistics of dynamic, static and looped tasks dispatched by
+ * TASK_tick and TASK_tick_batch, on the virtual clock. Dynamic tasks create
+ * their successor when run, so freed pool slots are taken again while
+ * statistics are gathered.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+
+#define CHAIN       1000
+#define EXE_US      300
+#define TICKS_PER_MS  (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+#define EXE_TICKS   (EXE_US * TICKS_PER_MS / 1000)
+
+static u32_t chain_left;
+static u32_t loops_left;
+static task *loop_task;
+
+static void chain_b_f(u32_t arg, void *arg_p);
+
+static void chain_a_f(u32_t arg, void *arg_p) {
+  SYS_hardsleep_us(EXE_US);
+  if (chain_left && --chain_left) {
+    TASK_run(TASK_create(chain_b_f, 0), 0, NULL);
+  }
+}
+
+static void chain_b_f(u32_t arg, void *arg_p) {
+  if (chain_left && --chain_left) {
+    TASK_run(TASK_create(chain_a_f, 0), 0, NULL);
+  }
+}
+
+static void loop_f(u32_t arg, void *arg_p) {
+  SYS_hardsleep_us(EXE_US);
+  if (--loops_left == 0) {
+    TASK_stop(loop_task);
+  }
+}
+
+static void check_stats(bool batch) {
+  task_stat a, b, l;
+  TASK_init();
+  TASK_stats_reset();
+  chain_left = CHAIN;
+  loops_left = CHAIN / 2;
+  TASK_run(TASK_create(chain_a_f, 0), 0, NULL);
+  TASK_run(TASK_create(chain_b_f, 0), 0, NULL);
+  loop_task = TASK_create(loop_f, TASK_STATIC);
+  TASK_loop(loop_task, 0, NULL);
+  while (batch ? TASK_tick_batch(0, 0) : TASK_tick());
+
+  CHECK(TASK_stats(0, &a));
+  CHECK(TASK_stats(1, &b));
+  CHECK(TASK_stats(2, &l));
+  CHECK(a.f == chain_a_f);
+  CHECK(b.f == chain_b_f);
+  CHECK(l.f == loop_f);
+  // two chains share the countdown, each run but the last creates one task
+  CHECK_EQ(a.runs + b.runs, CHAIN + 1);
+  CHECK_EQ(l.runs, CHAIN / 2);
+  CHECK_EQ(a.exe_min, EXE_TICKS);
+  CHECK_EQ(a.exe_max, EXE_TICKS);
+  CHECK_EQ(b.exe_max, 0);
+  CHECK_EQ(l.exe_total, (u64_t)l.runs * EXE_TICKS);
+  // a lap is one a, one b and the loop task, the loop task being waited
+  // for from its previous dispatch
+  CHECK_EQ(l.wait_max, 2 * EXE_TICKS);
+  CHECK(l.wait_total >= (l.runs - 1) * (sys_time)(2 * EXE_TICKS));
+  CHECK_EQ(a.wait_max, 2 * EXE_TICKS);
+  if (host_test_failures) {
+    TASK_dump_stats(IOSTD);
+  }
+}
+
+int main(void) {
+  host_test_init();
+  check_stats(FALSE);
+  check_stats(TRUE);
+  return host_test_result("taskq_stats");
+}
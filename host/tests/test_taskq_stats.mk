@@ -0,0 +1,2 @@
+CONFIG_TASK_QUEUE = 1
+PROG_FLAGS += -DCONFIG_TASK_STATS -DTASK_WARN_HIGH_EXE_TIME=1000
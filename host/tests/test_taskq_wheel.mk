@@ -0,0 +1,3 @@
+SRC = test_taskq.c
+CONFIG_TASK_QUEUE = 1
+PROG_FLAGS += -DCONFIG_TASKQ_MUTEX -DCONFIG_TASK_TIMER_WHEEL
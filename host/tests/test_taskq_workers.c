@@ -0,0 +1,105 @@
+/*
+ * test_taskq_workers.c
+ *
+ * Task queue workers as parallel host threads, CONFIG_ARCH_HOST_SMP:
+ * randomly scheduled static and dynamic tasks of all priorities must all
+ * execute, and a task must never execute on two workers at once.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "miniutils.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define STATICS             32
+#define POSTS               200000
+
+static task *statics[STATICS];
+static volatile u32_t busy[STATICS];
+static u32_t runs[STATICS];
+static u32_t posts[STATICS];
+static volatile u32_t overlaps;
+static volatile u32_t dyn_runs;
+
+static void *worker_thread(void *arg) {
+  TASK_worker_register((u32_t)(intptr_t)arg);
+  while (TRUE) {
+    while (TASK_tick());
+    TASK_wait();
+  }
+  return NULL;
+}
+
+static void spin(u32_t n) {
+  volatile u32_t i;
+  for (i = 0; i < n; i++);
+}
+
+static void static_f(u32_t arg, void *arg_p) {
+  if (__atomic_exchange_n(&busy[arg], 1, __ATOMIC_ACQUIRE)) {
+    __atomic_add_fetch(&overlaps, 1, __ATOMIC_RELAXED);
+  }
+  // not atomic, relying on the task being exclusive
+  runs[arg]++;
+  spin(arg * 16);
+  if (arg & 1) {
+    // let other workers in while executing
+    sched_yield();
+  }
+  __atomic_store_n(&busy[arg], 0, __ATOMIC_RELEASE);
+}
+
+static void dyn_f(u32_t arg, void *arg_p) {
+  spin(arg);
+  __atomic_add_fetch(&dyn_runs, 1, __ATOMIC_RELAXED);
+}
+
+int main(void) {
+  u32_t i, dyn_posts = 0;
+  pthread_t thread;
+  host_test_init();
+  TASK_init();
+  for (i = 0; i < STATICS; i++) {
+    statics[i] = TASK_create_prio(static_f, TASK_STATIC, i % CONFIG_TASK_PRIO_LEVELS);
+    CHECK(statics[i] != NULL);
+  }
+  for (i = 0; i < CONFIG_TASK_WORKERS; i++) {
+    pthread_create(&thread, NULL, worker_thread, (void *)(intptr_t)i);
+  }
+
+  host_test_seed(0x5eed);
+  for (i = 0; i < POSTS; i++) {
+    u32_t r = host_test_rand();
+    if (r & 1) {
+      u32_t s = (r >> 1) % STATICS;
+      // only scheduled from here, so not running stays so until run
+      if (!TASK_is_running(statics[s])) {
+        TASK_run(statics[s], s, NULL);
+        posts[s]++;
+      }
+    } else {
+      task *t = TASK_create_prio(dyn_f, 0, (r >> 1) % CONFIG_TASK_PRIO_LEVELS);
+      if (t) {
+        TASK_run(t, (r >> 8) & 0xff, NULL);
+        dyn_posts++;
+      }
+    }
+    if ((r & 0xf00) == 0) {
+      sched_yield();
+    }
+  }
+  while (TASK_got_active_tasks()) {
+    sched_yield();
+  }
+
+  CHECK_EQ(overlaps, 0);
+  CHECK_EQ(dyn_runs, dyn_posts);
+  CHECK(dyn_posts > POSTS / 4);
+  for (i = 0; i < STATICS; i++) {
+    // rescheduled while executing runs again, so at least once per post
+    CHECK(runs[i] >= posts[i]);
+    CHECK(posts[i] > 0);
+  }
+  return host_test_result("taskq_workers");
+}
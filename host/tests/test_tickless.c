@@ -0,0 +1,127 @@
+/*
+ * test_tickless.c
+ *
+ * Drift simulation of tickless idle on the virtual clock. The host
+ * simulates a 32768 Hz generic timer counting from true time while the
+ * 10 kHz main timer tick is suspended. Task timers and sleeping threads
+ * wake the system on periods not matching the generic timer, and the
+ * system clock is compared with true time on each wakeup, for two days of
+ * simulated time per case, long enough for slow drift to add up.
+ */
+
+#include "host_test.h"
+#include "taskq.h"
+#include "os.h"
+
+#define RUN_MS        (48 * 60 * 60 * 1000)
+#define TICKS_PER_MS  (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+#define NS_PER_TICK   (1000000000LL / SYS_MAIN_TIMER_FREQ)
+
+static s64_t drift_min, drift_max;
+static u32_t wakeups;
+
+// system clock minus true time, in ns
+static s64_t drift_ns(void) {
+  return (s64_t)SYS_get_tick() * NS_PER_TICK - (s64_t)arch_host_true_time_ns();
+}
+
+static void sample(void) {
+  s64_t d = drift_ns();
+  drift_min = MIN(drift_min, d);
+  drift_max = MAX(drift_max, d);
+  wakeups++;
+}
+
+static void reset(void) {
+  drift_min = drift_max = drift_ns();
+  wakeups = 0;
+  SYS_idle_stats_reset();
+}
+
+static void report(const char *name) {
+  sys_time idle, total;
+  u32_t sleeps;
+  SYS_idle_stats(&idle, &total, &sleeps);
+  printf("%s: %u wakeups, %u tickless sleeps, idle %.2f%%, "
+      "drift %+.1f..%+.1f us, final %+.1f us\n",
+      name, wakeups, sleeps, total ? 100.0 * idle / total : 0.0,
+      drift_min / 1000.0, drift_max / 1000.0, drift_ns() / 1000.0);
+}
+
+static void timer_f(u32_t arg, void *arg_p) {
+  sample();
+  // a little work on each wakeup
+  SYS_hardsleep_us(arg);
+}
+
+static void test_taskq(void) {
+  static task_timer tim[3];
+  static const u32_t period[3] = {7, 113, 1009};
+  u32_t i;
+  sys_time end = SYS_get_time_ms() + RUN_MS;
+  reset();
+  for (i = 0; i < 3; i++) {
+    task *t = TASK_create(timer_f, TASK_STATIC);
+    TASK_start_timer(t, &tim[i], 30 * (i + 1), NULL, period[i], period[i], "tl");
+  }
+  while (SYS_get_time_ms() < end) {
+    while (TASK_tick());
+    TASK_wait();
+  }
+  for (i = 0; i < 3; i++) {
+    TASK_stop_timer(&tim[i]);
+  }
+  while (TASK_tick());
+  report("task timers 7/113/1009 ms");
+  CHECK(wakeups >= RUN_MS / 7);
+}
+
+static os_thread thr[2];
+static u8_t stacks[2][256];
+static volatile bool stop;
+
+static void *sleeper_f(void *arg) {
+  while (!stop) {
+    OS_thread_sleep((sys_time)(intptr_t)arg);
+    sample();
+    SYS_hardsleep_us(50);
+  }
+  return NULL;
+}
+
+static void test_os(void) {
+  sys_time end = SYS_get_time_ms() + RUN_MS;
+  reset();
+  stop = FALSE;
+  OS_thread_create(&thr[0], 0, sleeper_f, (void *)37, stacks[0], sizeof(stacks[0]), "s37");
+  OS_thread_create(&thr[1], 0, sleeper_f, (void *)251, stacks[1], sizeof(stacks[1]), "s251");
+  while (SYS_get_time_ms() < end) {
+    OS_idle();
+  }
+  stop = TRUE;
+  while (OS_get_running_threads() || OS_get_next_wakeup(NULL) != OS_WUP_SLEEP_FOREVER) {
+    OS_idle();
+  }
+  report("threads sleeping 37/251 ms");
+  CHECK(wakeups >= RUN_MS / 37);
+}
+
+int main(void) {
+  static gen_tim tim;
+  host_test_init();
+  TASK_init();
+  OS_init();
+  timer_init(&tim);
+  SYS_tickless_init(&tim);
+
+  test_taskq();
+  // clock must not drift more than a main timer tick from true time
+  CHECK(drift_max - drift_min <= NS_PER_TICK);
+  CHECK(drift_max < NS_PER_TICK && drift_min >= -NS_PER_TICK);
+
+  test_os();
+  CHECK(drift_max - drift_min <= NS_PER_TICK);
+  CHECK(drift_max < NS_PER_TICK && drift_min >= -NS_PER_TICK);
+
+  return host_test_result("tickless");
+}
@@ -0,0 +1,5 @@
+CONFIG_TASK_QUEUE = 1
+CONFIG_OS = 1
+CONFIG_GEN_TIMER = 1
+CONFIG_SYS_TICKLESS = 1
+PROG_FLAGS += -DCONFIG_SYS_TICKLESS_TIMER_FREQ=32768
@@ -0,0 +1,160 @@
+/*
+ * test_uart_rx_dma.c
+ *
+ * Rx buffer accounting of circular dma uart reception, against a model
+ * of the dma: a stream of bytes written around the buffer, half and full
+ * transfer flags raised on passing the marks, an idle line interrupt
+ * between bursts, interrupts held off by critical sections of random
+ * length, up to a lap and a half, and a reader consuming at random.
+ *
+ * Once pending interrupts are served, the read index, received and lost
+ * byte counts must match the model, and every byte read must be the
+ * stream byte expected, never stale data.
+ */
+
+#include "host_test.h"
+#include "uart_driver.h"
+
+#define SIZE      UART_RX_BUFFER
+#define HALF      (SIZE / 2)
+#define STEPS     2000000
+
+static uart u;
+// dma model: bytes written in total, pending half or full transfer flag
+static u32_t dma_pos;
+static bool dma_flag;
+// dma position at last update
+static u32_t upd_pos;
+static bool idle_pending;
+// reader model: stream position of next unread byte
+static u32_t rd_pos;
+static u32_t exp_lost, exp_overruns;
+static u32_t reads, laps, held;
+
+static u8_t stream(u32_t pos) {
+  return (u8_t)(pos * 2654435761u >> 24);
+}
+
+static void dma_write(u32_t n) {
+  while (n--) {
+    u.rx.buf[dma_pos % SIZE] = stream(dma_pos);
+    dma_pos++;
+    if ((dma_pos % HALF) == 0) {
+      dma_flag = TRUE;
+    }
+  }
+}
+
+// Irq handler update, with dma position read at call.
+static void update(bool dma_irq) {
+  u16_t wix = dma_pos % SIZE;
+  if (dma_irq) {
+    dma_flag = FALSE;
+  }
+  u32_t bytes = u.rx_bytes;
+  u32_t len = UART_rx_dma_advance(&u, wix, dma_irq);
+  upd_pos = dma_pos;
+  CHECK_EQ(u.rx_bytes, bytes + len);
+  CHECK_EQ(u.rx.wix, wix);
+}
+
+// Checks indices and counts when no interrupt is pending. An idle line
+// update before the dma irq cannot know of a lap, so only then do they
+// match the dma model.
+static void check(u32_t overruns) {
+  u32_t pos = upd_pos;
+  bool overrun = FALSE;
+  if (pos - rd_pos > SIZE - 1) {
+    exp_lost += pos - rd_pos - (SIZE - 1);
+    exp_overruns++;
+    overrun = TRUE;
+    rd_pos = pos - (SIZE - 1);
+  }
+  CHECK_EQ(u.rx_bytes, pos);
+  CHECK_EQ(u.rx.rix, rd_pos % SIZE);
+  CHECK_EQ(u.rx_lost, exp_lost);
+  // seen as one or, split by idle line and dma irq, as two
+  if (overrun) {
+    CHECK(u.rx_overruns - overruns >= 1 && u.rx_overruns - overruns <= 2);
+  } else {
+    CHECK_EQ(u.rx_overruns, overruns);
+  }
+}
+
+static u32_t available(void) {
+  return u.rx.wix >= u.rx.rix ? u.rx.wix - u.rx.rix : u.rx.wix + SIZE - u.rx.rix;
+}
+
+static void reader(u32_t n) {
+  n = MIN(n, available());
+  // data not yet overwritten by dma must be the stream
+  bool valid = dma_pos - rd_pos <= SIZE;
+  while (n--) {
+    if (valid) {
+      CHECK_EQ(u.rx.buf[u.rx.rix], stream(rd_pos));
+    }
+    u.rx.rix = u.rx.rix + 1 >= SIZE ? 0 : u.rx.rix + 1;
+    rd_pos++;
+    reads++;
+  }
+}
+
+// Serves pending interrupts in random order, as the nvic would.
+static void serve(void) {
+  u32_t overruns = u.rx_overruns;
+  if (idle_pending && (host_test_rand() & 1)) {
+    idle_pending = FALSE;
+    update(FALSE);
+  }
+  if (dma_flag) {
+    update(TRUE);
+  }
+  if (idle_pending) {
+    idle_pending = FALSE;
+    update(FALSE);
+  }
+  check(overruns);
+}
+
+static void test_stream(void) {
+  u32_t step;
+  host_test_seed(21);
+  for (step = 0; step < STEPS && host_test_failures == 0; step++) {
+    u32_t r = host_test_rand() % 1000;
+    if (r < 600) {
+      // burst, line idles after
+      dma_write(1 + host_test_rand() % 24);
+      if (host_test_rand() & 1) idle_pending = TRUE;
+      serve();
+    } else if (r < 990) {
+      reader(host_test_rand() % 40);
+    } else if (r < 997) {
+      // irqs held off while a burst goes on, less than half a buffer
+      dma_write(host_test_rand() % HALF);
+      idle_pending = TRUE;
+      held++;
+      serve();
+    } else {
+      // held off for a lap or up to a lap and a half, right after the
+      // dma irq, the reader not getting to run
+      dma_write(HALF - dma_pos % HALF);
+      serve();
+      dma_write(SIZE + host_test_rand() % HALF);
+      idle_pending = TRUE;
+      laps++;
+      serve();
+    }
+  }
+  if (host_test_failures) {
+    printf("failed at step %u\n", step);
+  }
+  CHECK(exp_overruns > 0);
+  printf("%u bytes received, %u read, %u lost in %u overruns, %u holdoffs, %u laps\n",
+      dma_pos, reads, exp_lost, exp_overruns, held, laps);
+}
+
+int main(void) {
+  host_test_init();
+  test_stream();
+  return host_test_result("uart_rx_dma");
+}
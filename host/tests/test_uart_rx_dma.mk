@@ -0,0 +1,2 @@
+PROG_FLAGS += -DCONFIG_UART -DCONFIG_UART_DMA_RX -DCONFIG_UART_RX_STATS -DCONFIG_UART_CNT=1 -DUART_RX_BUFFER=64
+CFILES += uart_rx_dma.c
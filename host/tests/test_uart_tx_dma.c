@@ -0,0 +1,191 @@
+/*
+ * test_uart_tx_dma.c
+ *
+ * Tx chunk chaining of dma uart sending, against a model of the dma: a
+ * writer queueing bytes to the tx ring and referenced buffers, and a dma
+ * sending chunks partly or wholly, being stopped midway as on flush, or
+ * failing with transfer errors, with and without progress.
+ *
+ * Every byte sent must be the next one in queueing order, ring data queued
+ * before a referenced buffer going first and ring data queued after it
+ * going after. Referenced buffer callbacks come once, after the last byte
+ * of their buffer. Transfers failing without progress are retried, and
+ * dropped after UART_TX_DMA_RETRIES.
+ */
+
+#include "host_test.h"
+#include "uart_driver.h"
+
+#define SIZE      UART_TX_BUFFER
+#define REF_MAX   100
+#define STEPS     2000000
+
+static uart u;
+// stream positions of next byte queued and next byte sent
+static u32_t q_pos, out_pos;
+// chunk in flight and bytes of it sent
+static u8_t *fl_buf;
+static u16_t fl_len, fl_sent;
+// referenced buffer, stream position after it, callbacks
+static u8_t ref_buf[REF_MAX];
+static u32_t ref_end;
+static u32_t refs, ref_cbs;
+static u32_t exp_errors, exp_lost, stuck, drops, stops;
+
+static u8_t stream(u32_t pos) {
+  return (u8_t)(pos * 2654435761u >> 24);
+}
+
+static u32_t ring_free(void) {
+  return u.tx.wix >= u.tx.rix ? SIZE - 1 - (u.tx.wix - u.tx.rix) :
+      u.tx.rix - u.tx.wix - 1;
+}
+
+static void put_ring(u32_t n) {
+  n = MIN(n, ring_free());
+  while (n--) {
+    u.tx.buf[u.tx.wix] = stream(q_pos++);
+    u.tx.wix = u.tx.wix + 1 >= SIZE ? 0 : u.tx.wix + 1;
+  }
+}
+
+static void ref_cb(void *arg) {
+  CHECK(arg == &ref_buf);
+  // called once, after last byte of buffer
+  CHECK_EQ(out_pos, ref_end);
+  ref_cbs++;
+}
+
+// As UART_put_buf_ref
+static void put_ref(u16_t len) {
+  u16_t i;
+  if (u.tx_ref) {
+    return;
+  }
+  for (i = 0; i < len; i++) {
+    ref_buf[i] = stream(q_pos++);
+  }
+  ref_end = q_pos;
+  u.tx_ref = ref_buf;
+  u.tx_ref_len = len;
+  u.tx_ref_wix = u.tx.wix;
+  u.tx_ref_f = ref_cb;
+  u.tx_ref_arg = &ref_buf;
+  refs++;
+}
+
+static void kick(void) {
+  if (fl_len == 0) {
+    fl_len = UART_tx_dma_chunk(&u, &fl_buf);
+    fl_sent = 0;
+    CHECK_EQ(u.dma_tx_len, fl_len);
+  } else {
+    // busy
+    u8_t *buf;
+    CHECK_EQ(UART_tx_dma_chunk(&u, &buf), 0);
+  }
+}
+
+static void send(u16_t n) {
+  n = MIN(n, fl_len - fl_sent);
+  while (n--) {
+    CHECK_EQ(fl_buf[fl_sent], stream(out_pos));
+    fl_sent++;
+    out_pos++;
+  }
+}
+
+// Ends chunk in flight, as dma complete or error irq, or stop.
+static void done(bool error) {
+  void *arg = NULL;
+  if (fl_len == 0) {
+    return;
+  }
+  if (error) {
+    exp_errors++;
+    if (fl_sent == 0 && ++stuck > UART_TX_DMA_RETRIES) {
+      // dropped chunk is what would have been sent
+      u16_t i;
+      for (i = 0; i < fl_len; i++) {
+        CHECK_EQ(fl_buf[i], stream(out_pos + i));
+      }
+      out_pos += fl_len;
+      exp_lost += fl_len;
+      drops++;
+      stuck = 0;
+    }
+  }
+  if (fl_sent) {
+    stuck = 0;
+  }
+  uart_tx_ref_callback f = UART_tx_dma_done(&u, fl_len - fl_sent, error, &arg);
+  CHECK_EQ(u.tx_lost, exp_lost);
+  CHECK_EQ(u.tx_errors, exp_errors);
+  CHECK_EQ(u.dma_tx_len, 0);
+  fl_len = 0;
+  if (f) {
+    f(arg);
+  }
+}
+
+static void test_chain(void) {
+  u32_t step;
+  host_test_seed(22);
+  for (step = 0; step < STEPS && host_test_failures == 0; step++) {
+    u32_t r = host_test_rand() % 1000;
+    if (r < 300) {
+      put_ring(1 + host_test_rand() % 24);
+    } else if (r < 340) {
+      put_ref(1 + host_test_rand() % REF_MAX);
+    } else if (r < 600) {
+      kick();
+      send(host_test_rand() % 32);
+    } else if (r < 900) {
+      // transfer complete
+      kick();
+      send(fl_len);
+      done(FALSE);
+    } else if (r < 950) {
+      // stopped midway, as on flush or uart off
+      kick();
+      send(host_test_rand() % (fl_len + 1));
+      done(FALSE);
+      stops++;
+    } else if (r < 990) {
+      // transfer error midway
+      kick();
+      send(host_test_rand() % (fl_len + 1));
+      done(TRUE);
+    } else {
+      // failing for good, until dropped
+      u32_t i;
+      for (i = 0; i <= UART_TX_DMA_RETRIES; i++) {
+        kick();
+        done(TRUE);
+      }
+    }
+  }
+  if (host_test_failures) {
+    printf("failed at step %u\n", step);
+  }
+  // all is sent in the end
+  while (TRUE) {
+    kick();
+    if (fl_len == 0) break;
+    send(fl_len);
+    done(FALSE);
+  }
+  CHECK_EQ(out_pos, q_pos);
+  CHECK_EQ(u.tx.rix, u.tx.wix);
+  CHECK(u.tx_ref == NULL);
+  CHECK_EQ(ref_cbs, refs);
+  CHECK(drops > 0);
+  printf("%u bytes queued, %u refs, %u stops, %u errors, %u bytes dropped in %u drops\n",
+      q_pos, refs, stops, exp_errors, exp_lost, drops);
+}
+
+int main(void) {
+  host_test_init();
+  test_chain();
+  return host_test_result("uart_tx_dma");
+}
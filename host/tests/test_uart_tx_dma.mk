@@ -0,0 +1,2 @@
+PROG_FLAGS += -DCONFIG_UART -DCONFIG_UART_DMA_TX -DCONFIG_UART_CNT=1 -DUART_TX_BUFFER=64
+CFILES += uart_tx_dma.c
@@ -51,14 +51,35 @@ CPATH 	+= ${procdir}
 SPATH	+= ${procdir}
 INC 	+= -I${procdir}
 
+endif
+endif
+endif
+
+# host, for simulation off target
+ifeq (1, $(strip $(ARCH_HOST)))
+FLAGS	+= -DARCH_HOST
+FLAGS	+= -pthread
+
+archdir = ${gensysdir}/src/arch/host
+CPATH 	+= ${archdir}
+SPATH	+= ${archdir}
+INC 	+= -I${archdir}
+
+ifeq (1, $(strip $(CONFIG_ARCH_HOST_REALTIME)))
+FLAGS	+= -DCONFIG_ARCH_HOST_REALTIME
+endif
+ifeq (1, $(strip $(CONFIG_ARCH_HOST_SMP)))
+FLAGS	+= -DCONFIG_ARCH_HOST_SMP
 endif
 endif
 
 ### general system files and configs
 
 CFILES	+= arch.c
+ifneq (1, $(strip $(ARCH_HOST)))
 CFILES	+= proc_family.c
 CFILES	+= proc_specific.c
+endif
 CFILES	+= system.c
 
 ifeq (1, $(strip $(CONFIG_IO)))
@@ -205,6 +226,17 @@ endif
 ifeq (1, $(strip $(CONFIG_RINGBUFFER)))
 FLAGS	+= -DCONFIG_RINGBUFFER
 CFILES 	+= ringbuf.c
+ifeq (1, $(strip $(CONFIG_RINGBUF_SPSC)))
+FLAGS	+= -DCONFIG_RINGBUF_SPSC
+CFILES 	+= ringbuf_spsc.c
+endif
+endif
+
+### CONFIG_MEMPOOL - fixed block memory pools
+
+ifeq (1, $(strip $(CONFIG_MEMPOOL)))
+FLAGS	+= -DCONFIG_MEMPOOL
+CFILES 	+= mempool.c
 endif
 
 ### CONFIG_GPIO - gpio driver
@@ -234,12 +266,40 @@ ifeq (1, $(strip $(CONFIG_UART_OWN_CFG)))
 FLAGS	+= -DCONFIG_UART_OWN_CFG
 endif
 
+#   CONFIG_UART_DMA_RX - receive by circular dma, stm32f1/f4 driver only
+ifeq (1, $(strip $(CONFIG_UART_DMA_RX)))
+ifneq (1, $(strip $(PROC_FAMILY_STM32)))
+$(error "CONFIG_UART_DMA_RX is only supported on STM32F1 and STM32F4")
+endif
+ifeq (1, $(strip $(PROC_STM32F7)))
+$(error "CONFIG_UART_DMA_RX is only supported on STM32F1 and STM32F4")
+endif
+FLAGS	+= -DCONFIG_UART_DMA_RX
+CFILES	+= uart_rx_dma.c
+endif
+
+#   CONFIG_UART_DMA_TX - send by dma, stm32f1/f4 driver only
+ifeq (1, $(strip $(CONFIG_UART_DMA_TX)))
+ifneq (1, $(strip $(PROC_FAMILY_STM32)))
+$(error "CONFIG_UART_DMA_TX is only supported on STM32F1 and STM32F4")
+endif
+ifeq (1, $(strip $(PROC_STM32F7)))
+$(error "CONFIG_UART_DMA_TX is only supported on STM32F1 and STM32F4")
+endif
+FLAGS	+= -DCONFIG_UART_DMA_TX
+CFILES	+= uart_tx_dma.c
+endif
+
+#   CONFIG_UART_RX_STATS - count rx interrupts and bytes, stm32f1/f4 driver only
+ifeq (1, $(strip $(CONFIG_UART_RX_STATS)))
+FLAGS	+= -DCONFIG_UART_RX_STATS
+endif
+
 #   CONFIG_WIFI232 - wifi over serial driver USR_WIFI232B
 ifeq (1, $(strip $(CONFIG_WIFI232)))
 FLAGS	+= -DCONFIG_WIFI232
 CFILES	+= usr_wifi232_driver.c
 endif
-endif
 
 ### CONFIG_I2C - i2c driver
 
@@ -314,6 +374,14 @@ endif
 FLAGS	+= -DCONFIG_SPI_FLASH
 CFILES	+= spi_flash.c
 endif
+#   CONFIG_SPI_FLASH_LOG - append only log on spi flash, io_file media
+ifeq (1, $(strip $(CONFIG_SPI_FLASH_LOG)))
+ifneq (1, $(strip $(CONFIG_SPI_FLASH)))
+$(error "CONFIG_SPI_FLASH_LOG depends on CONFIG_SPI_FLASH")
+endif
+FLAGS	+= -DCONFIG_SPI_FLASH_LOG
+CFILES	+= spi_flash_log.c
+endif
 #   CONFIG_SPI_FLASH_M25P16 - spi flash driver for M25P16
 ifeq (1, $(strip $(CONFIG_SPI_FLASH_M25P16)))
 ifneq (1, $(strip $(CONFIG_TASK_QUEUE)))
@@ -397,11 +465,20 @@ endif
 
 ifeq (1, $(strip $(CONFIG_OS)))
 FLAGS	+= -DCONFIG_OS
+ifeq (1, $(strip $(CONFIG_OS_STATS)))
+FLAGS	+= -DCONFIG_OS_STATS
+CFILES	+= os_stats.c
+endif
+CFILES	+= os_core.c
 ifeq (1, $(strip $(ARCH_CORTEX)))
 CFILES	+= os.c 
 CFILES	+= list.c 
 SFILES	+= svc_handler.s 
 endif
+ifeq (1, $(strip $(ARCH_HOST)))
+CFILES	+= os.c 
+CFILES	+= list.c 
+endif
 endif
 
 ### CONFIG_SHARED_MEM - shared memory surviving resets
@@ -452,6 +529,15 @@ FLAGS	+= -DCONFIG_GEN_TIMER
 CFILES	+= gen_timer.c 
 endif
 
+### CONFIG_SYS_TICKLESS - tickless idle, generic timer as timebase
+
+ifeq (1, $(strip $(CONFIG_SYS_TICKLESS)))
+ifneq (1, $(strip $(CONFIG_GEN_TIMER)))
+$(error "CONFIG_SYS_TICKLESS depends on CONFIG_GEN_TIMER")
+endif
+FLAGS	+= -DCONFIG_SYS_TICKLESS
+endif
+
 ### CONFIG_NRF905 - nrf905 rf module driver
 
 ifeq (1, $(strip $(CONFIG_NRF905)))
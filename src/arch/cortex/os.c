@@ -1,54 +1,37 @@
-#include "os.h"
+/*
+ * Cortex variant of os.c
+ *
+ * Context switching, preemption and time of the OS. Scheduling and
+ * synchronization objects are in os_core.c.
+ */
+
+#include "os_core.h"
 #include "miniutils.h"
-#include "list.h"
-#include "linker_symaccess.h"
 #include "os_hal.h"
-#if CONFIG_OS_TASKQ_KERNEL
-#include "taskq.h"
-#endif
 
 // configs
 
-// will schedule a signalled thread first
-//#define CONFIG_OS_BUMP 1
-
-// will use taskq as kernel, not being in a thread
-//#define CONFIG_OS_TASKQ_KERNEL 1
-
-// checks os struct memory overwrites at certain points
-//#define OS_RUNTIME_VALIDITY_CHECK 1
-
-// enables debug dump printouts of os status
-//#define OS_DBG_MON 1
-// if OS_DBG_MON, enables logging of up to x created threads
-//#define OS_THREAD_PEERS 4
-// if OS_DBG_MON, enables logging of up to x created mutexes
-//#define OS_MUTEX_PEERS 4
-// if OS_DBG_MON, enables logging of up to x created conditionals
-//#define OS_COND_PEERS 4
-
-// enables thread stack checks, checked when entering and leaving threads
-//#define OS_STACK_CHECK 1
-
-// makes the scheduler calculate percentage of used stack for threads on debug dump
-//#define OS_STACK_USAGE_CHECK 1
-
-
-
-#define OS_THREAD_FLAG_ALIVE        (1<<0)
-#define OS_THREAD_FLAG_SLEEP        (1<<1)
-#define OS_FOREVER                  ((sys_time)-1)
-#define OS_STACK_START_MARKER       (0xf00dcafe)
-#define OS_STACK_END_MARKER         (0xfadebeef)
+// with CONFIG_OS_STATS, cpu time is measured in cycles if the hal defines
+// OS_HAL_CYCLES, else in system ticks
 
-#define OS_ELEMENT(obj) &((obj)->this.e)
-#define OS_TYPE(obj) ((obj)->type)
-#define OS_OBJ(ele) ((os_object *)((char *)(ele) + ((char *)&((os_object *)0)->e - (char *)0 )))
-#define OS_THREAD(ele) ((os_thread *)((char *)(ele) + ((char *)&((os_thread *)0)->this.e - (char *)0 )))
-#define OS_COND(ele) ((os_cond *)((char *)(ele) + ((char *)&((os_cond *)0)->this.e - (char *)0 )))
+// with an fpu, threads having an active fp context get s16-s31 saved on
+// context switch, as told by the EXC_RETURN fp bit; the hardware lazily
+// stacks s0-s15. Threads using fp need about 140 bytes more stack.
+#if defined(__FPU_USED) && (__FPU_USED == 1)
+#define OS_FPU                      1
+#else
+#define OS_FPU                      0
+#endif
+#define OS_EXC_RETURN_FP_BIT        (1<<4)
+#define OS_EXC_RETURN_THREAD        (0xfffffffd)
 
-#define _STACK_USAGE_MARK (0xea)
-#define _STACK_USAGE_MARK_32 ((_STACK_USAGE_MARK << 24) | (_STACK_USAGE_MARK << 16) | (_STACK_USAGE_MARK << 8) | _STACK_USAGE_MARK)
+#ifdef CONFIG_OS_STATS
+#ifdef OS_HAL_CYCLES
+#define OS_STATS_NOW()              OS_HAL_CYCLES()
+#else
+#define OS_STATS_NOW()              ((u32_t)SYS_get_tick())
+#endif
+#endif
 
 #ifndef OS_IRQ_SYSTICK_HANDLER
 #define OS_IRQ_SYSTICK_HANDLER SysTick_Handler
@@ -80,74 +63,27 @@ typedef struct {
   u32_t r9;
   u32_t r10;
   u32_t r11;
+#if OS_FPU
+  u32_t exc_return;
+#endif
 } thread_frame;
 
-#define OS_CANARY_MAGIC 0xf0f0feed
-
-static struct os {
-#if OS_RUNTIME_VALIDITY_CHECK
-  u32_t os_canary_pre;
-#endif
-  // pointer to current thread
-  os_thread *current_thread;
+// context switching state, referred by the PendSV handler
+static struct os_arch {
   // flags of current thread
   u32_t current_flags;
-#if CONFIG_OS_BUMP
-  // pointer to bumped thread
-  os_thread *bumped_thread;
-#endif
   // msp on first context switch
   void *main_msp;
-  // thread running queue
-  list_t q_running;
-  // thread sleeping queue
-  list_t q_sleep;
-  sys_time first_awake;
   volatile bool preemption;
-#if OS_RUNTIME_VALIDITY_CHECK
-  u32_t os_canary_post;
-#endif
-#if OS_DBG_MON
-  u8_t thread_peer_ix;
-  os_thread *thread_peers[OS_THREAD_PEERS];
-  u8_t mutex_peer_ix;
-  os_mutex *mutex_peers[OS_MUTEX_PEERS];
-  u8_t cond_peer_ix;
-  os_cond *cond_peers[OS_COND_PEERS];
-#endif
-} os;
+} os_arch;
 
-static volatile u32_t g_thr_id = 0;
-static volatile u32_t g_mutex_id = 0;
-static volatile u32_t g_cond_id = 0;
 static volatile u8_t g_crit_entry = 0;
 
 static u32_t __os_ctx_switch_select_thread(void *sp);
 static void __os_thread_death(void);
-static void __os_update_preemption();
 static void __os_disable_preemption(void);
 static void __os_enable_preemption(void);
 
-//------------ debug checks -------------
-static void __os_check_validity() {
-#if OS_RUNTIME_VALIDITY_CHECK
-  // check struct
-  ASSERT(os.os_canary_pre == OS_CANARY_MAGIC);
-  ASSERT(os.os_canary_post == OS_CANARY_MAGIC);
-  // check queue
-  {
-    element_t *e;
-    e = list_first(&os.q_running);
-    while (e) {
-      os_type type = OS_TYPE(OS_OBJ(e));
-      ASSERT(type == OS_THREAD);
-      e = list_next(e);
-    }
-  }
-#endif
-}
-
-
 //------------ irq calls -------------
 
 // called from SVC_Handler in svc_handler.s
@@ -188,13 +124,20 @@ void OS_IRQ_SYSTICK_HANDLER(void) {
 // and stack after restoring context upon function exit.
 __attribute__((naked)) void OS_IRQ_PENDSV_HANDLER(void)  {
   asm volatile (
-      // if os.current_flags != 0, then store context
+      // if os_arch.current_flags != 0, then store context
       "  ldr     r2, __os                  \n\t"
-      "  ldr     r1, [r2, %0]              \n\t" // get os.current_flags
+      "  ldr     r1, [r2, %0]              \n\t" // get os_arch.current_flags
       "  cbz     r1, __no_leave_context    \n\t"
       // ....store thread context
       "  mrs     r0, psp                   \n\t"
+#if OS_FPU
+      "  tst     lr, #0x10                 \n\t" // has thread an fp context?
+      "  it      eq                        \n\t"
+      "  vstmdbeq r0!, {s16-s31}           \n\t"
+      "  stmdb   r0!, {r4-r11, lr}         \n\t"
+#else
       "  stmdb   r0!, {r4-r11}             \n\t"
+#endif
       "  msr     psp, r0                   \n\t"
 
       // call __os_ctx_switch_select_thread
@@ -215,44 +158,62 @@ __attribute__((naked)) void OS_IRQ_PENDSV_HANDLER(void)  {
       "  orreq   r2, #1                    \n\t" // user
       "  msr     CONTROL, r2               \n\t"
       // ....restore thread context
+#if OS_FPU
+      "  ldmfd   r1!, {r4-r11, lr}         \n\t"
+      "  tst     lr, #0x10                 \n\t" // has thread an fp context?
+      "  it      eq                        \n\t"
+      "  vldmiaeq r1!, {s16-s31}           \n\t"
+#else
       "  ldmfd   r1!, {r4-r11}             \n\t"
-      "  msr     psp, r1                   \n\t"
       "  mvn     lr, #2                    \n\t" // __THREAD_RETURN
+#endif
+      "  msr     psp, r1                   \n\t"
       "  bx      lr                        \n\t"
 
       // ..else if no new thread, get ass back to kernel main
       "__no_enter_context:                 \n\t"
       "  ldr     r2, __os                  \n\t"
-      "  ldr     r1, [r2, %1]              \n\t" // r1 = os.main_msp
-      "  str     r0, [r2, %0]              \n\t" // os.current_flags = 0
+      "  ldr     r1, [r2, %1]              \n\t" // r1 = os_arch.main_msp
+      "  str     r0, [r2, %0]              \n\t" // os_arch.current_flags = 0
       "  msr     msp, r1                   \n\t" // msp = r1
+#if OS_FPU
+      "  pop     {r4-r11, lr}              \n\t"
+      "  tst     lr, #0x10                 \n\t" // has kernel an fp context?
+      "  it      eq                        \n\t"
+      "  vldmiaeq sp!, {s16-s31}           \n\t"
+#else
       "  pop     {r4-r11}                  \n\t"
       "  mvn     lr, #6                    \n\t" // __MAIN_RETURN, kernel
+#endif
       "  bx      lr                        \n\t"
       // .. store kernel main context
       "__no_leave_context:                 \n\t"
-//      "  ldr     r1, [r2, %1]              \n\t" // get os.main_msp
+//      "  ldr     r1, [r2, %1]              \n\t" // get os_arch.main_msp
 //      "  teq     r1, #0                    \n\t" // if zero, first ctx switch ever
 //      "  ittt    eq                        \n\t"
 //      "  pusheq  {r4-r11}                  \n\t"
 //      "  mrseq   r0, msp                   \n\t"
-//      "  streq   r0, [r2, %1]              \n\t" // store os.main_msp
+//      "  streq   r0, [r2, %1]              \n\t" // store os_arch.main_msp
+#if OS_FPU
+      "  tst     lr, #0x10                 \n\t" // has kernel an fp context?
+      "  it      eq                        \n\t"
+      "  vstmdbeq sp!, {s16-s31}           \n\t"
+      "  push  {r4-r11, lr}                \n\t"
+#else
       "  push  {r4-r11}                    \n\t"
+#endif
       "  mrs   r0, msp                     \n\t"
-      "  str   r0, [r2, %1]                \n\t" // store os.main_msp
+      "  str   r0, [r2, %1]                \n\t" // store os_arch.main_msp
       "  b       __do_ctx_switch           \n\t"
 
       "__os:                               \n\t"
-      "  .word   os                        \n\t"
+      "  .word   os_arch                   \n\t"
       :
-      : "n"(offsetof(struct os, current_flags)), "n"(offsetof(struct os, main_msp))
+      : "n"(offsetof(struct os_arch, current_flags)), "n"(offsetof(struct os_arch, main_msp))
   );
 }
-
-//------- System helpers -------------
-
 static __attribute__(( used )) u32_t __os_ctx_switch_select_thread(void *sp) {
-  os_thread *cand = NULL;
+  os_thread *cand;
   __CLREX();  // removes the local exclusive access tag for the processor
 
   enter_critical();
@@ -262,54 +223,44 @@ static __attribute__(( used )) u32_t __os_ctx_switch_select_thread(void *sp) {
     // save current psp to current thread
     if (os.current_thread->flags & OS_THREAD_FLAG_ALIVE) {
       os.current_thread->sp = sp;
+      if (sp < os.current_thread->sp_min) {
+        os.current_thread->sp_min = sp;
+      }
+#if OS_FPU
+      if (((thread_frame *)sp)->exc_return & OS_EXC_RETURN_FP_BIT) {
+        os.current_thread->flags &= ~OS_THREAD_FLAG_FPU;
+      } else {
+        os.current_thread->flags |= OS_THREAD_FLAG_FPU;
+      }
+#endif
     }
 #if OS_STACK_CHECK
     ASSERT(*(u32_t*)(os.current_thread->stack_start - 4) == OS_STACK_START_MARKER);
     ASSERT(*(u32_t*)(os.current_thread->stack_end) == OS_STACK_END_MARKER);
 #endif
   } else {
-    TRACE_OS_KERNEL_LEAVE(list_count(&os.q_sleep));
-  }
-
-  // find next candidate
-#if CONFIG_OS_TASKQ_KERNEL
-  if (TASK_got_active_tasks()) {
-    cand = NULL; // goto kernel
-  } else
-#endif
-#if CONFIG_OS_BUMP
-  if (os.bumped_thread != NULL) {
-    // if we have a bumped thread, prefer that to anything else
-    cand = os.bumped_thread;
-    os.bumped_thread = NULL;
-  } else
-#endif
-  {
-    cand = OS_THREAD(list_first(&os.q_running));
+    TRACE_OS_KERNEL_LEAVE(heap_count(&os.q_sleep));
   }
 
-  // reorder prio
-  if (cand != NULL) {
-    list_move_last(&os.q_running, OS_ELEMENT(cand));
-  }
+  cand = __os_select_thread();
   exit_critical();
 
   if (cand != NULL) {
     // got a candidate, setup context
-    os.current_flags = cand->flags;
+    os_arch.current_flags = cand->flags;
     TRACE_OS_CTX_ENTER(cand);
   } else {
     // no candidate, goto kernel
-    os.current_flags = 0;
-    TRACE_OS_KERNEL_ENTER(list_count(&os.q_sleep));
-    //TRACE_OS_SLEEP(list_count(&os.q_running));
+    os_arch.current_flags = 0;
+    TRACE_OS_KERNEL_ENTER(heap_count(&os.q_sleep));
+    //TRACE_OS_SLEEP(os.ready_count);
   }
   os.current_thread = cand;
-  __os_update_preemption();
+  __os_arch_update_preemption();
 
 
   asm volatile ("nop"); // compiler reorder barrier
-  if (os.current_flags) {
+  if (os_arch.current_flags) {
     // move candidate's sp to R1 before return
     asm volatile (
         "mov    r1, %0\n"
@@ -319,80 +270,33 @@ static __attribute__(( used )) u32_t __os_ctx_switch_select_thread(void *sp) {
     );
   }
   asm volatile ("nop"); // compiler reorder barrier
-  return os.current_flags;
+  return os_arch.current_flags;
 }
 
-static void __os_sleepers_update(list_t *q, sys_time now) {
-  element_t *e;
-  e = list_first(q);
-  while (e && list_get_order(e) <= now) {
-    // get sleeper element
-    os_type type = OS_TYPE(OS_OBJ(e));
-    enter_critical();
-    element_t *next_e = list_next(e);
-    exit_critical();
+//------- Core hooks -------------
 
-    switch (type) {
-    case OS_THREAD: {
-      // it was a thread, simply move from sleeping to running
-      os_thread *t = OS_THREAD(e);
-      enter_critical();
-      TRACE_OS_THRWAKED(t);
-      list_delete(q, e);
-      list_add(&os.q_running, e);
-      list_set_order(e, OS_FOREVER);
-      t->flags &= ~OS_THREAD_FLAG_SLEEP;
-      t->ret_val = TRUE;
-      __os_check_validity();
-      exit_critical();
-    }
-    break;
-
-    case OS_COND: {
-      // it was a conditional, recurse into conditional's sleep queue
-      os_cond *c = OS_COND(e);
-      if (now >= e->sort_order) {
-        TRACE_OS_CONDTIMWAKED(c);
-        __os_sleepers_update(&c->q_sleep, now);
-        enter_critical();
-        if (list_is_empty(&c->q_sleep)) {
-          // conds sleep queue got empty, remove from os's sleep queue
-          list_set_order(c, OS_FOREVER);
-          c->has_sleepers = FALSE;
-          list_delete(&os.q_sleep, e);
-        } else {
-          // conds sleep queue not empty, update in os's sleep queue
-          list_set_order(c, list_get_order(list_first(&c->q_sleep)));
-          list_delete(&os.q_sleep, e);
-          list_sort_insert(&os.q_sleep, e);
-        }
-        __os_check_validity();
-        exit_critical();
-      }
-    }
-    break;
-    }
-    e = next_e;
-  }
+void __os_arch_pend(void) {
+  OS_HAL_PENDING_CTX_SWITCH;
 }
 
-static void __os_update_first_awake() {
-  if (list_is_empty(&os.q_sleep)) {
-    os.first_awake = OS_FOREVER;
-  } else {
-    os.first_awake = list_get_order(list_first(&os.q_sleep));
+void __os_arch_ready(os_thread *t) {
+  if (os.current_thread && os.current_thread != t &&
+      t->prio > os.current_thread->prio) {
+    OS_HAL_PENDING_CTX_SWITCH;
   }
 }
 
-static void __os_update_preemption() {
+void __os_arch_update_preemption(void) {
 #if 0 && CONFIG_OS_TASKQ_KERNEL
-  if (os.q_running.length > 0 || TASK_got_active_tasks()) {
+  if (os.ready_count > 0 || TASK_got_active_tasks()) {
     __os_enable_preemption();
   } else {
     __os_disable_preemption();
   }
 #else
-  if (os.q_running.length <= 1) {
+  // time slicing only needed among threads of highest ready priority
+  if (os.ready_grp == 0 ||
+      list_count(&os.q_ready[__os_ready_top()]) <= 1) {
     __os_disable_preemption();
   } else {
     __os_enable_preemption();
@@ -400,25 +304,33 @@ static void __os_update_preemption() {
 #endif
 }
 
+void __os_arch_woken(void) {
+  if (!os_arch.preemption) {
+    OS_HAL_PENDING_CTX_SWITCH;
+  }
+}
+
+#ifdef CONFIG_OS_STATS
+u32_t __os_arch_stats_now(void) {
+  return OS_STATS_NOW();
+}
+#endif
+
+//------- System helpers -------------
+
 void OS_time_tick(sys_time now) {
-  if (now >= os.first_awake) {
-    __os_sleepers_update(&os.q_sleep, now);
-    __os_update_first_awake();
-    if (!os.preemption) {
+  if (__os_time_wake(now)) {
+    if (!os_arch.preemption) {
       OS_HAL_PENDING_CTX_SWITCH;
     }
-    __os_update_preemption();
+    __os_arch_update_preemption();
   }
 }
 
 __attribute__((noreturn)) static void __os_thread_death(void) {
   enter_critical();
-  TRACE_OS_THRDEAD(os.current_thread);
-  list_delete(&os.q_running, OS_ELEMENT(os.current_thread));
-  list_move_all(&os.q_running, &os.current_thread->q_join);
-  os.current_thread->flags = 0;
+  __os_thread_exit(os.current_thread);
   os.current_thread = NULL;
-  __os_check_validity();
   exit_critical();
   (void)OS_thread_yield();
   // will never execute this
@@ -429,25 +341,25 @@ __attribute__((noreturn)) static void __os_thread_death(void) {
 
 // disable systick
 static inline void __os_disable_preemption(void) {
-  if (os.preemption) {
+  if (os_arch.preemption) {
     TRACE_OS_PREEMPTION(0);
   }
-  os.preemption = FALSE;
+  os_arch.preemption = FALSE;
   OS_HAL_DISABLE_PREEMPTION;
 }
 
 // enable systick
 static inline void __os_enable_preemption(void) {
-  if (!os.preemption) {
+  if (!os_arch.preemption) {
     TRACE_OS_PREEMPTION(1);
   }
-  os.preemption = TRUE;
+  os_arch.preemption = TRUE;
   OS_HAL_ENABLE_PREEMPTION;
 }
 
 #if OS_DBG_MON
 static bool OS_enter_critical() {
-  bool pre = os.preemption;
+  bool pre = os_arch.preemption;
   __os_disable_preemption();
   return pre;
 }
@@ -491,472 +403,37 @@ u32_t OS_thread_create(os_thread *t, u32_t flags, void *(*func)(void *), void *a
   init_frame->lr = (u32_t)__os_thread_death;
   init_frame->psr = 0x21000000; // default psr
 
-  t->flags = OS_THREAD_FLAG_ALIVE | flags;
+  __os_thread_init(t, flags, func, name);
   t->sp = stack + stack_size - sizeof(cortex_frame) - sizeof(thread_frame);
+#if OS_FPU
+  // start without fp context
+  ((thread_frame *)t->sp)->exc_return = OS_EXC_RETURN_THREAD;
+#endif
   t->stack_start = stack;
   t->stack_end = (void*)(stack + stack_size);
-  t->func = func;
-  t->prio = 128;
-
-  t->this.type = OS_THREAD;
-
-  t->id = ++g_thr_id;
-  t->name = name;
-
-  list_init(&t->q_join);
-  list_set_order(OS_ELEMENT(t), OS_FOREVER);
-
-  enter_critical();
-  list_add(&os.q_running, OS_ELEMENT(t));
-#if OS_DBG_MON & OS_THREAD_PEERS > 0
-  {
-    int i;
-    for (i = 0; i < OS_THREAD_PEERS; i++) {
-      if (os.thread_peers[i] == t) {
-        break;
-      }
-    }
-    if (i == OS_THREAD_PEERS) {
-      os.thread_peers[os.thread_peer_ix++] = t;
-      if (os.thread_peer_ix >= OS_THREAD_PEERS) {
-        os.thread_peer_ix = 0;
-      }
-    }
-  }
+  t->sp_min = t->sp;
+#if OS_STACK_USAGE_CHECK
+  t->stack_mark = t->sp;
 #endif
-  TRACE_OS_THRCREATE(t);
-  __os_check_validity();
-  exit_critical();
+
+  __os_thread_start(t);
 
   __os_enable_preemption();
 
   return 0;
 }
 
-os_thread *OS_thread_self() {
-  return os.current_thread;
-}
-
-u32_t OS_thread_self_id() {
-  return os.current_thread->id;
-}
-
-u32_t OS_thread_id(os_thread *t) {
-  return t->id;
-}
-
 u32_t OS_thread_yield(void) {
   ASSERT(g_crit_entry == 0);
   TRACE_OS_YIELD(OS_thread_self());
-  os_svc(1);
-  return OS_thread_self()->ret_val;
-}
-
-void OS_thread_join(os_thread *t) {
-  os_thread *self = OS_thread_self();
-  ASSERT(self);
-  ASSERT(t != self);
+#ifdef CONFIG_OS_STATS
+  // read by the context switch
   enter_critical();
-  if (t->flags & OS_THREAD_FLAG_ALIVE) {
-    list_delete(&os.q_running, OS_ELEMENT(self));
-    list_add(&t->q_join, OS_ELEMENT(self));
-  }
+  os.yielding = TRUE;
   exit_critical();
-}
-
-u32_t OS_mutex_init(os_mutex *m, u32_t attrs) {
-  m->id = ++g_mutex_id;
-  m->lock = 0;
-  m->owner = 0;
-  m->attrs = attrs;
-  list_init(&m->q_block);
-#if OS_DBG_MON & OS_MUTEX_PEERS > 0
-  os.mutex_peers[os.mutex_peer_ix++] = m;
-  if (os.mutex_peer_ix >= OS_MUTEX_PEERS) {
-    os.mutex_peer_ix = 0;
-  }
 #endif
-  return 0;
-}
-
-void OS_thread_sleep(sys_time delay) {
-  os_thread *self = OS_thread_self();
-  sys_time awake = SYS_get_time_ms() + delay;
-  enter_critical();
-  TRACE_OS_THRSLEEP(self);
-  list_delete(&os.q_running, OS_ELEMENT(self));
-  list_set_order(OS_ELEMENT(self), awake);
-  list_sort_insert(&os.q_sleep, OS_ELEMENT(self));
-  __os_update_first_awake();
-  self->flags |= OS_THREAD_FLAG_SLEEP;
-  exit_critical();
-  (void)OS_thread_yield();
-}
-
-static u32_t OS_mutex_lock_internal(os_mutex *m) {
-  os_thread *self = OS_thread_self();
-  bool taken = TRUE;
-  u32_t res = 0;
-
-  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
-    enter_critical();
-    if (m->owner == self) {
-      m->depth++;
-      exit_critical();
-      return 0;
-    }
-    exit_critical();
-  } else {
-    ASSERT(m->owner != self);
-  }
-
-  TRACE_OS_MUTLOCK(m);
-  do {
-    taken = TRUE;
-    u32_t v;
-    // try setting mutex flag to busy
-    do {
-      v =  __LDREXW(&m->lock);
-      if (v) {
-        __CLREX();  // removes the local exclusive access tag for the processor
-        taken = FALSE;
-        break;
-      }
-    } while (__STREXW(1, &m->lock));
-
-    if (!taken) {
-      // mutex already busy
-      enter_critical();
-      TRACE_OS_MUT_WAITLOCK(self);
-      list_delete(&os.q_running, OS_ELEMENT(self));
-      list_add(&m->q_block, OS_ELEMENT(self));
-      exit_critical();
-      res = OS_thread_yield();
-    } else {
-      // mutex taken
-      enter_critical();
-      TRACE_OS_MUT_ACQLOCK(self);
-      m->owner = self;
-      if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
-        m->depth = 1;
-      }
-
-#if OS_DBG_MON
-      m->entered++;
-#endif
-      if ((m->attrs & OS_MUTEX_ATTR_CRITICAL_IRQ) == 0) {
-        // mutex is irq safe, keep critical lock gained when taking mutex
-        exit_critical();
-      }
-
-    }
-  } while (!taken);
-  return res;
-}
-
-u32_t OS_mutex_lock(os_mutex *m) {
-  u32_t r;
-  r = OS_mutex_lock_internal(m);
-  return r;
-}
-
-u32_t OS_mutex_unlock_internal(os_mutex *m, bool full) {
-  ASSERT(m->owner == OS_thread_self());
-
-  // reinsert all waiting threads to running queue
-  enter_critical();
-  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
-    if (full) {
-      // full reentrant unlock
-      m->depth = 0;
-    }
-    if (m->depth > 0) {
-      m->depth--;
-      exit_critical();
-      return m->depth + 1;
-    }
-  }
-
-  TRACE_OS_MUTUNLOCK(m);
-  list_move_all(&os.q_running, &m->q_block);
-  // reset mutex
-  m->lock = 0;
-
-  m->owner = 0;
-#if OS_DBG_MON
-      m->exited++;
-#endif
-  __os_check_validity();
-  __os_update_preemption();
-  exit_critical();
-  if (m->attrs & OS_MUTEX_ATTR_CRITICAL_IRQ) {
-    // mutex was irq safe, release the extra critical lock taken in mutex_lock
-    exit_critical();
-  }
-
-
-  return 0;
-}
-
-u32_t OS_mutex_unlock(os_mutex *m) {
-  u32_t r;
-  r = OS_mutex_unlock_internal(m, FALSE);
-  return r;
-}
-
-bool OS_mutex_try_lock(os_mutex *m) {
-  os_thread *self = OS_thread_self();
-  bool taken = TRUE;
-
-  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
-    enter_critical();
-    if (m->owner == self) {
-      m->depth++;
-      exit_critical();
-      return TRUE;
-    }
-    exit_critical();
-  } else {
-    ASSERT(m->owner != self);
-  }
-
-  TRACE_OS_MUTLOCK(m);
-
-  // try setting mutex flag to busy
-  do {
-    u32_t v;
-    v =  __LDREXW(&m->lock);
-    if (v) {
-      __CLREX();  // removes the local exclusive access tag for the processor
-      taken = FALSE;
-      break;
-    }
-  } while (__STREXW(1, &m->lock));
-
-  if (!taken) {
-    // mutex already busy
-    return FALSE;
-  }
-
-  TRACE_OS_MUT_ACQLOCK(m);
-  m->owner = self;
-  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
-    m->depth = 1;
-  }
-
-  return TRUE;
-}
-
-u32_t OS_cond_init(os_cond *c) {
-  c->id = ++g_cond_id;
-  c->this.type = OS_COND;
-  list_set_order(OS_ELEMENT(c), OS_FOREVER);
-  list_init(&c->q_block);
-  list_init(&c->q_sleep);
-#if OS_DBG_MON
-  c->waiting = 0;
-  c->signalled = 0;
-  c->broadcasted = 0;
-  os.cond_peers[os.cond_peer_ix++] = c;
-  if (os.cond_peer_ix >= OS_COND_PEERS) {
-    os.cond_peer_ix = 0;
-  }
-#endif
-  return 0;
-}
-
-u32_t OS_cond_wait(os_cond *c, os_mutex *m) {
-  os_thread *self = OS_thread_self();
-  u32_t r;
-  ASSERT((void*)c >= RAM_BEGIN);
-  ASSERT((void*)c < RAM_END);
-  enter_critical();
-  TRACE_OS_CONDWAIT(c);
-  //ASSERT(strcmp("main_kernel", self->name) != 0);
-  if (m) {
-    (void)OS_mutex_unlock_internal(m, TRUE);
-  }
-  list_delete(&os.q_running, OS_ELEMENT(self));
-  list_add(&c->q_block, OS_ELEMENT(self));
-  c->mutex = m;
-#if OS_DBG_MON
-  c->waiting++;
-#endif
-  exit_critical();
-  r = OS_thread_yield();
-  if (m) {
-    (void)OS_mutex_lock_internal(m);
-  }
-  return r;
-}
-
-u32_t OS_cond_timed_wait(os_cond *c, os_mutex *m, sys_time delay) {
-  bool into_sleep_queue;
-  u32_t r;
-  os_thread *self = OS_thread_self();
-  self->ret_val = FALSE;
-  enter_critical();
-
-  ASSERT(strcmp("main_kernel", self->name) != 0);
-
-  TRACE_OS_CONDTIMWAIT(c);
-
-  if (m) {
-    (void)OS_mutex_unlock_internal(m, TRUE);
-  }
-
-  into_sleep_queue = c->has_sleepers;
-  sys_time awake = SYS_get_time_ms() + delay;
-  list_delete(&os.q_running, OS_ELEMENT(self));
-  list_set_order(OS_ELEMENT(self), awake);
-  list_sort_insert(&c->q_sleep, OS_ELEMENT(self));
-
-  c->has_sleepers = TRUE;
-
-  if (list_get_order(OS_ELEMENT(c)) > awake) {
-    list_set_order(OS_ELEMENT(c), awake);
-  }
-  if (into_sleep_queue) {
-    // remove first so placement is updated
-    list_delete(&os.q_sleep, OS_ELEMENT(c));
-  }
-  // insert into sleep queue
-  list_sort_insert(&os.q_sleep, OS_ELEMENT(c));
-
-  os.first_awake = MIN(awake, os.first_awake);
-  c->mutex = m;
-#if OS_DBG_MON
-  c->waiting++;
-#endif
-  exit_critical();
-  r = OS_thread_yield();
-  if (m) {
-    (void)OS_mutex_lock_internal(m);
-  }
-  return r;
-}
-
-
-u32_t OS_cond_signal(os_cond *c) {
-  os_thread *t;
-  enter_critical();
-  TRACE_OS_CONDSIG(c);
-
-  // first, check if there are sleepers
-  if (!list_is_empty(&c->q_sleep)) {
-
-    // wake up first timed waiter
-    t = OS_THREAD(list_first(&c->q_sleep));
-    TRACE_OS_SIGWAKED(t);
-#if CONFIG_OS_BUMP
-    if (os.current_thread != t) {
-      // play it nice and do not bump if thread is already running
-      os.bumped_thread = t;
-    }
-#endif
-    list_delete(&c->q_sleep, OS_ELEMENT(t));
-    // did the condition's sleep queue become empty?
-    if (list_is_empty(&c->q_sleep)) {
-      c->has_sleepers = FALSE;
-      // yep, remove condition from os sleep queue and update first_awake value.
-      list_delete(&os.q_sleep, OS_ELEMENT(c));
-      __os_update_first_awake();
-    }
-  } else {
-  // no sleepers, wake first blockee
-    t = OS_THREAD(list_first(&c->q_block));
-    if (t != NULL) {
-      TRACE_OS_SIGWAKED(t);
-#if CONFIG_OS_BUMP
-      if (os.current_thread != t) {
-        // play it nice and do not bump if thread is already running
-        os.bumped_thread = t;
-      }
-#endif
-      list_delete(&c->q_block, OS_ELEMENT(t));
-    }
-  }
-  if (t != NULL) {
-    list_add(&os.q_running, OS_ELEMENT(t));
-#if OS_DBG_MON
-  c->signalled++;
-#endif
-  }
-  __os_check_validity();
-  __os_update_preemption();
-  exit_critical();
-  if (!os.preemption) {
-    OS_HAL_PENDING_CTX_SWITCH;
-  }
-
-  return 0;
-}
-
-u32_t OS_cond_broadcast(os_cond *c) {
-  enter_critical();
-  TRACE_OS_CONDBROAD(c);
-
-  // wake all sleepers
-  if (!list_is_empty(&c->q_sleep)) {
-#if CONFIG_OS_BUMP
-    if (os.current_thread != OS_THREAD(list_first(&c->q_sleep))) {
-      // play it nice and do not bump if thread is already running
-      os.bumped_thread = OS_THREAD(list_first(&c->q_sleep));
-    }
-#endif
-    TRACE_OS_SIGWAKED(OS_THREAD(list_first(&c->q_sleep)));
-    list_move_all(&os.q_running, &c->q_sleep);
-    //  remove condition from os sleep queue and update first_awake value.
-    c->has_sleepers = FALSE;
-    list_delete(&os.q_sleep, OS_ELEMENT(c));
-    __os_update_first_awake();
-  } else {
-    // if no sleepers, bump first blocked thread
-    if (!list_is_empty(&c->q_block)) {
-#if CONFIG_OS_BUMP
-      if (os.current_thread != OS_THREAD(list_first(&c->q_block))) {
-        // play it nice and do not bump if thread is already running
-        os.bumped_thread = OS_THREAD(list_first(&c->q_block));
-      }
-#endif
-      TRACE_OS_SIGWAKED(OS_THREAD(list_first(&c->q_block)));
-    }
-  }
-  // wake all blockees
-  list_move_all(&os.q_running, &c->q_block);
-#if OS_DBG_MON
-  c->broadcasted++;
-#endif
-  __os_check_validity();
-  __os_update_preemption();
-  exit_critical();
-  if (!os.preemption) {
-    OS_HAL_PENDING_CTX_SWITCH;
-  }
-  return 0;
-}
-
-os_wakeup_res OS_get_next_wakeup(sys_time *next_wakeup) {
-  if (os.q_running.length > 0) {
-    if (os.first_awake != OS_FOREVER) {
-      if (next_wakeup) {
-      *next_wakeup = os.first_awake;
-      }
-      return OS_WUP_SLEEP_RUNNING;
-    } else {
-      return OS_WUP_RUNNING;
-    }
-    return OS_WUP_RUNNING;
-  } else if (os.first_awake == OS_FOREVER) {
-    return OS_WUP_SLEEP_FOREVER;
-  } else if (next_wakeup) {
-    *next_wakeup = os.first_awake;
-  }
-  return OS_WUP_SLEEP;
-}
-
-u32_t OS_get_running_threads(void) {
-  return list_count(&os.q_running);
+  os_svc(1);
+  return OS_thread_self()->ret_val;
 }
 
 void OS_force_ctx_switch(void) {
@@ -965,181 +442,22 @@ void OS_force_ctx_switch(void) {
 
 void OS_init(void) {
   const u32_t ticks = (SYS_CPU_FREQ/SYS_OS_TICK_DIV) / CONFIG_OS_PREEMPT_FREQ;
-  memset(&os, 0, sizeof(os));
+  memset(&os_arch, 0, sizeof(os_arch));
 
-#if OS_RUNTIME_VALIDITY_CHECK
-  os.os_canary_pre = OS_CANARY_MAGIC;
-  os.os_canary_post = OS_CANARY_MAGIC;
+#if OS_FPU
+  // automatic and lazy fp state preservation
+  FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
 #endif
 
-  list_init(&os.q_running);
-  list_init(&os.q_sleep);
-  os.first_awake = OS_FOREVER;
+#if defined(CONFIG_OS_STATS) && defined(OS_HAL_CYCLES_INIT)
+  OS_HAL_CYCLES_INIT;
+#endif
+  __os_init();
 
   OS_HAL_CONFIG_PREEMPTION_TICK(ticks);
 }
 
 #if OS_DBG_MON
-static void OS_DBG_print_thread_list(u8_t io, list_t *l, bool detail, int indent);
-
-bool OS_DBG_print_thread(u8_t io, os_thread *t, bool detail, int indent) {
-  if (t == NULL) return FALSE;
-  char tab[32];
-  memset(tab, ' ', sizeof(tab));
-  tab[indent] = 0;
-  ioprint(io, "%sthread id:%04x  addr:%08x  name:%s  order:%08x\n", tab,
-      t->id, t, t->name == NULL ? "<n/a>" : t->name, t->this.e.sort_order);
-  if (!detail) return TRUE;
-  ioprint(io, "%s       func:%08x  flags:%08x\n", tab,
-      t->func, t->flags);
-  ioprint(io, "%s       sp:  %08x", tab,
-      t->sp);
-#if OS_STACK_CHECK
-  ioprint(io, " [%s]  ", (t->sp < t->stack_start || t->sp > t->stack_end) ? TEXT_BAD("BPTR") :" ok ");
-  bool sp_start_bad = OS_DBG_BADR(t->stack_start);
-  bool sp_end_bad = t->stack_end < t->stack_start || OS_DBG_BADR(t->stack_end);
-  ioprint(io, "  sp_start:%08x [%s]  sp_end:%08x [%s]",
-      t->stack_start,
-      sp_start_bad ? TEXT_BAD("BADR") : (*(u32_t*)(t->stack_start - 4) != OS_STACK_START_MARKER ? TEXT_BAD("CRPT") : " ok "),
-      t->stack_end,
-      sp_end_bad ? TEXT_BAD("BADR") : (*(u32_t*)(t->stack_end) != OS_STACK_END_MARKER ? TEXT_BAD("CRPT") : " ok ")
-          );
-#if OS_STACK_USAGE_CHECK
-  if (!sp_start_bad && !sp_end_bad) {
-    // for descending stacks
-    u32_t used_entries = 0;
-    u32_t *s = (u32_t *)t->stack_start;
-    while (s[used_entries] == _STACK_USAGE_MARK_32 && (void *)&s[used_entries] < t->stack_end) {
-      used_entries++;
-    }
-    u32_t perc = 100 - ((100 * used_entries) / ((t->stack_end - t->stack_start)/sizeof(u32_t)));
-    ioprint(io, "  used:%i%", perc);
-    if (perc == 100) {
-      ioprint(io, TEXT_BAD(" FULL"));
-    } else if (perc > 90) {
-      ioprint(io, TEXT_NOTE(" ALMOST FULL"));
-    }
-  }
-#endif
-#endif
-  ioprint(io, "\n");
-
-  if (!list_is_empty(&t->q_join)) {
-    ioprint(io, "%s       Join List (%i): \n", tab,
-        list_count(&t->q_join));
-    OS_DBG_print_thread_list(io, &t->q_join, FALSE, indent + 9);
-  }
-  return TRUE;
-}
-
-static void OS_DBG_print_thread_list(u8_t io, list_t *l, bool detail, int indent) {
-  element_t *cur = list_first(l);
-  while (cur) {
-    os_type type = OS_TYPE(OS_OBJ(cur));
-    switch (type) {
-    case OS_THREAD:
-      OS_DBG_print_thread(io, OS_THREAD(cur), detail, indent);
-      break;
-    case OS_COND:
-      OS_DBG_print_cond(io, OS_COND(cur), detail, indent);
-      break;
-    default:
-      // TODO
-      break;
-    }
-    cur = list_next(cur);
-  }
-}
-
-static void OS_DBG_list_threads(u8_t io) {
-  int i;
-  ioprint(io, "Running\n-------\n");
-  OS_DBG_print_thread(io, os.current_thread, TRUE, 2);
-  ioprint(io, "Scheduled\n---------\n");
-  OS_DBG_print_thread_list(io, &os.q_running, TRUE, 2);
-  ioprint(io, "Sleeping\n--------\n");
-  OS_DBG_print_thread_list(io, &os.q_sleep, TRUE, 2);
-  ioprint(io, "Thread peers\n------------\n");
-  for (i = 0; i < OS_THREAD_PEERS; i++) {
-    OS_DBG_print_thread(io, os.thread_peers[i], TRUE, 2);
-  }
-}
-
-bool OS_DBG_print_mutex(u8_t io, os_mutex *m, bool detail, int indent) {
-  if (m == NULL) return FALSE;
-  char tab[32];
-  memset(tab, ' ', sizeof(tab));
-  tab[indent] = 0;
-  ioprint(io, "%smutex  id:%04x  addr:%08x  lock:%08x  attr:%08x  depth:%i\n", tab, m->id, m, m->lock, m->attrs, m->depth);
-  if (!detail) return TRUE;
-  ioprint(io, "%s       owner: ", tab);
-  if (!OS_DBG_print_thread(io, m->owner, FALSE, indent+2)) {
-    ioprint(io, "\n");
-  }
-  ioprint(io, "%s       entries:%i  exits:%i\n", tab, m->entered, m->exited);
-  if (!list_is_empty(&m->q_block)) {
-    ioprint(io, "%s       Blocked List (%i)\n", tab, list_count(&m->q_block));
-    OS_DBG_print_thread_list(io, &m->q_block, FALSE, indent + 9);
-  }
-  return TRUE;
-
-}
-
-static void OS_DBG_list_mutexes(u8_t io) {
-  int i;
-  ioprint(io, "Mutex peers\n-----------\n");
-  for (i = 0; i < OS_MUTEX_PEERS; i++) {
-    OS_DBG_print_mutex(io, os.mutex_peers[i], 2, TRUE);
-  }
-}
-
-bool OS_DBG_print_cond(u8_t io, os_cond *c, bool detail, int indent) {
-  if (c == NULL) return FALSE;
-  char tab[32];
-  memset(tab, ' ', sizeof(tab));
-  tab[indent] = 0;
-  ioprint(io, "%scond   id:%04x  addr:%08x  sleepers:%s  order:%08x\n", tab,
-      c->id, c,  c->has_sleepers? "YES":"NO ", c->this.e.sort_order);
-  ioprint(io, "%s       mutex: ", tab);
-  if (!OS_DBG_print_mutex(io, c->mutex, FALSE, indent + 2)) {
-    ioprint(io, "\n");
-  }
-  if (!detail) return TRUE;
-  ioprint(io, "%s       waits:%i  signals:%i  broadcasts:%i\n", tab,
-      c->waiting, c->signalled, c->broadcasted);
-  if (!list_is_empty(&c->q_block)) {
-    ioprint(io, "%s       Blocked List (%i)\n", tab, list_count(&c->q_block));
-    OS_DBG_print_thread_list(io, &c->q_block, FALSE, indent + 9);
-  }
-  if (!list_is_empty(&c->q_sleep)) {
-    ioprint(io, "%s       TimedWait List (%i)\n", tab, list_count(&c->q_sleep));
-    OS_DBG_print_thread_list(io, &c->q_sleep, FALSE, indent + 9);
-  }
-  return TRUE;
-}
-
-static void OS_DBG_list_conds(u8_t io) {
-  int i;
-  ioprint(io, "Cond peers\n----------\n");
-  for (i = 0; i < OS_COND_PEERS; i++) {
-    OS_DBG_print_cond(io, os.cond_peers[i], 2, TRUE);
-  }
-}
-
-void OS_DBG_list_all(u8_t io, bool previous_preempt) {
-  ioprint(io, "OS INFO\n-------\n");
-  ioprint(io, "  Scheduled threads: %i\n", list_count(&os.q_running));
-  ioprint(io, "  Sleeping entries:  %i\n", list_count(&os.q_sleep));
-  ioprint(io, "  Spawned threads:   %i\n", g_thr_id);
-  ioprint(io, "  Critical depth:    %i\n", g_crit_entry);
-  ioprint(io, "  Preemption:        %s\n", previous_preempt ? "ON":"OFF");
-  ioprint(io, "  Now:               %i\n", SYS_get_time_ms());
-  ioprint(io, "  First awake:       %i (%i in future)\n", os.first_awake, os.first_awake - SYS_get_time_ms());
-  OS_DBG_list_threads(io);
-  OS_DBG_list_mutexes(io);
-  OS_DBG_list_conds(io);
-}
-
 void OS_DBG_dump(u8_t io) {
   bool pre = OS_enter_critical();
   OS_DBG_list_all(io, pre);
@@ -1150,7 +468,7 @@ void OS_DBG_dump(u8_t io) {
 void OS_DBG_dump_irq(u8_t io) {
   if(EXTI_GetITStatus(OS_DUMP_IRQ_EXTI_LINE) != RESET) {
     enter_critical();
-    OS_DBG_list_all(io, os.preemption);
+    OS_DBG_list_all(io, os_arch.preemption);
     exit_critical();
     EXTI_ClearITPendingBit(OS_DUMP_IRQ_EXTI_LINE);
   }
@@ -1158,26 +476,70 @@ void OS_DBG_dump_irq(u8_t io) {
 
 #endif
 
-os_thread *OS_DBG_get_thread_by_id(u32_t id) {
-#if OS_DBG_MON
-  int i;
-  for (i = 0; i < OS_THREAD_PEERS; i++) {
-    if (os.thread_peers[i] != NULL && os.thread_peers[i]->id == id) {
-      return os.thread_peers[i];
+#ifdef OS_HAL_CYCLES
+// thread switches per latency measurement
+#define OS_DBG_BENCH_SWITCHES       1000
+
+static struct {
+  os_thread thr[2];
+  u32_t stack[2][256];
+  bool fp;
+  bool fp_seen;
+  volatile float acc[2];
+} os_bench;
+
+static void *__os_bench_switch_f(void *arg) {
+  u32_t ix = (u32_t)arg;
+  u32_t i;
+  for (i = 0; i < OS_DBG_BENCH_SWITCHES / 2; i++) {
+    if (os_bench.fp) {
+      // gives thread an active fp context
+      os_bench.acc[ix] += 1.0f;
     }
+    (void)OS_thread_yield();
   }
+  enter_critical();
+  os_bench.fp_seen |= OS_thread_fp_context(OS_thread_self());
+  exit_critical();
   return NULL;
-#else
-  return NULL;
-#endif
 }
 
-os_thread **OS_DBG_get_thread_peers() {
-#if OS_DBG_MON
-  return os.thread_peers;
+// Returns cpu cycles per switch between two yielding threads, outranking
+// all others. The threads run to their end before kernel is back.
+static u32_t __os_bench_switch(bool fp) {
+  u32_t i, t0, t1;
+  os_bench.fp = fp;
+  enter_critical();
+  for (i = 0; i < 2; i++) {
+    OS_thread_create(&os_bench.thr[i], 0, __os_bench_switch_f, (void *)i,
+        os_bench.stack[i], sizeof(os_bench.stack[i]), "bench");
+    OS_thread_set_prio(&os_bench.thr[i], 255);
+  }
+  t0 = OS_HAL_CYCLES();
+  exit_critical();
+  t1 = OS_HAL_CYCLES();
+  return (t1 - t0) / OS_DBG_BENCH_SWITCHES;
+}
+
+void OS_DBG_bench_switch(u8_t io) {
+  ASSERT(OS_thread_self() == NULL);
+#if !defined(CONFIG_OS_STATS) && defined(OS_HAL_CYCLES_INIT)
+  // else already counting for stats
+  OS_HAL_CYCLES_INIT;
+#endif
+  os_bench.fp_seen = FALSE;
+  ioprint(io, "switch: %i cycles\n", __os_bench_switch(FALSE));
+#if OS_FPU
+  u32_t fp_cycles = __os_bench_switch(TRUE);
+  ioprint(io, "switch with fp: %i cycles, fp context %s\n", fp_cycles,
+      os_bench.fp_seen ? "saved" : TEXT_BAD("not saved"));
 #else
-  return NULL;
+  ioprint(io, "switch with fp: no fpu\n");
 #endif
 }
+#else
+void OS_DBG_bench_switch(u8_t io) {
+  ioprint(io, "no cycle counter\n");
+}
+#endif // OS_HAL_CYCLES
 #endif // OS_DBG_MON
-
@@ -137,6 +137,14 @@ s32_t USB_SER_rx_buf(u8_t *buf, u16_t len) {
   return ringbuf_get(&rx_rb, buf, len);
 }
 
+u16_t USB_SER_rx_peek_linear(u8_t **ptr) {
+  return ringbuf_available_linear(&rx_rb, ptr);
+}
+
+s32_t USB_SER_rx_consume(u16_t len) {
+  return ringbuf_get(&rx_rb, NULL, len);
+}
+
 s32_t USB_SER_tx_char(u8_t c) {
   return ringbuf_putc(&tx_rb, c);
 }
@@ -75,6 +75,14 @@ s32_t USB_SER_rx_buf(u8_t *buf, u16_t len) {
   return ringbuf_get(&rx_rb, buf, len);
 }
 
+u16_t USB_SER_rx_peek_linear(u8_t **ptr) {
+  return ringbuf_available_linear(&rx_rb, ptr);
+}
+
+s32_t USB_SER_rx_consume(u16_t len) {
+  return ringbuf_get(&rx_rb, NULL, len);
+}
+
 void USB_SER_tx_drain(void) {
   ringbuf_clear(&usb_vcd_ringbuf_tx);
 }
@@ -123,10 +131,11 @@ s32_t USB_SER_tx_buf(u8_t *buf, u16_t len) {
     } else if (res >= 0) {
       len -= res;
       buf += res;
+      sent += res;
     } else {
       break;
     }
-  } while (usb_assure_tx && sent < len && --spoon_guard);
+  } while (usb_assure_tx && len > 0 && --spoon_guard);
   if (spoon_guard == 0) {
     res = RB_ERR_FULL;
   }
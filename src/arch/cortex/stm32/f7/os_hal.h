@@ -21,4 +21,13 @@
   SysTick_CLKSourceConfig(SysTick_CLKSource_HCLK_Div8);
 
 
+#define OS_HAL_CYCLES_INIT \
+  do { \
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+    DWT->CYCCNT = 0; \
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+  } while (0)
+#define OS_HAL_CYCLES() \
+  (DWT->CYCCNT)
+
 #endif /* OS_HAL_H_ */
@@ -158,6 +158,17 @@ u16_t UART_rx_available(uart *u) {
   }
 }
 
+u16_t UART_rx_peek_linear(uart *u, u8_t **ptr) {
+  volatile u16_t r = u->rx.rix;
+  volatile u16_t w = u->rx.wix;
+  *ptr = &u->rx.buf[r];
+  if (w >= r) {
+    return w - r;
+  } else {
+    return UART_RX_BUFFER - r;
+  }
+}
+
 u16_t UART_tx_available(uart *u) {
   volatile u16_t r = u->tx.rix;
   volatile u16_t w = u->tx.wix;
@@ -6,16 +6,348 @@
 #define UART_CHECK_RX(u) (UART_HW(u)->SR & USART_SR_RXNE)
 #define UART_CHECK_TX(u) (UART_HW(u)->SR & USART_SR_TXE)
 #define UART_CHECK_OR(u) (UART_HW(u)->SR & USART_SR_ORE)
+#ifdef CONFIG_UART_DMA_RX
+// rx write index is only moved in irq, rx read index outside and by irq
+// when dma overran it, so reading takes a critical section
+#define UART_RX_IRQ_OFF(u)
+#define UART_RX_IRQ_ON(u)
+#define UART_RX_ENTER(u)   enter_critical()
+#define UART_RX_EXIT(u)    exit_critical()
+#else
 #define UART_RX_IRQ_OFF(u) UART_HW(u)->CR1 &= ~USART_CR1_RXNEIE
 #define UART_RX_IRQ_ON(u)  UART_HW(u)->CR1 |= USART_CR1_RXNEIE
+#define UART_RX_ENTER(u)   UART_RX_IRQ_OFF(u)
+#define UART_RX_EXIT(u)    UART_RX_IRQ_ON(u)
+#endif
 #define UART_TX_IRQ_OFF(u) UART_HW(u)->CR1 &= ~USART_CR1_TXEIE
 #define UART_TX_IRQ_ON(u)  UART_HW(u)->CR1 |= USART_CR1_TXEIE
 
+#ifdef CONFIG_UART_DMA_TX
+#if UART_SYNC_TX
+#error "CONFIG_UART_DMA_TX needs a tx buffer, UART_SYNC_TX must be 0"
+#endif
+#define UART_TX_START(u)   UART_tx_dma_kick(u)
+#else
+#define UART_TX_START(u)   UART_TX_IRQ_ON(u)
+#endif
+
+#if defined(CONFIG_UART_DMA_RX) || defined(CONFIG_UART_DMA_TX)
+
+#ifdef CONFIG_UART_OWN_CFG
+#error "CONFIG_UART_DMA_RX/TX cannot be combined with CONFIG_UART_OWN_CFG"
+#endif
+
+// rx and tx dma of each uart: channel or stream, its interrupt flags, request
+// channel and dma clock - may be overridden for alternate streams
+#if defined(PROC_STM32F1)
+typedef DMA_Channel_TypeDef uart_dma_hw;
+#define UART_DMA_CLOCK(clk)     RCC_AHBPeriphClockCmd(clk, ENABLE)
+#define UART_DMA_CLEAR(d, it)   DMA_ClearITPendingBit(it)
+// transfer error flag of a channel is three bits above its global flag
+#define UART_DMA_TE(d, it) \
+  (DMA_GetITStatus(((it) & 0x10000000) | (((it) & 0x0fffffff) << 3)) != RESET)
+#define UART_DMA_SET_MEM(d, m)  (d)->CMAR = (u32_t)(m)
+#ifndef UART1_RX_DMA
+#define UART1_RX_DMA    DMA1_Channel5, DMA1_IT_GL5, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART2_RX_DMA
+#define UART2_RX_DMA    DMA1_Channel6, DMA1_IT_GL6, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART3_RX_DMA
+#define UART3_RX_DMA    DMA1_Channel3, DMA1_IT_GL3, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART4_RX_DMA
+#define UART4_RX_DMA    DMA2_Channel3, DMA2_IT_GL3, 0, RCC_AHBPeriph_DMA2
+#endif
+#ifndef UART1_TX_DMA
+#define UART1_TX_DMA    DMA1_Channel4, DMA1_IT_GL4, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART2_TX_DMA
+#define UART2_TX_DMA    DMA1_Channel7, DMA1_IT_GL7, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART3_TX_DMA
+#define UART3_TX_DMA    DMA1_Channel2, DMA1_IT_GL2, 0, RCC_AHBPeriph_DMA1
+#endif
+#ifndef UART4_TX_DMA
+#define UART4_TX_DMA    DMA2_Channel5, DMA2_IT_GL5, 0, RCC_AHBPeriph_DMA2
+#endif
+#elif defined(PROC_STM32F4)
+typedef DMA_Stream_TypeDef uart_dma_hw;
+#define UART_DMA_CLOCK(clk)     RCC_AHB1PeriphClockCmd(clk, ENABLE)
+#define UART_DMA_CLEAR(d, it)   DMA_ClearITPendingBit(d, it)
+// transfer error flags of streams 4-7 are those of streams 0-3
+#define UART_DMA_TE(d, it) \
+  (DMA_GetITStatus(d, (it) & (DMA_IT_TEIF0 | DMA_IT_TEIF1 | DMA_IT_TEIF2 | DMA_IT_TEIF3)) != RESET)
+#define UART_DMA_SET_MEM(d, m)  (d)->M0AR = (u32_t)(m)
+#define UART_DMA_IT(x) \
+  (DMA_IT_TCIF##x | DMA_IT_HTIF##x | DMA_IT_TEIF##x | DMA_IT_DMEIF##x | DMA_IT_FEIF##x)
+#ifndef UART1_RX_DMA
+#define UART1_RX_DMA    DMA2_Stream2, UART_DMA_IT(2), DMA_Channel_4, RCC_AHB1Periph_DMA2
+#endif
+#ifndef UART2_RX_DMA
+#define UART2_RX_DMA    DMA1_Stream5, UART_DMA_IT(5), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#ifndef UART3_RX_DMA
+#define UART3_RX_DMA    DMA1_Stream1, UART_DMA_IT(1), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#ifndef UART4_RX_DMA
+#define UART4_RX_DMA    DMA1_Stream2, UART_DMA_IT(2), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#ifndef UART1_TX_DMA
+#define UART1_TX_DMA    DMA2_Stream7, UART_DMA_IT(7), DMA_Channel_4, RCC_AHB1Periph_DMA2
+#endif
+#ifndef UART2_TX_DMA
+#define UART2_TX_DMA    DMA1_Stream6, UART_DMA_IT(6), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#ifndef UART3_TX_DMA
+#define UART3_TX_DMA    DMA1_Stream3, UART_DMA_IT(3), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#ifndef UART4_TX_DMA
+#define UART4_TX_DMA    DMA1_Stream4, UART_DMA_IT(4), DMA_Channel_4, RCC_AHB1Periph_DMA1
+#endif
+#endif
+
+// Configures a dma channel or stream between uart data register and memory
+static void UART_dma_init(uart *u, uart_dma_hw *d, u32_t ch, u8_t *mem, u16_t len, bool rx) {
+  DMA_InitTypeDef cfg;
+  DMA_Cmd(d, DISABLE);
+  DMA_DeInit(d);
+  DMA_StructInit(&cfg);
+  cfg.DMA_PeripheralBaseAddr = (u32_t)&UART_HW(u)->DR;
+#if defined(PROC_STM32F1)
+  cfg.DMA_MemoryBaseAddr = (u32_t)mem;
+  cfg.DMA_DIR = rx ? DMA_DIR_PeripheralSRC : DMA_DIR_PeripheralDST;
+#elif defined(PROC_STM32F4)
+  cfg.DMA_Channel = ch;
+  cfg.DMA_Memory0BaseAddr = (u32_t)mem;
+  cfg.DMA_DIR = rx ? DMA_DIR_PeripheralToMemory : DMA_DIR_MemoryToPeripheral;
+#endif
+  cfg.DMA_BufferSize = len;
+  cfg.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  cfg.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  cfg.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  cfg.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  cfg.DMA_Mode = rx ? DMA_Mode_Circular : DMA_Mode_Normal;
+  cfg.DMA_Priority = rx ? DMA_Priority_High : DMA_Priority_Medium;
+  DMA_Init(d, &cfg);
+}
+
+#endif // CONFIG_UART_DMA_RX || CONFIG_UART_DMA_TX
+
+#ifdef CONFIG_UART_DMA_RX
+
+#define UART_RX_DMA(u)  ((uart_dma_hw *)((u)->dma_rx))
+
+static void UART_rx_dma_define(uart *u, void *dma, u32_t it, u32_t ch, u32_t clk) {
+  u->dma_rx = dma;
+  u->dma_rx_it = it;
+  u->dma_rx_ch = ch;
+  UART_DMA_CLOCK(clk);
+}
+
+// Picks up what dma has received since last time, and calls back
+static void UART_rx_dma_update(uart *u, bool dma_irq) {
+  enter_critical();
+  u16_t wix = UART_RX_BUFFER - DMA_GetCurrDataCounter(UART_RX_DMA(u));
+  if (wix >= UART_RX_BUFFER) {
+    wix = 0;
+  }
+  if (dma_irq) {
+    // a mark passed after reading position raises the irq again
+    UART_DMA_CLEAR(UART_RX_DMA(u), u->dma_rx_it);
+  }
+  u32_t len = UART_rx_dma_advance(u, wix, dma_irq);
+  exit_critical();
+  if (len == 0) {
+    return;
+  }
+  if (u->rx_f) {
+    u->rx_f(u->arg, u->rx.buf[wix == 0 ? UART_RX_BUFFER - 1 : wix - 1]);
+  }
+  if (u->rx_burst_f) {
+    u->rx_burst_f(u->burst_arg, MIN(len, UART_RX_BUFFER - 1));
+  }
+}
+
+// Starts circular dma reception into rx buffer
+static void UART_rx_dma_start(uart *u) {
+  UART_dma_init(u, UART_RX_DMA(u), u->dma_rx_ch, u->rx.buf, UART_RX_BUFFER, TRUE);
+  u->rx.wix = 0;
+  u->rx.rix = 0;
+  u->dma_rx_irq_wix = 0;
+  DMA_ITConfig(UART_RX_DMA(u), DMA_IT_HT | DMA_IT_TC, ENABLE);
+  USART_DMACmd(UART_HW(u), USART_DMAReq_Rx, ENABLE);
+  DMA_Cmd(UART_RX_DMA(u), ENABLE);
+}
+
+static void UART_rx_dma_stop(uart *u) {
+  USART_DMACmd(UART_HW(u), USART_DMAReq_Rx, DISABLE);
+  DMA_Cmd(UART_RX_DMA(u), DISABLE);
+}
+
+void UART_rx_dma_irq(uart *u) {
+#ifdef CONFIG_UART_RX_STATS
+  u->rx_irqs++;
+#endif
+  UART_rx_dma_update(u, TRUE);
+}
+
+void UART_set_burst_callback(uart *u, uart_rx_burst_callback rx_burst_f, void* arg) {
+  u->rx_burst_f = rx_burst_f;
+  u->burst_arg = arg;
+}
+
+#endif // CONFIG_UART_DMA_RX
+
+#ifdef CONFIG_UART_DMA_TX
+
+#define UART_TX_DMA(u)  ((uart_dma_hw *)((u)->dma_tx))
+
+static void UART_tx_dma_define(uart *u, void *dma, u32_t it, u32_t ch, u32_t clk) {
+  u->dma_tx = dma;
+  u->dma_tx_it = it;
+  u->dma_tx_ch = ch;
+  UART_DMA_CLOCK(clk);
+}
+
+static void UART_tx_dma_begin(uart *u, u8_t *buf, u16_t len) {
+  DMA_Cmd(UART_TX_DMA(u), DISABLE);
+  UART_DMA_CLEAR(UART_TX_DMA(u), u->dma_tx_it);
+  UART_DMA_SET_MEM(UART_TX_DMA(u), buf);
+  DMA_SetCurrDataCounter(UART_TX_DMA(u), len);
+  DMA_Cmd(UART_TX_DMA(u), ENABLE);
+}
+
+// Starts next tx transfer unless busy, in order of UART_tx_dma_chunk. Must
+// be called in critical.
+static void UART_tx_dma_next(uart *u) {
+  u8_t *buf;
+  u16_t len = UART_tx_dma_chunk(u, &buf);
+  if (len) {
+    UART_tx_dma_begin(u, buf, len);
+  }
+}
+
+static void UART_tx_dma_kick(uart *u) {
+  enter_critical();
+  UART_tx_dma_next(u);
+  exit_critical();
+}
+
+// Aborts current tx transfer, accounting for what was sent. Returns callback
+// of referenced buffer if it got completed. Must be called in critical.
+static uart_tx_ref_callback UART_tx_dma_stop(uart *u, void **ref_arg) {
+  if (u->dma_tx_len == 0) {
+    return NULL;
+  }
+  DMA_Cmd(UART_TX_DMA(u), DISABLE);
+#if defined(PROC_STM32F4)
+  while (DMA_GetCmdStatus(UART_TX_DMA(u)) != DISABLE);
+#endif
+  uart_tx_ref_callback ref_f =
+      UART_tx_dma_done(u, DMA_GetCurrDataCounter(UART_TX_DMA(u)), FALSE, ref_arg);
+  UART_DMA_CLEAR(UART_TX_DMA(u), u->dma_tx_it);
+  return ref_f;
+}
+
+static void UART_tx_dma_start(uart *u) {
+  uart_tx_ref_callback ref_f;
+  void *ref_arg = NULL;
+  enter_critical();
+  ref_f = UART_tx_dma_stop(u, &ref_arg);
+  UART_dma_init(u, UART_TX_DMA(u), u->dma_tx_ch, u->tx.buf, UART_TX_BUFFER, FALSE);
+  DMA_ITConfig(UART_TX_DMA(u), DMA_IT_TC | DMA_IT_TE, ENABLE);
+  USART_DMACmd(UART_HW(u), USART_DMAReq_Tx, ENABLE);
+  UART_tx_dma_next(u);
+  exit_critical();
+  if (ref_f) {
+    ref_f(ref_arg);
+  }
+}
+
+void UART_tx_dma_irq(uart *u) {
+  uart_tx_ref_callback ref_f = NULL;
+  void *ref_arg = NULL;
+  enter_critical();
+  bool error = UART_DMA_TE(UART_TX_DMA(u), u->dma_tx_it);
+  UART_DMA_CLEAR(UART_TX_DMA(u), u->dma_tx_it);
+  if (u->dma_tx_len) {
+    // on transfer error dma stopped, what is left is sent again
+    ref_f = UART_tx_dma_done(u,
+        error ? DMA_GetCurrDataCounter(UART_TX_DMA(u)) : 0, error, &ref_arg);
+  }
+  UART_tx_dma_next(u);
+  exit_critical();
+  if (ref_f) {
+    ref_f(ref_arg);
+  }
+}
+
+void UART_tx_dma_stats(uart *u, u32_t *errors, u32_t *lost) {
+  *errors = u->tx_errors;
+  *lost = u->tx_lost;
+}
+
+s32_t UART_put_buf_ref(uart *u, u8_t *buf, u16_t len, uart_tx_ref_callback ref_f, void *arg) {
+  if (UART_ALWAYS_SYNC_TX || u->sync_tx || len == 0) {
+    UART_put_buf(u, buf, len);
+    if (ref_f) {
+      ref_f(arg);
+    }
+    return len;
+  }
+  enter_critical();
+  if (u->tx_ref) {
+    exit_critical();
+    return -1;
+  }
+  u->tx_ref = buf;
+  u->tx_ref_len = len;
+  u->tx_ref_wix = u->tx.wix;
+  u->tx_ref_f = ref_f;
+  u->tx_ref_arg = arg;
+  UART_tx_dma_next(u);
+  exit_critical();
+  return len;
+}
+
+#endif // CONFIG_UART_DMA_TX
+
+#ifdef CONFIG_UART_RX_STATS
+void UART_rx_stats(uart *u, u32_t *irqs, u32_t *bytes, u32_t *overruns, u32_t *lost) {
+  *irqs = u->rx_irqs;
+  *bytes = u->rx_bytes;
+  *overruns = u->rx_overruns;
+  *lost = u->rx_lost;
+}
+
+void UART_rx_stats_reset(uart *u) {
+  u->rx_irqs = 0;
+  u->rx_bytes = 0;
+  u->rx_overruns = 0;
+  u->rx_lost = 0;
+}
+#endif
+
 void UART_irq(uart *u) {
   if (u->hw == 0) return;
 
+#ifdef CONFIG_UART_DMA_RX
+  if ((UART_HW(u)->SR & USART_SR_IDLE) && (UART_HW(u)->CR1 & USART_CR1_IDLEIE)) {
+    // line went idle, burst ended - flag is cleared by reading SR then DR
+    (void)UART_HW(u)->DR;
+#ifdef CONFIG_UART_RX_STATS
+    u->rx_irqs++;
+#endif
+    UART_rx_dma_update(u, FALSE);
+  }
+#else
   if ((UART_CHECK_RX(u)) && (UART_HW(u)->CR1 & USART_CR1_RXNEIE)) {
     u8_t c = UART_HW(u)->DR;
+#ifdef CONFIG_UART_RX_STATS
+    u->rx_irqs++;
+    u->rx_bytes++;
+#endif
     u->rx.buf[u->rx.wix++] = c;
     if (u->rx.wix >= UART_RX_BUFFER) {
       u->rx.wix = 0;
@@ -24,6 +356,8 @@ void UART_irq(uart *u) {
       u->rx_f(u->arg, c);
     }
   }
+#endif
+#ifndef CONFIG_UART_DMA_TX
   if ((UART_CHECK_TX(u))) {
     if (UART_ALWAYS_SYNC_TX || u->sync_tx) {
       UART_TX_IRQ_OFF(u);
@@ -39,14 +373,25 @@ void UART_irq(uart *u) {
       }
     }
   }
+#endif
   if (UART_CHECK_OR(u)) {
     (void)UART_HW(u)->DR;
+#ifdef CONFIG_UART_RX_STATS
+    u->rx_overruns++;
+    u->rx_lost++;
+#endif
   }
 }
 
 u16_t UART_rx_available(uart *u) {
+#ifdef CONFIG_UART_DMA_RX
+  enter_critical();
+#endif
   volatile u16_t r = u->rx.rix;
   volatile u16_t w = u->rx.wix;
+#ifdef CONFIG_UART_DMA_RX
+  exit_critical();
+#endif
   if (w >= r) {
     return w - r;
   } else {
@@ -54,6 +399,23 @@ u16_t UART_rx_available(uart *u) {
   }
 }
 
+u16_t UART_rx_peek_linear(uart *u, u8_t **ptr) {
+#ifdef CONFIG_UART_DMA_RX
+  enter_critical();
+#endif
+  volatile u16_t r = u->rx.rix;
+  volatile u16_t w = u->rx.wix;
+#ifdef CONFIG_UART_DMA_RX
+  exit_critical();
+#endif
+  *ptr = &u->rx.buf[r];
+  if (w >= r) {
+    return w - r;
+  } else {
+    return UART_RX_BUFFER - r;
+  }
+}
+
 u16_t UART_tx_available(uart *u) {
   volatile u16_t r = u->tx.rix;
   volatile u16_t w = u->tx.wix;
@@ -65,32 +427,83 @@ u16_t UART_tx_available(uart *u) {
 }
 
 void UART_tx_drain(uart *uart) {
-#if !UART_SYNC_TX
+#ifdef CONFIG_UART_DMA_TX
+  uart_tx_ref_callback ref_f;
+  void *ref_arg = NULL;
+  enter_critical();
+  ref_f = UART_tx_dma_stop(uart, &ref_arg);
+  if (uart->tx_ref) {
+    ref_f = uart->tx_ref_f;
+    ref_arg = uart->tx_ref_arg;
+    uart->tx_ref = NULL;
+  }
+  uart->tx.rix = 0;
+  uart->tx.wix = 0;
+  exit_critical();
+  if (ref_f) {
+    ref_f(ref_arg);
+  }
+#elif !UART_SYNC_TX
   uart->tx.rix = 0;
   uart->tx.wix = 0;
 #endif
 }
 
-void UART_tx_flush(uart *u) {
-  UART_RX_IRQ_OFF(u);
+#ifndef CONFIG_UART_DMA_TX
+// Sends tx ring data up to given index, blocking
+static void UART_tx_force_ring(uart *u, u16_t wix) {
   u16_t rix = u->tx.rix;
-  u16_t wix = u->tx.wix;
   while (rix != wix) {
     u8_t c = u->tx.buf[rix];
     UART_tx_force_char(u, c);
-    if (rix >= UART_RX_BUFFER - 1) {
+    if (rix >= UART_TX_BUFFER - 1) {
       rix = 0;
     } else {
       rix++;
     }
   }
   u->tx.rix = rix;
+}
+#endif
+
+void UART_tx_flush(uart *u) {
+#ifdef CONFIG_UART_DMA_TX
+  uart_tx_ref_callback ref_f;
+  void *ref_arg = NULL;
+  u8_t *buf;
+  u16_t len;
+  enter_critical();
+  ref_f = UART_tx_dma_stop(u, &ref_arg);
+  len = UART_tx_dma_chunk(u, &buf);
+  exit_critical();
+  if (ref_f) {
+    ref_f(ref_arg);
+  }
+  // chunks are sent by cpu with interrupts on, in dma order; a chunk in
+  // flight keeps others from restarting dma
+  while (len) {
+    u16_t i;
+    for (i = 0; i < len; i++) {
+      UART_tx_force_char(u, buf[i]);
+    }
+    enter_critical();
+    ref_f = UART_tx_dma_done(u, 0, FALSE, &ref_arg);
+    len = UART_tx_dma_chunk(u, &buf);
+    exit_critical();
+    if (ref_f) {
+      ref_f(ref_arg);
+    }
+  }
+#else
+  UART_RX_IRQ_OFF(u);
+  UART_tx_force_ring(u, u->tx.wix);
   UART_RX_IRQ_ON(u);
+#endif
 }
 
 s32_t UART_get_char(uart *u) {
   s32_t c = -1;
-  UART_RX_IRQ_OFF(u);
+  UART_RX_ENTER(u);
   if (u->rx.rix != u->rx.wix) {
     c = u->rx.buf[u->rx.rix];
     if (u->rx.rix >= UART_RX_BUFFER - 1) {
@@ -99,17 +512,17 @@ s32_t UART_get_char(uart *u) {
       u->rx.rix++;
     }
   }
-  UART_RX_IRQ_ON(u);
+  UART_RX_EXIT(u);
   return c;
 }
 
 s32_t UART_get_buf(uart *u, u8_t* dst, u16_t len) {
 
-  UART_RX_IRQ_OFF(u);
+  UART_RX_ENTER(u);
   u16_t avail = UART_rx_available(u);
   s32_t len_to_read = MIN(avail, len);
   if (len_to_read == 0) {
-    UART_RX_IRQ_ON(u);
+    UART_RX_EXIT(u);
     return 0;
   }
   u32_t remaining = len_to_read;
@@ -130,7 +543,7 @@ s32_t UART_get_buf(uart *u, u8_t* dst, u16_t len) {
     u->rx.rix = 0;
   }
 
-  UART_RX_IRQ_ON(u);
+  UART_RX_EXIT(u);
   return len_to_read;
 }
 
@@ -152,7 +565,7 @@ s32_t UART_put_char(uart *u, u8_t c) {
       } else {
         res = -1;
       }
-      UART_TX_IRQ_ON(u);
+      UART_TX_START(u);
     } while (u->assure_tx && res != 0 && --max_tries > 0);
     return res;
   }
@@ -195,10 +608,10 @@ s32_t UART_put_buf(uart *u, u8_t* c, u16_t len) {
       memcpy(&u->tx.buf[u->tx.wix], c, remaining);
       c += remaining;
       u->tx.wix += remaining;
-      if (u->tx.wix >= UART_RX_BUFFER) {
+      if (u->tx.wix >= UART_TX_BUFFER) {
         u->tx.wix = 0;
       }
-      UART_TX_IRQ_ON(u);
+      UART_TX_START(u);
       written += len_to_write;
     } while (u->assure_tx && written < len && guard < 0xff);
 
@@ -271,12 +684,35 @@ bool UART_config(uart *uart, u32_t baud, UART_databits databits,
     // Enable USART interrupts
     USART_ITConfig(UART_HW(uart), USART_IT_TC, DISABLE);
     USART_ITConfig(UART_HW(uart), USART_IT_TXE, DISABLE);
+#ifdef CONFIG_UART_DMA_RX
+    UART_rx_dma_start(uart);
+    USART_ITConfig(UART_HW(uart), USART_IT_IDLE, ENABLE);
+#else
     USART_ITConfig(UART_HW(uart), USART_IT_RXNE, ENABLE);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+    UART_tx_dma_start(uart);
+#endif
     USART_Cmd(UART_HW(uart), ENABLE);
   } else {
     USART_ITConfig(UART_HW(uart), USART_IT_TC, DISABLE);
     USART_ITConfig(UART_HW(uart), USART_IT_TXE, DISABLE);
+#ifdef CONFIG_UART_DMA_RX
+    USART_ITConfig(UART_HW(uart), USART_IT_IDLE, DISABLE);
+    UART_rx_dma_stop(uart);
+#else
     USART_ITConfig(UART_HW(uart), USART_IT_RXNE, DISABLE);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+    void *ref_arg = NULL;
+    enter_critical();
+    uart_tx_ref_callback ref_f = UART_tx_dma_stop(uart, &ref_arg);
+    exit_critical();
+    USART_DMACmd(UART_HW(uart), USART_DMAReq_Tx, DISABLE);
+    if (ref_f) {
+      ref_f(ref_arg);
+    }
+#endif
     USART_Cmd(UART_HW(uart), DISABLE);
   }
   return TRUE;
@@ -289,24 +725,48 @@ void UART_init() {
 
 #ifdef CONFIG_UART1
   _UART(uc++)->hw = USART1;
+#ifdef CONFIG_UART_DMA_RX
+  UART_rx_dma_define(_UART(uc-1), UART1_RX_DMA);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+  UART_tx_dma_define(_UART(uc-1), UART1_TX_DMA);
+#endif
   UART_config(_UART(uc-1), UART1_SPEED, UART_CFG_DATABITS_8, UART_CFG_STOPBITS_1,
       UART_CFG_PARITY_NONE, UART_CFG_FLOWCONTROL_NONE, TRUE);
   UART_TX_IRQ_OFF(_UART(uc-1));
 #endif
 #ifdef CONFIG_UART2
   _UART(uc++)->hw = USART2;
+#ifdef CONFIG_UART_DMA_RX
+  UART_rx_dma_define(_UART(uc-1), UART2_RX_DMA);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+  UART_tx_dma_define(_UART(uc-1), UART2_TX_DMA);
+#endif
   UART_config(_UART(uc-1), UART2_SPEED, UART_CFG_DATABITS_8, UART_CFG_STOPBITS_1,
       UART_CFG_PARITY_NONE, UART_CFG_FLOWCONTROL_NONE, TRUE);
   UART_TX_IRQ_OFF(_UART(uc-1));
 #endif
 #ifdef CONFIG_UART3
   _UART(uc++)->hw = USART3;
+#ifdef CONFIG_UART_DMA_RX
+  UART_rx_dma_define(_UART(uc-1), UART3_RX_DMA);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+  UART_tx_dma_define(_UART(uc-1), UART3_TX_DMA);
+#endif
   UART_config(_UART(uc-1), UART3_SPEED, UART_CFG_DATABITS_8, UART_CFG_STOPBITS_1,
       UART_CFG_PARITY_NONE, UART_CFG_FLOWCONTROL_NONE, TRUE);
   UART_TX_IRQ_OFF(_UART(uc-1));
 #endif
 #ifdef CONFIG_UART4
   _UART(uc++)->hw = UART4;
+#ifdef CONFIG_UART_DMA_RX
+  UART_rx_dma_define(_UART(uc-1), UART4_RX_DMA);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+  UART_tx_dma_define(_UART(uc-1), UART4_TX_DMA);
+#endif
   UART_config(_UART(uc-1), UART4_SPEED, UART_CFG_DATABITS_8, UART_CFG_STOPBITS_1,
       UART_CFG_PARITY_NONE, UART_CFG_FLOWCONTROL_NONE, TRUE);
   UART_TX_IRQ_OFF(_UART(uc-1));
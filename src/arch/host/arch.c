@@ -0,0 +1,360 @@
+#include "arch.h"
+#include "system.h"
+#ifdef CONFIG_SYS_TICKLESS
+#include "gen_timer.h"
+#endif
+#ifdef CONFIG_TASK_QUEUE
+#include "taskq.h"
+#endif
+#ifdef CONFIG_OS
+#include "os.h"
+#endif
+#include <stdlib.h>
+#include <time.h>
+#ifdef CONFIG_ARCH_HOST_SMP
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * Host variant of arch.c, POSIX
+ */
+
+// main timer ticks per ms
+#define HOST_TICKS_PER_MS     (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ)
+
+#ifdef CONFIG_ARCH_HOST_SMP
+#ifdef CONFIG_OS
+#error "CONFIG_ARCH_HOST_SMP is not supported with CONFIG_OS"
+#endif
+// critical nesting of each host thread, the lock being shared by all
+static __thread u32_t g_crit_entry = 0;
+static volatile u32_t g_crit_lock = 0;
+// event counter and wait for arch_host_wfe/arch_host_sev
+static volatile u32_t g_event = 0;
+static pthread_mutex_t g_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_event_cond = PTHREAD_COND_INITIALIZER;
+// spins before yielding the host cpu, as lock holder may be preempted
+#define HOST_SMP_SPINS        64
+#else
+static volatile u32_t g_crit_entry = 0;
+#endif
+// busy waited time not yet advanced, in 1/1000000 main timer ticks
+static u64_t g_busywait_frac = 0;
+// host time in outermost critical sections, see arch_host_crit_timing
+static bool g_crit_timing = FALSE;
+static u64_t g_crit_t0_ns = 0;
+static u64_t g_crit_ns = 0;
+static u32_t g_crit_sections = 0;
+
+static u64_t __host_mono_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#ifdef CONFIG_SYS_TICKLESS
+#ifdef CONFIG_ARCH_HOST_REALTIME
+#error "CONFIG_SYS_TICKLESS is not supported with CONFIG_ARCH_HOST_REALTIME"
+#endif
+// Simulated hardware for tickless idle: a true time, a main timer tick
+// which may be suspended, and a generic timer counting at
+// CONFIG_SYS_TICKLESS_TIMER_FREQ from true time. The system clock follows
+// true time while ticking, and is compensated by SYS_idle otherwise.
+static struct {
+  // true time in ns
+  u64_t now_ns;
+  bool tick_suspended;
+  // generic timer counter restarts at count start, overflowing at period.
+  // The prescaler is free running, so counts are whole counts since epoch.
+  gen_tim *tim;
+  u64_t start;
+  u32_t period;
+} g_hw;
+
+#define HOST_NS_PER_TICK      (1000000000ULL / SYS_MAIN_TIMER_FREQ)
+
+// Returns generic timer counts since epoch at given true time.
+static u64_t __host_timer_count(u64_t ns) {
+  return (ns * CONFIG_SYS_TICKLESS_TIMER_FREQ) / 1000000000ULL;
+}
+
+// Returns true time in ns when generic timer counter reaches given count.
+static u64_t __host_timer_ns(u32_t count) {
+  return ((g_hw.start + count) * 1000000000ULL + CONFIG_SYS_TICKLESS_TIMER_FREQ - 1) /
+      CONFIG_SYS_TICKLESS_TIMER_FREQ;
+}
+
+u32_t timer_hal_get_current(gen_tim *tim) {
+  return (u32_t)(__host_timer_count(g_hw.now_ns) - g_hw.start);
+}
+
+void timer_hal_set_period(gen_tim *tim, u32_t ticks) {
+  // counter restarts, as the count so far is accounted by gen_timer
+  g_hw.tim = tim;
+  g_hw.start = __host_timer_count(g_hw.now_ns);
+  g_hw.period = ticks;
+}
+
+__attribute__ (( weak )) void timer_fire_event(gen_tim *tim) {
+}
+
+void SYS_hal_tick_suspend(void) {
+  g_hw.tick_suspended = TRUE;
+}
+
+void SYS_hal_tick_resume(void) {
+  g_hw.tick_suspended = FALSE;
+  // timers expired while suspended, as pending tick irq would
+  arch_host_timer_irq();
+}
+
+u64_t arch_host_true_time_ns(void) {
+  return g_hw.now_ns;
+}
+
+// Advances true time, taking generic timer overflow irqs on the way.
+static void __host_hw_advance(u64_t until_ns) {
+  while (g_hw.tim && __host_timer_ns(g_hw.period) <= until_ns) {
+    // counter wraps, overflow irq may set a new period
+    g_hw.now_ns = __host_timer_ns(g_hw.period);
+    g_hw.start += g_hw.period;
+    timer_hal_cb_overflow(g_hw.tim);
+  }
+  g_hw.now_ns = until_ns;
+}
+
+// Sleeps until generic timer overflows, the only irq while tick is
+// suspended.
+static void __host_tickless_sleep(void) {
+  ASSERT(g_hw.tim);
+  __host_hw_advance(__host_timer_ns(g_hw.period));
+}
+#endif // CONFIG_SYS_TICKLESS
+
+// Advances system clock by given main timer ticks, as the ticking timer
+// irq would.
+static void __host_tick(u32_t ticks) {
+#ifdef CONFIG_SYS_TICKLESS
+  __host_hw_advance(g_hw.now_ns + (u64_t)ticks * HOST_NS_PER_TICK);
+#endif
+  SYS_timer_advance(ticks);
+}
+
+#ifdef CONFIG_ARCH_HOST_SMP
+// Critical sections are a recursive spinlock, being what interrupt masking
+// is to a single core. Each host thread is a core.
+void enter_critical(void) {
+  if (g_crit_entry == 0) {
+    u32_t spins = 0;
+    while (__atomic_exchange_n(&g_crit_lock, 1, __ATOMIC_ACQUIRE)) {
+      while (__atomic_load_n(&g_crit_lock, __ATOMIC_RELAXED)) {
+        if (++spins >= HOST_SMP_SPINS) {
+          spins = 0;
+          sched_yield();
+        }
+      }
+    }
+  }
+  g_crit_entry++;
+  if (g_crit_entry == 1 && g_crit_timing) {
+    g_crit_t0_ns = __host_mono_ns();
+  }
+  TRACE_IRQ_OFF(g_crit_entry);
+}
+#else
+void enter_critical(void) {
+  g_crit_entry++;
+  if (g_crit_entry == 1 && g_crit_timing) {
+    g_crit_t0_ns = __host_mono_ns();
+  }
+  TRACE_IRQ_OFF(g_crit_entry);
+}
+#endif
+
+void exit_critical(void) {
+  ASSERT(g_crit_entry > 0);
+  if (g_crit_entry == 1 && g_crit_timing) {
+    // still holding the lock on smp
+    g_crit_ns += __host_mono_ns() - g_crit_t0_ns;
+    g_crit_sections++;
+  }
+  g_crit_entry--;
+  TRACE_IRQ_ON(g_crit_entry);
+#ifdef CONFIG_ARCH_HOST_SMP
+  if (g_crit_entry == 0) {
+    __atomic_store_n(&g_crit_lock, 0, __ATOMIC_RELEASE);
+  }
+#endif
+#ifdef CONFIG_OS
+  if (g_crit_entry == 0) {
+    __os_pendsv();
+  }
+#endif
+}
+
+bool within_critical(void) {
+  return g_crit_entry > 0;
+}
+
+void arch_host_crit_timing(bool on) {
+  ASSERT(g_crit_entry == 0);
+  if (on) {
+    g_crit_ns = 0;
+    g_crit_sections = 0;
+  }
+  g_crit_timing = on;
+}
+
+u64_t arch_host_crit_ns(u32_t *sections) {
+  if (sections) *sections = g_crit_sections;
+  return g_crit_ns;
+}
+
+#ifdef CONFIG_ARCH_HOST_SMP
+void *arch_host_thread_self(void) {
+  return (void *)pthread_self();
+}
+
+u32_t arch_host_events(void) {
+  return __atomic_load_n(&g_event, __ATOMIC_ACQUIRE);
+}
+
+void arch_host_wfe(u32_t seen) {
+  pthread_mutex_lock(&g_event_mutex);
+  while (__atomic_load_n(&g_event, __ATOMIC_ACQUIRE) == seen) {
+    pthread_cond_wait(&g_event_cond, &g_event_mutex);
+  }
+  pthread_mutex_unlock(&g_event_mutex);
+}
+
+void arch_host_sev(void) {
+  pthread_mutex_lock(&g_event_mutex);
+  __atomic_add_fetch(&g_event, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&g_event_cond);
+  pthread_mutex_unlock(&g_event_mutex);
+}
+#endif
+
+void arch_reset(void) {
+  exit(EXIT_SUCCESS);
+}
+
+void arch_break_if_dbg(void) {
+}
+
+void irq_disable(void) {
+}
+
+void irq_enable(void) {
+}
+
+__attribute__ (( weak )) void arch_host_timer_irq(void) {
+#ifdef CONFIG_TASK_QUEUE
+  TASK_timer();
+#endif
+#ifdef CONFIG_OS
+  OS_time_tick(SYS_get_time_ms());
+#endif
+}
+
+#ifdef CONFIG_ARCH_HOST_REALTIME
+
+static u64_t g_epoch_ns = 0;
+
+static u64_t __host_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  if (g_epoch_ns == 0) {
+    g_epoch_ns = (u64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+  return (u64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - g_epoch_ns;
+}
+
+// Catches up system clock with host time.
+static void __host_clock_sync(void) {
+  u64_t ticks = (__host_now_ns() * SYS_MAIN_TIMER_FREQ) / 1000000000ULL;
+  sys_time now = SYS_get_tick();
+  if (ticks > now) {
+    SYS_timer_advance((u32_t)(ticks - now));
+  }
+  arch_host_timer_irq();
+}
+
+static void __host_sleep_until(sys_time ms) {
+  u64_t until_ns = (u64_t)ms * 1000000ULL;
+  u64_t now_ns = __host_now_ns();
+  if (until_ns > now_ns) {
+    struct timespec ts;
+    ts.tv_sec = (until_ns - now_ns) / 1000000000ULL;
+    ts.tv_nsec = (until_ns - now_ns) % 1000000000ULL;
+    nanosleep(&ts, NULL);
+  }
+  __host_clock_sync();
+}
+
+#endif // CONFIG_ARCH_HOST_REALTIME
+
+// Idles until given ms, advancing the clock.
+static void __host_idle_until(sys_time ms) {
+#ifdef CONFIG_ARCH_HOST_REALTIME
+  __host_sleep_until(ms);
+#else
+  sys_time now = SYS_get_time_ms();
+  if (ms > now) {
+    // skip to the ms tick of wakeup, as the timer irq would wake on it
+    __host_tick((u32_t)(ms * HOST_TICKS_PER_MS - SYS_get_tick()));
+  }
+  arch_host_timer_irq();
+#endif
+}
+
+void arch_sleep(void) {
+#ifdef CONFIG_SYS_TICKLESS
+  if (g_hw.tick_suspended) {
+    __host_tickless_sleep();
+    return;
+  }
+#endif
+  // emulates sleeping until next interrupt, being next task timer or
+  // thread wakeup, or else next ms tick
+  sys_time now = SYS_get_time_ms();
+  sys_time wake = (sys_time)-1;
+#ifdef CONFIG_TASK_QUEUE
+  {
+    sys_time t;
+    if (TASK_next_wakeup_ms(&t, NULL) == 0) {
+      wake = MIN(wake, t);
+    }
+  }
+#endif
+#ifdef CONFIG_OS
+  {
+    sys_time t;
+    os_wakeup_res res = OS_get_next_wakeup(&t);
+    if (res == OS_WUP_SLEEP || res == OS_WUP_SLEEP_RUNNING) {
+      wake = MIN(wake, t);
+    }
+  }
+#endif
+  if (wake == (sys_time)-1 || wake <= now) {
+    wake = now + 1;
+  }
+  __host_idle_until(wake);
+}
+
+void arch_busywait_us(u32_t us) {
+#ifdef CONFIG_ARCH_HOST_REALTIME
+  u64_t until_ns = __host_now_ns() + (u64_t)us * 1000ULL;
+  while (__host_now_ns() < until_ns);
+  __host_clock_sync();
+#else
+  g_busywait_frac += (u64_t)us * SYS_MAIN_TIMER_FREQ;
+  u32_t ticks = (u32_t)(g_busywait_frac / 1000000ULL);
+  g_busywait_frac %= 1000000ULL;
+  if (ticks) {
+    __host_tick(ticks);
+    arch_host_timer_irq();
+  }
+#endif
+}
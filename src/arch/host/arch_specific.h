@@ -0,0 +1,90 @@
+/*
+ * arch_specific.h
+ *
+ * Host (POSIX) architecture, for running the system off target in
+ * simulations and benchmarks.
+ *
+ * There are no interrupts. The system clock is virtual and advanced only
+ * when idling in arch_sleep or busy waiting, so runs are deterministic.
+ * The clock then skips directly to next task timer or OS thread wakeup.
+ * With CONFIG_ARCH_HOST_REALTIME, the clock instead follows host monotonic
+ * time, and idling sleeps the host process.
+ * With CONFIG_ARCH_HOST_SMP, each host thread is a core running in
+ * parallel, critical sections being a spinlock shared by all cores. This
+ * is for task queue workers, see CONFIG_TASK_WORKERS, and cannot be
+ * combined with CONFIG_OS. The virtual clock must then only be advanced
+ * by one thread.
+ */
+
+#ifndef ARCH_SPECIFIC_H_
+#define ARCH_SPECIFIC_H_
+
+#include "system_config.h"
+// host libc, included ahead of miniutils renaming its functions
+#include <stdlib.h>
+#include <string.h>
+
+// nominal cpu frequency of the simulated target
+#ifndef SYS_CPU_FREQ
+#define SYS_CPU_FREQ          (72000000)
+#endif
+
+/**
+ * What the system timer interrupt does on target, called whenever the
+ * clock is advanced. Default runs TASK_timer and OS_time_tick if
+ * configured. Weak, may be overridden by application.
+ */
+void arch_host_timer_irq(void);
+
+/**
+ * Starts or stops measuring host time spent in outermost critical sections,
+ * being interrupts disabled on target. Starting resets the measurement.
+ * Must be called outside critical.
+ */
+void arch_host_crit_timing(bool on);
+/**
+ * Returns host ns spent in outermost critical sections while measuring, and
+ * their number in sections if not NULL.
+ */
+u64_t arch_host_crit_ns(u32_t *sections);
+
+#ifdef CONFIG_SYS_TICKLESS
+/**
+ * Simulated true time in ns. With CONFIG_SYS_TICKLESS, the host simulates
+ * the main timer tick being suspended and the generic timer, implementing
+ * the timer_hal and SYS_hal_tick functions. The generic timer counts from
+ * true time, and the system clock drifts from true time as much as
+ * SYS_idle fails to compensate slept time.
+ */
+u64_t arch_host_true_time_ns(void);
+#endif
+
+#ifdef CONFIG_ARCH_HOST_SMP
+/**
+ * Identifies calling host thread, i.e. the core.
+ */
+void *arch_host_thread_self(void);
+/**
+ * Returns event counter, increased by arch_host_sev. Read in critical
+ * before leaving it and waiting, so no event is missed.
+ */
+u32_t arch_host_events(void);
+/**
+ * Waits for event, as WFE. Returns when event counter differs from seen.
+ */
+void arch_host_wfe(u32_t seen);
+/**
+ * Signals event to all cores, as SEV.
+ */
+void arch_host_sev(void);
+#endif
+
+#ifdef CONFIG_OS
+/**
+ * Emulated PendSV, takes a pending context switch. Called by arch when
+ * leaving outermost critical section.
+ */
+void __os_pendsv(void);
+#endif
+
+#endif /* ARCH_SPECIFIC_H_ */
@@ -0,0 +1,200 @@
+/*
+ * Host variant of os.c, POSIX
+ *
+ * Each thread runs in a pthread, but only one context at a time - a thread
+ * or the kernel, being the context calling OS_init - holds the cpu. As on
+ * a single core target, the running context hands over the cpu on context
+ * switches. Scheduling, priority inheritance, sleep and wakeup are done by
+ * os_core.c, shared with the cortex variant.
+ *
+ * There is no time slicing. A context switch is taken when a thread
+ * blocks, sleeps or yields, or when leaving the outermost critical section
+ * after a thread of higher priority than current became ready. The
+ * kernel is lower than any thread, and is switched out as soon as any
+ * thread is ready. Along with the virtual clock, runs are deterministic.
+ *
+ * All OS calls must be made from threads or the kernel.
+ */
+
+#include "os_core.h"
+#include "miniutils.h"
+#include <pthread.h>
+
+#if OS_DBG_MON
+#error "OS_DBG_MON is not supported on ARCH_HOST"
+#endif
+
+static struct os_arch {
+  // context switch pending
+  volatile bool pending;
+} os_arch;
+
+// held by the context owning the cpu
+static pthread_mutex_t g_cpu = PTHREAD_MUTEX_INITIALIZER;
+// signalled when kernel is scheduled
+static pthread_cond_t g_kernel_run = PTHREAD_COND_INITIALIZER;
+
+// Picks next context to run and makes it current. Returns NULL for kernel.
+static os_thread *__os_switch_thread(void) {
+  os_thread *cand = __os_select_thread();
+  os_arch.pending = FALSE;
+  os.current_thread = cand;
+  return cand;
+}
+
+// Hands over the cpu to given context, NULL being kernel.
+static void __os_run(os_thread *t) {
+  pthread_cond_signal(t ? &t->_host_run : &g_kernel_run);
+}
+
+// Switches context, returns when caller is scheduled again. Must not be
+// called in critical, the critical nesting is shared by all contexts.
+static void __os_ctx_switch(void) {
+  os_thread *self = os.current_thread;
+  os_thread *cand;
+  enter_critical();
+  cand = __os_switch_thread();
+  exit_critical();
+  if (cand != self) {
+    __os_run(cand);
+    while (os.current_thread != self) {
+      pthread_cond_wait(self ? &self->_host_run : &g_kernel_run, &g_cpu);
+    }
+  }
+}
+
+// Pends a context switch, taken when leaving outermost critical section.
+static void __os_pend(void) {
+  os_arch.pending = TRUE;
+  if (!within_critical()) {
+    __os_pendsv();
+  }
+}
+
+void __os_pendsv(void) {
+  if (os_arch.pending) {
+    __os_ctx_switch();
+  }
+}
+
+//------- Core hooks -------------
+
+void __os_arch_pend(void) {
+  os_arch.pending = TRUE;
+}
+
+void __os_arch_ready(os_thread *t) {
+  // kernel is lower than any thread
+  if (os.current_thread == NULL ||
+      (os.current_thread != t && t->prio > os.current_thread->prio)) {
+    os_arch.pending = TRUE;
+  }
+}
+
+void __os_arch_update_preemption(void) {
+  // no time slicing
+}
+
+void __os_arch_woken(void) {
+  // switch is taken when leaving critical
+}
+
+#ifdef CONFIG_OS_STATS
+u32_t __os_arch_stats_now(void) {
+  // cpu time in ticks of the virtual clock
+  return (u32_t)SYS_get_tick();
+}
+#endif
+
+//------- System helpers -------------
+
+void OS_time_tick(sys_time now) {
+  // as irq, switches to woken threads on return only, when all sleepers
+  // due are ready
+  enter_critical();
+  if (__os_time_wake(now)) {
+    __os_pend();
+  }
+  exit_critical();
+}
+
+// Called with cpu held when thread function returns, hands over the cpu
+// without waiting for it back.
+static void __os_thread_death(void) {
+  os_thread *self = os.current_thread;
+  os_thread *cand;
+  enter_critical();
+  __os_thread_exit(self);
+  os.current_thread = NULL;
+  cand = __os_switch_thread();
+  exit_critical();
+  pthread_cond_destroy(&self->_host_run);
+  __os_run(cand);
+}
+
+static void *__os_thread_entry(void *arg) {
+  os_thread *t = (os_thread *)arg;
+  pthread_mutex_lock(&g_cpu);
+  while (os.current_thread != t) {
+    pthread_cond_wait(&t->_host_run, &g_cpu);
+  }
+  (void)t->func(t->_host_arg);
+  __os_thread_death();
+  pthread_mutex_unlock(&g_cpu);
+  return NULL;
+}
+
+//------- Public functions -----------
+
+u32_t OS_thread_create(os_thread *t, u32_t flags, void *(*func)(void *), void *arg, void *stack, u32_t stack_size, const char *name) {
+  pthread_attr_t attr;
+  int res;
+
+#if OS_STACK_USAGE_CHECK
+  // threads run on host stacks, scans of given stack report it unused
+  memset(stack, _STACK_USAGE_MARK, stack_size & ~3);
+#endif
+  __os_thread_init(t, flags, func, name);
+  // threads run on host stacks, given stack is only kept for reference
+  t->sp = (u8_t *)stack + stack_size;
+  t->stack_start = stack;
+  t->stack_end = (u8_t *)stack + stack_size;
+  t->sp_min = t->sp;
+#if OS_STACK_USAGE_CHECK
+  t->stack_mark = t->sp;
+#endif
+  t->_host_arg = arg;
+
+  pthread_cond_init(&t->_host_run, NULL);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  res = pthread_create(&t->_host_thread, &attr, __os_thread_entry, t);
+  pthread_attr_destroy(&attr);
+  ASSERT(res == 0);
+
+  __os_thread_start(t);
+
+  return 0;
+}
+
+u32_t OS_thread_yield(void) {
+  ASSERT(!within_critical());
+#ifdef CONFIG_OS_STATS
+  enter_critical();
+  os.yielding = TRUE;
+  exit_critical();
+#endif
+  __os_ctx_switch();
+  return os.current_thread ? os.current_thread->ret_val : 0;
+}
+
+void OS_force_ctx_switch(void) {
+  __os_pend();
+}
+
+void OS_init(void) {
+  memset(&os_arch, 0, sizeof(os_arch));
+  __os_init();
+  // calling context becomes kernel, owning the cpu
+  pthread_mutex_lock(&g_cpu);
+}
@@ -119,6 +119,62 @@ static int cli_dump(u32_t argc) {
   return CLI_OK;
 }
 
+static int cli_ctx_bench(u32_t argc) {
+#if CONFIG_OS && OS_DBG_MON
+  OS_DBG_bench_switch(IOSTD);
+#else
+  print("os debug monitor not enabled\n");
+#endif
+  return CLI_OK;
+}
+
+static int cli_task_stats(u32_t argc, char *cmd) {
+#ifdef CONFIG_TASK_STATS
+  if (argc == 1 && IS_STRING(cmd) && strcmp("reset", cmd) == 0) {
+    TASK_stats_reset();
+  } else if (argc != 0) {
+    return CLI_ERR_PARAM;
+  }
+  TASK_dump_stats(IOSTD);
+#else
+  print("task stats not enabled\n");
+#endif
+  return CLI_OK;
+}
+
+static int cli_idle(u32_t argc, char *cmd) {
+#ifdef CONFIG_SYS_TICKLESS
+  if (argc == 1 && IS_STRING(cmd) && strcmp("reset", cmd) == 0) {
+    SYS_idle_stats_reset();
+    return CLI_OK;
+  } else if (argc != 0) {
+    return CLI_ERR_PARAM;
+  }
+  sys_time idle, total;
+  u32_t sleeps;
+  SYS_idle_stats(&idle, &total, &sleeps);
+  print("idle %i of %i ticks, %i%%, %i sleeps\n",
+      (u32_t)idle, (u32_t)total, total ? (u32_t)((idle * 100) / total) : 0, sleeps);
+#else
+  print("tickless not enabled\n");
+#endif
+  return CLI_OK;
+}
+
+static int cli_top(u32_t argc, char *cmd) {
+#if defined(CONFIG_OS) && defined(CONFIG_OS_STATS)
+  if (argc == 1 && IS_STRING(cmd) && strcmp("reset", cmd) == 0) {
+    OS_stats_reset();
+  } else if (argc != 0) {
+    return CLI_ERR_PARAM;
+  }
+  OS_stats_dump(IOSTD);
+#else
+  print("os stats not enabled\n");
+#endif
+  return CLI_OK;
+}
+
 static int cli_dump_trace(u32_t argc) {
 #ifdef DBG_TRACE_MON
   SYS_dump_trace(IOSTD);
@@ -303,12 +359,15 @@ static s32_t cli_assert(u32_t argc) {
 
 CLI_MENU_START(system)
 CLI_FUNC("assert", cli_assert, "Asserts")
+CLI_FUNC("ctxbench", cli_ctx_bench, "Measure thread switch latency in cycles")
 CLI_FUNC("dbg", cli_dbg, "Set debug filter and level\n"
     "dbg (level <dbg|info|warn|fatal>) (on [x]*) (off [x]*)\n"
     "x - <sys|app|task|os|heap|comm|cli|nvs|spi|eth|fs|i2c|wifi|web|radio|all>\n"
     "ex: dbg level info off all on app sys\n")
 CLI_FUNC("dump", cli_dump, "Dump system info")
 CLI_FUNC("hardfault", cli_hardfault, "Hardfaults")
+CLI_FUNC("idle", cli_idle, "Dump tickless idle residency\n"
+    "idle (reset)")
 CLI_FUNC("memfind", cli_memfind, "Find 32 bit hex in memory\n"
     "memfind <value>")
 CLI_FUNC("memrd", cli_memrd, "Read from memory\n"
@@ -316,5 +375,9 @@ CLI_FUNC("memrd", cli_memrd, "Read from memory\n"
 CLI_FUNC("memtest", cli_memtest, "Run memory test\n"
     "memtest <addr> <len>")
 CLI_FUNC("reset", cli_reset, "Resets processor")
+CLI_FUNC("taskstats", cli_task_stats, "Dump task execution statistics\n"
+    "taskstats (reset)")
+CLI_FUNC("top", cli_top, "Dump thread cpu usage\n"
+    "top (reset)")
 CLI_FUNC("trace", cli_dump_trace, "Dump system trace")
 CLI_MENU_END
@@ -7,7 +7,7 @@
 
 #include "gen_timer.h"
 
-static inline void timer_set_period(tim, u32_t ticks) {
+static inline void timer_set_period(gen_tim *tim, u32_t ticks) {
   timer_hal_set_period(tim, ticks);
   tim->timer_period = ticks;
 }
@@ -40,7 +40,7 @@ void timer_set_wakeup(gen_tim *tim, tick ticks) {
     tim->next_wakeup_tick = ticks;
     timer_decide_next_period(tim);
   } else {
-    TIM_ASSERT(0);
+    ASSERT(FALSE);
   }
 }
 
@@ -78,8 +78,7 @@ void timer_hal_cb_overflow(gen_tim *tim) {
   if (tim->next_wakeup_tick == 0) {
     timer_set_period(tim, TIMER_MAX_TICKS);
   } else {
-    tim->wakeup_ticks_left -= tim->timer_period;
-    if (tim->wakeup_ticks_left == 0) {
+    if (tim->cur_tick >= tim->next_wakeup_tick) {
       timer_set_period(tim, TIMER_MAX_TICKS);
       tim->next_wakeup_tick = 0;
       timer_fire_event(tim);
@@ -44,7 +44,6 @@ typedef TIMER_TICK_TYPE tick;
 #endif // TIMER_CALC_CURRENT_TICK
 
 typedef struct {
-  tick wakeup_ticks_left;
   u32_t timer_period;
   volatile tick cur_tick;
   tick next_wakeup_tick;
@@ -59,6 +58,8 @@ tick timer_wakeup_time(gen_tim *tim);
 // implement these
 u32_t timer_hal_get_current(gen_tim *tim);
 void timer_hal_set_period(gen_tim *tim, u32_t ticks);
+// called from timer_hal_cb_overflow when wakeup time is reached
+void timer_fire_event(gen_tim *tim);
 
 // call this from timer overflow irq
 void timer_hal_cb_overflow(gen_tim *tim);
@@ -14,11 +14,14 @@
 #ifdef CONFIG_USB_VCD
 #include "usb_serial.h"
 #endif
+#ifdef CONFIG_SPI_FLASH_LOG
+#include "spi_flash_log.h"
+#endif
 
 
 typedef struct {
   io_media media;
-  u32_t media_id;
+  uintptr_t media_id;
   io_rx_cb cb;
   void *cb_arg;
 } io_bus_def;
@@ -47,7 +50,11 @@ static void io_usb_cb(u16_t available, void *arg) {
 bool IO_assure_tx(u8_t io, bool on) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_assure_tx(_UART(io_bus[io].media_id), on);
+#else
+    return FALSE;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_assure_tx(on);
@@ -65,7 +72,11 @@ bool IO_assure_tx(u8_t io, bool on) {
 bool IO_blocking_tx(u8_t io, bool on) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_sync_tx(_UART(io_bus[io].media_id), on);
+#else
+    return FALSE;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_assure_tx(on);
@@ -89,7 +100,9 @@ void IO_set_callback(u8_t io, io_rx_cb cb, void *arg) {
 
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     UART_set_callback(_UART(io_bus[io].media_id), cb ? io_uart_cb : (void*)NULL, (void*)(u32_t)io);
+#endif
     break;
 #ifdef CONFIG_USB_VCD
   case io_usb:
@@ -113,21 +126,30 @@ s32_t IO_get_char(u8_t io) {
   s32_t res;
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_get_char(_UART(io_bus[io].media_id));
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     res = USB_SER_rx_char(&c);
     return res ? res : c;
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    res = SFL_read((spi_flash_log *)io_bus[io].media_id, &c, 1);
+    return res == 1 ? c : -1;
+#else
     return -1;
+#endif
   case io_ringbuffer:
     res = ringbuf_getc((ringbuf *)io_bus[io].media_id, &c);
     return res ? res : c;
   case io_memory: {
     u8_t *p = (u8_t *)io_bus[io].media_id;
     c = *p++;
-    io_bus[io].media_id = (u32_t)p;
+    io_bus[io].media_id = (uintptr_t)p;
     return c;
   }
   }
@@ -138,19 +160,27 @@ s32_t IO_get_char(u8_t io) {
 s32_t IO_get_buf(u8_t io, u8_t *buf, u16_t len) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_get_buf(_UART(io_bus[io].media_id), buf, len);
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_rx_buf(buf, len);
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_read((spi_flash_log *)io_bus[io].media_id, buf, len);
+#else
     return -1;
+#endif
   case io_ringbuffer:
     return ringbuf_get((ringbuf *)io_bus[io].media_id, buf, len);
   case io_memory: {
     u8_t *p = (u8_t *)io_bus[io].media_id;
     memcpy(buf, p, len);
-    io_bus[io].media_id = (u32_t)p + len;
+    io_bus[io].media_id = (uintptr_t)p + len;
     return len;
   }
   }
@@ -160,19 +190,27 @@ s32_t IO_get_buf(u8_t io, u8_t *buf, u16_t len) {
 s32_t IO_put_char(u8_t io, u8_t c) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_put_char(_UART(io_bus[io].media_id), c);
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_tx_char(c);
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_write((spi_flash_log *)io_bus[io].media_id, &c, 1) == 1 ? 0 : -1;
+#else
     return -1;
+#endif
   case io_ringbuffer:
     return ringbuf_putc((ringbuf *)io_bus[io].media_id, c);
   case io_memory: {
     u8_t *p = (u8_t *)io_bus[io].media_id;
     *p++ = c;
-    io_bus[io].media_id = (u32_t)p;
+    io_bus[io].media_id = (uintptr_t)p;
     return c;
   }
   }
@@ -182,7 +220,9 @@ s32_t IO_put_char(u8_t io, u8_t c) {
 void IO_tx_force_char(u8_t io, u8_t c) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     UART_tx_force_char(_UART(io_bus[io].media_id), c);
+#endif
     break;
 #ifdef CONFIG_USB_VCD
   case io_usb:
@@ -190,6 +230,9 @@ void IO_tx_force_char(u8_t io, u8_t c) {
     break;
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    SFL_write((spi_flash_log *)io_bus[io].media_id, &c, 1);
+#endif
     break;
   case io_ringbuffer:
     ringbuf_putc((ringbuf *)io_bus[io].media_id, c);
@@ -197,7 +240,7 @@ void IO_tx_force_char(u8_t io, u8_t c) {
   case io_memory: {
     u8_t *p = (u8_t *)io_bus[io].media_id;
     *p++ = c;
-    io_bus[io].media_id = (u32_t)p;
+    io_bus[io].media_id = (uintptr_t)p;
     break;
   }
   }
@@ -207,7 +250,9 @@ void IO_tx_force_char(u8_t io, u8_t c) {
 void IO_tx_drain(u8_t io) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     UART_tx_drain(_UART(io_bus[io].media_id));
+#endif
     break;
 #ifdef CONFIG_USB_VCD
   case io_usb:
@@ -215,6 +260,9 @@ void IO_tx_drain(u8_t io) {
     break;
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    SFL_drain((spi_flash_log *)io_bus[io].media_id);
+#endif
     break;
   case io_ringbuffer:
     ringbuf_clear((ringbuf *)io_bus[io].media_id);
@@ -229,7 +277,9 @@ void IO_tx_drain(u8_t io) {
 void IO_tx_flush(u8_t io) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     UART_tx_flush(_UART(io_bus[io].media_id));
+#endif
     break;
 #ifdef CONFIG_USB_VCD
   case io_usb:
@@ -237,6 +287,10 @@ void IO_tx_flush(u8_t io) {
     break;
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    SFL_flush((spi_flash_log *)io_bus[io].media_id);
+#endif
+    break;
   case io_ringbuffer:
   case io_memory:
     break;
@@ -247,35 +301,175 @@ void IO_tx_flush(u8_t io) {
 s32_t IO_put_buf(u8_t io, u8_t *buf, u16_t len) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_put_buf(_UART(io_bus[io].media_id), buf, len);
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_tx_buf(buf, len);
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_write((spi_flash_log *)io_bus[io].media_id, buf, len);
+#else
     return -1;
+#endif
   case io_ringbuffer:
     return ringbuf_put((ringbuf *)io_bus[io].media_id, buf, len);
   case io_memory: {
     u8_t *p = (u8_t *)io_bus[io].media_id;
     memcpy(p, buf, len);
-    io_bus[io].media_id = (u32_t)p + len;
+    io_bus[io].media_id = (uintptr_t)p + len;
     return len;
   }
   }
   return -1;
 }
 
+s32_t IO_put_iov(u8_t io, const io_iov *iov, u8_t iovcnt) {
+  u8_t i;
+  s32_t sent = 0;
+  switch (io_bus[io].media) {
+  case io_uart:
+#ifdef CONFIG_UART
+    for (i = 0; i < iovcnt; i++) {
+      s32_t res = UART_put_buf(_UART(io_bus[io].media_id), iov[i].buf, iov[i].len);
+      if (res < 0) return sent > 0 ? sent : res;
+      sent += res;
+      if (res < iov[i].len) break;
+    }
+    return sent;
+#else
+    return -1;
+#endif
+#ifdef CONFIG_USB_VCD
+  case io_usb:
+    for (i = 0; i < iovcnt; i++) {
+      s32_t res = USB_SER_tx_buf(iov[i].buf, iov[i].len);
+      if (res < 0) return sent > 0 ? sent : res;
+      sent += res;
+      if (res < iov[i].len) break;
+    }
+    return sent;
+#endif
+  case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    for (i = 0; i < iovcnt; i++) {
+      s32_t res = SFL_write((spi_flash_log *)io_bus[io].media_id, iov[i].buf, iov[i].len);
+      sent += res;
+      if (res < iov[i].len) break;
+    }
+    return sent;
+#else
+    return -1;
+#endif
+  case io_ringbuffer: {
+    ringbuf *rb = (ringbuf *)io_bus[io].media_id;
+    for (i = 0; i < iovcnt; i++) {
+      sent += iov[i].len;
+    }
+    // all or nothing, no other writer may take the space in between
+    enter_critical();
+    if (sent > ringbuf_free(rb)) {
+      exit_critical();
+      return RB_ERR_FULL;
+    }
+    for (i = 0; i < iovcnt; i++) {
+      if (iov[i].len) {
+        ringbuf_put(rb, iov[i].buf, iov[i].len);
+      }
+    }
+    exit_critical();
+    return sent;
+  }
+  case io_memory: {
+    u8_t *p = (u8_t *)io_bus[io].media_id;
+    for (i = 0; i < iovcnt; i++) {
+      memcpy(p, iov[i].buf, iov[i].len);
+      p += iov[i].len;
+    }
+    sent = p - (u8_t *)io_bus[io].media_id;
+    io_bus[io].media_id = (uintptr_t)p;
+    return sent;
+  }
+  }
+  return -1;
+}
+
+s32_t IO_peek_linear(u8_t io, u8_t **ptr) {
+  switch (io_bus[io].media) {
+  case io_uart:
+#ifdef CONFIG_UART
+    return UART_rx_peek_linear(_UART(io_bus[io].media_id), ptr);
+#else
+    return -1;
+#endif
+#ifdef CONFIG_USB_VCD
+  case io_usb:
+    return USB_SER_rx_peek_linear(ptr);
+#endif
+  case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_peek_linear((spi_flash_log *)io_bus[io].media_id, ptr);
+#else
+    return -1;
+#endif
+  case io_ringbuffer:
+    return ringbuf_available_linear((ringbuf *)io_bus[io].media_id, ptr);
+  case io_memory:
+    *ptr = (u8_t *)io_bus[io].media_id;
+    return 0xffff;
+  }
+  return -1;
+}
+
+s32_t IO_consume(u8_t io, u16_t len) {
+  switch (io_bus[io].media) {
+  case io_uart:
+#ifdef CONFIG_UART
+    return UART_get_buf(_UART(io_bus[io].media_id), NULL, len);
+#else
+    return -1;
+#endif
+#ifdef CONFIG_USB_VCD
+  case io_usb:
+    return USB_SER_rx_consume(len);
+#endif
+  case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_consume((spi_flash_log *)io_bus[io].media_id, len);
+#else
+    return -1;
+#endif
+  case io_ringbuffer:
+    return ringbuf_get((ringbuf *)io_bus[io].media_id, NULL, len);
+  case io_memory:
+    io_bus[io].media_id += len;
+    return len;
+  }
+  return -1;
+}
+
 s32_t IO_rx_available(u8_t io) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_rx_available(_UART(io_bus[io].media_id));
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return USB_SER_rx_avail();
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_rx_available((spi_flash_log *)io_bus[io].media_id);
+#else
     return -1;
+#endif
   case io_ringbuffer:
     return ringbuf_available((ringbuf *)io_bus[io].media_id);
   case io_memory:
@@ -287,13 +481,21 @@ s32_t IO_rx_available(u8_t io) {
 s32_t IO_tx_available(u8_t io) {
   switch (io_bus[io].media) {
   case io_uart:
+#ifdef CONFIG_UART
     return UART_tx_available(_UART(io_bus[io].media_id));
+#else
+    return -1;
+#endif
 #ifdef CONFIG_USB_VCD
   case io_usb:
     return 8; // TODO PETER
 #endif
   case io_file:
+#ifdef CONFIG_SPI_FLASH_LOG
+    return SFL_tx_available((spi_flash_log *)io_bus[io].media_id);
+#else
     return -1;
+#endif
   case io_ringbuffer:
     return ringbuf_free((ringbuf *)io_bus[io].media_id);
   case io_memory:
@@ -302,7 +504,7 @@ s32_t IO_tx_available(u8_t io) {
   return -1;
 }
 
-void IO_define(u8_t io, io_media media, u32_t id) {
+void IO_define(u8_t io, io_media media, uintptr_t id) {
   io_bus[io].media = media;
   io_bus[io].media_id = id;
 }
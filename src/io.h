@@ -28,6 +28,12 @@ typedef enum {
 
 typedef void(*io_rx_cb)(u8_t io, void *arg, u16_t available);
 
+// one part of a vectored write
+typedef struct {
+  u8_t *buf;
+  u16_t len;
+} io_iov;
+
 #ifndef CONFIG_IO_MAX
 #define CONFIG_IO_MAX 4
 #endif
@@ -46,7 +52,9 @@ bool IO_assure_tx(u8_t io, bool on);
 #else
 bool IO_blocking_tx(u8_t io, bool on);
 #endif
-// Set rx callback, set NULL if no callback is wanted
+// Set rx callback, set NULL if no callback is wanted. The callback gets
+// the number of bytes available, which may be more than one, e.g. a whole
+// uart dma burst; read them all by IO_get_buf in chunks.
 void IO_set_callback(u8_t io, io_rx_cb cb, void *arg);
 // Get rx callback
 void IO_get_callback(u8_t io, io_rx_cb *cb, void **arg);
@@ -72,12 +80,27 @@ void IO_tx_flush(u8_t io);
 #endif
 // sends a buffer to io
 s32_t IO_put_buf(u8_t io, u8_t *buf, u16_t len);
+// sends given buffers in order to io, as if by one IO_put_buf on the
+// concatenated data but without assembling it. Returns total number of bytes
+// sent. On ringbuffer, nothing is sent unless all fits, checked and written
+// in one critical section.
+s32_t IO_put_iov(u8_t io, const io_iov *iov, u8_t iovcnt);
+// returns number of unread bytes that can be read linearly from io without
+// copying and sets ptr to first byte, without consuming them. Data in a
+// wrapped rx buffer needs a second peek after IO_consume. Memory has no
+// bounds, it returns 0xffff, the most one IO_consume can take; the caller
+// knows how much it has put there.
+s32_t IO_peek_linear(u8_t io, u8_t **ptr);
+// discards given number of unread bytes from io, e.g. after IO_peek_linear
+s32_t IO_consume(u8_t io, u16_t len);
 // returns number of unread bytes from io rx buffer
 s32_t IO_rx_available(u8_t io);
 // returns number of free bytes in io tx buffer
 s32_t IO_tx_available(u8_t io);
 
-void IO_define(u8_t io, io_media media, u32_t id);
+// defines io on given media, id being uart index, ringbuf pointer, memory
+// pointer or, for io_file, spi_flash_log pointer
+void IO_define(u8_t io, io_media media, uintptr_t id);
 
 #else
 
@@ -178,3 +178,121 @@ void list_move_all_first(list_t* l_dst, list_t* l_src) {
   l_src->last_element = NULL;
 }
 
+
+void heap_init(heap_t* h) {
+  h->root = NULL;
+  h->length = 0;
+}
+
+// Links two heap roots, making the one with higher order first child
+// of the other. Returns new root.
+static element_t* heap_link(element_t* a, element_t* b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+  if (list_get_order(b) < list_get_order(a)) {
+    element_t* t = a;
+    a = b;
+    b = t;
+  }
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL) {
+    a->child->prev = b;
+  }
+  a->child = b;
+  return a;
+}
+
+// Merges siblings starting with e in two passes, pairing left to right
+// and then linking pairs right to left. Returns new root.
+static element_t* heap_merge_pairs(element_t* e) {
+  element_t* pairs = NULL;
+  while (e != NULL) {
+    element_t* a = e;
+    element_t* b = e->next;
+    e = b ? b->next : NULL;
+    a->next = a->prev = NULL;
+    if (b != NULL) {
+      b->next = b->prev = NULL;
+      a = heap_link(a, b);
+    }
+    // stack pairs using next
+    a->next = pairs;
+    pairs = a;
+  }
+  element_t* root = NULL;
+  while (pairs != NULL) {
+    element_t* n = pairs->next;
+    pairs->next = NULL;
+    root = heap_link(root, pairs);
+    pairs = n;
+  }
+  return root;
+}
+
+void heap_insert(heap_t* h, void* ve) {
+  LIST_ASSERT(ve != NULL);
+  element_t* e = (element_t*) ve;
+  e->next = NULL;
+  e->prev = NULL;
+  e->child = NULL;
+  h->root = heap_link(h->root, e);
+  h->length++;
+}
+
+void heap_delete(heap_t* h, void* ve) {
+  LIST_ASSERT(ve != NULL);
+  LIST_ASSERT(h->length > 0);
+  element_t* e = (element_t*) ve;
+  if (e == h->root) {
+    h->root = heap_merge_pairs(e->child);
+  } else {
+    // cut out subtree
+    if (e->prev->child == e) {
+      e->prev->child = e->next;
+    } else {
+      e->prev->next = e->next;
+    }
+    if (e->next != NULL) {
+      e->next->prev = e->prev;
+    }
+    h->root = heap_link(h->root, heap_merge_pairs(e->child));
+  }
+  e->next = NULL;
+  e->prev = NULL;
+  e->child = NULL;
+  h->length--;
+  LIST_ASSERT((h->length == 0) == (h->root == NULL));
+}
+
+void* heap_pop(heap_t* h) {
+  element_t* e = h->root;
+  if (e != NULL) {
+    heap_delete(h, e);
+  }
+  return e;
+}
+
+void heap_update(heap_t* h, void* ve, list_sort_order order) {
+  heap_delete(h, ve);
+  list_set_order(ve, order);
+  heap_insert(h, ve);
+}
+
+void* heap_next(void* ve) {
+  element_t* e = (element_t*) ve;
+  if (e->child != NULL) {
+    return e->child;
+  }
+  while (e != NULL) {
+    if (e->next != NULL) {
+      return e->next;
+    }
+    // climb to parent, found as prev of leftmost sibling
+    while (e->prev != NULL && e->prev->child != e) {
+      e = e->prev;
+    }
+    e = e->prev;
+  }
+  return NULL;
+}
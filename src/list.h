@@ -20,6 +20,8 @@ typedef struct element_s
   struct element_s* prev;
   /* Sort order */
   list_sort_order sort_order;
+  /* Heap first child, only used when element is in a heap */
+  struct element_s* child;
 } element_t;
 
 /**
@@ -34,6 +36,19 @@ typedef struct list_s
   u32_t length;
 } list_t;
 
+/**
+ * A heap representation. Elements are ordered on sort order like
+ * list_sort_insert, but insert and delete are O(log n) amortized.
+ * In a heap, element next is right sibling, element prev is left
+ * sibling or parent if element is leftmost child.
+ */
+typedef struct heap_s
+{
+  /* The element with lowest order */
+  element_t* root;
+  u32_t length;
+} heap_t;
+
 /**
  * Checks if list is empty
  */
@@ -118,4 +133,47 @@ void list_move_all(list_t* l_dst, list_t* l_src);
  */
 void list_move_all_first(list_t* l_dst, list_t* l_src);
 
+/**
+ * Checks if heap is empty
+ */
+#define heap_is_empty(aheap) \
+  ((aheap)->root == NULL)
+/**
+ * Returns element with lowest order in heap O(1)
+ */
+#define heap_first(aheap) \
+  ((aheap)->root)
+/**
+ * Returns heap size
+ */
+#define heap_count(aheap) \
+  ((aheap)->length)
+
+/**
+ * Initializes a heap
+ */
+void heap_init(heap_t* heap);
+/**
+ * Inserts element in heap on its order O(1)
+ */
+void heap_insert(heap_t* heap, void* element);
+/**
+ * Deletes element from heap O(log n) amortized
+ */
+void heap_delete(heap_t* heap, void* element);
+/**
+ * Removes and returns element with lowest order, or NULL if empty O(log n) amortized
+ */
+void* heap_pop(heap_t* heap);
+/**
+ * Changes order of element already in heap O(log n) amortized
+ */
+void heap_update(heap_t* heap, void* element, list_sort_order order);
+/**
+ * Returns next element in heap after given element, in no particular order.
+ * Used for traversing all elements of a heap, starting from heap_first.
+ * Heap must not be modified during traversal.
+ */
+void* heap_next(void* element);
+
 #endif /*_LIST_H_*/
@@ -0,0 +1,142 @@
+/*
+ * mempool.c
+ *
+ * Fixed block memory pools.
+ */
+
+#include "mempool.h"
+#include "miniutils.h"
+
+#define MEMPOOL_ENTER(p) \
+  do { if ((p)->attrs & MEMPOOL_ATTR_IRQ_SAFE) enter_critical(); } while (0)
+#define MEMPOOL_EXIT(p) \
+  do { if ((p)->attrs & MEMPOOL_ATTR_IRQ_SAFE) exit_critical(); } while (0)
+
+void mempool_init(mempool *p, void *mem, u32_t mem_size, u16_t block_size, u8_t attrs) {
+  u32_t i;
+  ASSERT(((uintptr_t)mem & (CONFIG_MEMPOOL_ALIGN - 1)) == 0);
+  if (block_size < sizeof(void *)) {
+    block_size = sizeof(void *);
+  }
+  block_size = (block_size + CONFIG_MEMPOOL_ALIGN - 1) & ~(CONFIG_MEMPOOL_ALIGN - 1);
+  p->mem = (u8_t *)mem;
+  p->block_size = block_size;
+  p->blocks = mem_size / block_size;
+  p->attrs = attrs;
+  ASSERT(p->blocks > 0);
+  // link all blocks, first block first
+  p->free_list = NULL;
+  for (i = p->blocks; i > 0; i--) {
+    void **b = (void **)&p->mem[(i - 1) * block_size];
+    *b = p->free_list;
+    p->free_list = b;
+  }
+  p->used = 0;
+  mempool_stats_reset(p);
+}
+
+void *mempool_alloc(mempool *p) {
+  void **b;
+  MEMPOOL_ENTER(p);
+  b = (void **)p->free_list;
+  if (b) {
+    p->free_list = *b;
+    p->used++;
+    if (p->used > p->peak) {
+      p->peak = p->used;
+    }
+    p->allocs++;
+  } else {
+    p->fails++;
+  }
+  MEMPOOL_EXIT(p);
+  return b;
+}
+
+void mempool_free(mempool *p, void *b) {
+  if (b == NULL) return;
+  ASSERT(mempool_owns(p, b));
+  ASSERT(((u32_t)((u8_t *)b - p->mem) % p->block_size) == 0);
+  MEMPOOL_ENTER(p);
+  ASSERT(p->used > 0);
+  *(void **)b = p->free_list;
+  p->free_list = b;
+  p->used--;
+  MEMPOOL_EXIT(p);
+}
+
+bool mempool_owns(mempool *p, void *b) {
+  return (u8_t *)b >= p->mem && (u8_t *)b < p->mem + p->blocks * p->block_size;
+}
+
+u32_t mempool_available(mempool *p) {
+  return p->blocks - p->used;
+}
+
+void mempool_stats_reset(mempool *p) {
+  p->peak = p->used;
+  p->allocs = 0;
+  p->fails = 0;
+}
+
+void mempool_dump(u8_t io, mempool *p) {
+  ioprint(io, "pool %08x  block:%i  blocks:%i  used:%i  peak:%i  allocs:%i  fails:%i\n",
+      p->mem, p->block_size, p->blocks, p->used, p->peak, p->allocs, p->fails);
+}
+
+void mempool_group_init(mempool_group *g, mempool *pools, u8_t count) {
+  u8_t i;
+  for (i = 1; i < count; i++) {
+    ASSERT(pools[i-1].block_size <= pools[i].block_size);
+  }
+  g->pools = pools;
+  g->count = count;
+  g->req_bytes = 0;
+  g->blk_bytes = 0;
+}
+
+void *mempool_group_alloc(mempool_group *g, u32_t size) {
+  u8_t i;
+  for (i = 0; i < g->count; i++) {
+    mempool *p = &g->pools[i];
+    if (p->block_size < size) continue;
+    void *b = mempool_alloc(p);
+    if (b) {
+      g->req_bytes += size;
+      g->blk_bytes += p->block_size;
+      return b;
+    }
+  }
+  return NULL;
+}
+
+void mempool_group_stats_reset(mempool_group *g) {
+  u8_t i;
+  for (i = 0; i < g->count; i++) {
+    mempool_stats_reset(&g->pools[i]);
+  }
+  g->req_bytes = 0;
+  g->blk_bytes = 0;
+}
+
+void mempool_group_free(mempool_group *g, void *b) {
+  u8_t i;
+  if (b == NULL) return;
+  for (i = 0; i < g->count; i++) {
+    if (mempool_owns(&g->pools[i], b)) {
+      mempool_free(&g->pools[i], b);
+      return;
+    }
+  }
+  ASSERT(FALSE);
+}
+
+void mempool_group_dump(u8_t io, mempool_group *g) {
+  u8_t i;
+  for (i = 0; i < g->count; i++) {
+    mempool_dump(io, &g->pools[i]);
+  }
+  ioprint(io, "requested:%i  allocated:%i  internal fragmentation:%i%%\n",
+      g->req_bytes, g->blk_bytes,
+      g->blk_bytes ? (u32_t)(((u64_t)(g->blk_bytes - g->req_bytes) * 100) / g->blk_bytes) : 0);
+}
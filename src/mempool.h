@@ -0,0 +1,94 @@
+/*
+ * mempool.h
+ *
+ * Fixed block memory pools. A pool carves a caller provided memory area
+ * into blocks of equal size. Free blocks are kept in a list embedded in
+ * the blocks themselves, so allocation and release are O(1) and there is
+ * no external fragmentation.
+ * Pools of different block sizes can be grouped into size classes, where
+ * an allocation is served by the smallest block size fitting the request.
+ */
+
+#ifndef MEMPOOL_H_
+#define MEMPOOL_H_
+
+#include "system.h"
+
+/* Alignment of blocks, block sizes are rounded up to this. At least the
+   pointer size, as free blocks hold the free list */
+#ifndef CONFIG_MEMPOOL_ALIGN
+#ifdef ARCH_HOST
+#define CONFIG_MEMPOOL_ALIGN        8
+#else
+#define CONFIG_MEMPOOL_ALIGN        4
+#endif
+#endif
+
+/* Pool may be used from interrupts, alloc and free enter critical sections */
+#define MEMPOOL_ATTR_IRQ_SAFE       (1<<0)
+
+typedef struct mempool_s {
+  u8_t *mem;
+  void *free_list;
+  u16_t block_size;
+  u16_t blocks;
+  u8_t attrs;
+  // blocks currently allocated
+  u16_t used;
+  // high water mark of allocated blocks
+  u16_t peak;
+  // number of allocations
+  u32_t allocs;
+  // number of failed allocations
+  u32_t fails;
+} mempool;
+
+typedef struct {
+  // pools in ascending block size order
+  mempool *pools;
+  u8_t count;
+  // sum of requested bytes and of allocated block bytes, for estimating
+  // internal fragmentation
+  u32_t req_bytes;
+  u32_t blk_bytes;
+} mempool_group;
+
+/* Size of memory area needed for a pool of given number of blocks */
+#define MEMPOOL_MEM_SIZE(block_size, blocks) \
+  ((((block_size) + CONFIG_MEMPOOL_ALIGN - 1) & ~(CONFIG_MEMPOOL_ALIGN - 1)) * (blocks))
+
+/* Initiates a pool carving given memory into blocks of block_size bytes.
+   Memory must be aligned to CONFIG_MEMPOOL_ALIGN.
+   @param attrs MEMPOOL_ATTR_IRQ_SAFE or 0
+ */
+void mempool_init(mempool *p, void *mem, u32_t mem_size, u16_t block_size, u8_t attrs);
+/* Allocates a block.
+   @returns the block or NULL if pool is exhausted
+ */
+void *mempool_alloc(mempool *p);
+/* Releases a block allocated from given pool */
+void mempool_free(mempool *p, void *b);
+/* Returns whether block belongs to given pool */
+bool mempool_owns(mempool *p, void *b);
+/* Returns number of free blocks */
+u32_t mempool_available(mempool *p);
+/* Resets high water mark and counters */
+void mempool_stats_reset(mempool *p);
+void mempool_dump(u8_t io, mempool *p);
+
+/* Initiates a group of size classes from initiated pools, which must be
+   given in ascending block size order */
+void mempool_group_init(mempool_group *g, mempool *pools, u8_t count);
+/* Allocates from the smallest block size fitting size. If that pool is
+   exhausted, next larger is tried.
+   @returns the block or NULL if no pool could serve the request
+ */
+void *mempool_group_alloc(mempool_group *g, u32_t size);
+/* Releases a block allocated from given group */
+void mempool_group_free(mempool_group *g, void *b);
+/* Resets high water marks and counters of all pools and of the group.
+   Byte counters wrap after 4 GiB, so long runs reset them periodically */
+void mempool_group_stats_reset(mempool_group *g);
+void mempool_group_dump(u8_t io, mempool_group *g);
+
+#endif /* MEMPOOL_H_ */
@@ -43,7 +43,58 @@ typedef unsigned int utype_t;
 typedef signed int stype_t;
 #endif
 
+#ifdef MINIUTILS_PRINT_BUFFER
+// Formatted output to an io is staged on stack and put in chunks instead
+// of per character
+typedef struct {
+  long io;
+  int len;
+  char buf[MINIUTILS_PRINT_BUFFER];
+} print_stage;
+
+static void stage_flush(print_stage *st) {
+  if (st->len > 0) {
+    long p = st->io;
+    PUTB(p, st->buf, st->len);
+    st->len = 0;
+  }
+}
+
+static void stage_putc(print_stage *st, char c) {
+  if (st->len >= MINIUTILS_PRINT_BUFFER) {
+    stage_flush(st);
+  }
+  st->buf[st->len++] = c;
+}
+
+static void stage_putb(print_stage *st, const char *b, int l) {
+  if (l > MINIUTILS_PRINT_BUFFER - st->len) {
+    stage_flush(st);
+    if (l >= MINIUTILS_PRINT_BUFFER) {
+      // would not fit anyway, put directly
+      long p = st->io;
+      PUTB(p, b, l);
+      return;
+    }
+  }
+  memcpy(&st->buf[st->len], b, l);
+  st->len += l;
+}
+
+#define V_PUTC(p, c) \
+  do { if (st) stage_putc(st, (c)); else { PUTC(p, c); } } while (0)
+#define V_PUTB(p, b, l) \
+  do { if (st) stage_putb(st, (b), (l)); else { PUTB(p, b, l); } } while (0)
+#else
+#define V_PUTC(p, c)    PUTC(p, c)
+#define V_PUTB(p, b, l) PUTB(p, b, l)
+#endif
+
+#ifdef MINIUTILS_PRINT_BUFFER
+static void v_printf_stage(long p, const char* f, va_list arg_p, print_stage *st) {
+#else
 void v_printf(long p, const char* f, va_list arg_p) {
+#endif
   register const char* tmp_f = f;
   register const char* start_f = f;
   char c;
@@ -63,7 +114,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
       // formatting
       switch (c) {
       case '%': {
-        PUTC(p, '%');
+        V_PUTC(p, '%');
         break;
       }
       case '0':
@@ -125,7 +176,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
           flags |= ITOA_NEGATE;
         }
         u_itoa(v, &buf[0], 10, num, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
       case 'u': {
@@ -135,7 +186,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
         else
           v = va_arg(arg_p, unsigned int);
         u_itoa(v, &buf[0], 10, num, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
 #ifdef MINIUTILS_PRINT_FLOAT
@@ -150,14 +201,14 @@ void v_printf(long p, const char* f, va_list arg_p) {
         buf[c] = '.';
         int mul = 1, i;
         for (i = 0; i < fracnum; i++) mul *= 10;
-        u_itoa((int)(v * mul) - (int)(v), &buf[c+1], 10, fracnum, 0);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        u_itoa((int)(v * mul) - (int)(v) * mul, &buf[c+1], 10, fracnum, 0);
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
 #endif
       case 'p': {
         u_itoa(va_arg(arg_p, int), &buf[0], 16, sizeof(void *)*2, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
       case 'X':
@@ -171,7 +222,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
         else
           v = va_arg(arg_p, int);
         u_itoa(v, &buf[0], 16, num, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
       case 'o': {
@@ -181,7 +232,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
         else
           v = va_arg(arg_p, int);
         u_itoa(v, &buf[0], 8, num, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
       case 'b': {
@@ -191,12 +242,12 @@ void v_printf(long p, const char* f, va_list arg_p) {
         else
           v = va_arg(arg_p, int);
         u_itoa(v, &buf[0], 2, num, flags);
-        PUTB(p, &buf[0], strlen(&buf[0]));
+        V_PUTB(p, &buf[0], strlen(&buf[0]));
         break;
       }
       case 'c': {
         int d = va_arg(arg_p, int);
-        PUTC(p, d);
+        V_PUTC(p, d);
         break;
       }
       case 's': {
@@ -204,17 +255,17 @@ void v_printf(long p, const char* f, va_list arg_p) {
         int s_len = strlen(s);
         if (s_len < num && !num_neg) {
           int i;
-          for (i = 0; i < num-s_len; i++) PUTC(p, ' ');
+          for (i = 0; i < num-s_len; i++) V_PUTC(p, ' ');
         }
-        PUTB(p, s, s_len);
+        V_PUTB(p, s, s_len);
         if (s_len < num && num_neg) {
           int i;
-          for (i = 0; i < num-s_len; i++) PUTC(p, ' ');
+          for (i = 0; i < num-s_len; i++) V_PUTC(p, ' ');
         }
         break;
       }
       default:
-        PUTC(p, '?');
+        V_PUTC(p, '?');
         break;
       }
       start_f = tmp_f;
@@ -223,7 +274,7 @@ void v_printf(long p, const char* f, va_list arg_p) {
       // not formatting
       if (c == '%') {
         if (tmp_f > start_f + 1) {
-          PUTB(p, start_f, (int)(tmp_f - start_f - 1));
+          V_PUTB(p, start_f, (int)(tmp_f - start_f - 1));
         }
         num = 0;
         num_neg = FALSE;
@@ -240,14 +291,30 @@ void v_printf(long p, const char* f, va_list arg_p) {
     }
   } // while string
   if (tmp_f > start_f + 1) {
-    PUTB(p, start_f, (int)(tmp_f - start_f - 1));
+    V_PUTB(p, start_f, (int)(tmp_f - start_f - 1));
   }
 }
 
+#ifdef MINIUTILS_PRINT_BUFFER
+void v_printf(long p, const char* f, va_list arg_p) {
+  v_printf_stage(p, f, arg_p, NULL);
+}
+
+static void v_ioprint(int io, const char* f, va_list arg_p) {
+  print_stage st;
+  st.io = io;
+  st.len = 0;
+  v_printf_stage(io, f, arg_p, &st);
+  stage_flush(&st);
+}
+#else
+#define v_ioprint(io, f, arg_p) v_printf((io), (f), (arg_p))
+#endif
+
 void ioprint(int io, const char* f, ...) {
   va_list arg_p;
   va_start(arg_p, f);
-  v_printf(io, f, arg_p);
+  v_ioprint(io, f, arg_p);
   va_end(arg_p);
 }
 
@@ -255,7 +322,7 @@ void ioprint(int io, const char* f, ...) {
 void print(const char* f, ...) {
   va_list arg_p;
   va_start(arg_p, f);
-  v_printf(IOSTD, f, arg_p);
+  v_ioprint(IOSTD, f, arg_p);
   va_end(arg_p);
 }
 #endif
@@ -279,11 +346,11 @@ void printbuf(u8_t io, u8_t *buf, u16_t len) {
 }
 
 void vprint(const char* f, va_list arg_p) {
-  v_printf(IOSTD, f, arg_p);
+  v_ioprint(IOSTD, f, arg_p);
 }
 
 void vioprint(int io, const char* f, va_list arg_p) {
-  v_printf(io, f, arg_p);
+  v_ioprint(io, f, arg_p);
 }
 
 void sprint(char *s, const char* f, ...) {
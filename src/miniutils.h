@@ -12,6 +12,23 @@
 #include "miniutils_config.h"
 #include "system.h"
 
+#ifdef ARCH_HOST
+// host libc has functions of same names but other signatures, keep these
+// apart. Host libc headers must be included before this header.
+#define itoa      mu_itoa
+#define atoi      mu_atoi
+#define strlen    mu_strlen
+#define strnlen   mu_strnlen
+#define strcmp    mu_strcmp
+#define strncmp   mu_strncmp
+#define strncpy   mu_strncpy
+#define strcpy    mu_strcpy
+#define strchr    mu_strchr
+#define strpbrk   mu_strpbrk
+#define strstr    mu_strstr
+#define rand      mu_rand
+#endif
+
 #ifdef USE_COLOR_CODING
 #define TEXT_GOOD(s) "\033[1;32m"s"\033[m"
 #define TEXT_BAD(s) "\033[1;35m"s"\033[m"
@@ -21,6 +21,9 @@
 #define MINIUTILS_PRINT_LONGLONG
 // enabel base64 encoding/decoding
 #define MINIUTILS_BASE64
+// format into a stack buffer of this size in print/ioprint and put it in
+// chunks by PUTB instead of calling PUTC per character
+#define MINIUTILS_PRINT_BUFFER  32
 
 #define PUTC(p, c)  \
   if ((int)(p) == STDOUT) \
@@ -10,10 +10,18 @@
 
 #include "system.h"
 #include "list.h"
+#ifdef ARCH_HOST
+#include <pthread.h>
+#endif
 
 // do not modify without altering asm code in os.c
 #define OS_THREAD_FLAG_PRIVILEGED   (1<<2)
 
+// Thread priorities range 0..255, higher being more urgent. Threads
+// of higher priority always preempt threads of lower priority. Threads
+// of same priority are round-robin scheduled.
+#define OS_THREAD_PRIO_DEFAULT      128
+
 typedef enum os_type_e {
   OS_THREAD = 0,
   OS_COND
@@ -24,18 +32,51 @@ typedef struct os_object_t {
   os_type type;
 } os_object;
 
+struct os_mutex_t;
+
+#ifdef CONFIG_OS_STATS
+// number of one second load windows averaged by the 10s load
+#ifndef OS_STATS_HISTORY
+#define OS_STATS_HISTORY            10
+#endif
+#endif
+
 typedef struct os_thread_t {
   os_object this;
   u32_t id;
-  u8_t prio;
+  u8_t prio; // effective priority, may be inherited
+  u8_t base_prio; // assigned priority
+  struct os_mutex_t *wait_mutex; // mutex blocking this thread
+  struct os_mutex_t *held; // mutexes held by this thread
   void * sp; // The current stack pointer
   u32_t flags; // Status flags
   list_t q_join;
   void * stack_start;
   void * stack_end;
+  void * sp_min; // lowest stack pointer sampled on context switches
+#if OS_STACK_USAGE_CHECK
+  void * stack_mark; // lowest stack address found used by scans
+#endif
   void *(*func)(void *);
   const char *name;
   u32_t ret_val;
+#ifdef CONFIG_OS_STATS
+  u64_t run_time; // cpu time, in cycles or system ticks
+  u32_t run_window; // cpu time in current load window
+  u32_t switches; // number of times scheduled
+  u32_t preempted; // number of times switched out while ready
+  u32_t yields; // number of times switched out voluntarily
+  u16_t load_1s; // permille of cpu last second
+  u16_t load_10s; // permille of cpu, average over last windows
+  u16_t load_hist[OS_STATS_HISTORY]; // permille of cpu per window
+  u32_t load_sum; // sum of load_hist
+  struct os_thread_t *_stat_next;
+#endif
+#ifdef ARCH_HOST
+  pthread_t _host_thread;
+  pthread_cond_t _host_run; // signalled when thread is scheduled
+  void *_host_arg;
+#endif
 } os_thread;
 
 typedef struct os_mutex_t {
@@ -43,11 +84,16 @@ typedef struct os_mutex_t {
   u32_t lock;
   u32_t attrs;
   os_thread *owner;
-  list_t q_block;
+  list_t q_block; // blocked threads, highest priority first
   u16_t depth;
+  struct os_mutex_t *_held_next; // next mutex held by same owner
 #if OS_DBG_MON
   u32_t entered;
   u32_t exited;
+  u32_t contended; // number of blocking lock attempts
+  u32_t boosts; // number of owner priority boosts
+  sys_time wait_time; // total ms threads have been blocked
+  sys_time wait_max; // longest ms a thread has been blocked
 #endif
 } os_mutex;
 
@@ -56,7 +102,7 @@ typedef struct os_cond_t {
   u32_t id;
   os_mutex *mutex;
   list_t q_block;
-  list_t q_sleep;
+  heap_t q_sleep; // timed waiters, earliest wakeup first
   bool has_sleepers;
 #if OS_DBG_MON
   u32_t waiting;
@@ -65,6 +111,56 @@ typedef struct os_cond_t {
 #endif
 } os_cond;
 
+// Fixed size message queue. Messages are copied into slots of a caller
+// provided arena of slots * msg_size bytes. For passing buffer ownership
+// instead of copying, use msg_size sizeof(void *) and the _ptr functions.
+typedef struct os_mq_t {
+  u32_t id;
+  u8_t *arena;
+  u16_t slots;
+  u16_t msg_size;
+  volatile u16_t count;
+  u16_t head; // next slot to write
+  u16_t tail; // next slot to read
+  os_cond c_recv; // threads awaiting messages
+  os_cond c_send; // threads awaiting free slots
+#if OS_DBG_MON
+  u32_t sent;
+  u32_t received;
+  u32_t full; // number of times a sender found queue full
+#endif
+} os_mq;
+
+// Counting semaphore. Posting and taking an available unit are lock free
+// and do not enter critical sections. Posting is safe from interrupts.
+typedef struct os_sem_t {
+  u32_t id;
+  volatile u32_t count;
+  volatile u32_t waiters; // number of threads in OS_sem_wait slow path
+  os_cond cond;
+} os_sem;
+
+// Group of 32 event flags. Setting, clearing, and a satisfied wait are
+// lock free and do not enter critical sections. Setting and clearing are
+// safe from interrupts.
+typedef struct os_flags_t {
+  u32_t id;
+  volatile u32_t flags;
+  volatile u32_t waiters; // number of threads in OS_flags_wait slow path
+  os_cond cond;
+} os_flags;
+
+// wait for any of the flags in mask
+#define OS_FLAGS_ANY                0
+// wait for all of the flags in mask
+#define OS_FLAGS_ALL                (1<<0)
+// clear the waited flags when wait is satisfied
+#define OS_FLAGS_CLEAR              (1<<1)
+
+// timeouts for message queues, semaphores and event flags
+#define OS_NOWAIT                   0
+#define OS_WAIT_FOREVER             ((sys_time)-1)
+
 /**
  * Enabling this flag will make thread enter critical section
  * when mutex is taken and release the critical section when
@@ -94,7 +190,30 @@ u32_t OS_thread_id(os_thread *t);
 os_thread *OS_thread_self(void);
 u32_t OS_thread_self_id(void);
 u32_t OS_thread_yield(void);
+void OS_thread_set_prio(os_thread *t, u8_t prio);
+u8_t OS_thread_get_prio(os_thread *t);
 void OS_thread_join(os_thread *t);
+/**
+ * Returns whether the saved context of given thread holds fpu registers,
+ * as when it was switched out using floating point. Such switches also
+ * save s16-s31. Always FALSE without an fpu.
+ */
+bool OS_thread_fp_context(os_thread *t);
+/**
+ * Advances the stack watermark of given thread by a binary search for the
+ * first used word of its stack. Needs OS_STACK_USAGE_CHECK, else nop.
+ * Cheap enough for calling periodically from a low priority thread.
+ */
+void OS_thread_stack_scan(os_thread *t);
+/**
+ * Returns peak stack usage in bytes of given thread, being the deepest of
+ * stack pointers sampled on context switches and of the watermark found
+ * by OS_thread_stack_scan. The sampled value only covers switch points and
+ * may underestimate, the watermark may underestimate if the thread wrote
+ * values equal to the stack mark.
+ * @param size if not NULL, populated with stack size in bytes
+ */
+u32_t OS_thread_stack_usage(os_thread *t, u32_t *size);
 
 void OS_thread_sleep(sys_time t);
 
@@ -109,8 +228,99 @@ u32_t OS_cond_timed_wait(os_cond *c, os_mutex *m, sys_time t);
 u32_t OS_cond_signal(os_cond *c);
 u32_t OS_cond_broadcast(os_cond *c);
 
+/**
+ * Initializes a message queue with given arena of slots * msg_size bytes.
+ */
+u32_t OS_mq_init(os_mq *q, void *arena, u32_t slots, u32_t msg_size);
+/**
+ * Copies message into queue. If queue is full, waits at most timeout ms for
+ * a free slot. Timeout may be OS_NOWAIT or OS_WAIT_FOREVER.
+ * Returns FALSE if message could not be queued.
+ */
+bool OS_mq_send(os_mq *q, const void *msg, sys_time timeout);
+/**
+ * Copies first message in queue into msg. If queue is empty, waits at most
+ * timeout ms for a message. Timeout may be OS_NOWAIT or OS_WAIT_FOREVER.
+ * With OS_NOWAIT, this may be called from interrupts.
+ * Returns FALSE if no message was received.
+ */
+bool OS_mq_recv(os_mq *q, void *msg, sys_time timeout);
+/**
+ * Copies message into queue without waiting, may be called from interrupts.
+ * Returns FALSE if queue is full.
+ */
+bool OS_mq_post(os_mq *q, const void *msg);
+/**
+ * Sends buffer pointer, passing ownership of buffer to receiver. Queue
+ * must have msg_size sizeof(void *).
+ */
+bool OS_mq_send_ptr(os_mq *q, void *buf, sys_time timeout);
+/**
+ * Receives buffer pointer, taking ownership of buffer. Queue must have
+ * msg_size sizeof(void *).
+ */
+bool OS_mq_recv_ptr(os_mq *q, void **buf, sys_time timeout);
+/**
+ * Returns number of queued messages.
+ */
+u32_t OS_mq_count(os_mq *q);
+
+/**
+ * Initializes a counting semaphore with given count.
+ */
+u32_t OS_sem_init(os_sem *s, u32_t count);
+/**
+ * Takes one unit of semaphore. If none is available, waits at most
+ * timeout ms. Timeout may be OS_NOWAIT or OS_WAIT_FOREVER. With
+ * OS_NOWAIT, this may be called from interrupts.
+ * Returns FALSE if no unit was taken.
+ */
+bool OS_sem_wait(os_sem *s, sys_time timeout);
+/**
+ * Gives one unit of semaphore, waking a waiter if any. May be called from
+ * interrupts.
+ */
+void OS_sem_post(os_sem *s);
+/**
+ * Returns number of available units.
+ */
+u32_t OS_sem_count(os_sem *s);
+
+/**
+ * Initializes an event flag group with given flags set.
+ */
+u32_t OS_flags_init(os_flags *f, u32_t flags);
+/**
+ * Waits for any or all of the flags in mask to be set, as given by
+ * OS_FLAGS_ANY or OS_FLAGS_ALL in opts. With OS_FLAGS_CLEAR in opts, the
+ * flags in mask are cleared when the wait is satisfied. Waits at most
+ * timeout ms, which may be OS_NOWAIT or OS_WAIT_FOREVER. With OS_NOWAIT,
+ * this may be called from interrupts.
+ * Returns the set flags of mask, or 0 on timeout.
+ */
+u32_t OS_flags_wait(os_flags *f, u32_t mask, u32_t opts, sys_time timeout);
+/**
+ * Sets flags, waking waiters. May be called from interrupts.
+ */
+void OS_flags_set(os_flags *f, u32_t flags);
+/**
+ * Clears flags. May be called from interrupts.
+ */
+void OS_flags_clear(os_flags *f, u32_t flags);
+/**
+ * Returns currently set flags.
+ */
+u32_t OS_flags_get(os_flags *f);
+
 os_wakeup_res OS_get_next_wakeup(sys_time *next_wakeup);
 u32_t OS_get_running_threads(void);
+/**
+ * Idles the kernel, i.e. main context, when it has nothing to do, until an
+ * irq. With CONFIG_SYS_TICKLESS, the timer tick is suspended until next
+ * thread wakeup or task timer, see SYS_idle. Returns directly if threads are
+ * ready.
+ */
+void OS_idle(void);
 void OS_force_ctx_switch(void);
 
 void OS_init(void);
@@ -118,12 +328,42 @@ void OS_time_tick(sys_time now);
 
 os_thread *OS_DBG_get_thread_by_id(u32_t id);
 
+#ifdef CONFIG_OS_STATS
+/**
+ * Returns system load in permille over last second and averaged over last
+ * OS_STATS_HISTORY seconds. Load is time not spent in kernel.
+ */
+void OS_stats_load(u16_t *load_1s, u16_t *load_10s);
+/**
+ * Iterates all live threads, starting with NULL. Returns NULL when done.
+ */
+os_thread *OS_stats_next_thread(os_thread *t);
+/**
+ * Clears accumulated cpu time and switch counts.
+ */
+void OS_stats_reset(void);
+void OS_stats_dump(u8_t io);
+/**
+ * Replaces load sample at ix in history hist of OS_STATS_HISTORY windows
+ * with load, keeping sum as the sum of the history. Returns the average of
+ * the n first windows, n being the number of windows closed so far up to
+ * OS_STATS_HISTORY.
+ */
+u16_t OS_stats_average(u16_t *hist, u32_t *sum, u32_t ix, u32_t n, u16_t load);
+#endif
+
 #if OS_DBG_MON
 bool OS_DBG_print_thread(u8_t io, os_thread *t, bool detail, int indent);
 bool OS_DBG_print_cond(u8_t io, os_cond *c, bool detail, int indent);
 bool OS_DBG_print_mutex(u8_t io, os_mutex *m, bool detail, int indent);
 void OS_DBG_dump(u8_t io);
 void OS_DBG_list_all(u8_t io, bool prev_preempt);
+/**
+ * Measures thread switch latency in cpu cycles, between two yielding
+ * threads without and with floating point contexts. Must be called from
+ * kernel. Needs a cycle counter, OS_HAL_CYCLES.
+ */
+void OS_DBG_bench_switch(u8_t io);
 #ifdef OS_DUMP_IRQ
 void OS_DBG_dump_irq(u8_t io);
 #endif
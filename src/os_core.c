@@ -0,0 +1,1551 @@
+/*
+ * os_core.c
+ *
+ * Scheduler core of the OS, independent of the architecture: ready queues,
+ * sleepers, priority inheritance, mutexes, conditionals, message queues,
+ * semaphores, event flags, stack usage and statistics. Context switching
+ * and time are done by arch/<arch>/os.c, see os_core.h.
+ */
+
+#include "os_core.h"
+#include "miniutils.h"
+#include "list.h"
+#ifdef ARCH_CORTEX
+#include "linker_symaccess.h"
+#endif
+#if CONFIG_OS_TASKQ_KERNEL
+#include "taskq.h"
+#endif
+
+#ifdef CONFIG_OS_STATS
+// load window in ms
+#define OS_STATS_WINDOW             1000
+#endif
+
+struct os_core os;
+
+static volatile u32_t g_thr_id = 0;
+static volatile u32_t g_mutex_id = 0;
+static volatile u32_t g_cond_id = 0;
+static volatile u32_t g_mq_id = 0;
+static volatile u32_t g_sem_id = 0;
+static volatile u32_t g_flags_id = 0;
+
+static void __os_ready_add(os_thread *t);
+static void __os_ready_del(os_thread *t);
+static void __os_ready_add_all(list_t *l);
+static void __os_thread_eff_prio(os_thread *t, u8_t prio);
+
+//------------ debug checks -------------
+
+void __os_check_validity(void) {
+#if OS_RUNTIME_VALIDITY_CHECK
+  // check struct
+  ASSERT(os.os_canary_pre == OS_CANARY_MAGIC);
+  ASSERT(os.os_canary_post == OS_CANARY_MAGIC);
+  // check queues
+  {
+    int lvl;
+    u32_t count = 0;
+    for (lvl = 0; lvl < OS_PRIO_LEVELS; lvl++) {
+      element_t *e;
+      e = list_first(&os.q_ready[lvl]);
+      ASSERT((e != NULL) == ((os.ready_map[lvl >> 5] & (1u<<(lvl & 31))) != 0));
+      ASSERT((os.ready_map[lvl >> 5] != 0) == ((os.ready_grp & (1u<<(lvl >> 5))) != 0));
+      while (e) {
+        os_type type = OS_TYPE(OS_OBJ(e));
+        ASSERT(type == OS_THREAD);
+        ASSERT(OS_THREAD(e)->prio == lvl);
+        count++;
+        e = list_next(e);
+      }
+    }
+    ASSERT(count == os.ready_count);
+  }
+#endif
+}
+
+//------- System helpers -------------
+
+#ifdef CONFIG_OS_STATS
+void __os_stats_account(void) {
+  u32_t now = __os_arch_stats_now();
+  u32_t d = now - os.stat_stamp;
+  os.stat_stamp = now;
+  os.window_time += d;
+  if (os.current_thread) {
+    os.current_thread->run_time += d;
+    os.current_thread->run_window += d;
+  } else {
+    os.kernel_time += d;
+    os.window_kernel += d;
+  }
+}
+
+// Closes load window, must be called in critical.
+static void __os_stats_window(void) {
+  os_thread *t = os.stat_threads;
+  u32_t total = os.window_time;
+  u32_t ix = os.hist_ix;
+  if (os.hist_len < OS_STATS_HISTORY) {
+    os.hist_len++;
+  }
+  while (t) {
+    t->load_1s = total ? (u16_t)(((u64_t)t->run_window * 1000) / total) : 0;
+    t->load_10s = OS_stats_average(t->load_hist, &t->load_sum, ix, os.hist_len, t->load_1s);
+    t->run_window = 0;
+    t = t->_stat_next;
+  }
+  os.load_1s = total ? (u16_t)(1000 - ((u64_t)os.window_kernel * 1000) / total) : 0;
+  os.load_10s = OS_stats_average(os.load_hist, &os.load_sum, ix, os.hist_len, os.load_1s);
+  os.hist_ix = ix + 1 >= OS_STATS_HISTORY ? 0 : ix + 1;
+  os.window_time = 0;
+  os.window_kernel = 0;
+}
+#endif
+
+os_thread *__os_select_thread(void) {
+  os_thread *cand = NULL;
+
+#ifdef CONFIG_OS_STATS
+  __os_stats_account();
+#endif
+
+  // find next candidate
+#if CONFIG_OS_TASKQ_KERNEL
+  if (TASK_got_active_tasks()) {
+    cand = NULL; // goto kernel
+  } else
+#endif
+#if CONFIG_OS_BUMP
+  if (os.bumped_thread != NULL &&
+      (os.bumped_thread->flags & OS_THREAD_FLAG_READY) &&
+      os.bumped_thread->prio >= __os_ready_top()) {
+    // if we have a bumped thread not outranked by others, prefer that
+    cand = os.bumped_thread;
+    os.bumped_thread = NULL;
+  } else
+#endif
+  if (os.ready_grp) {
+    // pick first thread of highest ready priority
+    cand = OS_THREAD(list_first(&os.q_ready[__os_ready_top()]));
+  }
+
+  // round robin among same priority
+  if (cand != NULL) {
+    list_move_last(&os.q_ready[cand->prio], OS_ELEMENT(cand));
+  }
+#ifdef CONFIG_OS_STATS
+  // picking current thread again is no switch
+  if (cand != os.current_thread) {
+    if (os.current_thread != NULL) {
+      if (os.yielding || (os.current_thread->flags & OS_THREAD_FLAG_READY) == 0) {
+        os.current_thread->yields++;
+      } else {
+        os.current_thread->preempted++;
+      }
+    }
+    if (cand != NULL) {
+      cand->switches++;
+    }
+  }
+  os.yielding = FALSE;
+#endif
+  return cand;
+}
+
+static void __os_sleepers_update(heap_t *q, sys_time now) {
+  element_t *e;
+  while (TRUE) {
+    enter_critical();
+    e = heap_first(q);
+    if (e == NULL || list_get_order(e) > now) {
+      exit_critical();
+      break;
+    }
+    // get sleeper element
+    os_type type = OS_TYPE(OS_OBJ(e));
+
+    switch (type) {
+    case OS_THREAD: {
+      // it was a thread, simply move from sleeping to running
+      os_thread *t = OS_THREAD(e);
+      TRACE_OS_THRWAKED(t);
+      heap_delete(q, e);
+      list_set_order(e, OS_FOREVER);
+      __os_ready_add(t);
+      t->flags &= ~OS_THREAD_FLAG_SLEEP;
+      t->ret_val = TRUE;
+      __os_check_validity();
+      exit_critical();
+    }
+    break;
+
+    case OS_COND: {
+      // it was a conditional, recurse into conditional's sleep queue
+      os_cond *c = OS_COND(e);
+      exit_critical();
+      TRACE_OS_CONDTIMWAKED(c);
+      __os_sleepers_update(&c->q_sleep, now);
+      enter_critical();
+      if (heap_is_empty(&c->q_sleep)) {
+        // conds sleep queue got empty, remove from sleep queue
+        list_set_order(OS_ELEMENT(c), OS_FOREVER);
+        c->has_sleepers = FALSE;
+        heap_delete(q, e);
+      } else {
+        // conds sleep queue not empty, update in sleep queue
+        heap_update(q, e, list_get_order(heap_first(&c->q_sleep)));
+      }
+      __os_check_validity();
+      exit_critical();
+    }
+    break;
+
+    default:
+      ASSERT(FALSE);
+      exit_critical();
+      return;
+    }
+  }
+}
+
+static void __os_update_first_awake() {
+  if (heap_is_empty(&os.q_sleep)) {
+    os.first_awake = OS_FOREVER;
+  } else {
+    os.first_awake = list_get_order(heap_first(&os.q_sleep));
+  }
+}
+
+// Puts thread last in ready queue of its priority, must be called in
+// critical. Pends a context switch if thread is to preempt current context.
+static void __os_ready_add(os_thread *t) {
+  u32_t lvl = t->prio;
+  list_add(&os.q_ready[lvl], OS_ELEMENT(t));
+  os.ready_map[lvl >> 5] |= (1u<<(lvl & 31));
+  os.ready_grp |= (1u<<(lvl >> 5));
+  os.ready_count++;
+  t->flags |= OS_THREAD_FLAG_READY;
+  __os_arch_ready(t);
+}
+
+// Removes thread from ready queue, must be called in critical.
+static void __os_ready_del(os_thread *t) {
+  u32_t lvl = t->prio;
+  list_delete(&os.q_ready[lvl], OS_ELEMENT(t));
+  if (list_is_empty(&os.q_ready[lvl])) {
+    os.ready_map[lvl >> 5] &= ~(1u<<(lvl & 31));
+    if (os.ready_map[lvl >> 5] == 0) {
+      os.ready_grp &= ~(1u<<(lvl >> 5));
+    }
+  }
+  os.ready_count--;
+  t->flags &= ~OS_THREAD_FLAG_READY;
+}
+
+// Moves all threads in given list to ready queues, keeping order, must be
+// called in critical.
+static void __os_ready_add_all(list_t *l) {
+  element_t *e;
+  while ((e = list_first(l)) != NULL) {
+    list_delete(l, e);
+    __os_ready_add(OS_THREAD(e));
+  }
+}
+
+// Inserts thread in mutex block queue after all threads of same or higher
+// priority, must be called in critical.
+static void __os_block_insert(list_t *q, os_thread *t) {
+  element_t *e = list_first(q);
+  while (e && OS_THREAD(e)->prio >= t->prio) {
+    e = list_next(e);
+  }
+  if (e) {
+    list_insert_before(q, OS_ELEMENT(t), e);
+  } else {
+    list_add(q, OS_ELEMENT(t));
+  }
+}
+
+// Sets effective priority of thread and requeues it wherever it is queued,
+// must be called in critical.
+static void __os_thread_eff_prio(os_thread *t, u8_t prio) {
+  if (t->prio == prio) {
+    return;
+  }
+  if (t->flags & OS_THREAD_FLAG_READY) {
+    __os_ready_del(t);
+    t->prio = prio;
+    __os_ready_add(t);
+    if (t == os.current_thread &&
+        prio < __os_ready_top()) {
+      // current thread got outranked
+      __os_arch_pend();
+    }
+  } else if (t->wait_mutex) {
+    list_delete(&t->wait_mutex->q_block, OS_ELEMENT(t));
+    t->prio = prio;
+    __os_block_insert(&t->wait_mutex->q_block, t);
+  } else {
+    t->prio = prio;
+  }
+}
+
+// Returns priority of thread, considering threads blocked on mutexes it holds.
+static u8_t __os_thread_inherited_prio(os_thread *t) {
+  u8_t prio = t->base_prio;
+  os_mutex *m = t->held;
+  while (m) {
+    element_t *e = list_first(&m->q_block);
+    if (e && OS_THREAD(e)->prio > prio) {
+      prio = OS_THREAD(e)->prio;
+    }
+    m = m->_held_next;
+  }
+  return prio;
+}
+
+// Lends given priority to owner of mutex, and transitively to owners of
+// mutexes that owner is blocked on, must be called in critical.
+static void __os_mutex_boost(os_mutex *m, u8_t prio) {
+  int depth = 0;
+  while (m && m->owner && m->owner->prio < prio && depth++ < OS_MUTEX_INHERIT_DEPTH) {
+    os_thread *o = m->owner;
+#if OS_DBG_MON
+    m->boosts++;
+#endif
+    __os_thread_eff_prio(o, prio);
+    m = o->wait_mutex;
+  }
+}
+
+// Takes ownership of mutex, must be called in critical. Threads blocking
+// after the mutex was taken but before it was owned lent their priority to
+// nobody, so the new owner inherits from the block queue here.
+static void __os_mutex_own(os_mutex *m, os_thread *t) {
+  m->owner = t;
+  m->_held_next = t->held;
+  t->held = m;
+  __os_thread_eff_prio(t, __os_thread_inherited_prio(t));
+  if (t->wait_mutex) {
+    __os_mutex_boost(t->wait_mutex, t->prio);
+  }
+}
+
+// Releases ownership of mutex, must be called in critical.
+static void __os_mutex_disown(os_mutex *m, os_thread *t) {
+  os_mutex **pm = &t->held;
+  while (*pm && *pm != m) {
+    pm = &(*pm)->_held_next;
+  }
+  if (*pm) {
+    *pm = m->_held_next;
+  }
+  m->_held_next = NULL;
+  m->owner = 0;
+}
+
+bool __os_time_wake(sys_time now) {
+#ifdef CONFIG_OS_STATS
+  enter_critical();
+  __os_stats_account();
+  if (now - os.window_start >= OS_STATS_WINDOW) {
+    os.window_start = now;
+    __os_stats_window();
+  }
+  exit_critical();
+#endif
+  if (now >= os.first_awake) {
+    __os_sleepers_update(&os.q_sleep, now);
+    __os_update_first_awake();
+    return TRUE;
+  }
+  return FALSE;
+}
+
+void __os_thread_init(os_thread *t, u32_t flags, void *(*func)(void *), const char *name) {
+  t->flags = OS_THREAD_FLAG_ALIVE | flags;
+  t->func = func;
+  t->prio = OS_THREAD_PRIO_DEFAULT;
+  t->base_prio = OS_THREAD_PRIO_DEFAULT;
+  t->wait_mutex = NULL;
+  t->held = NULL;
+
+  t->this.type = OS_THREAD;
+
+  t->id = ++g_thr_id;
+  t->name = name;
+
+  list_init(&t->q_join);
+  list_set_order(OS_ELEMENT(t), OS_FOREVER);
+}
+
+void __os_thread_start(os_thread *t) {
+  enter_critical();
+#ifdef CONFIG_OS_STATS
+  {
+    os_thread *st = os.stat_threads;
+    while (st && st != t) {
+      st = st->_stat_next;
+    }
+    if (st == NULL) {
+      t->_stat_next = os.stat_threads;
+      os.stat_threads = t;
+    }
+    t->run_time = 0;
+    t->run_window = 0;
+    t->switches = 0;
+    t->preempted = 0;
+    t->yields = 0;
+    t->load_1s = 0;
+    t->load_10s = 0;
+    memset(t->load_hist, 0, sizeof(t->load_hist));
+    t->load_sum = 0;
+  }
+#endif
+  __os_ready_add(t);
+#if OS_DBG_MON & OS_THREAD_PEERS > 0
+  {
+    int i;
+    for (i = 0; i < OS_THREAD_PEERS; i++) {
+      if (os.thread_peers[i] == t) {
+        break;
+      }
+    }
+    if (i == OS_THREAD_PEERS) {
+      os.thread_peers[os.thread_peer_ix++] = t;
+      if (os.thread_peer_ix >= OS_THREAD_PEERS) {
+        os.thread_peer_ix = 0;
+      }
+    }
+  }
+#endif
+  TRACE_OS_THRCREATE(t);
+  __os_check_validity();
+  exit_critical();
+}
+
+void __os_thread_exit(os_thread *t) {
+  TRACE_OS_THRDEAD(t);
+#ifdef CONFIG_OS_STATS
+  {
+    __os_stats_account();
+    os_thread **pt = &os.stat_threads;
+    while (*pt && *pt != t) {
+      pt = &(*pt)->_stat_next;
+    }
+    if (*pt) {
+      *pt = t->_stat_next;
+    }
+  }
+#endif
+  __os_ready_del(t);
+  __os_ready_add_all(&t->q_join);
+  t->flags = 0;
+  __os_check_validity();
+}
+
+void __os_init(void) {
+  memset(&os, 0, sizeof(os));
+
+#if OS_RUNTIME_VALIDITY_CHECK
+  os.os_canary_pre = OS_CANARY_MAGIC;
+  os.os_canary_post = OS_CANARY_MAGIC;
+#endif
+
+  {
+    int lvl;
+    for (lvl = 0; lvl < OS_PRIO_LEVELS; lvl++) {
+      list_init(&os.q_ready[lvl]);
+    }
+  }
+  heap_init(&os.q_sleep);
+  os.first_awake = OS_FOREVER;
+
+#ifdef CONFIG_OS_STATS
+  os.stat_stamp = __os_arch_stats_now();
+  os.window_start = SYS_get_time_ms();
+#endif
+}
+
+//------- Public functions -----------
+
+void OS_thread_stack_scan(os_thread *t) {
+#if OS_STACK_USAGE_CHECK
+  // for descending stacks, binary search below previous watermark for the
+  // lowest word not being the mark. Used stack may hold words equal to the
+  // mark, so the search looks for runs of marks rather than single words,
+  // presuming untouched stack is contiguous.
+  u32_t *start = (u32_t *)t->stack_start;
+  u32_t *limit = (u32_t *)MIN(t->stack_mark, t->sp_min);
+  u32_t *lo = start;
+  u32_t *hi = limit;
+  while (lo < hi) {
+    u32_t *mid = lo + (hi - lo) / 2;
+    // runs are checked below the limit only, as words between search bounds
+    // and limit may be used ones equal to the mark
+    u32_t *w = limit - mid >= OS_STACK_MARK_RUN ? mid :
+        (limit - start >= OS_STACK_MARK_RUN ? limit - OS_STACK_MARK_RUN : start);
+    u32_t *end = MIN(w + OS_STACK_MARK_RUN, limit);
+    while (w < end && *w == _STACK_USAGE_MARK_32) {
+      w++;
+    }
+    if (w == end) {
+      // run of marks, watermark is above
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  // first used word of the run
+  while (hi < limit && *hi == _STACK_USAGE_MARK_32) {
+    hi++;
+  }
+  t->stack_mark = hi;
+#else
+  (void)t;
+#endif
+}
+
+u32_t OS_thread_stack_usage(os_thread *t, u32_t *size) {
+  void *low = t->sp_min;
+#if OS_STACK_USAGE_CHECK
+  low = MIN(low, t->stack_mark);
+#endif
+  if (size) {
+    *size = (u32_t)((u8_t *)t->stack_end - (u8_t *)t->stack_start);
+  }
+  return (u32_t)((u8_t *)t->stack_end - (u8_t *)low);
+}
+
+os_thread *OS_thread_self() {
+  return os.current_thread;
+}
+
+u32_t OS_thread_self_id() {
+  return os.current_thread->id;
+}
+
+u32_t OS_thread_id(os_thread *t) {
+  return t->id;
+}
+
+void OS_thread_set_prio(os_thread *t, u8_t prio) {
+  enter_critical();
+  t->base_prio = prio;
+  // keep priority inherited from mutexes held, if higher
+  __os_thread_eff_prio(t, __os_thread_inherited_prio(t));
+  if (t->wait_mutex) {
+    __os_mutex_boost(t->wait_mutex, t->prio);
+  }
+  __os_arch_update_preemption();
+  exit_critical();
+}
+
+u8_t OS_thread_get_prio(os_thread *t) {
+  return t->prio;
+}
+
+bool OS_thread_fp_context(os_thread *t) {
+  return (t->flags & OS_THREAD_FLAG_FPU) != 0;
+}
+
+void OS_thread_join(os_thread *t) {
+  os_thread *self = OS_thread_self();
+  bool joined = FALSE;
+  ASSERT(self);
+  ASSERT(t != self);
+  enter_critical();
+  if (t->flags & OS_THREAD_FLAG_ALIVE) {
+    __os_ready_del(self);
+    list_add(&t->q_join, OS_ELEMENT(self));
+    joined = TRUE;
+  }
+  exit_critical();
+  if (joined) {
+    (void)OS_thread_yield();
+  }
+}
+
+u32_t OS_mutex_init(os_mutex *m, u32_t attrs) {
+  m->id = ++g_mutex_id;
+  m->lock = 0;
+  m->owner = 0;
+  m->attrs = attrs;
+  m->_held_next = NULL;
+  list_init(&m->q_block);
+#if OS_DBG_MON & OS_MUTEX_PEERS > 0
+  os.mutex_peers[os.mutex_peer_ix++] = m;
+  if (os.mutex_peer_ix >= OS_MUTEX_PEERS) {
+    os.mutex_peer_ix = 0;
+  }
+#endif
+  return 0;
+}
+
+void OS_thread_sleep(sys_time delay) {
+  os_thread *self = OS_thread_self();
+  sys_time awake = SYS_get_time_ms() + delay;
+  ASSERT(self);
+  enter_critical();
+  TRACE_OS_THRSLEEP(self);
+  __os_ready_del(self);
+  list_set_order(OS_ELEMENT(self), awake);
+  heap_insert(&os.q_sleep, OS_ELEMENT(self));
+  __os_update_first_awake();
+  self->flags |= OS_THREAD_FLAG_SLEEP;
+  exit_critical();
+  (void)OS_thread_yield();
+}
+
+static u32_t OS_mutex_lock_internal(os_mutex *m) {
+  os_thread *self = OS_thread_self();
+  bool taken = TRUE;
+  u32_t res = 0;
+#if OS_DBG_MON
+  bool blocked = FALSE;
+  sys_time block_start = 0;
+#endif
+
+  ASSERT(self);
+  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
+    enter_critical();
+    if (m->owner == self) {
+      m->depth++;
+      exit_critical();
+      return 0;
+    }
+    exit_critical();
+  } else {
+    ASSERT(m->owner != self);
+  }
+
+  TRACE_OS_MUTLOCK(m);
+  do {
+    taken = TRUE;
+    u32_t v;
+    // try setting mutex flag to busy
+    do {
+      v = OS_LDREX(&m->lock);
+      if (v) {
+        OS_CLREX();  // removes the local exclusive access tag for the processor
+        taken = FALSE;
+        break;
+      }
+    } while (OS_STREX(1, &m->lock));
+
+    if (!taken) {
+      // mutex already busy
+      enter_critical();
+      if (m->lock == 0) {
+        // released meanwhile, try again
+        exit_critical();
+        continue;
+      }
+      TRACE_OS_MUT_WAITLOCK(self);
+      __os_ready_del(self);
+      self->wait_mutex = m;
+      __os_block_insert(&m->q_block, self);
+      // lend our priority to owner
+      __os_mutex_boost(m, self->prio);
+#if OS_DBG_MON
+      m->contended++;
+      if (!blocked) {
+        blocked = TRUE;
+        block_start = SYS_get_time_ms();
+      }
+#endif
+      exit_critical();
+      res = OS_thread_yield();
+    } else {
+      // mutex taken
+      enter_critical();
+      TRACE_OS_MUT_ACQLOCK(self);
+      __os_mutex_own(m, self);
+      if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
+        m->depth = 1;
+      }
+
+#if OS_DBG_MON
+      m->entered++;
+      if (blocked) {
+        sys_time wait = SYS_get_time_ms() - block_start;
+        m->wait_time += wait;
+        m->wait_max = MAX(m->wait_max, wait);
+      }
+#endif
+      if ((m->attrs & OS_MUTEX_ATTR_CRITICAL_IRQ) == 0) {
+        // mutex is irq safe, keep critical lock gained when taking mutex
+        exit_critical();
+      }
+
+    }
+  } while (!taken);
+  return res;
+}
+
+u32_t OS_mutex_lock(os_mutex *m) {
+  u32_t r;
+  r = OS_mutex_lock_internal(m);
+  return r;
+}
+
+static u32_t OS_mutex_unlock_internal(os_mutex *m, bool full) {
+  ASSERT(m->owner == OS_thread_self());
+
+  // reinsert all waiting threads to running queue
+  enter_critical();
+  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
+    if (full) {
+      // full reentrant unlock
+      m->depth = 0;
+    }
+    if (m->depth > 0) {
+      m->depth--;
+      exit_critical();
+      return m->depth + 1;
+    }
+  }
+
+  TRACE_OS_MUTUNLOCK(m);
+  os_thread *owner = m->owner;
+  __os_mutex_disown(m, owner);
+  // drop priority inherited through this mutex
+  __os_thread_eff_prio(owner, __os_thread_inherited_prio(owner));
+  // wake blocked threads, highest priority first
+  element_t *e = list_first(&m->q_block);
+  while (e) {
+    OS_THREAD(e)->wait_mutex = NULL;
+    e = list_next(e);
+  }
+  __os_ready_add_all(&m->q_block);
+  // reset mutex
+  m->lock = 0;
+
+#if OS_DBG_MON
+      m->exited++;
+#endif
+  __os_check_validity();
+  __os_arch_update_preemption();
+  exit_critical();
+  if (m->attrs & OS_MUTEX_ATTR_CRITICAL_IRQ) {
+    // mutex was irq safe, release the extra critical lock taken in mutex_lock
+    exit_critical();
+  }
+
+
+  return 0;
+}
+
+u32_t OS_mutex_unlock(os_mutex *m) {
+  u32_t r;
+  r = OS_mutex_unlock_internal(m, FALSE);
+  return r;
+}
+
+bool OS_mutex_try_lock(os_mutex *m) {
+  os_thread *self = OS_thread_self();
+  bool taken = TRUE;
+
+  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
+    enter_critical();
+    if (m->owner == self) {
+      m->depth++;
+      exit_critical();
+      return TRUE;
+    }
+    exit_critical();
+  } else {
+    ASSERT(m->owner != self);
+  }
+
+  TRACE_OS_MUTLOCK(m);
+
+  // try setting mutex flag to busy
+  do {
+    u32_t v;
+    v = OS_LDREX(&m->lock);
+    if (v) {
+      OS_CLREX();  // removes the local exclusive access tag for the processor
+      taken = FALSE;
+      break;
+    }
+  } while (OS_STREX(1, &m->lock));
+
+  if (!taken) {
+    // mutex already busy
+    return FALSE;
+  }
+
+  TRACE_OS_MUT_ACQLOCK(m);
+  enter_critical();
+  __os_mutex_own(m, self);
+  exit_critical();
+  if (m->attrs & OS_MUTEX_ATTR_REENTRANT) {
+    m->depth = 1;
+  }
+
+  return TRUE;
+}
+
+u32_t OS_cond_init(os_cond *c) {
+  c->id = ++g_cond_id;
+  c->this.type = OS_COND;
+  list_set_order(OS_ELEMENT(c), OS_FOREVER);
+  list_init(&c->q_block);
+  heap_init(&c->q_sleep);
+  c->has_sleepers = FALSE;
+#if OS_DBG_MON
+  c->waiting = 0;
+  c->signalled = 0;
+  c->broadcasted = 0;
+  os.cond_peers[os.cond_peer_ix++] = c;
+  if (os.cond_peer_ix >= OS_COND_PEERS) {
+    os.cond_peer_ix = 0;
+  }
+#endif
+  return 0;
+}
+
+// Puts thread in condition's block queue, must be called in critical.
+static void __os_cond_block(os_cond *c, os_thread *t) {
+  __os_ready_del(t);
+  list_add(&c->q_block, OS_ELEMENT(t));
+#if OS_DBG_MON
+  c->waiting++;
+#endif
+}
+
+// Puts thread in condition's sleep queue until given time, must be
+// called in critical.
+static void __os_cond_sleep(os_cond *c, os_thread *t, sys_time awake) {
+  bool into_sleep_queue = c->has_sleepers;
+  __os_ready_del(t);
+  list_set_order(OS_ELEMENT(t), awake);
+  heap_insert(&c->q_sleep, OS_ELEMENT(t));
+
+  c->has_sleepers = TRUE;
+
+  if (into_sleep_queue) {
+    // update placement in sleep queue if we're first to wake
+    if (list_get_order(OS_ELEMENT(c)) > awake) {
+      heap_update(&os.q_sleep, OS_ELEMENT(c), awake);
+    }
+  } else {
+    // insert into sleep queue
+    list_set_order(OS_ELEMENT(c), awake);
+    heap_insert(&os.q_sleep, OS_ELEMENT(c));
+  }
+
+  os.first_awake = MIN(awake, os.first_awake);
+#if OS_DBG_MON
+  c->waiting++;
+#endif
+}
+
+u32_t OS_cond_wait(os_cond *c, os_mutex *m) {
+  os_thread *self = OS_thread_self();
+  u32_t r;
+  ASSERT(self);
+#ifdef ARCH_CORTEX
+  ASSERT((void*)c >= RAM_BEGIN);
+  ASSERT((void*)c < RAM_END);
+#endif
+  enter_critical();
+  TRACE_OS_CONDWAIT(c);
+  if (m) {
+    (void)OS_mutex_unlock_internal(m, TRUE);
+  }
+  __os_cond_block(c, self);
+  c->mutex = m;
+  exit_critical();
+  r = OS_thread_yield();
+  if (m) {
+    (void)OS_mutex_lock_internal(m);
+  }
+  return r;
+}
+
+u32_t OS_cond_timed_wait(os_cond *c, os_mutex *m, sys_time delay) {
+  u32_t r;
+  os_thread *self = OS_thread_self();
+  ASSERT(self);
+  self->ret_val = FALSE;
+  enter_critical();
+
+  TRACE_OS_CONDTIMWAIT(c);
+
+  if (m) {
+    (void)OS_mutex_unlock_internal(m, TRUE);
+  }
+
+  __os_cond_sleep(c, self, SYS_get_time_ms() + delay);
+  c->mutex = m;
+  exit_critical();
+  r = OS_thread_yield();
+  if (m) {
+    (void)OS_mutex_lock_internal(m);
+  }
+  return r;
+}
+
+u32_t OS_cond_signal(os_cond *c) {
+  os_thread *t;
+  enter_critical();
+  TRACE_OS_CONDSIG(c);
+
+  // first, check if there are sleepers
+  if (!heap_is_empty(&c->q_sleep)) {
+
+    // wake up first timed waiter
+    t = OS_THREAD(heap_first(&c->q_sleep));
+    TRACE_OS_SIGWAKED(t);
+#if CONFIG_OS_BUMP
+    if (os.current_thread != t) {
+      // play it nice and do not bump if thread is already running
+      os.bumped_thread = t;
+    }
+#endif
+    heap_delete(&c->q_sleep, OS_ELEMENT(t));
+    // did the condition's sleep queue become empty?
+    if (heap_is_empty(&c->q_sleep)) {
+      c->has_sleepers = FALSE;
+      // yep, remove condition from os sleep queue and update first_awake value.
+      heap_delete(&os.q_sleep, OS_ELEMENT(c));
+      list_set_order(OS_ELEMENT(c), OS_FOREVER);
+      __os_update_first_awake();
+    }
+  } else {
+  // no sleepers, wake first blockee
+    t = OS_THREAD(list_first(&c->q_block));
+    if (t != NULL) {
+      TRACE_OS_SIGWAKED(t);
+#if CONFIG_OS_BUMP
+      if (os.current_thread != t) {
+        // play it nice and do not bump if thread is already running
+        os.bumped_thread = t;
+      }
+#endif
+      list_delete(&c->q_block, OS_ELEMENT(t));
+    }
+  }
+  if (t != NULL) {
+    __os_ready_add(t);
+#if OS_DBG_MON
+  c->signalled++;
+#endif
+  }
+  __os_check_validity();
+  __os_arch_update_preemption();
+  exit_critical();
+  __os_arch_woken();
+
+  return 0;
+}
+
+u32_t OS_cond_broadcast(os_cond *c) {
+  enter_critical();
+  TRACE_OS_CONDBROAD(c);
+
+  // wake all sleepers
+  if (!heap_is_empty(&c->q_sleep)) {
+    element_t *e;
+#if CONFIG_OS_BUMP
+    if (os.current_thread != OS_THREAD(heap_first(&c->q_sleep))) {
+      // play it nice and do not bump if thread is already running
+      os.bumped_thread = OS_THREAD(heap_first(&c->q_sleep));
+    }
+#endif
+    TRACE_OS_SIGWAKED(OS_THREAD(heap_first(&c->q_sleep)));
+    while ((e = heap_pop(&c->q_sleep)) != NULL) {
+      __os_ready_add(OS_THREAD(e));
+    }
+    //  remove condition from os sleep queue and update first_awake value.
+    c->has_sleepers = FALSE;
+    heap_delete(&os.q_sleep, OS_ELEMENT(c));
+    list_set_order(OS_ELEMENT(c), OS_FOREVER);
+    __os_update_first_awake();
+  } else {
+    // if no sleepers, bump first blocked thread
+    if (!list_is_empty(&c->q_block)) {
+#if CONFIG_OS_BUMP
+      if (os.current_thread != OS_THREAD(list_first(&c->q_block))) {
+        // play it nice and do not bump if thread is already running
+        os.bumped_thread = OS_THREAD(list_first(&c->q_block));
+      }
+#endif
+      TRACE_OS_SIGWAKED(OS_THREAD(list_first(&c->q_block)));
+    }
+  }
+  // wake all blockees
+  __os_ready_add_all(&c->q_block);
+#if OS_DBG_MON
+  c->broadcasted++;
+#endif
+  __os_check_validity();
+  __os_arch_update_preemption();
+  exit_critical();
+  __os_arch_woken();
+  return 0;
+}
+
+u32_t OS_mq_init(os_mq *q, void *arena, u32_t slots, u32_t msg_size) {
+  ASSERT(arena);
+  ASSERT(slots > 0 && slots <= 0xffff);
+  ASSERT(msg_size > 0 && msg_size <= 0xffff);
+  q->id = ++g_mq_id;
+  q->arena = (u8_t *)arena;
+  q->slots = slots;
+  q->msg_size = msg_size;
+  q->count = 0;
+  q->head = 0;
+  q->tail = 0;
+  OS_cond_init(&q->c_recv);
+  OS_cond_init(&q->c_send);
+#if OS_DBG_MON
+  q->sent = 0;
+  q->received = 0;
+  q->full = 0;
+#endif
+  return 0;
+}
+
+// Waits on condition until signalled or until given time, must be called
+// in critical with nesting depth one. Returns FALSE if time has passed.
+static bool __os_cond_wait_until(os_cond *c, sys_time until) {
+  os_thread *self = OS_thread_self();
+  if (until != OS_WAIT_FOREVER && SYS_get_time_ms() >= until) {
+    return FALSE;
+  }
+  ASSERT(self);
+  if (until == OS_WAIT_FOREVER) {
+    __os_cond_block(c, self);
+  } else {
+    __os_cond_sleep(c, self, until);
+  }
+  c->mutex = NULL;
+  exit_critical();
+  (void)OS_thread_yield();
+  enter_critical();
+  return TRUE;
+}
+
+// Copies message into next free slot, must be called in critical.
+static void __os_mq_put(os_mq *q, const void *msg) {
+  memcpy(&q->arena[q->head * q->msg_size], msg, q->msg_size);
+  q->head = q->head + 1 >= q->slots ? 0 : q->head + 1;
+  q->count++;
+#if OS_DBG_MON
+  q->sent++;
+#endif
+  if (!list_is_empty(&q->c_recv.q_block) || !heap_is_empty(&q->c_recv.q_sleep)) {
+    OS_cond_signal(&q->c_recv);
+  }
+}
+
+// Copies message out of first slot, must be called in critical.
+static void __os_mq_get(os_mq *q, void *msg) {
+  memcpy(msg, &q->arena[q->tail * q->msg_size], q->msg_size);
+  q->tail = q->tail + 1 >= q->slots ? 0 : q->tail + 1;
+  q->count--;
+#if OS_DBG_MON
+  q->received++;
+#endif
+  if (!list_is_empty(&q->c_send.q_block) || !heap_is_empty(&q->c_send.q_sleep)) {
+    OS_cond_signal(&q->c_send);
+  }
+}
+
+bool OS_mq_send(os_mq *q, const void *msg, sys_time timeout) {
+  sys_time until = timeout == OS_WAIT_FOREVER ? OS_WAIT_FOREVER : SYS_get_time_ms() + timeout;
+  enter_critical();
+  while (q->count >= q->slots) {
+#if OS_DBG_MON
+    q->full++;
+#endif
+    if (timeout == OS_NOWAIT || !__os_cond_wait_until(&q->c_send, until)) {
+      exit_critical();
+      return FALSE;
+    }
+  }
+  __os_mq_put(q, msg);
+  exit_critical();
+  return TRUE;
+}
+
+bool OS_mq_recv(os_mq *q, void *msg, sys_time timeout) {
+  sys_time until = timeout == OS_WAIT_FOREVER ? OS_WAIT_FOREVER : SYS_get_time_ms() + timeout;
+  enter_critical();
+  while (q->count == 0) {
+    if (timeout == OS_NOWAIT || !__os_cond_wait_until(&q->c_recv, until)) {
+      exit_critical();
+      return FALSE;
+    }
+  }
+  __os_mq_get(q, msg);
+  exit_critical();
+  return TRUE;
+}
+
+bool OS_mq_post(os_mq *q, const void *msg) {
+  bool res = FALSE;
+  enter_critical();
+  if (q->count < q->slots) {
+    __os_mq_put(q, msg);
+    res = TRUE;
+  }
+#if OS_DBG_MON
+  else {
+    q->full++;
+  }
+#endif
+  exit_critical();
+  return res;
+}
+
+bool OS_mq_send_ptr(os_mq *q, void *buf, sys_time timeout) {
+  ASSERT(q->msg_size == sizeof(void *));
+  return OS_mq_send(q, &buf, timeout);
+}
+
+bool OS_mq_recv_ptr(os_mq *q, void **buf, sys_time timeout) {
+  ASSERT(q->msg_size == sizeof(void *));
+  return OS_mq_recv(q, buf, timeout);
+}
+
+u32_t OS_mq_count(os_mq *q) {
+  return q->count;
+}
+
+u32_t OS_sem_init(os_sem *s, u32_t count) {
+  s->id = ++g_sem_id;
+  s->count = count;
+  s->waiters = 0;
+  OS_cond_init(&s->cond);
+  return 0;
+}
+
+// Takes one unit if available, without critical section.
+static bool __os_sem_try_take(os_sem *s) {
+  u32_t v;
+  do {
+    v = OS_LDREX(&s->count);
+    if (v == 0) {
+      OS_CLREX();  // removes the local exclusive access tag for the processor
+      return FALSE;
+    }
+  } while (OS_STREX(v - 1, &s->count));
+  return TRUE;
+}
+
+bool OS_sem_wait(os_sem *s, sys_time timeout) {
+  bool res = FALSE;
+  if (__os_sem_try_take(s)) {
+    return TRUE;
+  }
+  if (timeout == OS_NOWAIT) {
+    return FALSE;
+  }
+  sys_time until = timeout == OS_WAIT_FOREVER ? OS_WAIT_FOREVER : SYS_get_time_ms() + timeout;
+  enter_critical();
+  // posters check waiters after incrementing count, so registering and
+  // checking count in same critical section cannot miss a post
+  s->waiters++;
+  do {
+    if (__os_sem_try_take(s)) {
+      res = TRUE;
+      break;
+    }
+  } while (__os_cond_wait_until(&s->cond, until));
+  s->waiters--;
+  exit_critical();
+  return res;
+}
+
+void OS_sem_post(os_sem *s) {
+  u32_t v;
+  do {
+    v = OS_LDREX(&s->count);
+  } while (OS_STREX(v + 1, &s->count));
+  if (s->waiters) {
+    OS_cond_signal(&s->cond);
+  }
+}
+
+u32_t OS_sem_count(os_sem *s) {
+  return s->count;
+}
+
+u32_t OS_flags_init(os_flags *f, u32_t flags) {
+  f->id = ++g_flags_id;
+  f->flags = flags;
+  f->waiters = 0;
+  OS_cond_init(&f->cond);
+  return 0;
+}
+
+// Checks if flags satisfy the wait and clears them if requested, without
+// critical section. Returns matching flags, or 0 if not satisfied.
+static u32_t __os_flags_try(os_flags *f, u32_t mask, u32_t opts) {
+  u32_t v, m;
+  do {
+    v = OS_LDREX(&f->flags);
+    m = v & mask;
+    if ((opts & OS_FLAGS_ALL) ? m != mask : m == 0) {
+      OS_CLREX();  // removes the local exclusive access tag for the processor
+      return 0;
+    }
+    if ((opts & OS_FLAGS_CLEAR) == 0) {
+      OS_CLREX();  // removes the local exclusive access tag for the processor
+      return m;
+    }
+  } while (OS_STREX(v & ~mask, &f->flags));
+  return m;
+}
+
+u32_t OS_flags_wait(os_flags *f, u32_t mask, u32_t opts, sys_time timeout) {
+  u32_t res;
+  ASSERT(mask);
+  res = __os_flags_try(f, mask, opts);
+  if (res || timeout == OS_NOWAIT) {
+    return res;
+  }
+  sys_time until = timeout == OS_WAIT_FOREVER ? OS_WAIT_FOREVER : SYS_get_time_ms() + timeout;
+  enter_critical();
+  f->waiters++;
+  do {
+    res = __os_flags_try(f, mask, opts);
+    if (res) {
+      break;
+    }
+  } while (__os_cond_wait_until(&f->cond, until));
+  f->waiters--;
+  exit_critical();
+  return res;
+}
+
+void OS_flags_set(os_flags *f, u32_t flags) {
+  u32_t v;
+  do {
+    v = OS_LDREX(&f->flags);
+  } while (OS_STREX(v | flags, &f->flags));
+  if (f->waiters) {
+    // waiters have different masks, let all recheck
+    OS_cond_broadcast(&f->cond);
+  }
+}
+
+void OS_flags_clear(os_flags *f, u32_t flags) {
+  u32_t v;
+  do {
+    v = OS_LDREX(&f->flags);
+  } while (OS_STREX(v & ~flags, &f->flags));
+}
+
+u32_t OS_flags_get(os_flags *f) {
+  return f->flags;
+}
+
+os_wakeup_res OS_get_next_wakeup(sys_time *next_wakeup) {
+  if (os.ready_count > 0) {
+    if (os.first_awake != OS_FOREVER) {
+      if (next_wakeup) {
+        *next_wakeup = os.first_awake;
+      }
+      return OS_WUP_SLEEP_RUNNING;
+    } else {
+      return OS_WUP_RUNNING;
+    }
+  } else if (os.first_awake == OS_FOREVER) {
+    return OS_WUP_SLEEP_FOREVER;
+  } else if (next_wakeup) {
+    *next_wakeup = os.first_awake;
+  }
+  return OS_WUP_SLEEP;
+}
+
+u32_t OS_get_running_threads(void) {
+  return os.ready_count;
+}
+
+void OS_idle(void) {
+  if (os.ready_count > 0) {
+    return;
+  }
+#ifdef CONFIG_SYS_TICKLESS
+  SYS_idle();
+#else
+  arch_sleep();
+#endif
+}
+
+#ifdef CONFIG_OS_STATS
+void OS_stats_load(u16_t *load_1s, u16_t *load_10s) {
+  if (load_1s) *load_1s = os.load_1s;
+  if (load_10s) *load_10s = os.load_10s;
+}
+
+os_thread *OS_stats_next_thread(os_thread *t) {
+  return t == NULL ? os.stat_threads : t->_stat_next;
+}
+
+void OS_stats_reset(void) {
+  enter_critical();
+  os_thread *t = os.stat_threads;
+  while (t) {
+    t->run_time = 0;
+    t->switches = 0;
+    t->preempted = 0;
+    t->yields = 0;
+    t = t->_stat_next;
+  }
+  os.kernel_time = 0;
+  exit_critical();
+}
+
+void OS_stats_dump(u8_t io) {
+  // u64 counters are updated by context switches, read them in critical
+  enter_critical();
+  __os_stats_account();
+  u64_t kernel_time = os.kernel_time;
+  u64_t total = kernel_time;
+  u16_t load_1s = os.load_1s;
+  u16_t load_10s = os.load_10s;
+  os_thread *t = os.stat_threads;
+  while (t) {
+    total += t->run_time;
+    t = t->_stat_next;
+  }
+  t = os.stat_threads;
+  exit_critical();
+  ioprint(io, "load %i.%i%% (1s)  %i.%i%% (10s)  kernel %i%%\n",
+      load_1s / 10, load_1s % 10, load_10s / 10, load_10s % 10,
+      total ? (u32_t)((kernel_time * 100) / total) : 0);
+  ioprint(io, "  id  prio  1s    10s   total  switches  preempt  yield  name\n");
+  while (t) {
+    u32_t id, switches, preempted, yields;
+    u16_t l1, l10;
+    u8_t prio;
+    u64_t run_time;
+    const char *name;
+    enter_critical();
+    id = t->id;
+    prio = t->prio;
+    l1 = t->load_1s;
+    l10 = t->load_10s;
+    run_time = t->run_time;
+    switches = t->switches;
+    preempted = t->preempted;
+    yields = t->yields;
+    name = t->name;
+    t = t->_stat_next;
+    exit_critical();
+    ioprint(io, "%04x  %3i  %3i.%i  %3i.%i  %3i%%   %8i  %7i  %5i  %s\n",
+        id, prio,
+        l1 / 10, l1 % 10,
+        l10 / 10, l10 % 10,
+        total ? (u32_t)((run_time * 100) / total) : 0,
+        switches, preempted, yields,
+        name == NULL ? "<n/a>" : name);
+  }
+}
+#endif
+
+#if OS_DBG_MON
+static void OS_DBG_print_thread_list(u8_t io, list_t *l, bool detail, int indent);
+static void OS_DBG_print_thread_heap(u8_t io, heap_t *h, bool detail, int indent);
+
+bool OS_DBG_print_thread(u8_t io, os_thread *t, bool detail, int indent) {
+  if (t == NULL) return FALSE;
+  char tab[32];
+  memset(tab, ' ', sizeof(tab));
+  tab[indent] = 0;
+  ioprint(io, "%sthread id:%04x  addr:%08x  name:%s  order:%08x\n", tab,
+      t->id, t, t->name == NULL ? "<n/a>" : t->name, t->this.e.sort_order);
+  if (!detail) return TRUE;
+  ioprint(io, "%s       func:%08x  flags:%08x  prio:%i (%i)%s\n", tab,
+      t->func, t->flags, t->prio, t->base_prio,
+      OS_thread_fp_context(t) ? "  fpu" : "");
+  ioprint(io, "%s       sp:  %08x", tab,
+      t->sp);
+#if OS_STACK_CHECK
+  ioprint(io, " [%s]  ", (t->sp < t->stack_start || t->sp > t->stack_end) ? TEXT_BAD("BPTR") :" ok ");
+  bool sp_start_bad = OS_DBG_BADR(t->stack_start);
+  bool sp_end_bad = t->stack_end < t->stack_start || OS_DBG_BADR(t->stack_end);
+  ioprint(io, "  sp_start:%08x [%s]  sp_end:%08x [%s]",
+      t->stack_start,
+      sp_start_bad ? TEXT_BAD("BADR") : (*(u32_t*)(t->stack_start - 4) != OS_STACK_START_MARKER ? TEXT_BAD("CRPT") : " ok "),
+      t->stack_end,
+      sp_end_bad ? TEXT_BAD("BADR") : (*(u32_t*)(t->stack_end) != OS_STACK_END_MARKER ? TEXT_BAD("CRPT") : " ok ")
+          );
+#if OS_STACK_USAGE_CHECK
+  if (!sp_start_bad && !sp_end_bad) {
+    u32_t size;
+    OS_thread_stack_scan(t);
+    u32_t used = OS_thread_stack_usage(t, &size);
+    u32_t perc = (100 * used) / size;
+    ioprint(io, "  used:%i%", perc);
+    if (perc == 100) {
+      ioprint(io, TEXT_BAD(" FULL"));
+    } else if (perc > 90) {
+      ioprint(io, TEXT_NOTE(" ALMOST FULL"));
+    }
+  }
+#endif
+#endif
+  ioprint(io, "\n");
+
+  if (!list_is_empty(&t->q_join)) {
+    ioprint(io, "%s       Join List (%i): \n", tab,
+        list_count(&t->q_join));
+    OS_DBG_print_thread_list(io, &t->q_join, FALSE, indent + 9);
+  }
+  return TRUE;
+}
+
+static void OS_DBG_print_element(u8_t io, element_t *e, bool detail, int indent) {
+  os_type type = OS_TYPE(OS_OBJ(e));
+  switch (type) {
+  case OS_THREAD:
+    OS_DBG_print_thread(io, OS_THREAD(e), detail, indent);
+    break;
+  case OS_COND:
+    OS_DBG_print_cond(io, OS_COND(e), detail, indent);
+    break;
+  default:
+    // TODO
+    break;
+  }
+}
+
+static void OS_DBG_print_thread_list(u8_t io, list_t *l, bool detail, int indent) {
+  element_t *cur = list_first(l);
+  while (cur) {
+    OS_DBG_print_element(io, cur, detail, indent);
+    cur = list_next(cur);
+  }
+}
+
+// heap is printed in traversal order, not wakeup order
+static void OS_DBG_print_thread_heap(u8_t io, heap_t *h, bool detail, int indent) {
+  element_t *cur = heap_first(h);
+  while (cur) {
+    OS_DBG_print_element(io, cur, detail, indent);
+    cur = heap_next(cur);
+  }
+}
+
+static void OS_DBG_list_threads(u8_t io) {
+  int i;
+  ioprint(io, "Running\n-------\n");
+  OS_DBG_print_thread(io, os.current_thread, TRUE, 2);
+  ioprint(io, "Scheduled\n---------\n");
+  for (i = OS_PRIO_LEVELS-1; i >= 0; i--) {
+    if (list_is_empty(&os.q_ready[i])) continue;
+    ioprint(io, "  prio %i\n", i);
+    OS_DBG_print_thread_list(io, &os.q_ready[i], TRUE, 2);
+  }
+  ioprint(io, "Sleeping\n--------\n");
+  OS_DBG_print_thread_heap(io, &os.q_sleep, TRUE, 2);
+  ioprint(io, "Thread peers\n------------\n");
+  for (i = 0; i < OS_THREAD_PEERS; i++) {
+    OS_DBG_print_thread(io, os.thread_peers[i], TRUE, 2);
+  }
+}
+
+bool OS_DBG_print_mutex(u8_t io, os_mutex *m, bool detail, int indent) {
+  if (m == NULL) return FALSE;
+  char tab[32];
+  memset(tab, ' ', sizeof(tab));
+  tab[indent] = 0;
+  ioprint(io, "%smutex  id:%04x  addr:%08x  lock:%08x  attr:%08x  depth:%i\n", tab, m->id, m, m->lock, m->attrs, m->depth);
+  if (!detail) return TRUE;
+  ioprint(io, "%s       owner: ", tab);
+  if (!OS_DBG_print_thread(io, m->owner, FALSE, indent+2)) {
+    ioprint(io, "\n");
+  }
+  ioprint(io, "%s       entries:%i  exits:%i\n", tab, m->entered, m->exited);
+  ioprint(io, "%s       contended:%i  boosts:%i  wait:%ims  max wait:%ims\n", tab,
+      m->contended, m->boosts, (u32_t)m->wait_time, (u32_t)m->wait_max);
+  if (!list_is_empty(&m->q_block)) {
+    ioprint(io, "%s       Blocked List (%i)\n", tab, list_count(&m->q_block));
+    OS_DBG_print_thread_list(io, &m->q_block, FALSE, indent + 9);
+  }
+  return TRUE;
+
+}
+
+static void OS_DBG_list_mutexes(u8_t io) {
+  int i;
+  ioprint(io, "Mutex peers\n-----------\n");
+  for (i = 0; i < OS_MUTEX_PEERS; i++) {
+    OS_DBG_print_mutex(io, os.mutex_peers[i], 2, TRUE);
+  }
+}
+
+bool OS_DBG_print_cond(u8_t io, os_cond *c, bool detail, int indent) {
+  if (c == NULL) return FALSE;
+  char tab[32];
+  memset(tab, ' ', sizeof(tab));
+  tab[indent] = 0;
+  ioprint(io, "%scond   id:%04x  addr:%08x  sleepers:%s  order:%08x\n", tab,
+      c->id, c,  c->has_sleepers? "YES":"NO ", c->this.e.sort_order);
+  ioprint(io, "%s       mutex: ", tab);
+  if (!OS_DBG_print_mutex(io, c->mutex, FALSE, indent + 2)) {
+    ioprint(io, "\n");
+  }
+  if (!detail) return TRUE;
+  ioprint(io, "%s       waits:%i  signals:%i  broadcasts:%i\n", tab,
+      c->waiting, c->signalled, c->broadcasted);
+  if (!list_is_empty(&c->q_block)) {
+    ioprint(io, "%s       Blocked List (%i)\n", tab, list_count(&c->q_block));
+    OS_DBG_print_thread_list(io, &c->q_block, FALSE, indent + 9);
+  }
+  if (!heap_is_empty(&c->q_sleep)) {
+    ioprint(io, "%s       TimedWait List (%i)\n", tab, heap_count(&c->q_sleep));
+    OS_DBG_print_thread_heap(io, &c->q_sleep, FALSE, indent + 9);
+  }
+  return TRUE;
+}
+
+static void OS_DBG_list_conds(u8_t io) {
+  int i;
+  ioprint(io, "Cond peers\n----------\n");
+  for (i = 0; i < OS_COND_PEERS; i++) {
+    OS_DBG_print_cond(io, os.cond_peers[i], 2, TRUE);
+  }
+}
+
+void OS_DBG_list_all(u8_t io, bool previous_preempt) {
+  ioprint(io, "OS INFO\n-------\n");
+  ioprint(io, "  Scheduled threads: %i\n", os.ready_count);
+  ioprint(io, "  Sleeping entries:  %i\n", heap_count(&os.q_sleep));
+  ioprint(io, "  Spawned threads:   %i\n", g_thr_id);
+  ioprint(io, "  Critical:          %s\n", within_critical() ? "YES":"NO");
+  ioprint(io, "  Preemption:        %s\n", previous_preempt ? "ON":"OFF");
+  ioprint(io, "  Now:               %i\n", SYS_get_time_ms());
+  ioprint(io, "  First awake:       %i (%i in future)\n", os.first_awake, os.first_awake - SYS_get_time_ms());
+  OS_DBG_list_threads(io);
+  OS_DBG_list_mutexes(io);
+  OS_DBG_list_conds(io);
+}
+
+os_thread **OS_DBG_get_thread_peers() {
+  return os.thread_peers;
+}
+#endif // OS_DBG_MON
+
+os_thread *OS_DBG_get_thread_by_id(u32_t id) {
+#if OS_DBG_MON
+  int i;
+  for (i = 0; i < OS_THREAD_PEERS; i++) {
+    if (os.thread_peers[i] != NULL && os.thread_peers[i]->id == id) {
+      return os.thread_peers[i];
+    }
+  }
+#else
+  (void)id;
+#endif
+  return NULL;
+}
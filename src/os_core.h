@@ -0,0 +1,199 @@
+/*
+ * os_core.h
+ *
+ * Internals of the OS shared by the architecture variants. The scheduler
+ * core in os_core.c keeps ready queues, sleepers, priority inheritance and
+ * all synchronization objects. The variant in arch/<arch>/os.c does
+ * context switching and time, implementing the __os_arch hooks below and
+ * calling the core on context switches, ticks and thread start and death.
+ *
+ * Not for application use, see os.h.
+ */
+
+#ifndef OS_CORE_H_
+#define OS_CORE_H_
+
+#include "os.h"
+#include "list.h"
+
+// configs, set by compiler flags
+
+// will schedule a signalled thread first
+//#define CONFIG_OS_BUMP 1
+
+// will use taskq as kernel, not being in a thread
+//#define CONFIG_OS_TASKQ_KERNEL 1
+
+// checks os struct memory overwrites at certain points
+//#define OS_RUNTIME_VALIDITY_CHECK 1
+
+// enables debug dump printouts of os status
+//#define OS_DBG_MON 1
+// if OS_DBG_MON, enables logging of up to x created threads
+//#define OS_THREAD_PEERS 4
+// if OS_DBG_MON, enables logging of up to x created mutexes
+//#define OS_MUTEX_PEERS 4
+// if OS_DBG_MON, enables logging of up to x created conditionals
+//#define OS_COND_PEERS 4
+
+// enables thread stack checks, checked when entering and leaving threads
+//#define OS_STACK_CHECK 1
+
+// fills thread stacks with a mark, enabling watermark scans of used stack
+// in OS_thread_stack_scan and on debug dump
+//#define OS_STACK_USAGE_CHECK 1
+
+// max length of mutex owner chains priorities are inherited through
+#ifndef OS_MUTEX_INHERIT_DEPTH
+#define OS_MUTEX_INHERIT_DEPTH 8
+#endif
+
+#define OS_THREAD_FLAG_ALIVE        (1<<0)
+#define OS_THREAD_FLAG_SLEEP        (1<<1)
+#define OS_THREAD_FLAG_READY        (1<<3)
+// set by context switch when thread's saved context holds fpu registers
+#define OS_THREAD_FLAG_FPU          (1<<4)
+#define OS_FOREVER                  ((sys_time)-1)
+#define OS_STACK_START_MARKER       (0xf00dcafe)
+#define OS_STACK_END_MARKER         (0xfadebeef)
+
+#define OS_ELEMENT(obj) &((obj)->this.e)
+#define OS_TYPE(obj) ((obj)->type)
+#define OS_OBJ(ele) ((os_object *)((char *)(ele) + ((char *)&((os_object *)0)->e - (char *)0 )))
+#define OS_THREAD(ele) ((os_thread *)((char *)(ele) + ((char *)&((os_thread *)0)->this.e - (char *)0 )))
+#define OS_COND(ele) ((os_cond *)((char *)(ele) + ((char *)&((os_cond *)0)->this.e - (char *)0 )))
+
+// threads are scheduled on each of the 256 priorities, with a two level
+// bitmap of non-empty ready queues: bit g of ready_grp is set if any bit of
+// ready_map[g] is, bit b of ready_map[g] is set if q_ready[g*32+b] is
+// non-empty
+#define OS_PRIO_LEVELS              256
+#define OS_PRIO_GROUPS              (OS_PRIO_LEVELS / 32)
+
+#define _STACK_USAGE_MARK (0xea)
+#define _STACK_USAGE_MARK_32 ((_STACK_USAGE_MARK << 24) | (_STACK_USAGE_MARK << 16) | (_STACK_USAGE_MARK << 8) | _STACK_USAGE_MARK)
+// number of consecutive mark words taken as untouched stack
+#define OS_STACK_MARK_RUN 8
+
+#define OS_CANARY_MAGIC 0xf0f0feed
+
+// exclusive access for lock free updates from threads and irqs. On host
+// only one context runs at a time, so plain access is exclusive.
+#ifdef ARCH_CORTEX
+#define OS_LDREX(p)                 __LDREXW(p)
+#define OS_STREX(v, p)              __STREXW((v), (p))
+#define OS_CLREX()                  __CLREX()
+#else
+#define OS_LDREX(p)                 (*(p))
+#define OS_STREX(v, p)              (*(p) = (v), 0)
+#define OS_CLREX()
+#endif
+
+struct os_core {
+#if OS_RUNTIME_VALIDITY_CHECK
+  u32_t os_canary_pre;
+#endif
+  // pointer to current thread, NULL being kernel
+  os_thread *current_thread;
+#if CONFIG_OS_BUMP
+  // pointer to bumped thread
+  os_thread *bumped_thread;
+#endif
+  // thread ready queue per priority
+  list_t q_ready[OS_PRIO_LEVELS];
+  // bitmaps of non-empty ready queues
+  u32_t ready_map[OS_PRIO_GROUPS];
+  u8_t ready_grp;
+  // number of ready threads
+  u32_t ready_count;
+  // thread and condition sleeping queue, earliest wakeup first
+  heap_t q_sleep;
+  sys_time first_awake;
+#ifdef CONFIG_OS_STATS
+  // all created threads
+  os_thread *stat_threads;
+  // time stamp of last accounting
+  u32_t stat_stamp;
+  // time spent outside threads
+  u64_t kernel_time;
+  // load window start in ms, and window times
+  sys_time window_start;
+  u32_t window_time;
+  u32_t window_kernel;
+  // set when current thread yields voluntarily
+  bool yielding;
+  // system load in permille, and per window history of it
+  u16_t load_1s;
+  u16_t load_10s;
+  u16_t load_hist[OS_STATS_HISTORY];
+  u32_t load_sum;
+  // history slot of next window, and number of windows in history
+  u8_t hist_ix;
+  u8_t hist_len;
+#endif
+#if OS_RUNTIME_VALIDITY_CHECK
+  u32_t os_canary_post;
+#endif
+#if OS_DBG_MON
+  u8_t thread_peer_ix;
+  os_thread *thread_peers[OS_THREAD_PEERS];
+  u8_t mutex_peer_ix;
+  os_mutex *mutex_peers[OS_MUTEX_PEERS];
+  u8_t cond_peer_ix;
+  os_cond *cond_peers[OS_COND_PEERS];
+#endif
+};
+
+extern struct os_core os;
+
+// Returns highest priority having ready threads, some must be ready.
+static inline u32_t __os_ready_top(void) {
+  u32_t grp = 31 - __builtin_clz(os.ready_grp);
+  return (grp << 5) | (31 - __builtin_clz(os.ready_map[grp]));
+}
+
+//------- Core, called by arch -------
+
+/* Resets all scheduler state */
+void __os_init(void);
+/* Checks scheduler state, if OS_RUNTIME_VALIDITY_CHECK */
+void __os_check_validity(void);
+/* Picks next thread to run, or NULL for kernel, and puts it last among
+   threads of its priority. Accounts time of leaving context and counts
+   the switch, if any, with CONFIG_OS_STATS. Does not change current
+   thread. Must be called in
+   critical. */
+os_thread *__os_select_thread(void);
+/* Initiates thread fields not concerning the stack */
+void __os_thread_init(os_thread *t, u32_t flags, void *(*func)(void *), const char *name);
+/* Makes initiated thread ready */
+void __os_thread_start(os_thread *t);
+/* Removes dead thread from scheduling and readies its joiners. Must be
+   called in critical. */
+void __os_thread_exit(os_thread *t);
+/* Wakes sleepers due at given time, and closes load windows with
+   CONFIG_OS_STATS. Returns TRUE if sleepers were due. */
+bool __os_time_wake(sys_time now);
+#ifdef CONFIG_OS_STATS
+/* Accounts time since last call to current thread or kernel, must be
+   called in critical. */
+void __os_stats_account(void);
+#endif
+
+//------- Arch hooks, called by core -------
+
+/* Pends a context switch, taken when leaving critical */
+void __os_arch_pend(void);
+/* Called in critical when given thread became ready, pends a context
+   switch if thread is to preempt current context. */
+void __os_arch_ready(os_thread *t);
+/* Called in critical after ready queues changed, updates time slicing */
+void __os_arch_update_preemption(void);
+/* Called outside critical after threads were woken by a cond */
+void __os_arch_woken(void);
+#ifdef CONFIG_OS_STATS
+/* Current time in cpu cycles or ticks, for cpu accounting */
+u32_t __os_arch_stats_now(void);
+#endif
+
+#endif /* OS_CORE_H_ */
@@ -0,0 +1,13 @@
+/*
+ * os_stats.c
+ *
+ * Load averaging of os statistics, independent of the scheduler.
+ */
+
+#include "os.h"
+
+u16_t OS_stats_average(u16_t *hist, u32_t *sum, u32_t ix, u32_t n, u16_t load) {
+  *sum = *sum - hist[ix] + load;
+  hist[ix] = load;
+  return n ? (u16_t)(*sum / n) : 0;
+}
@@ -95,6 +95,28 @@ int ringbuf_available_linear(ringbuf *rb, u8_t **ptr) {
   }
 }
 
+int ringbuf_reserve_linear(ringbuf *rb, u8_t **ptr) {
+  u16_t rix = rb->r_ix;
+  u16_t wix = rb->w_ix;
+  u16_t free = RB_FREE(rix, wix);
+  *ptr = &rb->buffer[wix];
+  return MIN(free, rb->max_len - wix);
+}
+
+int ringbuf_commit(ringbuf *rb, u16_t len) {
+  u16_t rix = rb->r_ix;
+  u16_t wix = rb->w_ix;
+  if (len > RB_FREE(rix, wix)) {
+    return RB_ERR_FULL;
+  }
+  wix += len;
+  if (wix >= rb->max_len) {
+    wix -= rb->max_len;
+  }
+  rb->w_ix = wix;
+  return len;
+}
+
 int ringbuf_free(ringbuf *rb) {
   u16_t rix = rb->r_ix;
   u16_t wix = rb->w_ix;
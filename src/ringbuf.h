@@ -14,6 +14,10 @@
 #define RB_ERR_EMPTY        -500
 #define RB_ERR_FULL         -501
 
+/*
+ * Ring buffer keeping one byte empty. Not safe for concurrent use without
+ * critical sections, see ringbuf_spsc.h for a lock free variant.
+ */
 typedef struct {
   u8_t *buffer;
   volatile u16_t r_ix;
@@ -49,6 +53,16 @@ int ringbuf_available(ringbuf *rb);
    null argument for buf.
  */
 int ringbuf_available_linear(ringbuf *rb, u8_t **ptr);
+/* Returns linear write capacity and pointer to buffer. Data
+   written to the pointer is not readable until ringbuf_commit
+   is called. Meant for filling the buffer directly, e.g. by dma.
+ */
+int ringbuf_reserve_linear(ringbuf *rb, u8_t **ptr);
+/* Advances the write pointer after data has been written to the
+   pointer returned by ringbuf_reserve_linear.
+   @returns number of bytes committed or RB_ERR_FULL
+ */
+int ringbuf_commit(ringbuf *rb, u16_t len);
 /*  Empties ringbuffer  */
 int ringbuf_clear(ringbuf *rb);
 
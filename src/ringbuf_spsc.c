@@ -0,0 +1,165 @@
+/*
+ * ringbuf_spsc.c
+ *
+ * Lock free single producer single consumer ring buffer.
+ */
+
+#include "ringbuf_spsc.h"
+#include "miniutils.h"
+#include "linker_symaccess.h"
+
+// Producer owns w_ix, consumer owns r_ix. Own index is read plainly, other
+// side's index is read before touching data (acquire), and own index is
+// written after data has been touched (release).
+#ifdef ARCH_CORTEX
+#define RB_BARRIER()  __DMB()
+#else
+#define RB_BARRIER()  __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#endif
+
+#define RB_AVAIL(rix, wix) \
+  ((u32_t)((wix) - (rix)))
+#define RB_FREE(rix, wix) \
+  (rb->max_len - RB_AVAIL(rix, wix))
+
+void ringbuf_spsc_init(ringbuf_spsc *rb, u8_t *buffer, u16_t max_len) {
+  ASSERT(max_len > 0 && (max_len & (max_len - 1)) == 0);
+  rb->max_len = max_len;
+  rb->mask = max_len - 1;
+  rb->buffer = buffer;
+  rb->r_ix = 0;
+  rb->w_ix = 0;
+}
+
+int ringbuf_spsc_getc(ringbuf_spsc *rb, u8_t *c) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  RB_BARRIER();
+  if (rix == wix) {
+    return RB_ERR_EMPTY;
+  }
+  if (c) {
+    *c = rb->buffer[rix & rb->mask];
+  }
+  RB_BARRIER();
+  rb->r_ix = rix + 1;
+
+  return RB_OK;
+}
+
+int ringbuf_spsc_putc(ringbuf_spsc *rb, u8_t c) {
+  u32_t wix = rb->w_ix;
+  u32_t rix = rb->r_ix;
+  RB_BARRIER();
+  if (RB_AVAIL(rix, wix) >= rb->max_len) {
+    return RB_ERR_FULL;
+  }
+  rb->buffer[wix & rb->mask] = c;
+  RB_BARRIER();
+  rb->w_ix = wix + 1;
+
+  return RB_OK;
+}
+
+int ringbuf_spsc_available(ringbuf_spsc *rb) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  return RB_AVAIL(rix, wix);
+}
+
+int ringbuf_spsc_free(ringbuf_spsc *rb) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  return RB_FREE(rix, wix);
+}
+
+int ringbuf_spsc_clear(ringbuf_spsc *rb) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  rb->r_ix = wix;
+  return RB_AVAIL(rix, wix);
+}
+
+int ringbuf_spsc_available_linear(ringbuf_spsc *rb, u8_t **ptr) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  RB_BARRIER();
+  u32_t avail = RB_AVAIL(rix, wix);
+  if (avail == 0) {
+    return 0;
+  }
+  u32_t offs = rix & rb->mask;
+  *ptr = &rb->buffer[offs];
+  return MIN(avail, rb->max_len - offs);
+}
+
+int ringbuf_spsc_reserve_linear(ringbuf_spsc *rb, u8_t **ptr) {
+  u32_t wix = rb->w_ix;
+  u32_t rix = rb->r_ix;
+  RB_BARRIER();
+  u32_t free = RB_FREE(rix, wix);
+  u32_t offs = wix & rb->mask;
+  *ptr = &rb->buffer[offs];
+  return MIN(free, rb->max_len - offs);
+}
+
+int ringbuf_spsc_commit(ringbuf_spsc *rb, u16_t len) {
+  u32_t wix = rb->w_ix;
+  u32_t rix = rb->r_ix;
+  if (len > RB_FREE(rix, wix)) {
+    return RB_ERR_FULL;
+  }
+  RB_BARRIER();
+  rb->w_ix = wix + len;
+  return len;
+}
+
+int ringbuf_spsc_put(ringbuf_spsc *rb, const u8_t *buf, u16_t len) {
+  u32_t wix = rb->w_ix;
+  u32_t rix = rb->r_ix;
+  RB_BARRIER();
+  u32_t free = RB_FREE(rix, wix);
+  if (free == 0) {
+    return RB_ERR_FULL;
+  }
+  if (len > free) {
+    len = free;
+  }
+  u32_t offs = wix & rb->mask;
+  u32_t part = MIN(len, rb->max_len - offs);
+  ASSERT(VALID_DATA(buf));
+  memcpy(&rb->buffer[offs], buf, part);
+  if (part < len) {
+    memcpy(&rb->buffer[0], buf + part, len - part);
+  }
+  RB_BARRIER();
+  rb->w_ix = wix + len;
+
+  return len;
+}
+
+int ringbuf_spsc_get(ringbuf_spsc *rb, u8_t *buf, u16_t len) {
+  u32_t rix = rb->r_ix;
+  u32_t wix = rb->w_ix;
+  RB_BARRIER();
+  u32_t avail = RB_AVAIL(rix, wix);
+  if (avail == 0) {
+    return RB_ERR_EMPTY;
+  }
+  if (len > avail) {
+    len = avail;
+  }
+  if (buf) {
+    u32_t offs = rix & rb->mask;
+    u32_t part = MIN(len, rb->max_len - offs);
+    ASSERT(VALID_RAM(buf));
+    memcpy(buf, &rb->buffer[offs], part);
+    if (part < len) {
+      memcpy(buf + part, &rb->buffer[0], len - part);
+    }
+  }
+  RB_BARRIER();
+  rb->r_ix = rix + len;
+
+  return len;
+}
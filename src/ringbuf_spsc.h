@@ -0,0 +1,77 @@
+/*
+ * ringbuf_spsc.h
+ *
+ * Lock free ring buffer for one producer and one consumer, e.g. an irq and
+ * a task, or two threads. Indices are free running and masked, hence the
+ * size of the buffer must be a power of two. All of the buffer can be used,
+ * as opposed to ringbuf where one byte is always left empty.
+ *
+ * The producer may only call ringbuf_spsc_putc, ringbuf_spsc_put,
+ * ringbuf_spsc_reserve_linear, ringbuf_spsc_commit and ringbuf_spsc_free.
+ * The consumer may only call ringbuf_spsc_getc, ringbuf_spsc_get,
+ * ringbuf_spsc_available_linear, ringbuf_spsc_available and
+ * ringbuf_spsc_clear.
+ * Return codes are the same as for ringbuf.
+ */
+
+#ifndef RINGBUF_SPSC_H_
+#define RINGBUF_SPSC_H_
+
+#include "system.h"
+#include "ringbuf.h"
+
+typedef struct {
+  u8_t *buffer;
+  // written by consumer only
+  volatile u32_t r_ix;
+  // written by producer only
+  volatile u32_t w_ix;
+  u32_t mask;
+  u16_t max_len;
+} ringbuf_spsc;
+
+/* Initiates a ring buffer, max_len must be a power of two */
+void ringbuf_spsc_init(ringbuf_spsc *rb, u8_t *buffer, u16_t max_len);
+/* Returns a character from ringbuffer
+   @returns RB_OK or RB_ERR_EMPTY
+ */
+int ringbuf_spsc_getc(ringbuf_spsc *rb, u8_t *c);
+/* Puts a character into ringbuffer
+   @returns RB_OK or RB_ERR_FULL
+ */
+int ringbuf_spsc_putc(ringbuf_spsc *rb, u8_t c);
+/* Returns a region of data from ringbuffer
+   @param buf can be null, whereas the read pointer is simply advanced
+   @returns number of actual bytes returned or RB_ERR_EMPTY
+ */
+int ringbuf_spsc_get(ringbuf_spsc *rb, u8_t *buf, u16_t len);
+/* Writes a region of data into ringbuffer.
+   @returns number of actual bytes written or RB_ERR_FULL
+ */
+int ringbuf_spsc_put(ringbuf_spsc *rb, const u8_t *buf, u16_t len);
+/* Returns current write capacity of ringbuffer */
+int ringbuf_spsc_free(ringbuf_spsc *rb);
+/* Returns current read capacity of ringbuffer */
+int ringbuf_spsc_available(ringbuf_spsc *rb);
+/* Returns linear read capacity and pointer to buffer.
+   The read pointer can be advanced by calling ringbuf_spsc_get with
+   null argument for buf.
+ */
+int ringbuf_spsc_available_linear(ringbuf_spsc *rb, u8_t **ptr);
+/* Returns linear write capacity and pointer to buffer. Data
+   written to the pointer is not readable until ringbuf_spsc_commit
+   is called. Meant for filling the buffer directly, e.g. by dma.
+ */
+int ringbuf_spsc_reserve_linear(ringbuf_spsc *rb, u8_t **ptr);
+/* Advances the write pointer after data has been written to the
+   pointer returned by ringbuf_spsc_reserve_linear.
+   @returns number of bytes committed or RB_ERR_FULL
+ */
+int ringbuf_spsc_commit(ringbuf_spsc *rb, u16_t len);
+/* Discards all readable data. Consumer side, a producer wanting to
+   empty the buffer must have the consumer do it.
+   @returns number of bytes discarded
+ */
+int ringbuf_spsc_clear(ringbuf_spsc *rb);
+
+#endif /* RINGBUF_SPSC_H_ */
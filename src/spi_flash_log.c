@@ -0,0 +1,412 @@
+/*
+ * spi_flash_log.c
+ *
+ * Append only log on spi flash.
+ */
+
+#include "spi_flash_log.h"
+#include "miniutils.h"
+
+#define SFL_PAGE      CONFIG_SPI_FLASH_LOG_PAGE
+
+enum sfl_op {
+  SFL_OP_IDLE = 0,
+  SFL_OP_ERASE,
+  SFL_OP_WRITE,
+  SFL_OP_READ,
+};
+
+static spi_flash_log *sfl_logs[CONFIG_SPI_FLASH_LOG_MAX];
+
+static void sfl_exec(spi_flash_log *log);
+
+// Returns offset advanced by n.
+static u32_t sfl_offs(spi_flash_log *log, u32_t offs, u32_t n) {
+  offs += n;
+  return offs >= 2 * log->size ? offs - 2 * log->size : offs;
+}
+
+// Returns distance from offset b up to offset a.
+static u32_t sfl_dist(spi_flash_log *log, u32_t a, u32_t b) {
+  return a >= b ? a - b : a + 2 * log->size - b;
+}
+
+// Returns whether offset is at start of a bad sector.
+static bool sfl_at_bad(spi_flash_log *log, u32_t offs) {
+  if (offs % log->sector) {
+    return FALSE;
+  }
+  u32_t s = (offs % log->size) / log->sector;
+  return (log->bad_map[s / 32] & (1 << (s & 31))) != 0;
+}
+
+// Moves offset over bad sectors.
+static u32_t sfl_skip_bad(spi_flash_log *log, u32_t offs) {
+  while (sfl_at_bad(log, offs)) {
+    offs = sfl_offs(log, offs, log->sector);
+  }
+  return offs;
+}
+
+// Moves read cursor to oldest data if it was lost. Must be called in
+// critical.
+static void sfl_clamp_rd(spi_flash_log *log) {
+  if (sfl_dist(log, log->wr, log->rd) > sfl_dist(log, log->wr, log->tail)) {
+    log->lost += sfl_dist(log, log->tail, log->rd);
+    log->rd = log->tail;
+    log->rx_len = 0;
+    log->rx_ix = 0;
+  }
+}
+
+// Moves erase head past its sector, erased or bad, losing the data a lap
+// behind. Must be called in critical.
+static void sfl_erased_advance(spi_flash_log *log) {
+  log->erased = sfl_offs(log, log->erased, log->sector);
+  if (sfl_dist(log, log->erased, log->tail) > log->size) {
+    log->tail = sfl_skip_bad(log, sfl_offs(log, log->erased, log->size));
+    sfl_clamp_rd(log);
+  }
+}
+
+// Moves write head over bad sectors, and erase head along if not ahead.
+// Must be called in critical.
+static void sfl_wr_skip_bad(spi_flash_log *log) {
+  while (sfl_at_bad(log, log->wr)) {
+    if (log->erased == log->wr) {
+      sfl_erased_advance(log);
+    } else {
+      log->bad_ahead--;
+    }
+    log->wr = sfl_offs(log, log->wr, log->sector);
+  }
+}
+
+// Marks sector at erase head bad unless that would leave less than two
+// good sectors. Must be called in critical.
+static bool sfl_mark_bad(spi_flash_log *log) {
+  u32_t s = (log->erased % log->size) / log->sector;
+  if (log->bad_sectors + 2 >= log->size / log->sector) {
+    return FALSE;
+  }
+  log->bad_map[s / 32] |= (1 << (s & 31));
+  log->bad_sectors++;
+  return TRUE;
+}
+
+// Returns free space in staging buffer taking writes. A batch never
+// crosses a page.
+static u16_t sfl_fill_room(spi_flash_log *log) {
+  u8_t f = log->tx_fill;
+  u32_t start = log->wr + log->tx_len[f ^ 1];
+  return SFL_PAGE - (start % SFL_PAGE) - log->tx_len[f];
+}
+
+// Hands over staging buffer taking writes for programming if other is
+// free. Must be called in critical.
+static void sfl_swap(spi_flash_log *log) {
+  u8_t f = log->tx_fill;
+  if (log->tx_len[f] && log->tx_len[f ^ 1] == 0) {
+    log->tx_fill = f ^ 1;
+  }
+}
+
+// Schedules flash operations unless already going. Must be called in
+// critical.
+static void sfl_kick(spi_flash_log *log) {
+  if (log->op == SFL_OP_IDLE && !log->retry && !TASK_is_running(log->task)) {
+    TASK_run(log->task, 0, log);
+  }
+}
+
+static void sfl_task_f(u32_t arg, void *arg_p) {
+  spi_flash_log *log = (spi_flash_log *)arg_p;
+  log->retry = FALSE;
+  sfl_exec(log);
+}
+
+static void sfl_op_done(spi_flash_log *log, int res) {
+  bool again = FALSE;
+  enter_critical();
+  if (res != SPI_OK) {
+    log->errors++;
+    log->last_err = res;
+  }
+  switch (log->op) {
+  case SFL_OP_ERASE:
+    log->erases++;
+    if (res != SPI_OK) {
+      log->erase_fails++;
+      if (sfl_mark_bad(log)) {
+        log->bad_ahead++;
+      } else {
+        // too few good sectors left, try again later
+        again = TRUE;
+        break;
+      }
+    }
+    sfl_erased_advance(log);
+    // write head may be waiting at the failed sector
+    sfl_wr_skip_bad(log);
+    break;
+  case SFL_OP_WRITE:
+    log->wr = sfl_offs(log, log->wr, log->op_len);
+    sfl_wr_skip_bad(log);
+    log->tx_len[log->tx_fill ^ 1] = 0;
+    log->pages++;
+    if (sfl_fill_room(log) == 0) {
+      sfl_swap(log);
+    }
+    break;
+  case SFL_OP_READ:
+    // discard if cursor was moved meanwhile
+    if (res == SPI_OK && log->op_offs == log->rd) {
+      log->rx_len = log->op_len;
+      log->rx_ix = 0;
+    }
+    break;
+  }
+  log->op = SFL_OP_IDLE;
+  if (again) {
+    log->retry = TRUE;
+  } else {
+    sfl_kick(log);
+  }
+  exit_critical();
+  if (again) {
+    TASK_start_timer(log->task, &log->timer, 0, log, 1, 0, "sflog");
+  }
+}
+
+static void sfl_flash_cb(spi_flash_dev *dev, int res) {
+  u8_t i;
+  for (i = 0; i < CONFIG_SPI_FLASH_LOG_MAX; i++) {
+    spi_flash_log *log = sfl_logs[i];
+    if (log && log->sfd == dev && log->op != SFL_OP_IDLE) {
+      sfl_op_done(log, res);
+      return;
+    }
+  }
+}
+
+// Starts next flash operation: erase ahead of write head when less than a
+// sector is left erased, else program a staged batch, else prefetch from
+// read cursor.
+static void sfl_exec(spi_flash_log *log) {
+  int res = SPI_OK;
+  u32_t offs = 0;
+  u8_t *buf = NULL;
+  enter_critical();
+  if (log->op != SFL_OP_IDLE) {
+    exit_critical();
+    return;
+  }
+  if (log->tx_flush && log->tx_len[log->tx_fill ^ 1] == 0) {
+    sfl_swap(log);
+    log->tx_flush = FALSE;
+  }
+  u16_t pending = log->tx_len[log->tx_fill ^ 1];
+  // bad sectors ahead are not counted as erased
+  while (sfl_dist(log, log->erased, log->wr) - log->bad_ahead * log->sector <= log->sector &&
+      sfl_at_bad(log, log->erased)) {
+    log->bad_ahead++;
+    sfl_erased_advance(log);
+  }
+  if (sfl_dist(log, log->erased, log->wr) - log->bad_ahead * log->sector <= log->sector) {
+    log->op = SFL_OP_ERASE;
+    offs = log->erased;
+    // erasing oldest sector, move read cursor past it
+    if (sfl_dist(log, sfl_offs(log, log->erased, log->sector), log->tail) > log->size) {
+      log->tail = sfl_skip_bad(log, sfl_offs(log, log->erased, log->sector + log->size));
+      sfl_clamp_rd(log);
+    }
+  } else if (pending) {
+    log->op = SFL_OP_WRITE;
+    log->op_len = pending;
+    offs = log->wr;
+    buf = log->tx_buf[log->tx_fill ^ 1];
+  } else if (log->rx_ix == log->rx_len && log->rd != log->wr) {
+    log->op = SFL_OP_READ;
+    offs = log->rd;
+    // within sector, as next may be bad
+    log->op_len = MIN(MIN(SFL_PAGE, sfl_dist(log, log->wr, log->rd)), log->sector - offs % log->sector);
+    log->rx_len = 0;
+    log->rx_ix = 0;
+    buf = log->rx_buf;
+  }
+  log->op_offs = offs;
+  exit_critical();
+
+  u32_t addr = log->addr + offs % log->size;
+  switch (log->op) {
+  case SFL_OP_ERASE:
+    res = SPI_FLASH_erase(log->sfd, sfl_flash_cb, addr, log->sector);
+    break;
+  case SFL_OP_WRITE:
+    res = SPI_FLASH_write(log->sfd, sfl_flash_cb, addr, log->op_len, buf);
+    break;
+  case SFL_OP_READ:
+    res = SPI_FLASH_read(log->sfd, sfl_flash_cb, addr, log->op_len, buf);
+    break;
+  default:
+    return;
+  }
+  if (res == SPI_FLASH_ERR_BUSY) {
+    // flash used by someone else, retry later
+    enter_critical();
+    log->op = SFL_OP_IDLE;
+    log->retry = TRUE;
+    exit_critical();
+    TASK_start_timer(log->task, &log->timer, 0, log, 1, 0, "sflog");
+  } else if (res != SPI_OK) {
+    sfl_op_done(log, res);
+  }
+}
+
+void SFL_init(spi_flash_log *log, spi_flash_dev *sfd, u32_t addr, u32_t size) {
+  u8_t i;
+  memset(log, 0, sizeof(spi_flash_log));
+  log->sfd = sfd;
+  log->addr = addr;
+  log->size = size;
+  log->sector = sfd->flash_conf.size_sector_erase_min;
+  ASSERT((sfd->flash_conf.size_page_write_max % SFL_PAGE) == 0);
+  ASSERT((addr % log->sector) == 0);
+  ASSERT((size % log->sector) == 0);
+  ASSERT(size >= 2 * log->sector);
+  ASSERT(size / log->sector <= CONFIG_SPI_FLASH_LOG_SECTORS);
+  ASSERT(size <= 0x80000000);
+  log->task = TASK_create(sfl_task_f, TASK_STATIC);
+  ASSERT(log->task);
+  for (i = 0; i < CONFIG_SPI_FLASH_LOG_MAX; i++) {
+    if (sfl_logs[i] == NULL || sfl_logs[i] == log) {
+      sfl_logs[i] = log;
+      break;
+    }
+  }
+  ASSERT(i < CONFIG_SPI_FLASH_LOG_MAX);
+  // start erasing ahead
+  enter_critical();
+  sfl_kick(log);
+  exit_critical();
+}
+
+s32_t SFL_write(spi_flash_log *log, const u8_t *buf, u16_t len) {
+  s32_t taken = 0;
+  enter_critical();
+  while (len > 0) {
+    u8_t f = log->tx_fill;
+    u16_t room = sfl_fill_room(log);
+    if (room == 0) {
+      if (log->tx_len[f ^ 1]) {
+        break;
+      }
+      log->tx_fill = f ^ 1;
+      continue;
+    }
+    u16_t n = MIN(room, len);
+    memcpy(&log->tx_buf[f][log->tx_len[f]], buf, n);
+    log->tx_len[f] += n;
+    buf += n;
+    len -= n;
+    taken += n;
+  }
+  if (sfl_fill_room(log) == 0) {
+    sfl_swap(log);
+  }
+  log->bytes += taken;
+  log->dropped += len;
+  if (log->tx_len[log->tx_fill ^ 1]) {
+    sfl_kick(log);
+  }
+  exit_critical();
+  return taken;
+}
+
+void SFL_flush(spi_flash_log *log) {
+  enter_critical();
+  log->tx_flush = TRUE;
+  sfl_kick(log);
+  exit_critical();
+}
+
+void SFL_drain(spi_flash_log *log) {
+  enter_critical();
+  log->tx_len[log->tx_fill] = 0;
+  log->tx_flush = FALSE;
+  exit_critical();
+}
+
+s32_t SFL_read(spi_flash_log *log, u8_t *buf, u16_t len) {
+  enter_critical();
+  u16_t n = MIN(len, log->rx_len - log->rx_ix);
+  if (buf) {
+    memcpy(buf, &log->rx_buf[log->rx_ix], n);
+  }
+  log->rx_ix += n;
+  log->rd = sfl_skip_bad(log, sfl_offs(log, log->rd, n));
+  if (log->rx_ix == log->rx_len && log->rd != log->wr) {
+    sfl_kick(log);
+  }
+  exit_critical();
+  return n;
+}
+
+s32_t SFL_peek_linear(spi_flash_log *log, u8_t **ptr) {
+  enter_critical();
+  s32_t n = log->rx_len - log->rx_ix;
+  *ptr = &log->rx_buf[log->rx_ix];
+  if (n == 0 && log->rd != log->wr) {
+    sfl_kick(log);
+  }
+  exit_critical();
+  return n;
+}
+
+s32_t SFL_consume(spi_flash_log *log, u16_t len) {
+  return SFL_read(log, NULL, len);
+}
+
+void SFL_rewind(spi_flash_log *log) {
+  enter_critical();
+  log->rd = log->tail;
+  log->rx_len = 0;
+  log->rx_ix = 0;
+  sfl_kick(log);
+  exit_critical();
+}
+
+s32_t SFL_rx_available(spi_flash_log *log) {
+  return log->rx_len - log->rx_ix;
+}
+
+s32_t SFL_tx_available(spi_flash_log *log) {
+  s32_t avail;
+  enter_critical();
+  avail = sfl_fill_room(log);
+  if (log->tx_len[log->tx_fill ^ 1] == 0) {
+    avail += SFL_PAGE;
+  }
+  exit_critical();
+  return avail;
+}
+
+void SFL_dump(u8_t io, spi_flash_log *log) {
+  u32_t sectors = log->size / log->sector;
+  u32_t s;
+  ioprint(io, "sflog %08x+%08x  wr:%i  rd:%i  erased:%i  tail:%i  staged:%i+%i  op:%i\n",
+      log->addr, log->size, log->wr, log->rd, log->erased, log->tail,
+      log->tx_len[log->tx_fill ^ 1], log->tx_len[log->tx_fill], log->op);
+  ioprint(io, "  bytes:%i  dropped:%i  lost:%i  pages:%i  erases:%i (%i/sector)  errors:%i  last err:%i\n",
+      log->bytes, log->dropped, log->lost, log->pages, log->erases, log->erases / sectors,
+      log->errors, log->last_err);
+  if (log->bad_sectors) {
+    ioprint(io, "  erase fails:%i  bad sectors:%i ", log->erase_fails, log->bad_sectors);
+    for (s = 0; s < sectors; s++) {
+      if (log->bad_map[s / 32] & (1 << (s & 31))) {
+        ioprint(io, " %08x", log->addr + s * log->sector);
+      }
+    }
+    ioprint(io, "\n");
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ * spi_flash_log.h
+ *
+ * Append only log on a region of a spi flash, for streaming e.g. debug or
+ * telemetry output to flash. Used as io_file media by io, see IO_define.
+ *
+ * Written data is staged in ram and programmed by SPI_FLASH_write in
+ * batches not crossing a page, while next batch is filled. Sectors are
+ * erased ahead of the write head, so writing rarely waits for an erase.
+ * The region is used circularly, the oldest data being erased when the
+ * log wraps.
+ * Programmed data is read back from a read cursor, prefetched to ram a
+ * batch at a time.
+ *
+ * All flash operations are run by a task, so writing and reading never
+ * block. Data written while both staging buffers are full is dropped and
+ * counted.
+ * A sector failing to erase is marked bad and skipped by writing and
+ * reading from then on, as long as two good sectors remain.
+ * The log is empty after SFL_init, whatever the region contains, and no
+ * sector is known to be bad.
+ */
+
+#ifndef SPI_FLASH_LOG_H_
+#define SPI_FLASH_LOG_H_
+
+#include "system.h"
+#include "spi_flash.h"
+#include "taskq.h"
+
+/* Size of staging and prefetch buffers. Must divide the flash page size */
+#ifndef CONFIG_SPI_FLASH_LOG_PAGE
+#define CONFIG_SPI_FLASH_LOG_PAGE   256
+#endif
+
+/* Max number of logs */
+#ifndef CONFIG_SPI_FLASH_LOG_MAX
+#define CONFIG_SPI_FLASH_LOG_MAX    1
+#endif
+
+/* Max number of sectors in a log region, for the bad sector map */
+#ifndef CONFIG_SPI_FLASH_LOG_SECTORS
+#define CONFIG_SPI_FLASH_LOG_SECTORS  256
+#endif
+
+typedef struct {
+  spi_flash_dev *sfd;
+  // flash region, in whole sectors
+  u32_t addr;
+  u32_t size;
+  u32_t sector;
+  task *task;
+  task_timer timer;
+  // log offsets modulo twice the size, so they never overflow and the
+  // distance between two is unambiguous. Flash address is
+  // addr + offset % size. Programmed up to wr, erased up to erased, read
+  // up to rd, oldest data at tail
+  u32_t wr;
+  u32_t erased;
+  u32_t rd;
+  u32_t tail;
+  // bad sectors, and how many of them are between wr and erased
+  u32_t bad_map[(CONFIG_SPI_FLASH_LOG_SECTORS + 31) / 32];
+  u16_t bad_sectors;
+  u16_t bad_ahead;
+  // staging, tx_fill takes writes while the other is programmed
+  u8_t tx_buf[2][CONFIG_SPI_FLASH_LOG_PAGE];
+  volatile u16_t tx_len[2];
+  volatile u8_t tx_fill;
+  volatile bool tx_flush;
+  // prefetched data from rd
+  u8_t rx_buf[CONFIG_SPI_FLASH_LOG_PAGE];
+  volatile u16_t rx_len;
+  volatile u16_t rx_ix;
+  // ongoing flash operation
+  volatile u8_t op;
+  u32_t op_offs;
+  u16_t op_len;
+  bool retry;
+  // stats
+  u32_t bytes;
+  u32_t dropped;
+  // unread bytes lost when oldest data was erased
+  u32_t lost;
+  u32_t pages;
+  u32_t erases;
+  u32_t erase_fails;
+  u32_t errors;
+  s32_t last_err;
+} spi_flash_log;
+
+/* Initiates a log on given flash region. Region must be sector aligned and
+   span at least two, at most CONFIG_SPI_FLASH_LOG_SECTORS sectors. Flash
+   must be opened by caller.
+ */
+void SFL_init(spi_flash_log *log, spi_flash_dev *sfd, u32_t addr, u32_t size);
+/* Appends data to log.
+   @returns number of bytes taken, rest being dropped if staging is full
+ */
+s32_t SFL_write(spi_flash_log *log, const u8_t *buf, u16_t len);
+/* Programs partially filled staging buffer too, without blocking */
+void SFL_flush(spi_flash_log *log);
+/* Discards data not yet being programmed */
+void SFL_drain(spi_flash_log *log);
+/* Reads data from read cursor.
+   @returns number of bytes read, 0 if nothing is prefetched yet
+ */
+s32_t SFL_read(spi_flash_log *log, u8_t *buf, u16_t len);
+/* Returns number of prefetched bytes readable at ptr, without consuming */
+s32_t SFL_peek_linear(spi_flash_log *log, u8_t **ptr);
+/* Advances read cursor over prefetched bytes, e.g. after peeking */
+s32_t SFL_consume(spi_flash_log *log, u16_t len);
+/* Moves read cursor to oldest data in log */
+void SFL_rewind(spi_flash_log *log);
+/* Returns number of bytes readable without waiting */
+s32_t SFL_rx_available(spi_flash_log *log);
+/* Returns number of bytes writable without dropping */
+s32_t SFL_tx_available(spi_flash_log *log);
+/* Prints state, write/erase statistics and bad sectors */
+void SFL_dump(u8_t io, spi_flash_log *log);
+
+#endif /* SPI_FLASH_LOG_H_ */
@@ -54,6 +54,19 @@ static struct {
   volatile u8_t time_h;
   volatile u16_t time_d;
 #endif
+#ifdef CONFIG_SYS_TICKLESS
+  gen_tim *idle_tim;
+  // generic timer tick and system clock tick of first wakeup, slept time
+  // being derived from these
+  bool idle_anchored;
+  tick idle_anchor;
+  sys_time idle_anchor_time;
+  // remainder at anchor, in 1/CONFIG_SYS_TICKLESS_TIMER_FREQ timer ticks
+  u64_t idle_frac;
+  sys_time idle_ticks;
+  sys_time idle_stat_start;
+  u32_t idle_sleeps;
+#endif
 } sys;
 
 bool SYS_timer() {
@@ -92,6 +105,128 @@ bool SYS_timer() {
   return r;
 }
 
+void SYS_timer_advance(u32_t ticks) {
+#if defined(CONFIG_RTC) && defined(CONFIG_SYS_USE_RTC)
+  (void)ticks;
+#else
+  enter_critical();
+  sys.time_tick += ticks;
+  sys_time sub = sys.time_sub + ticks;
+  u32_t ms = sub / (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ);
+  sys.time_sub = sub % (SYS_MAIN_TIMER_FREQ / SYS_TIMER_TICK_FREQ);
+  sys.time_ms_c += ms;
+  // carry through calendar
+  u32_t c = sys.time_ms + ms;
+  sys.time_ms = c % 1000;
+  c = c / 1000 + sys.time_s;
+  sys.time_s = c % 60;
+  c = c / 60 + sys.time_m;
+  sys.time_m = c % 60;
+  c = c / 60 + sys.time_h;
+  sys.time_h = c % 24;
+  sys.time_d += c / 24;
+  exit_critical();
+#endif
+}
+
+#ifdef CONFIG_SYS_TICKLESS
+void SYS_tickless_init(gen_tim *tim) {
+  sys.idle_tim = tim;
+  sys.idle_anchored = FALSE;
+  sys.idle_frac = 0;
+  SYS_idle_stats_reset();
+}
+
+void SYS_idle(void) {
+  enter_critical();
+  sys_time now = SYS_get_time_ms();
+  sys_time wake = now + CONFIG_SYS_TICKLESS_MAX_MS;
+  bool busy = FALSE;
+#ifdef CONFIG_TASK_QUEUE
+  {
+    sys_time t;
+    busy |= TASK_got_active_tasks();
+    if (TASK_next_wakeup_ms(&t, NULL) == 0) {
+      wake = MIN(wake, t);
+    }
+  }
+#endif
+#ifdef CONFIG_OS
+  {
+    sys_time t;
+    switch (OS_get_next_wakeup(&t)) {
+    case OS_WUP_SLEEP:
+      wake = MIN(wake, t);
+      break;
+    case OS_WUP_SLEEP_FOREVER:
+      break;
+    default:
+      busy = TRUE;
+      break;
+    }
+  }
+#endif
+  if (busy) {
+    exit_critical();
+    return;
+  }
+  if (sys.idle_tim == NULL || wake < now + CONFIG_SYS_TICKLESS_MIN_MS) {
+    exit_critical();
+    arch_sleep();
+    return;
+  }
+
+  SYS_hal_tick_suspend();
+  tick start = timer_get(sys.idle_tim);
+  timer_set_wakeup(sys.idle_tim,
+      start + ((tick)(wake - now) * CONFIG_SYS_TICKLESS_TIMER_FREQ) / 1000);
+  // wakes on pending irq even if masked
+  arch_sleep();
+  // let pending irqs be serviced, generic timer overflow included
+  exit_critical();
+  enter_critical();
+  tick end = timer_get(sys.idle_tim);
+  timer_abort_wakeup(sys.idle_tim);
+
+  // compensate clock. Sleep starts at an unknown fraction of a generic
+  // timer tick, while wakeup is on a tick edge. Hence, the clock is
+  // derived from generic timer ticks since the first wakeup instead of
+  // adding each sleep, which would drift by the fraction every time.
+  u32_t ticks;
+  sys_time now_tick = SYS_get_tick();
+  if (!sys.idle_anchored) {
+    u64_t acc = (u64_t)(end - start) * SYS_MAIN_TIMER_FREQ;
+    ticks = (u32_t)(acc / CONFIG_SYS_TICKLESS_TIMER_FREQ);
+    sys.idle_frac = acc % CONFIG_SYS_TICKLESS_TIMER_FREQ;
+    sys.idle_anchor = end;
+    sys.idle_anchor_time = now_tick + ticks;
+    sys.idle_anchored = TRUE;
+  } else {
+    u64_t acc = (u64_t)(end - sys.idle_anchor) * SYS_MAIN_TIMER_FREQ + sys.idle_frac;
+    sys_time wake_tick = sys.idle_anchor_time + acc / CONFIG_SYS_TICKLESS_TIMER_FREQ;
+    // never go back, e.g. if main timer runs faster than generic timer
+    ticks = wake_tick > now_tick ? (u32_t)(wake_tick - now_tick) : 0;
+  }
+  SYS_timer_advance(ticks);
+  sys.idle_ticks += ticks;
+  sys.idle_sleeps++;
+  SYS_hal_tick_resume();
+  exit_critical();
+}
+
+void SYS_idle_stats(sys_time *idle_ticks, sys_time *total_ticks, u32_t *sleeps) {
+  if (idle_ticks) *idle_ticks = sys.idle_ticks;
+  if (total_ticks) *total_ticks = SYS_get_tick() - sys.idle_stat_start;
+  if (sleeps) *sleeps = sys.idle_sleeps;
+}
+
+void SYS_idle_stats_reset(void) {
+  sys.idle_ticks = 0;
+  sys.idle_sleeps = 0;
+  sys.idle_stat_start = SYS_get_tick();
+}
+#endif // CONFIG_SYS_TICKLESS
+
 void SYS_init() {
   memset(&sys, 0, sizeof(sys));
 #ifdef DBG_TRACE_MON
@@ -198,6 +333,11 @@ void SYS_assert(const char* file, int line) {
     SYS_reboot(REBOOT_ASSERT);
   }
 
+#ifdef ARCH_HOST
+  // nothing to blink on host, end the simulation as failed
+  exit(EXIT_FAILURE);
+#endif
+
   const int ASSERT_BLINK = 0x100000;
   volatile int asserted;
   while (1) {
@@ -218,6 +358,9 @@ void SYS_hardsleep_ms(u32_t ms) {
 #if defined(CONFIG_RTC) && defined(CONFIG_SYS_USE_RTC)
   u64_t tick_release = RTC_get_tick() + RTC_MS_TO_TICK((u64_t)ms);
   while (RTC_get_tick() < tick_release);
+#elif defined(ARCH_HOST)
+  // clock only advances when busy waiting
+  arch_busywait_us(ms * 1000);
 #else
   sys_time release = SYS_get_time_ms() + ms;
   while (SYS_get_time_ms() < release);
@@ -256,11 +399,11 @@ extern char __BUILD_DATE;
 extern char __BUILD_NUMBER;
 
 u32_t SYS_build_number() {
-  return (u32_t)&__BUILD_NUMBER;
+  return (u32_t)(uintptr_t)&__BUILD_NUMBER;
 }
 
 u32_t SYS_build_date() {
-  return (u32_t)&__BUILD_DATE;
+  return (u32_t)(uintptr_t)&__BUILD_DATE;
 }
 
 __attribute__ (( noreturn )) void SYS_reboot(enum reboot_reason_e r) {
@@ -47,6 +47,11 @@ extern void *_variadic_call(void *func, int argc, void* args);
 extern int _sqrt(int);
 #endif
 
+#ifdef ARCH_HOST
+typedef void * hw_io_port;
+typedef u16_t hw_io_pin;
+#endif
+
 #ifdef PROC_FAMILY_STM32
 typedef GPIO_TypeDef * hw_io_port;
 typedef uint16_t hw_io_pin;
@@ -97,6 +102,12 @@ void SYS_init();
  * the system clock ticking.
  */
 bool SYS_timer();
+/**
+ * Advances system clock given number of timer ticks at once, same as calling
+ * SYS_timer as many times. Used to compensate for time when timer irq has
+ * been suspended. On CONFIG_SYS_USE_RTC, this does nothing.
+ */
+void SYS_timer_advance(u32_t ticks);
 /**
  * Get milliseconds since system clock start
  */
@@ -125,4 +136,49 @@ void SYS_break_if_dbg(void);
 void SYS_dump_trace(u8_t io);
 void SYS_reboot(enum reboot_reason_e);
 
+#ifdef CONFIG_SYS_TICKLESS
+#include "gen_timer.h"
+
+/* Frequency of the generic timer used as timebase when idling tickless */
+#ifndef CONFIG_SYS_TICKLESS_TIMER_FREQ
+#error "CONFIG_SYS_TICKLESS needs CONFIG_SYS_TICKLESS_TIMER_FREQ"
+#endif
+/* Longest tickless sleep in ms */
+#ifndef CONFIG_SYS_TICKLESS_MAX_MS
+#define CONFIG_SYS_TICKLESS_MAX_MS    1000
+#endif
+/* If next wakeup is nearer than this in ms, the timer tick is kept */
+#ifndef CONFIG_SYS_TICKLESS_MIN_MS
+#define CONFIG_SYS_TICKLESS_MIN_MS    2
+#endif
+
+/**
+ * Sets the generic timer used as timebase when idling tickless. The timer
+ * must keep running and be able to wake the processor while the main timer
+ * tick is suspended.
+ */
+void SYS_tickless_init(gen_tim *tim);
+/**
+ * Idles until next task timer or OS thread wakeup, or until any irq. The
+ * main timer tick is suspended and the generic timer is programmed to wake
+ * the processor. On wakeup, the system clock is advanced by the time slept.
+ * If there are pending tasks or running threads, this returns directly. If
+ * the next wakeup is nearer than CONFIG_SYS_TICKLESS_MIN_MS, this only calls
+ * arch_sleep. Must not be called from within a critical section.
+ */
+void SYS_idle(void);
+/**
+ * Returns timer ticks spent in tickless sleep and timer ticks elapsed
+ * since start or last SYS_idle_stats_reset, and number of tickless sleeps.
+ */
+void SYS_idle_stats(sys_time *idle_ticks, sys_time *total_ticks, u32_t *sleeps);
+void SYS_idle_stats_reset(void);
+
+// implement these
+// stop the main timer tick irq without resetting the counter
+void SYS_hal_tick_suspend(void);
+// restart the main timer tick irq
+void SYS_hal_tick_resume(void);
+#endif
+
 #endif /* SYSTEM_H_ */
@@ -687,7 +687,7 @@ static const char* const TRACE_NAMES[] = {
 #define TRACE_IRQ_EXIT(irq)         TRACE_LOG(_TRC_OP_IRQ_EXIT, irq+5)
 #else
 #define TRACE_IRQ_ENTER(irq)        TRACE_LOG(_TRC_OP_IRQ_ENTER, (irq))
-#define TRACE_IRQ_ENTER(irq)        TRACE_LOG(_TRC_OP_IRQ_EXIT, (irq))
+#define TRACE_IRQ_EXIT(irq)         TRACE_LOG(_TRC_OP_IRQ_EXIT, (irq))
 #endif
 
 #define TRACE_IRQ_ON(l)             //TRACE_LOG(_TRC_OP_IRQ_ON, l)
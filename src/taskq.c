@@ -13,22 +13,101 @@
 #include "os.h"
 #endif
 
-static struct {
-  volatile task* head;
-  volatile task* last;
+// run queue of a worker
+typedef struct {
+  // run queue per priority level
+  volatile task* head[CONFIG_TASK_PRIO_LEVELS];
+  volatile task* last[CONFIG_TASK_PRIO_LEVELS];
+  // bitmap of non-empty priority levels
+  volatile u32_t prio_map;
   task* current;
+#if CONFIG_TASK_WORKERS > 1
+  // thread registered as this worker
+  void *thread;
+  // number of dispatched tasks, and how many of these were stolen
+  u32_t runs;
+  u32_t steals;
+#endif
+} task_queue;
+
+static struct {
+  task_queue q[CONFIG_TASK_WORKERS];
+#if CONFIG_TASK_WORKERS > 1
+  // worker getting next task scheduled from outside the workers
+  u8_t rr;
+#ifdef CONFIG_ARCH_HOST_SMP
+  // number of workers waiting for an event in TASK_wait
+  u8_t waiting;
+#endif
+#endif
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  task_timer *wheel[CONFIG_TASK_TIMER_WHEEL_SLOTS];
+  u32_t wheel_map[CONFIG_TASK_TIMER_WHEEL_SLOTS/32];
+  // time of next slot to be processed by TASK_timer
+  sys_time wheel_time;
+  u32_t wheel_count;
+  // earliest timer in wheel, NULL if not known
+  task_timer *wheel_min;
+#else
   task_timer *first_timer;
+#endif
   volatile bool tim_lock;
 #ifdef CONFIG_OS
-  os_cond cond;
+  os_flags flags;
 #endif
 } task_sys;
 
+// event flag set when a task is scheduled
+#define TASK_OS_FLAG_RUN      (1<<0)
+
+#define TASK_POOL_WORDS       (((CONFIG_TASK_POOL-1)/32)+1)
+#define TASK_POOL_SUM_WORDS   (((TASK_POOL_WORDS-1)/32)+1)
+
+// Free tasks are marked by set bits in mask. Each bit in sum tells
+// if corresponding mask word has any free task. For pools > 1024 tasks,
+// each bit in top tells if corresponding sum word has any free task.
+// Hence, finding a free task is O(1) using clz/ctz.
 static struct {
   task task[CONFIG_TASK_POOL];
-  u32_t mask[((CONFIG_TASK_POOL-1)/32)+1];
+  u32_t mask[TASK_POOL_WORDS];
+  u32_t sum[TASK_POOL_SUM_WORDS];
+#if TASK_POOL_SUM_WORDS > 1
+  u32_t top;
+#endif
 } task_pool;
 
+#if CONFIG_TASK_PRIO_LEVELS > 1
+// level of run queue the task is put in
+#define TASK_LEVEL(t)         ((t)->_lvl)
+#else
+#define TASK_LEVEL(t)         0
+#endif
+
+#if CONFIG_TASK_WORKERS > 1
+// queue the task is put in, or executed by
+#define TASK_QUEUE(t)         (&task_sys.q[(t)->_wq])
+#define TASK_SET_QUEUE(t, q)  do { (t)->_wq = (q) - &task_sys.q[0]; } while (0)
+// workers may preempt each other, so mutex state is guarded
+#define TQ_MUTEX_ENTER        enter_critical()
+#define TQ_MUTEX_EXIT         exit_critical()
+#ifdef CONFIG_OS
+#define TASK_THREAD_SELF()    OS_thread_self()
+#else
+// host smp, workers being plain host threads
+#define TASK_THREAD_SELF()    arch_host_thread_self()
+#endif
+#else
+#define TASK_QUEUE(t)         (&task_sys.q[0])
+#define TASK_SET_QUEUE(t, q)
+#define TQ_MUTEX_ENTER
+#define TQ_MUTEX_EXIT
+#endif
+
+#define TASK_POOL_MSB(x)      (31 - __builtin_clz(x))
+#define TASK_POOL_LSB(x)      (__builtin_ctz(x))
+#define TASK_POOL_IS_FREE(ix) \
+  ((task_pool.mask[(ix)/32] & (1<<((ix) & 0x1f))) != 0)
+
 #ifdef CONFIG_TASKQ_DBG_CRITICAL
 static volatile u8_t _crit = 0;
 #define TQ_ENTER_CRITICAL do {ASSERT(_crit == 0); _crit = 1;} while(0)
@@ -40,6 +119,17 @@ static volatile u8_t _crit = 0;
 
 volatile static u8_t _g_timer_ix = 0;
 
+#ifdef CONFIG_TASK_STATS
+static task_stat task_stats[CONFIG_TASK_STATS_ENTRIES];
+#endif
+
+#ifdef CONFIG_TASK_TIMER_WHEEL
+#if CONFIG_TASK_TIMER_WHEEL_SLOTS < 32 || (CONFIG_TASK_TIMER_WHEEL_SLOTS & (CONFIG_TASK_TIMER_WHEEL_SLOTS-1))
+#error "CONFIG_TASK_TIMER_WHEEL_SLOTS must be a power of two and at least 32"
+#endif
+#define TASK_WHEEL_MASK   (CONFIG_TASK_TIMER_WHEEL_SLOTS-1)
+static void task_remove_timer(task_timer *timer);
+#endif
 static void task_insert_timer(task_timer *timer, sys_time actual_time);
 
 static void print_task(u8_t io, task *t, const char *prefix) {
@@ -74,44 +164,89 @@ static void print_timer(u8_t io, task_timer *t, const char *prefix, sys_time now
         (u32_t)t->start_time,
         (u32_t)(t->start_time - now),
         (u32_t)(t->recurrent_time),
-        (u32_t)(t->_next),
+        (u32_t)(uintptr_t)(t->_next),
         t->name);
+#ifdef CONFIG_TASK_EDF
+    ioprint(io, "%s        deadline:%08x  missed:%i  overruns:%i\n",
+        prefix,
+        (u32_t)t->deadline,
+        t->missed,
+        t->overruns);
+#endif
     print_task(io, t->task, prefix);
   } else {
     ioprint(io, "%s NONE\n", prefix);
   }
 }
 
+static inline void task_pool_set_free(u32_t ix) {
+  u32_t w = ix/32;
+  task_pool.mask[w] |= (1<<(ix & 0x1f));
+  task_pool.sum[w/32] |= (1<<(w & 0x1f));
+#if TASK_POOL_SUM_WORDS > 1
+  task_pool.top |= (1<<(w/32));
+#endif
+}
+
+static inline void task_pool_set_used(u32_t ix) {
+  u32_t w = ix/32;
+  task_pool.mask[w] &= ~(1<<(ix & 0x1f));
+  if (task_pool.mask[w] == 0) {
+    task_pool.sum[w/32] &= ~(1<<(w & 0x1f));
+#if TASK_POOL_SUM_WORDS > 1
+    if (task_pool.sum[w/32] == 0) {
+      task_pool.top &= ~(1<<(w/32));
+    }
+#endif
+  }
+}
+
 #define TASK_DUMP_OUTPUT "  task list __ "
 #define TASK_TIM_DUMP_OUTPUT "  tmr list __ "
 void TASK_dump_pool(u8_t io) {
-  int i, j;
-  for (i = 0; i <= (CONFIG_TASK_POOL-1)/32; i++) {
-       if (task_pool.mask[i]) {
-         for (j = 0; j < 32; j++) {
-           int ix = i*32+j;
-           ioprint(io, "TASK %i @ %08x\n", ix, &task_pool.task[ix]);
-           print_task(io, &task_pool.task[ix], "");
-         }
-       }
-     }
+  int i;
+  for (i = 0; i < TASK_POOL_WORDS; i++) {
+    u32_t used = ~task_pool.mask[i];
+    while (used) {
+      int ix = i*32 + TASK_POOL_LSB(used);
+      used &= used - 1;
+      if (ix >= CONFIG_TASK_POOL) break;
+      ioprint(io, "TASK %i @ %08x\n", ix, &task_pool.task[ix]);
+      print_task(io, &task_pool.task[ix], "");
+    }
+  }
 }
 
 void TASK_dump(u8_t io) {
   ioprint(io, "TASK SYSTEM\n-----------\n");
-  print_task(io, task_sys.current, "  current");
 
   char lst[sizeof(TASK_DUMP_OUTPUT)];
   memcpy(lst, TASK_DUMP_OUTPUT, sizeof(TASK_DUMP_OUTPUT));
   char* p = (char*)strchr(lst, '_');
-  task* ct = (task *)task_sys.head;
-  int ix = 1;
-  while (ct) {
-    sprint(p, "%02i", ix++);
-    print_task(io, ct, lst);
-    ct = ct->_next;
+  int ix;
+  int lvl;
+  int w;
+  for (w = 0; w < CONFIG_TASK_WORKERS; w++) {
+    task_queue *q = &task_sys.q[w];
+#if CONFIG_TASK_WORKERS > 1
+    ioprint(io, "  worker %i  thread:%08x  runs:%i  steals:%i\n", w, q->thread, q->runs, q->steals);
+#endif
+    print_task(io, q->current, "  current");
+    for (lvl = CONFIG_TASK_PRIO_LEVELS-1; lvl >= 0; lvl--) {
+      task* ct = (task *)q->head[lvl];
+      if (ct == 0) continue;
+#if CONFIG_TASK_PRIO_LEVELS > 1
+      ioprint(io, "  prio %i\n", lvl);
+#endif
+      ix = 1;
+      while (ct) {
+        sprint(p, "%02i", ix++);
+        print_task(io, ct, lst);
+        ct = ct->_next;
+      }
+      print_task(io, (task *)q->last[lvl], "  last   ");
+    }
   }
-  print_task(io, (task *)task_sys.last, "  last   ");
 
   ioprint(io, "  pool bitmap ");
   for (ix = 0; ix < sizeof(task_pool.mask)/sizeof(task_pool.mask[0]); ix++) {
@@ -119,12 +254,13 @@ void TASK_dump(u8_t io) {
   }
   ioprint(io, "\n");
 
-  for (ix = 0; ix < sizeof(task_pool.mask)/sizeof(task_pool.mask[0]); ix++) {
-    int bit;
-    for (bit = 0; bit < 32; bit++) {
-      if ((task_pool.mask[ix] & (1<<bit)) == 0) {
-        print_task(io, &task_pool.task[ix*32 + bit], " ");
-      }
+  for (ix = 0; ix < TASK_POOL_WORDS; ix++) {
+    u32_t used = ~task_pool.mask[ix];
+    while (used) {
+      int tix = ix*32 + TASK_POOL_LSB(used);
+      used &= used - 1;
+      if (tix >= CONFIG_TASK_POOL) break;
+      print_task(io, &task_pool.task[tix], " ");
     }
   }
   ioprint(io, "\n");
@@ -133,63 +269,141 @@ void TASK_dump(u8_t io) {
   char lst2[sizeof(TASK_TIM_DUMP_OUTPUT)];
   memcpy(lst2, TASK_TIM_DUMP_OUTPUT, sizeof(TASK_TIM_DUMP_OUTPUT));
   p = (char*)strchr(lst2, '_');
-  task_timer* tt = task_sys.first_timer;
   ix = 1;
   sys_time now = SYS_get_time_ms();
-  while (tt) {
-    sprint(p, "%02i", ix++);
-    print_timer(io, tt, lst2, now);
-    tt = tt->_next;
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  int slot;
+  for (slot = 0; slot < CONFIG_TASK_TIMER_WHEEL_SLOTS; slot++) {
+    task_timer* tt = task_sys.wheel[slot];
+#else
+  {
+    task_timer* tt = task_sys.first_timer;
+#endif
+    while (tt) {
+      sprint(p, "%02i", ix++);
+      print_timer(io, tt, lst2, now);
+      tt = tt->_next;
+    }
+  }
+}
+
+#ifdef CONFIG_TASK_STATS
+// Returns stats entry + 1 for given task function, or 0 if table is full
+static u8_t task_stats_entry(task_f f) {
+  int i;
+  for (i = 0; i < CONFIG_TASK_STATS_ENTRIES; i++) {
+    if (task_stats[i].f == f) {
+      return i + 1;
+    }
+    if (task_stats[i].f == 0) {
+      task_stats[i].f = f;
+      task_stats[i].exe_min = U32_MAX;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static void task_stats_update(task *t, u32_t wait, u32_t exe) {
+  task_stat *st = &task_stats[t->_stat - 1];
+  st->runs++;
+  st->exe_total += exe;
+  st->exe_min = MIN(st->exe_min, exe);
+  st->exe_max = MAX(st->exe_max, exe);
+  st->wait_total += wait;
+  st->wait_max = MAX(st->wait_max, wait);
+  u32_t bin = wait == 0 ? 0 : MIN(32 - __builtin_clz(wait), CONFIG_TASK_STATS_BINS-1);
+  if (st->wait_hist[bin] < U16_MAX) {
+    st->wait_hist[bin]++;
   }
 }
 
+bool TASK_stats(u32_t entry, task_stat *stat) {
+  if (entry >= CONFIG_TASK_STATS_ENTRIES || task_stats[entry].f == 0) {
+    return FALSE;
+  }
+  enter_critical();
+  memcpy(stat, &task_stats[entry], sizeof(task_stat));
+  exit_critical();
+  return TRUE;
+}
+
+void TASK_stats_reset(void) {
+  int i;
+  enter_critical();
+  for (i = 0; i < CONFIG_TASK_STATS_ENTRIES; i++) {
+    task_f f = task_stats[i].f;
+    memset(&task_stats[i], 0, sizeof(task_stat));
+    task_stats[i].f = f;
+    task_stats[i].exe_min = U32_MAX;
+  }
+  exit_critical();
+}
+
+void TASK_dump_stats(u8_t io) {
+  int i, b;
+  ioprint(io, "TASK STATS\n----------\n");
+  for (i = 0; i < CONFIG_TASK_STATS_ENTRIES; i++) {
+    task_stat st;
+    if (!TASK_stats(i, &st)) break;
+    ioprint(io, "  f:%08x  runs:%i\n", st.f, st.runs);
+    if (st.runs == 0) continue;
+    ioprint(io, "    exe  avg:%i  min:%i  max:%i\n",
+        (u32_t)(st.exe_total / st.runs), st.exe_min, st.exe_max);
+    ioprint(io, "    wait avg:%i  max:%i\n    wait log2 hist:",
+        (u32_t)(st.wait_total / st.runs), st.wait_max);
+    for (b = 0; b < CONFIG_TASK_STATS_BINS; b++) {
+      ioprint(io, " %i", st.wait_hist[b]);
+    }
+    ioprint(io, "\n");
+  }
+}
+#endif // CONFIG_TASK_STATS
+
 void TASK_init() {
   int i;
   DBG(D_TASK, D_DEBUG, "TASK init\n");
   memset(&task_sys, 0, sizeof(task_sys));
   memset(&task_pool, 0, sizeof(task_pool));
+#ifdef CONFIG_TASK_STATS
+  memset(task_stats, 0, sizeof(task_stats));
+#endif
   for (i = 0; i < CONFIG_TASK_POOL; i++) {
     task_pool.task[i]._ix = i;
-    task_pool.mask[i/32] |= (1<<(i&0x1f));
+    task_pool_set_free(i);
   }
 #ifdef CONFIG_OS
-  OS_cond_init(&task_sys.cond);
+  OS_flags_init(&task_sys.flags, 0);
 #endif
 }
 
 static task* TASK_snatch_free(int dir) {
-  int i, j;
-  if (dir) {
-    for (i = (CONFIG_TASK_POOL-1)/32; i >= 0; i--) {
-      if (task_pool.mask[i]) {
-        for (j = 31; j >= 0; j--) {
-          if (task_pool.mask[i] & (1<<j)) {
-            goto task_found;
-          }
-        }
-      }
-    }
-  } else {
-    for (i = 0; i <= (CONFIG_TASK_POOL-1)/32; i++) {
-      if (task_pool.mask[i]) {
-        for (j = 0; j < 32; j++) {
-          if (task_pool.mask[i] & (1<<j)) {
-            goto task_found;
-          }
-        }
-      }
-    }
+  u32_t s, w;
+#if TASK_POOL_SUM_WORDS > 1
+  if (task_pool.top == 0) {
+    return 0;
   }
-  return 0;
-task_found:
-  task_pool.mask[i] &= ~(1<<j);
-  task* task = &task_pool.task[i*32+j];
+  s = dir ? TASK_POOL_MSB(task_pool.top) : TASK_POOL_LSB(task_pool.top);
+#else
+  if (task_pool.sum[0] == 0) {
+    return 0;
+  }
+  s = 0;
+#endif
+  w = s*32 + (dir ? TASK_POOL_MSB(task_pool.sum[s]) : TASK_POOL_LSB(task_pool.sum[s]));
+  u32_t ix = w*32 + (dir ? TASK_POOL_MSB(task_pool.mask[w]) : TASK_POOL_LSB(task_pool.mask[w]));
+  task_pool_set_used(ix);
+  task* task = &task_pool.task[ix];
   TRACE_TASK_ALLO(task->_ix);
   return task;
-
 }
 
 task* TASK_create(task_f f, u8_t flags) {
+  return TASK_create_prio(f, flags, CONFIG_TASK_PRIO_DEFAULT);
+}
+
+task* TASK_create_prio(task_f f, u8_t flags, u8_t prio) {
+  ASSERT(prio < CONFIG_TASK_PRIO_LEVELS);
   enter_critical();
   TQ_ENTER_CRITICAL;
   task* task = TASK_snatch_free(flags & TASK_STATIC);
@@ -200,39 +414,192 @@ task* TASK_create(task_f f, u8_t flags) {
     task->run_requests = 0;
     task->flags = flags & (~(TASK_RUN | TASK_EXE | TASK_WAIT | TASK_KILLED));
     task->_id = task->_ix;
+#if CONFIG_TASK_PRIO_LEVELS > 1
+    task->prio = prio;
+#endif
+#ifdef CONFIG_TASK_STATS
+    enter_critical();
+    task->_stat = task_stats_entry(f);
+    exit_critical();
+#endif
     return task;
   } else {
     return 0;
   }
 }
 
+void TASK_set_prio(task* task, u8_t prio) {
+  ASSERT(prio < CONFIG_TASK_PRIO_LEVELS);
+#if CONFIG_TASK_PRIO_LEVELS > 1
+  task->prio = prio;
+#endif
+}
+
+#if CONFIG_TASK_WORKERS > 1
+// Returns queue of calling worker, or NULL if not called from a worker.
+static task_queue *task_self(void) {
+  void *self = TASK_THREAD_SELF();
+  u32_t w;
+  for (w = 0; w < CONFIG_TASK_WORKERS; w++) {
+    if (task_sys.q[w].thread == self) {
+      return &task_sys.q[w];
+    }
+  }
+  return NULL;
+}
+
+// Returns task executed by calling worker, or NULL.
+static task *task_current(void) {
+  task_queue *q = task_self();
+  return q ? q->current : NULL;
+}
+
+// Returns queue a task is dispatched from by given worker along with its
+// level, or NULL if there is nothing to do. This is the worker's own queue
+// unless another worker has a task of higher priority ready, in which case
+// that is stolen. Only queue heads are stolen, keeping order within each
+// queue, and a head executing on its worker is left alone. Must be called
+// in critical.
+static task_queue *task_source(task_queue *q, u32_t *lvl) {
+  task_queue *src = q->prio_map ? q : NULL;
+  s32_t top = q->prio_map ? (s32_t)(31 - __builtin_clz(q->prio_map)) : -1;
+  u32_t w = q - &task_sys.q[0];
+  u32_t i;
+  for (i = 1; i < CONFIG_TASK_WORKERS; i++) {
+    task_queue *v = &task_sys.q[(w + i) % CONFIG_TASK_WORKERS];
+    if (v->prio_map == 0) continue;
+    s32_t l = 31 - __builtin_clz(v->prio_map);
+    if (l > top && (v->head[l]->flags & TASK_EXE) == 0) {
+      top = l;
+      src = v;
+    }
+  }
+  *lvl = (u32_t)top;
+  return src;
+}
+
+// Returns queue to put given task in, must be called in critical. An
+// executing task goes back to its worker so it never runs on two workers at
+// once. Others go to the scheduling worker, or round robin if scheduled from
+// outside the workers.
+static task_queue *task_sched_queue(task *t) {
+  if (t->flags & TASK_EXE) {
+    return TASK_QUEUE(t);
+  }
+  task_queue *q = task_self();
+  if (q == NULL) {
+    q = &task_sys.q[task_sys.rr];
+    task_sys.rr = (task_sys.rr + 1) % CONFIG_TASK_WORKERS;
+  }
+  return q;
+}
+#else
+#define task_self()           (&task_sys.q[0])
+#define task_current()        (task_sys.q[0].current)
+#define task_sched_queue(t)   (&task_sys.q[0])
+
+static inline task_queue *task_source(task_queue *q, u32_t *lvl) {
+  if (q->prio_map == 0) {
+    return NULL;
+  }
+  *lvl = 31 - __builtin_clz(q->prio_map);
+  return q;
+}
+#endif
+
+// Puts task in given run queue of given level, must be called in critical.
+// With CONFIG_TASK_EDF, queue is kept sorted on deadline, tasks with same
+// deadline in order of scheduling.
+static void task_enqueue(task_queue *q, volatile task *t, u32_t lvl) {
+  // would same task be added twice or more, this at least fixes endless loop
+  t->_next = 0;
+  TASK_SET_QUEUE(t, q);
+  if (q->last[lvl] == 0) {
+    q->head[lvl] = t;
+    q->last[lvl] = t;
+    q->prio_map |= (1<<lvl);
+    return;
+  }
+#ifdef CONFIG_TASK_EDF
+  if (q->last[lvl]->_deadline > t->_deadline) {
+    if (q->head[lvl]->_deadline > t->_deadline) {
+      t->_next = (task *)q->head[lvl];
+      q->head[lvl] = t;
+    } else {
+      task *ct = (task *)q->head[lvl];
+      while (ct->_next->_deadline <= t->_deadline) {
+        ct = ct->_next;
+      }
+      t->_next = ct->_next;
+      ct->_next = (task *)t;
+    }
+    return;
+  }
+#endif
+  q->last[lvl]->_next = (task *)t;
+  q->last[lvl] = t;
+}
+
+// Reschedules a looped task in given queue when dispatched, must be called
+// in critical.
+static void task_requeue_loop(task_queue *q, volatile task *t) {
+#if CONFIG_TASK_PRIO_LEVELS > 1
+  t->_lvl = t->prio;
+#endif
+#ifdef CONFIG_TASK_EDF
+  t->_deadline = SYS_get_time_ms() + CONFIG_TASK_EDF_DEADLINE;
+  t->_timer = NULL;
+#endif
+  task_enqueue(q, t, TASK_LEVEL(t));
+}
+
+#ifdef CONFIG_TASK_EDF
+// Counts a missed deadline if task was scheduled by timer and finished
+// late, must be called in critical.
+static inline void task_check_deadline(volatile task *t) {
+  if (t->_timer && SYS_get_time_ms() > t->_deadline) {
+    t->_timer->missed++;
+  }
+}
+#endif
+
+static void task_schedule(task* task, u32_t arg, void* arg_p);
+
 void TASK_loop(task* task, u32_t arg, void* arg_p) {
   task->flags |= TASK_LOOP;
   TASK_run(task, arg, arg_p);
 }
 
 void TASK_run(task* task, u32_t arg, void* arg_p) {
+#ifdef CONFIG_TASK_EDF
+  task->_deadline = SYS_get_time_ms() + CONFIG_TASK_EDF_DEADLINE;
+  task->_timer = NULL;
+#endif
+  task_schedule(task, arg, arg_p);
+}
+
+static void task_schedule(task* task, u32_t arg, void* arg_p) {
   ASSERT(task);
-  ASSERT((task_pool.mask[task->_ix/32] & (1<<(task->_ix & 0x1f))) == 0); // check it is allocated
+  ASSERT(!TASK_POOL_IS_FREE(task->_ix)); // check it is allocated
   ASSERT((task->flags & TASK_RUN) == 0);       // already scheduled
   ASSERT((task->flags & TASK_WAIT) == 0);      // waiting for a mutex
   ASSERT(task >= &task_pool.task[0]);          // mem check
   ASSERT(task <= &task_pool.task[CONFIG_TASK_POOL]); // mem check
-  task->flags |= TASK_RUN;
-  task->arg = arg;
-  task->arg_p = arg_p;
 
   enter_critical();
   TQ_ENTER_CRITICAL;
-  if (task_sys.last == 0) {
-    task_sys.head = task;
-  } else {
-    task_sys.last->_next = task;
-  }
-  task_sys.last = task;
-  // would same task be added twice or more, this at least fixes endless loop
-  task->_next = 0;
+  // in critical, as a worker may be finishing the task meanwhile
+  task->flags |= TASK_RUN;
+  task->arg = arg;
+  task->arg_p = arg_p;
+#if CONFIG_TASK_PRIO_LEVELS > 1
+  task->_lvl = task->prio;
+#endif
+  task_enqueue(task_sched_queue(task), task, TASK_LEVEL(task));
   task->run_requests++; // if added again during execution
+#ifdef CONFIG_TASK_STATS
+  task->_run_tick = SYS_get_tick();
+#endif
   TRACE_TASK_RUN(task->_id);
 #if defined(CONFIG_OS) & defined(CONFIG_TASK_QUEUE_IN_THREAD)
   //#if defined(CONFIG_OS)
@@ -246,8 +613,16 @@ void TASK_run(task* task, u32_t arg, void* arg_p) {
   // hardfault:
   //  INVPC: UsaFlt general
   //  FORCED: HardFlt SVC/BKPT within SVC
-
-  OS_cond_signal(&task_sys.cond);
+  //
+  // Tasks are frequently run from IRQs, so signal through event flags
+  // which only take the scheduler when the task thread actually waits.
+  // From an IRQ, this broadcasts the flags' cond in critical and only
+  // pends PendSV, never taking the svc.
+  OS_flags_set(&task_sys.flags, TASK_OS_FLAG_RUN);
+#elif defined(CONFIG_ARCH_HOST_SMP) && CONFIG_TASK_WORKERS > 1
+  if (task_sys.waiting) {
+    arch_host_sev();
+  }
 #endif
   TQ_EXIT_CRITICAL;
   exit_critical();
@@ -269,6 +644,11 @@ void TASK_start_timer(task *task, task_timer* timer, u32_t arg, void *arg_p, sys
   timer->recurrent_time = recurrent_time;
   timer->alive = TRUE;
   timer->name = name;
+#ifdef CONFIG_TASK_EDF
+  timer->deadline = recurrent_time;
+  timer->missed = 0;
+  timer->overruns = 0;
+#endif
   task_insert_timer(timer, SYS_get_time_ms() + start_time);
   task_sys.tim_lock = FALSE;
 #ifndef CONFIG_TASK_NONCRITICAL_TIMER
@@ -281,6 +661,12 @@ void TASK_set_timer_recurrence(task_timer* timer, sys_time recurrent_time) {
   timer->recurrent_time = recurrent_time;
 }
 
+#ifdef CONFIG_TASK_EDF
+void TASK_set_timer_deadline(task_timer* timer, sys_time deadline) {
+  timer->deadline = deadline;
+}
+#endif
+
 void TASK_stop_timer(task_timer* timer) {
 #ifndef CONFIG_TASK_NONCRITICAL_TIMER
   enter_critical();
@@ -296,6 +682,9 @@ void TASK_stop_timer(task_timer* timer) {
   task_sys.tim_lock = TRUE;
   timer->alive = FALSE;
 
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  task_remove_timer(timer);
+#else
   // wipe all dead instances
   task_timer *cur_timer = task_sys.first_timer;
   task_timer *pre_timer = NULL;
@@ -310,6 +699,7 @@ void TASK_stop_timer(task_timer* timer) {
     pre_timer = cur_timer;
     cur_timer = cur_timer->_next;
   }
+#endif
   task_sys.tim_lock = FALSE;
 #ifndef CONFIG_TASK_NONCRITICAL_TIMER
   TQ_EXIT_CRITICAL;
@@ -318,34 +708,72 @@ void TASK_stop_timer(task_timer* timer) {
 }
 
 void TASK_stop() {
-  task_sys.current->flags &= ~(TASK_LOOP | TASK_RUN);
-  task_sys.current->flags |= TASK_KILLED;
+  task *t = task_current();
+  t->flags &= ~(TASK_LOOP | TASK_RUN);
+  t->flags |= TASK_KILLED;
 }
 
 u32_t TASK_id() {
-  return task_sys.current->_ix;
+  return task_current()->_ix;
 }
 
 u8_t TASK_is_running(task* t) {
   return t->flags & TASK_RUN;
 }
 
+#if CONFIG_TASK_WORKERS > 1
+void TASK_worker_register(u32_t worker) {
+  ASSERT(worker < CONFIG_TASK_WORKERS);
+  task_sys.q[worker].thread = TASK_THREAD_SELF();
+}
+
+void TASK_wait() {
+  task_queue *q = task_self();
+  ASSERT(q);
+  while (TRUE) {
+    u32_t lvl;
+    enter_critical();
+    if (task_source(q, &lvl)) {
+      exit_critical();
+      break;
+    }
+#ifdef CONFIG_OS
+    // not cleared on wakeup, as all idle workers need to recheck
+    OS_flags_clear(&task_sys.flags, TASK_OS_FLAG_RUN);
+    exit_critical();
+    (void)OS_flags_wait(&task_sys.flags, TASK_OS_FLAG_RUN, OS_FLAGS_ANY, OS_WAIT_FOREVER);
+#else
+    // event read in critical, so a task scheduled meanwhile is not missed
+    task_sys.waiting++;
+    u32_t ev = arch_host_events();
+    exit_critical();
+    arch_host_wfe(ev);
+    enter_critical();
+    task_sys.waiting--;
+    exit_critical();
+#endif
+  }
+}
+#else
 void TASK_wait() {
-  while (task_sys.head == 0) {
+  while (task_sys.q[0].prio_map == 0) {
 #if defined(CONFIG_OS) & defined(CONFIG_TASK_QUEUE_IN_THREAD)
-    OS_cond_wait(&task_sys.cond, NULL);
+    (void)OS_flags_wait(&task_sys.flags, TASK_OS_FLAG_RUN, OS_FLAGS_ANY | OS_FLAGS_CLEAR, OS_WAIT_FOREVER);
+#elif defined(CONFIG_SYS_TICKLESS)
+    SYS_idle();
 #else
     arch_sleep();
 #endif
   }
 }
+#endif
 
 void TASK_free(task *t) {
   enter_critical();
   TQ_ENTER_CRITICAL;
   if ((t->flags & TASK_RUN) == 0) {
     // not scheduled, so remove it directly from pool
-    task_pool.mask[t->_ix/32] |= (1<<(t->_ix & 0x1f));
+    task_pool_set_free(t->_ix);
   }
   // else, scheduled => will be removed in TASK_tick when executed
 
@@ -386,66 +814,111 @@ void TASK_free(task *t) {
 }
 
 bool TASK_got_active_tasks(void) {
-  return task_sys.head != NULL || task_sys.current != NULL;
+  u32_t w;
+  for (w = 0; w < CONFIG_TASK_WORKERS; w++) {
+    if (task_sys.q[w].prio_map != 0 || task_sys.q[w].current != NULL) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+#if TASK_WARN_HIGH_EXE_TIME > 0 || defined(CONFIG_TASK_STATS)
+// Accounts execution of task started at then. Must be called in critical,
+// before the task may be freed.
+// @returns execution time
+static sys_time task_exe_done(volatile task *t, sys_time then) {
+  sys_time delta = SYS_get_tick() - then;
+#ifdef CONFIG_TASK_STATS
+  if (t->_stat) {
+    task_stats_update((task *)t, (u32_t)(then - t->_run_tick), (u32_t)delta);
+  }
+  if (t->flags & TASK_LOOP) {
+    // looped tasks were rescheduled when dispatched
+    t->_run_tick = then;
+  }
+#endif
+  return delta;
 }
+#endif
+
+#if TASK_WARN_HIGH_EXE_TIME > 0
+static void task_exe_warn(task_f f, sys_time delta) {
+  if (delta >= TASK_WARN_HIGH_EXE_TIME) {
+    DBG(D_TASK, D_WARN, "TASK task %p: %i ticks\n", f, (u32_t)delta);
+  }
+}
+#endif
 
 u32_t TASK_tick() {
+  task_queue *q = task_self();
+  u32_t lvl;
+  ASSERT(q);
   enter_critical();
   TQ_ENTER_CRITICAL;
-  volatile task* t = task_sys.head;
-  task_sys.current = (task *)t;
-  if (t == 0) {
+  // pick highest non-empty priority level
+  task_queue *src = task_source(q, &lvl);
+  if (src == NULL) {
     // naught to do
+    q->current = 0;
     TQ_EXIT_CRITICAL;
     exit_critical();
     return 0;
   }
+  volatile task* t = src->head[lvl];
+  q->current = (task *)t;
   ASSERT(t >= &task_pool.task[0]);
   ASSERT(t <= &task_pool.task[CONFIG_TASK_POOL]);
+#if CONFIG_TASK_WORKERS > 1
+  q->runs++;
+  if (src != q) {
+    q->steals++;
+  }
+#endif
 
   // execute
   bool do_run = (t->flags & (TASK_RUN | TASK_KILLED)) == TASK_RUN;
   bool free = FALSE;
-  // first, fiddle with queue - remove task from schedq unless loop
-  // reinsert or kill off
+  // first, fiddle with queue - remove task from schedq, then reinsert
+  // if loop or kill off
+  src->head[lvl] = t->_next;
+  if (t->_next == 0) {
+    src->last[lvl] = 0;
+    src->prio_map &= ~(1<<lvl);
+  } else {
+    ASSERT(src->head[lvl] >= &task_pool.task[0]);
+    ASSERT(src->head[lvl] <= &task_pool.task[CONFIG_TASK_POOL]);
+  }
+  TASK_SET_QUEUE(t, q);
+  if (do_run) {
+    // marked in critical, so a reschedule from elsewhere knows the worker
+    t->flags |= TASK_EXE;
+  }
   if ((t->flags & (TASK_LOOP | TASK_KILLED)) == TASK_LOOP) {
-    // loop, put this at end or simply keep if the only one
-    if (t->_next != 0) {
-      task_sys.last->_next = (task *)t;
-      task_sys.head = t->_next;
-      if (task_sys.head != 0) {
-        ASSERT(task_sys.head >= &task_pool.task[0]);
-        ASSERT(task_sys.head <= &task_pool.task[CONFIG_TASK_POOL]);
-      }
-      task_sys.last = t;
-    }
+    // loop, put this at end of queue
+    task_requeue_loop(q, t);
   } else {
     // no loop, kill off
-    task_sys.head = t->_next;
-    if (t->_next == 0) {
-      task_sys.last = 0;
-    } else {
-      ASSERT(task_sys.head >= &task_pool.task[0]);
-      ASSERT(task_sys.head <= &task_pool.task[CONFIG_TASK_POOL]);
-    }
     // free unless static
     if ((t->flags & TASK_STATIC) == 0) {
       free = TRUE;
-      //task_pool.mask[t->_ix/32] |= (1<<(t->_ix & 0x1f));
-      //TRACE_TASK_FREE(t->_ix);
     }
     t->flags &= ~TASK_RUN;
   }
+  if (!do_run && free && (t->flags & TASK_WAIT) == 0) {
+    // freed while queued, release now as it will not run
+    task_pool_set_free(t->_ix);
+    TRACE_TASK_FREE(t->_ix);
+  }
   TQ_EXIT_CRITICAL;
   exit_critical();
 
   if (do_run) {
     u8_t run_requests;
     // execute
-#if TASK_WARN_HIGH_EXE_TIME > 0
-    time then = SYS_get_tick();
+#if TASK_WARN_HIGH_EXE_TIME > 0 || defined(CONFIG_TASK_STATS)
+    sys_time then = SYS_get_tick();
 #endif
-    t->flags |= TASK_EXE;
     TRACE_TASK_ENTER(t->_id);
     do {
       t->f(t->arg, t->arg_p);
@@ -463,23 +936,201 @@ u32_t TASK_tick() {
     TQ_ENTER_CRITICAL;
     TRACE_TASK_EXIT(t->_id);
     t->flags &= ~TASK_EXE;
-    if (free) {
-      task_pool.mask[t->_ix/32] |= (1<<(t->_ix & 0x1f));
+#ifdef CONFIG_TASK_EDF
+    task_check_deadline(t);
+#endif
+#if TASK_WARN_HIGH_EXE_TIME > 0
+    sys_time delta = task_exe_done(t, then);
+    task_f f = t->f;
+#elif defined(CONFIG_TASK_STATS)
+    task_exe_done(t, then);
+#endif
+    // keep it if it now waits for a mutex or was scheduled anew meanwhile
+    if (free && (t->flags & (TASK_WAIT | TASK_RUN)) == 0) {
+      task_pool_set_free(t->_ix);
       TRACE_TASK_FREE(t->_ix);
     }
     TQ_EXIT_CRITICAL;
     exit_critical();
 #if TASK_WARN_HIGH_EXE_TIME > 0
-    time delta = SYS_get_tick() - then;
-    if (delta >= TASK_WARN_HIGH_EXE_TIME) {
-      DBG(D_TASK, D_WARN, "TASK task %p: %i ticks\n", t->f, delta);
-    }
+    task_exe_warn(f, delta);
 #endif
   }
 
   return 1;
 }
 
+u32_t TASK_tick_batch(u32_t max_tasks, sys_time budget_ticks) {
+  task_queue *q = task_self();
+  u32_t lvl;
+  u32_t top;
+  ASSERT(q);
+  enter_critical();
+  TQ_ENTER_CRITICAL;
+  task_queue *src = task_source(q, &lvl);
+  if (src == NULL) {
+    // naught to do
+    q->current = 0;
+    TQ_EXIT_CRITICAL;
+    exit_critical();
+    return 0;
+  }
+#if CONFIG_TASK_WORKERS > 1
+  if (src != q) {
+    // steal one at a time, leaving the rest to its worker
+    TQ_EXIT_CRITICAL;
+    exit_critical();
+    return TASK_tick();
+  }
+#endif
+  // detach whole ready list of highest non-empty priority level, tasks
+  // scheduled meanwhile end up in the emptied live queue
+  volatile task* t = q->head[lvl];
+  volatile task* tail = q->last[lvl];
+  q->head[lvl] = 0;
+  q->last[lvl] = 0;
+  q->prio_map &= ~(1<<lvl);
+  sys_time start = budget_ticks ? SYS_get_tick() : 0;
+  u32_t count = 0;
+
+  // each turn is entered in critical, finishing previous task and
+  // preparing next in one go
+  while (TRUE) {
+    q->current = (task *)t;
+    ASSERT(t >= &task_pool.task[0]);
+    ASSERT(t <= &task_pool.task[CONFIG_TASK_POOL]);
+#if CONFIG_TASK_WORKERS > 1
+    q->runs++;
+#endif
+    // grab next before task may be requeued
+    volatile task* next = t->_next;
+    bool do_run = (t->flags & (TASK_RUN | TASK_KILLED)) == TASK_RUN;
+    bool free = FALSE;
+    if (do_run) {
+      t->flags |= TASK_EXE;
+    }
+    if ((t->flags & (TASK_LOOP | TASK_KILLED)) == TASK_LOOP) {
+      // loop, put this in live queue before running, same as TASK_tick
+      task_requeue_loop(q, t);
+    } else {
+      // no loop, kill off, free unless static
+      if ((t->flags & TASK_STATIC) == 0) {
+        free = TRUE;
+      }
+      t->flags &= ~TASK_RUN;
+    }
+    TQ_EXIT_CRITICAL;
+    exit_critical();
+
+    if (do_run) {
+#if TASK_WARN_HIGH_EXE_TIME > 0 || defined(CONFIG_TASK_STATS)
+      sys_time then = SYS_get_tick();
+#endif
+      TRACE_TASK_ENTER(t->_id);
+      while (TRUE) {
+        t->f(t->arg, t->arg_p);
+
+        enter_critical();
+        TQ_ENTER_CRITICAL;
+        if (t->run_requests > 0) {
+          t->run_requests--;
+        }
+        if (t->run_requests == 0) {
+          // keep critical for finishing up
+          break;
+        }
+        TQ_EXIT_CRITICAL;
+        exit_critical();
+      }
+      TRACE_TASK_EXIT(t->_id);
+      t->flags &= ~TASK_EXE;
+#ifdef CONFIG_TASK_EDF
+      task_check_deadline(t);
+#endif
+#if TASK_WARN_HIGH_EXE_TIME > 0
+      sys_time delta = task_exe_done(t, then);
+      if (delta >= TASK_WARN_HIGH_EXE_TIME) {
+        // warn outside critical, task is not freed yet
+        task_f f = t->f;
+        TQ_EXIT_CRITICAL;
+        exit_critical();
+        task_exe_warn(f, delta);
+        enter_critical();
+        TQ_ENTER_CRITICAL;
+      }
+#elif defined(CONFIG_TASK_STATS)
+      task_exe_done(t, then);
+#endif
+    } else {
+      enter_critical();
+      TQ_ENTER_CRITICAL;
+    }
+    // keep it if it now waits for a mutex or was scheduled anew meanwhile
+    if (free && (t->flags & (TASK_WAIT | TASK_RUN)) == 0) {
+      task_pool_set_free(t->_ix);
+      TRACE_TASK_FREE(t->_ix);
+    }
+    count++;
+
+    if (next == 0) {
+      break;
+    }
+    t = next;
+    if ((max_tasks && count >= max_tasks) ||
+        (budget_ticks && SYS_get_tick() - start >= budget_ticks) ||
+#ifdef CONFIG_TASK_EDF
+        (q->head[lvl] && q->head[lvl]->_deadline < t->_deadline) ||
+#endif
+        (task_source(q, &top) && top > lvl)) {
+      // out of budget, an earlier deadline or a higher priority level got
+      // ready - put back remainder in live queue to keep order
+      if (q->last[lvl] == 0) {
+        q->head[lvl] = t;
+        q->last[lvl] = tail;
+        q->prio_map |= (1<<lvl);
+      } else {
+#ifdef CONFIG_TASK_EDF
+        // merge sorted remainder with sorted live queue, remainder first on
+        // same deadline as it was scheduled earlier
+        volatile task *lt = q->head[lvl];
+        volatile task *mt;
+        if (lt->_deadline < t->_deadline) {
+          q->head[lvl] = mt = lt;
+          lt = lt->_next;
+        } else {
+          q->head[lvl] = mt = t;
+          t = t->_next;
+        }
+        while (t && lt) {
+          if (lt->_deadline < t->_deadline) {
+            mt->_next = (task *)lt;
+            lt = lt->_next;
+          } else {
+            mt->_next = (task *)t;
+            t = t->_next;
+          }
+          mt = mt->_next;
+        }
+        if (t) {
+          mt->_next = (task *)t;
+          q->last[lvl] = tail;
+        } else {
+          mt->_next = (task *)lt;
+        }
+#else
+        tail->_next = (task *)q->head[lvl];
+        q->head[lvl] = t;
+#endif
+      }
+      break;
+    }
+  }
+  TQ_EXIT_CRITICAL;
+  exit_critical();
+
+  return count;
+}
+
 #ifdef CONFIG_TASKQ_MUTEX
 
 static void task_take_lock(task *t, task_mutex *m) {
@@ -493,17 +1144,20 @@ static void task_release_lock(task_mutex *m) {
 }
 
 bool TASK_mutex_lock(task_mutex *m) {
-  task *t = task_sys.current;
+  task *t = task_current();
+  TQ_MUTEX_ENTER;
   if (!m->taken) {
     m->entries = 1;
     task_take_lock(t, m);
     TRACE_TASK_MUTEX_ENTER(t->_id);
+    TQ_MUTEX_EXIT;
     return TRUE;
   }
   if (m->reentrant && m->owner == t) {
     m->entries++;
     TRACE_TASK_MUTEX_ENTER_M(t->_id);
     ASSERT(m->entries < 254);
+    TQ_MUTEX_EXIT;
     return TRUE;
   }
   // taken, mark task still allocated and insert into mutexq
@@ -512,26 +1166,36 @@ bool TASK_mutex_lock(task_mutex *m) {
   TQ_ENTER_CRITICAL;
   t->wait_mutex = m;
   if ((t->flags & (TASK_STATIC | TASK_LOOP)) == 0) {
-    task_pool.mask[t->_ix/32] &= ~(1<<(t->_ix & 0x1f));
+    task_pool_set_used(t->_ix);
   }
   if ((t->flags & TASK_LOOP)) {
-    // looped, remove us from end of queue
-    ASSERT(task_sys.last == t);
-    ASSERT(task_sys.head);
-    if (task_sys.head == t) {
-      // the only task in sched queue
-      task_sys.head = NULL;
-      task_sys.last = NULL;
+    // looped, remove us from queue
+    task_queue *q = TASK_QUEUE(t);
+    u32_t lvl = TASK_LEVEL(t);
+#ifndef CONFIG_TASK_EDF
+    // without deadline ordering, we were put at the end
+    ASSERT(q->last[lvl] == t);
+#endif
+    ASSERT(q->head[lvl]);
+    if (q->head[lvl] == t) {
+      q->head[lvl] = t->_next;
+      if (t->_next == NULL) {
+        // the only task in sched queue
+        q->last[lvl] = NULL;
+        q->prio_map &= ~(1<<lvl);
+      }
     } else {
-      // find the task pointing to the last task == current task
-      task *ct = (task *)task_sys.head;
+      // find the task pointing to current task
+      task *ct = (task *)q->head[lvl];
       while (ct->_next != t) {
         ct = ct->_next;
         ASSERT(ct);
       }
-      // remove last task from queue
-      ct->_next = NULL;
-      task_sys.last = ct;
+      // remove current task from queue
+      ct->_next = t->_next;
+      if (q->last[lvl] == t) {
+        q->last[lvl] = ct;
+      }
     }
   }
   TQ_EXIT_CRITICAL;
@@ -547,36 +1211,42 @@ bool TASK_mutex_lock(task_mutex *m) {
   t->_next = NULL;
   t->flags &= ~TASK_RUN;
   t->flags |= TASK_WAIT;
+  TQ_MUTEX_EXIT;
 
   return FALSE;
 }
 
 bool TASK_mutex_try_lock(task_mutex *m) {
+  task *t = task_current();
+  bool res = FALSE;
+  TQ_MUTEX_ENTER;
   if (!m->taken) {
     m->entries = 1;
-    task_take_lock(task_sys.current, m);
-    TRACE_TASK_MUTEX_ENTER(task_sys.current->_id);
-    return TRUE;
-  }
-  if (m->reentrant && m->owner == task_sys.current) {
+    task_take_lock(t, m);
+    TRACE_TASK_MUTEX_ENTER(t->_id);
+    res = TRUE;
+  } else if (m->reentrant && m->owner == t) {
     m->entries++;
-    TRACE_TASK_MUTEX_ENTER_M(task_sys.current->_id);
+    TRACE_TASK_MUTEX_ENTER_M(t->_id);
     ASSERT(m->entries < 254);
-    return TRUE;
+    res = TRUE;
   }
-  return FALSE;
+  TQ_MUTEX_EXIT;
+  return res;
 }
 
 void TASK_mutex_unlock(task_mutex *m) {
   ASSERT(m->entries > 0);
-  //ASSERT(m->owner == task_sys.current);
+  //ASSERT(m->owner == cur);
   ASSERT(!m->reentrant && m->entries <= 1);
+  TQ_MUTEX_ENTER;
   if (m->entries > 1) {
     m->entries--;
-    TRACE_TASK_MUTEX_EXIT_L(task_sys.current->_id);
+    TRACE_TASK_MUTEX_EXIT_L(task_current()->_id);
+    TQ_MUTEX_EXIT;
     return;
   }
-  TRACE_TASK_MUTEX_EXIT(task_sys.current->_id);
+  TRACE_TASK_MUTEX_EXIT(task_current()->_id);
   task_release_lock(m);
   task *t = (task *)m->head;
   while (t) {
@@ -585,17 +1255,220 @@ void TASK_mutex_unlock(task_mutex *m) {
     t->wait_mutex = NULL;
     TRACE_TASK_MUTEX_WAKE(t->_id);
     if ((t->flags & TASK_KILLED) == 0) {
-      TASK_run(t, t->arg, t->arg_p);
+      // keeps deadline, if any
+      task_schedule(t, t->arg, t->arg_p);
     }
     t = next;
   }
   m->head = NULL;
   m->last = NULL;
+  TQ_MUTEX_EXIT;
 }
 
 #endif // CONFIG_TASKQ_MUTEX
 
 
+#ifdef CONFIG_TASK_TIMER_WHEEL
+
+// Returns offset from given slot to next slot holding timers, or
+// CONFIG_TASK_TIMER_WHEEL_SLOTS if wheel is empty.
+static u32_t task_wheel_next_slot(u32_t from) {
+  u32_t offs = 0;
+  while (offs < CONFIG_TASK_TIMER_WHEEL_SLOTS) {
+    u32_t slot = (from + offs) & TASK_WHEEL_MASK;
+    u32_t bits = task_sys.wheel_map[slot/32] >> (slot & 0x1f);
+    if (bits == 0) {
+      offs += 32 - (slot & 0x1f);
+    } else {
+      offs += __builtin_ctz(bits);
+      break;
+    }
+  }
+  return MIN(offs, CONFIG_TASK_TIMER_WHEEL_SLOTS);
+}
+
+static void task_insert_timer(task_timer *timer, sys_time actual_time) {
+  timer->start_time = actual_time;
+  // overdue timers are put in the slot processed next
+  u32_t slot = (u32_t)MAX(actual_time, task_sys.wheel_time) & TASK_WHEEL_MASK;
+  timer->_slot = slot;
+  timer->_prev = 0;
+  timer->_next = task_sys.wheel[slot];
+  if (timer->_next) {
+    timer->_next->_prev = timer;
+  }
+  task_sys.wheel[slot] = timer;
+  task_sys.wheel_map[slot/32] |= (1<<(slot & 0x1f));
+  if (task_sys.wheel_count == 0 ||
+      (task_sys.wheel_min && actual_time < task_sys.wheel_min->start_time)) {
+    task_sys.wheel_min = timer;
+  }
+  task_sys.wheel_count++;
+}
+
+static void task_remove_timer(task_timer *timer) {
+  u32_t slot = timer->_slot;
+  if (timer->_prev) {
+    timer->_prev->_next = timer->_next;
+  } else {
+    ASSERT(task_sys.wheel[slot] == timer);
+    task_sys.wheel[slot] = timer->_next;
+  }
+  if (timer->_next) {
+    timer->_next->_prev = timer->_prev;
+  }
+  if (task_sys.wheel[slot] == 0) {
+    task_sys.wheel_map[slot/32] &= ~(1<<(slot & 0x1f));
+  }
+  timer->_next = 0;
+  timer->_prev = 0;
+  if (timer == task_sys.wheel_min) {
+    task_sys.wheel_min = NULL;
+  }
+  task_sys.wheel_count--;
+}
+
+// Returns earliest timer in wheel, which must not be empty.
+static task_timer *task_wheel_find_min(void) {
+  task_timer *first = NULL;
+  u32_t offs = 0;
+  // find first slot holding timers expiring within this lap, these are
+  // earlier than all timers in other slots
+  while ((offs += task_wheel_next_slot(task_sys.wheel_time + offs)) < CONFIG_TASK_TIMER_WHEEL_SLOTS) {
+    sys_time lap_end = task_sys.wheel_time + offs;
+    task_timer *cur_timer = task_sys.wheel[(task_sys.wheel_time + offs) & TASK_WHEEL_MASK];
+    while (cur_timer) {
+      if (cur_timer->start_time <= lap_end &&
+          (first == NULL || cur_timer->start_time < first->start_time)) {
+        first = cur_timer;
+      }
+      cur_timer = cur_timer->_next;
+    }
+    if (first) return first;
+    offs++;
+  }
+  // all timers are at least one lap away, find earliest
+  u32_t slot;
+  for (slot = 0; slot < CONFIG_TASK_TIMER_WHEEL_SLOTS; slot++) {
+    task_timer *cur_timer = task_sys.wheel[slot];
+    while (cur_timer) {
+      if (first == NULL || cur_timer->start_time < first->start_time) {
+        first = cur_timer;
+      }
+      cur_timer = cur_timer->_next;
+    }
+  }
+  return first;
+}
+
+s32_t TASK_next_wakeup_ms(sys_time *t, task_timer **timer) {
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+  enter_critical();
+#endif
+  if (task_sys.wheel_count == 0) {
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+    exit_critical();
+#endif
+    if (timer) *timer = NULL;
+    return -1;
+  }
+  // earliest is kept until it expires or is stopped, so the wheel is only
+  // searched once per expiry even if all timers are laps away
+  task_timer *first = task_sys.wheel_min;
+  if (first == NULL) {
+    first = task_wheel_find_min();
+    if (!task_sys.tim_lock) {
+      task_sys.wheel_min = first;
+    }
+  }
+  if (t) *t = first->start_time;
+  if (timer) *timer = first;
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+  exit_critical();
+#endif
+  return 0;
+}
+
+void TASK_timer() {
+  if (task_sys.wheel_count == 0 || task_sys.tim_lock) {
+    return;
+  }
+  sys_time now = SYS_get_time_ms();
+  if (now < task_sys.wheel_time) {
+    return;
+  }
+  // number of slots to process, one lap at most
+  u32_t slots = (u32_t)MIN(now - task_sys.wheel_time + 1, CONFIG_TASK_TIMER_WHEEL_SLOTS);
+  u32_t offs = 0;
+  while ((offs += task_wheel_next_slot(task_sys.wheel_time + offs)) < slots) {
+    u32_t slot = (task_sys.wheel_time + offs) & TASK_WHEEL_MASK;
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+    enter_critical();
+    TQ_ENTER_CRITICAL;
+#endif
+    // detach slot, then reinsert all timers not expired
+    task_timer *cur_timer = task_sys.wheel[slot];
+    if (task_sys.wheel_min && task_sys.wheel_min->_slot == slot) {
+      task_sys.wheel_min = NULL;
+    }
+    task_sys.wheel[slot] = 0;
+    task_sys.wheel_map[slot/32] &= ~(1<<(slot & 0x1f));
+    while (cur_timer) {
+      task_timer *next_timer = cur_timer->_next;
+      task_sys.wheel_count--;
+      if (cur_timer->start_time > now) {
+        // not this lap
+        task_insert_timer(cur_timer, cur_timer->start_time);
+      } else {
+        if (((cur_timer->task->flags & (TASK_RUN | TASK_WAIT)) == 0) && cur_timer->alive) {
+          // expired, schedule for run
+          TRACE_TASK_TIMER(cur_timer->_ix);
+#ifdef CONFIG_TASK_EDF
+          cur_timer->task->_deadline = cur_timer->start_time + cur_timer->deadline;
+          cur_timer->task->_timer = cur_timer;
+#endif
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+          TQ_EXIT_CRITICAL;
+#endif
+          task_schedule(cur_timer->task, cur_timer->arg, cur_timer->arg_p);
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+          TQ_ENTER_CRITICAL;
+#endif
+        }
+#ifdef CONFIG_TASK_EDF
+        else if (cur_timer->alive) {
+          cur_timer->overruns++;
+        }
+#endif
+        if (cur_timer->recurrent_time && cur_timer->alive) {
+          // recurrent, reinsert, skipping laps missed
+          cur_timer->start_time += cur_timer->recurrent_time;
+          while (cur_timer->start_time <= now) {
+            cur_timer->start_time += cur_timer->recurrent_time;
+#ifdef CONFIG_TASK_EDF
+            cur_timer->overruns++;
+#endif
+          }
+          task_insert_timer(cur_timer, cur_timer->start_time);
+        } else {
+          cur_timer->alive = FALSE;
+          cur_timer->_next = 0;
+          cur_timer->_prev = 0;
+        }
+      }
+      cur_timer = next_timer;
+    }
+#ifndef CONFIG_TASK_NONCRITICAL_TIMER
+    TQ_EXIT_CRITICAL;
+    exit_critical();
+#endif
+    offs++;
+  }
+  task_sys.wheel_time = now + 1;
+}
+
+#else // CONFIG_TASK_TIMER_WHEEL
+
 static void task_insert_timer(task_timer *timer, sys_time actual_time) {
   timer->start_time = actual_time;
 
@@ -656,20 +1529,36 @@ void TASK_timer() {
     if (((cur_timer->task->flags & (TASK_RUN | TASK_WAIT)) == 0) && cur_timer->alive) {
       // expired, schedule for run
       TRACE_TASK_TIMER(cur_timer->_ix);
+#ifdef CONFIG_TASK_EDF
+      cur_timer->task->_deadline = cur_timer->start_time + cur_timer->deadline;
+      cur_timer->task->_timer = cur_timer;
+#endif
 #ifndef CONFIG_TASK_NONCRITICAL_TIMER
       TQ_EXIT_CRITICAL;
 #endif
-      TASK_run(cur_timer->task, cur_timer->arg, cur_timer->arg_p);
+      task_schedule(cur_timer->task, cur_timer->arg, cur_timer->arg_p);
 #ifndef CONFIG_TASK_NONCRITICAL_TIMER
       TQ_ENTER_CRITICAL;
 #endif
     }
+#ifdef CONFIG_TASK_EDF
+    else if (cur_timer->alive) {
+      cur_timer->overruns++;
+    }
+#endif
     old_timer = cur_timer;
     cur_timer = cur_timer->_next;
     task_sys.first_timer = cur_timer;
     if (old_timer->recurrent_time && old_timer->alive) {
-      // recurrent, reinsert
+      // recurrent, reinsert, skipping laps missed so it is not met again
+      // behind the loop
       old_timer->start_time += old_timer->recurrent_time; // need to set this before inserting for sorting
+      while (old_timer->start_time <= SYS_get_time_ms()) {
+        old_timer->start_time += old_timer->recurrent_time;
+#ifdef CONFIG_TASK_EDF
+        old_timer->overruns++;
+#endif
+      }
       task_insert_timer(old_timer, old_timer->start_time);
     } else {
       old_timer->alive = FALSE;
@@ -680,3 +1569,5 @@ void TASK_timer() {
 #endif
   }
 }
+
+#endif // CONFIG_TASK_TIMER_WHEEL
@@ -19,6 +19,72 @@
 #define CONFIG_TASK_POOL      64
 #endif
 
+/* Number of priority levels of the run queue, at most 32. Tasks with
+   higher priority are always executed before tasks with lower priority.
+   Tasks of same priority are executed in order of scheduling. */
+#ifndef CONFIG_TASK_PRIO_LEVELS
+#define CONFIG_TASK_PRIO_LEVELS     1
+#endif
+#if CONFIG_TASK_PRIO_LEVELS > 32
+#error "CONFIG_TASK_PRIO_LEVELS cannot exceed 32"
+#endif
+/* Priority of tasks created by TASK_create */
+#ifndef CONFIG_TASK_PRIO_DEFAULT
+#define CONFIG_TASK_PRIO_DEFAULT    0
+#endif
+
+/* Number of worker threads executing tasks. Each worker has its own run
+   queue, where tasks scheduled by the worker itself are put. Tasks
+   scheduled from elsewhere are spread over the workers, and a worker
+   running out of tasks steals from the others. Priority order holds over
+   all workers, and a task never executes on two workers at once. More than
+   one worker requires CONFIG_OS and CONFIG_TASK_QUEUE_IN_THREAD, workers
+   then sharing the cpu, or CONFIG_ARCH_HOST_SMP, workers then being host
+   threads running in parallel. */
+#ifndef CONFIG_TASK_WORKERS
+#define CONFIG_TASK_WORKERS         1
+#endif
+#if CONFIG_TASK_WORKERS > 1 && !(defined(CONFIG_OS) && defined(CONFIG_TASK_QUEUE_IN_THREAD)) && \
+    !defined(CONFIG_ARCH_HOST_SMP)
+#error "CONFIG_TASK_WORKERS > 1 requires CONFIG_OS and CONFIG_TASK_QUEUE_IN_THREAD, or CONFIG_ARCH_HOST_SMP"
+#endif
+#if CONFIG_TASK_WORKERS > 256
+#error "CONFIG_TASK_WORKERS cannot exceed 256"
+#endif
+
+/* With CONFIG_TASK_STATS, execution statistics are gathered per task
+   function. Number of task functions that can be tracked. */
+#ifdef CONFIG_TASK_STATS
+#ifndef CONFIG_TASK_STATS_ENTRIES
+#define CONFIG_TASK_STATS_ENTRIES   16
+#endif
+/* Number of log2 bins in the queue latency histogram */
+#ifndef CONFIG_TASK_STATS_BINS
+#define CONFIG_TASK_STATS_BINS      12
+#endif
+#endif
+
+/* With CONFIG_TASK_TIMER_WHEEL, timers are kept in a hashed timing wheel
+   instead of a sorted list, giving O(1) start and stop. Each slot is
+   one ms wide. Number of slots must be a power of two and at least 32.
+   The earliest timer is cached, so the wheel is searched for it once per
+   expiry, also when all timers are laps away. */
+#ifdef CONFIG_TASK_TIMER_WHEEL
+#ifndef CONFIG_TASK_TIMER_WHEEL_SLOTS
+#define CONFIG_TASK_TIMER_WHEEL_SLOTS   64
+#endif
+#endif
+
+/* With CONFIG_TASK_EDF, tasks of same priority are executed earliest
+   deadline first. A task scheduled by a timer gets the deadline of the timer
+   expiry plus the timer's relative deadline. Other tasks get a deadline of
+   CONFIG_TASK_EDF_DEADLINE ms from when they are scheduled. */
+#ifdef CONFIG_TASK_EDF
+#ifndef CONFIG_TASK_EDF_DEADLINE
+#define CONFIG_TASK_EDF_DEADLINE    10
+#endif
+#endif
+
 /* Flag for a task that is scheduled to run in next TASK_tick */
 #define TASK_RUN        (1<<0)
 /* Flag for a task that will be rescheduled after each execution  */
@@ -34,24 +100,71 @@
 
 typedef void(*task_f)(u32_t arg, void* arg_p);
 
+#if CONFIG_TASK_POOL > 256
+typedef u16_t task_ix;
+#else
+typedef u8_t task_ix;
+#endif
+
 #ifdef CONFIG_TASKQ_MUTEX
 struct task_mutex_s;
 #endif
+#ifdef CONFIG_TASK_EDF
+struct task_timer_s;
+#endif
 
 typedef struct task_s {
-  u8_t _ix;
-  u8_t _id;
+  task_ix _ix;
+  task_ix _id;
   u8_t flags;
   volatile u8_t run_requests;
+#if CONFIG_TASK_PRIO_LEVELS > 1
+  u8_t prio;
+  u8_t _lvl;
+#endif
+#if CONFIG_TASK_WORKERS > 1
+  // worker queue the task is put in, or executed by
+  u8_t _wq;
+#endif
   u32_t arg;
   void* arg_p;
   task_f f;
 #ifdef CONFIG_TASKQ_MUTEX
   struct task_mutex_s *wait_mutex;
+#endif
+#ifdef CONFIG_TASK_STATS
+  // stats entry + 1, or 0 if not tracked
+  u8_t _stat;
+  // tick when scheduled
+  sys_time _run_tick;
+#endif
+#ifdef CONFIG_TASK_EDF
+  // absolute deadline in ms
+  sys_time _deadline;
+  // timer having scheduled this task, or NULL
+  struct task_timer_s *_timer;
 #endif
   struct task_s *_next;
 } task;
 
+#ifdef CONFIG_TASK_STATS
+typedef struct {
+  // task function
+  task_f f;
+  // number of dispatches
+  u32_t runs;
+  // execution ticks
+  sys_time exe_total;
+  u32_t exe_min;
+  u32_t exe_max;
+  // ticks from being scheduled until dispatched
+  sys_time wait_total;
+  u32_t wait_max;
+  // histogram of wait ticks, bin n counts waits in [2^(n-1), 2^n)
+  u16_t wait_hist[CONFIG_TASK_STATS_BINS];
+} task_stat;
+#endif
+
 typedef struct task_timer_s {
   u8_t _ix;
   task *task;
@@ -61,7 +174,19 @@ typedef struct task_timer_s {
   void* arg_p;
   bool alive;
   const char *name;
+#ifdef CONFIG_TASK_EDF
+  // deadline relative to expiry
+  sys_time deadline;
+  // number of times task finished after deadline
+  u32_t missed;
+  // number of expiries skipped as task was still pending or timer was late
+  u32_t overruns;
+#endif
   struct task_timer_s *_next;
+#ifdef CONFIG_TASK_TIMER_WHEEL
+  struct task_timer_s *_prev;
+  u16_t _slot;
+#endif
 } task_timer;
 
 #ifdef CONFIG_TASKQ_MUTEX
@@ -88,6 +213,21 @@ void TASK_init();
  * @returns the task or NULL if no free psace
  */
 task* TASK_create(task_f f, u8_t flags);
+/**
+ * Creates a new task with given priority
+ * @param f the task function of this task
+ * @param flags TASK_STATIC for static allocation of task (memory never released) or 0 for dynamic
+ * @param prio the priority, 0 being lowest and CONFIG_TASK_PRIO_LEVELS-1 highest
+ * @returns the task or NULL if no free psace
+ */
+task* TASK_create_prio(task_f f, u8_t flags, u8_t prio);
+/**
+ * Sets priority of given task. If the task is already scheduled, the
+ * new priority is effective next time it is scheduled.
+ * @param task the task
+ * @param prio the priority, 0 being lowest and CONFIG_TASK_PRIO_LEVELS-1 highest
+ */
+void TASK_set_prio(task* task, u8_t prio);
 /**
  * Loops this task until TASK_kill is called upon it
  * @param task the task to loop
@@ -135,6 +275,14 @@ void TASK_start_timer(task *task, task_timer* timer, u32_t arg, void *arg_p, sys
  * this invocation
  */
 void TASK_set_timer_recurrence(task_timer* timer, sys_time recurrent_time);
+#ifdef CONFIG_TASK_EDF
+/**
+ * Sets deadline of given timer, relative to each expiry. TASK_start_timer
+ * sets the deadline to the recurrent time, so call this after starting.
+ * Effective from next expiry.
+ */
+void TASK_set_timer_deadline(task_timer* timer, sys_time deadline);
+#endif
 /**
  * Kills of given timer
  */
@@ -165,6 +313,22 @@ bool TASK_mutex_try_lock(task_mutex *m);
 void TASK_mutex_unlock(task_mutex *m);
 #endif
 
+#if CONFIG_TASK_WORKERS > 1
+/**
+ * Binds calling thread to given worker, 0 to CONFIG_TASK_WORKERS-1. Each
+ * worker thread must do this once before calling TASK_tick, TASK_tick_batch
+ * or TASK_wait, e.g.
+ * void *worker_thread(void *arg) {
+ *   TASK_worker_register((u32_t)arg);
+ *   while (TRUE) {
+ *     while (TASK_tick());
+ *     TASK_wait();
+ *   }
+ * }
+ */
+void TASK_worker_register(u32_t worker);
+#endif
+
 /**
  * Executes one pending task and returns 1. If there is no pending task, this function
  * returns 0.
@@ -175,9 +339,20 @@ void TASK_mutex_unlock(task_mutex *m);
  * }
  */
 u32_t TASK_tick();
+/**
+ * Executes pending tasks of highest ready priority level in a batch and returns
+ * number of dispatched tasks. The ready list is detached in one critical section
+ * and run privately, so critical sections are cut down to one per task. Order is
+ * same as calling TASK_tick repeatedly.
+ * Batch stops when max_tasks tasks have been dispatched, when budget_ticks system
+ * ticks have elapsed, or when a task of higher priority becomes ready. Remaining
+ * tasks are put back first in line. Zero max_tasks or budget_ticks means no limit.
+ */
+u32_t TASK_tick_batch(u32_t max_tasks, sys_time budget_ticks);
 /**
  * Depending on build time config, will either suspend thread that is execution tasks
- * or will call arch_sleep.
+ * or will call arch_sleep. With several workers, returns when there is a task the
+ * calling worker may execute.
  */
 void TASK_wait();
 /**
@@ -196,4 +371,17 @@ bool TASK_got_active_tasks(void);
 void TASK_dump(u8_t io);
 void TASK_dump_pool(u8_t io);
 
+#ifdef CONFIG_TASK_STATS
+/**
+ * Copies statistics of given entry into stat.
+ * Returns FALSE if there is no such entry.
+ */
+bool TASK_stats(u32_t entry, task_stat *stat);
+/**
+ * Clears all gathered statistics
+ */
+void TASK_stats_reset(void);
+void TASK_dump_stats(u8_t io);
+#endif
+
 #endif /* TASKQ_H_ */
@@ -1,6 +1,11 @@
 #ifndef __TYPE_H
 #define __TYPE_H
 
+#ifdef ARCH_HOST
+// host libc headers define these, long may be 64 bits
+#include <stdint.h>
+#include <stddef.h>
+#else
 typedef signed long long int64_t;
 typedef signed long  int32_t;
 typedef signed short int16_t;
@@ -11,6 +16,9 @@ typedef unsigned long  uint32_t;
 typedef unsigned short uint16_t;
 typedef unsigned char  uint8_t;
 
+typedef __UINTPTR_TYPE__ uintptr_t;
+#endif
+
 typedef enum {FALSE = 0, TRUE = !FALSE} bool;
 
 #define U8_MAX     ((u8_t)255)
@@ -26,7 +34,9 @@ typedef enum {FALSE = 0, TRUE = !FALSE} bool;
 #define FALSE       (0)
 #define TRUE        (!FALSE)
 
+#ifndef NULL
 #define NULL        ((void*)0)
+#endif
 
 typedef uint64_t u64_t;
 typedef int64_t s64_t;
@@ -21,7 +21,14 @@
 #define UART_ALWAYS_SYNC_TX     0
 #endif
 
+// tx dma transfers failing without progress before their data is dropped
+#ifndef UART_TX_DMA_RETRIES
+#define UART_TX_DMA_RETRIES     2
+#endif
+
 typedef void(*uart_rx_callback)(void *arg, u8_t c);
+typedef void(*uart_rx_burst_callback)(void *arg, u16_t len);
+typedef void(*uart_tx_ref_callback)(void *arg);
 
 typedef struct {
   void* hw;
@@ -39,6 +46,45 @@ typedef struct {
 #endif
   uart_rx_callback rx_f;
   void* arg;
+#ifdef CONFIG_UART_DMA_RX
+  uart_rx_burst_callback rx_burst_f;
+  void* burst_arg;
+  // dma channel or stream receiving into rx.buf, its interrupt flags and
+  // request channel
+  void* dma_rx;
+  u32_t dma_rx_it;
+  u32_t dma_rx_ch;
+  // rx write index at last dma half or full transfer irq
+  u16_t dma_rx_irq_wix;
+#endif
+#ifdef CONFIG_UART_DMA_TX
+  // dma channel or stream sending from tx.buf or referenced buffer, its
+  // interrupt flags and request channel
+  void* dma_tx;
+  u32_t dma_tx_it;
+  u32_t dma_tx_ch;
+  // length of ongoing tx transfer, zero if idle, and if it is the referenced
+  // buffer
+  volatile u16_t dma_tx_len;
+  volatile bool dma_tx_ref;
+  // referenced buffer pending, sent when tx.rix reaches tx_ref_wix
+  u8_t *tx_ref;
+  u16_t tx_ref_len;
+  u16_t tx_ref_wix;
+  uart_tx_ref_callback tx_ref_f;
+  void* tx_ref_arg;
+  // tx transfers failed in a row without progress
+  u8_t dma_tx_retries;
+  // tx transfer errors, and bytes dropped by them
+  u32_t tx_errors;
+  u32_t tx_lost;
+#endif
+#ifdef CONFIG_UART_RX_STATS
+  u32_t rx_irqs;
+  u32_t rx_bytes;
+  u32_t rx_overruns;
+  u32_t rx_lost;
+#endif
   bool assure_tx;
   bool sync_tx;
 } uart;
@@ -76,10 +122,101 @@ void UART_irq(uart *uart);
 void UART_init();
 bool UART_assure_tx(uart *u, bool on);
 bool UART_sync_tx(uart *u, bool on);
+/**
+ * Sets rx callback. Normally called for each received byte. With
+ * CONFIG_UART_DMA_RX, it is called once per burst with the last received
+ * byte, the whole burst being available by UART_get_buf.
+ */
 void UART_set_callback(uart *uart, uart_rx_callback rx_f, void* arg);
 void UART_get_callback(uart *uart, uart_rx_callback *rx_f, void **arg);
+#ifdef CONFIG_UART_DMA_RX
+/**
+ * With CONFIG_UART_DMA_RX, the uart receives into rx buffer by circular dma.
+ * Received data is picked up on idle line, meaning a burst has ended, and on
+ * dma half and full transfer, so a continuous stream gives two interrupts per
+ * rx buffer length instead of one per byte.
+ * The dma interrupt of each uart rx channel or stream must be enabled in
+ * NVIC by application, and its handler must call UART_rx_dma_irq.
+ */
+void UART_rx_dma_irq(uart *uart);
+/**
+ * Sets callback called once per received burst with number of new bytes.
+ */
+void UART_set_burst_callback(uart *uart, uart_rx_burst_callback rx_burst_f, void* arg);
+/**
+ * Moves rx write index to where dma has written up to, for drivers. If dma
+ * overwrote unread data, read index moves to oldest byte left and the
+ * overrun is counted. dma_irq tells if called from a dma half or full
+ * transfer interrupt, after reading dma position and before clearing the
+ * interrupt flags. Then a lap of dma around the buffer since previous such
+ * interrupt is detected, as long as that interrupt is not held off for a
+ * lap and a half. Must be called in critical.
+ * Returns number of bytes received since last call.
+ */
+u32_t UART_rx_dma_advance(uart *uart, u16_t wix, bool dma_irq);
+#endif
+#ifdef CONFIG_UART_DMA_TX
+/**
+ * With CONFIG_UART_DMA_TX, the uart sends tx buffer by dma. The linear part
+ * of the tx ring is sent in one transfer, and a wrapped part is chained on
+ * transfer complete.
+ * The dma interrupt of each uart tx channel or stream must be enabled in
+ * NVIC by application, and its handler must call UART_tx_dma_irq.
+ */
+void UART_tx_dma_irq(uart *uart);
+/**
+ * Sends given buffer by dma without copying it to tx buffer, after data
+ * already in tx buffer. Buffer must be left untouched until callback is
+ * called, from dma interrupt, when buffer is sent. Data put to tx buffer
+ * meanwhile is sent after referenced buffer.
+ * Only one referenced buffer may be pending per uart.
+ * Returns len, or -1 if a referenced buffer is already pending.
+ */
+s32_t UART_put_buf_ref(uart *uart, u8_t *buf, u16_t len, uart_tx_ref_callback f, void *arg);
+/**
+ * Returns number of tx dma transfer errors, and of bytes dropped after
+ * UART_TX_DMA_RETRIES transfers in a row failed without progress.
+ */
+void UART_tx_dma_stats(uart *uart, u32_t *errors, u32_t *lost);
+/**
+ * Takes next tx chunk unless one is in flight, for drivers: ring data
+ * queued before the referenced buffer, the referenced buffer, then the
+ * rest of the ring. Wrapped ring data is taken in two chunks. Must be
+ * called in critical.
+ * Returns chunk length, zero if nothing to send or a chunk is in flight.
+ */
+u16_t UART_tx_dma_chunk(uart *uart, u8_t **buf);
+/**
+ * Accounts the chunk in flight as done, for drivers, left bytes of it
+ * being unsent. Unsent bytes are taken again by next chunk. On error
+ * without progress UART_TX_DMA_RETRIES times in a row, the unsent bytes
+ * are dropped. Must be called in critical.
+ * Returns callback of referenced buffer if this completed it, with its
+ * argument in arg, to be called after leaving critical.
+ */
+uart_tx_ref_callback UART_tx_dma_done(uart *uart, u16_t left, bool error, void **arg);
+#endif
+#ifdef CONFIG_UART_RX_STATS
+/**
+ * Returns number of rx interrupts and received bytes since last reset,
+ * for comparing interrupt load of rx modes, and number of overruns and
+ * bytes lost by them. With dma rx, an overrun is dma overwriting unread
+ * data, the read index then moving to the oldest byte left.
+ */
+void UART_rx_stats(uart *uart, u32_t *irqs, u32_t *bytes, u32_t *overruns, u32_t *lost);
+void UART_rx_stats_reset(uart *uart);
+#endif
 s32_t UART_get_char(uart *uart);
+/**
+ * Reads received data into given buffer. If buffer is NULL, data is
+ * discarded, e.g. after reading it by UART_rx_peek_linear.
+ */
 s32_t UART_get_buf(uart *uart, u8_t* c, u16_t len);
+/**
+ * Returns number of received bytes readable linearly from rx buffer
+ * without copying, and sets ptr to first byte. Read pointer is not advanced.
+ */
+u16_t UART_rx_peek_linear(uart *uart, u8_t **ptr);
 s32_t UART_put_char(uart *uart, u8_t c);
 void UART_tx_force_char(uart *uart, u8_t c);
 s32_t UART_put_buf(uart *uart, u8_t* c, u16_t len);
@@ -0,0 +1,39 @@
+/*
+ * uart_rx_dma.c
+ *
+ * Rx buffer accounting of uart drivers receiving by circular dma,
+ * independent of the dma hardware.
+ */
+
+#include "uart_driver.h"
+#include "miniutils.h"
+
+u32_t UART_rx_dma_advance(uart *u, u16_t wix, bool dma_irq) {
+  const u16_t half = UART_RX_BUFFER / 2;
+  u16_t old_wix = u->rx.wix;
+  u32_t len = wix >= old_wix ? wix - old_wix : wix + UART_RX_BUFFER - old_wix;
+  u32_t unread = old_wix >= u->rx.rix ? old_wix - u->rx.rix : old_wix + UART_RX_BUFFER - u->rx.rix;
+  if (dma_irq) {
+    // dma passed a half buffer mark since previous dma irq, if it seems not
+    // it went a lap around unnoticed
+    u16_t last = u->dma_rx_irq_wix;
+    u32_t since = wix >= last ? wix - last : wix + UART_RX_BUFFER - last;
+    if (last % half + since < half) {
+      len += UART_RX_BUFFER;
+    }
+    u->dma_rx_irq_wix = wix;
+  }
+  u->rx.wix = wix;
+  if (unread + len > UART_RX_BUFFER - 1) {
+    // dma overwrote unread data, oldest byte left is just after wix
+    u->rx.rix = wix + 1 >= UART_RX_BUFFER ? 0 : wix + 1;
+#ifdef CONFIG_UART_RX_STATS
+    u->rx_overruns++;
+    u->rx_lost += unread + len - (UART_RX_BUFFER - 1);
+#endif
+  }
+#ifdef CONFIG_UART_RX_STATS
+  u->rx_bytes += len;
+#endif
+  return len;
+}
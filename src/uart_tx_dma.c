@@ -0,0 +1,56 @@
+/*
+ * uart_tx_dma.c
+ *
+ * Tx chunk chaining of uart drivers sending by dma, independent of the
+ * dma hardware.
+ */
+
+#include "uart_driver.h"
+#include "miniutils.h"
+
+u16_t UART_tx_dma_chunk(uart *u, u8_t **buf) {
+  if (u->dma_tx_len) {
+    return 0;
+  }
+  u16_t end = u->tx_ref ? u->tx_ref_wix : u->tx.wix;
+  if (u->tx.rix != end) {
+    u->dma_tx_ref = FALSE;
+    *buf = &u->tx.buf[u->tx.rix];
+    u->dma_tx_len = (end > u->tx.rix ? end : UART_TX_BUFFER) - u->tx.rix;
+  } else if (u->tx_ref) {
+    u->dma_tx_ref = TRUE;
+    *buf = u->tx_ref;
+    u->dma_tx_len = u->tx_ref_len;
+  }
+  return u->dma_tx_len;
+}
+
+uart_tx_ref_callback UART_tx_dma_done(uart *u, u16_t left, bool error, void **arg) {
+  uart_tx_ref_callback ref_f = NULL;
+  u16_t sent = u->dma_tx_len - left;
+  if (error) {
+    u->tx_errors++;
+    if (sent == 0 && ++u->dma_tx_retries > UART_TX_DMA_RETRIES) {
+      // failing for good, drop the chunk
+      sent = u->dma_tx_len;
+      u->tx_lost += sent;
+    }
+  }
+  if (sent) {
+    u->dma_tx_retries = 0;
+  }
+  if (u->dma_tx_ref) {
+    u->tx_ref += sent;
+    u->tx_ref_len -= sent;
+    if (u->tx_ref_len == 0) {
+      ref_f = u->tx_ref_f;
+      *arg = u->tx_ref_arg;
+      u->tx_ref = NULL;
+    }
+  } else {
+    u->tx.rix = (u->tx.rix + sent) % UART_TX_BUFFER;
+  }
+  u->dma_tx_len = 0;
+  u->dma_tx_ref = FALSE;
+  return ref_f;
+}
@@ -18,6 +18,10 @@ s32_t USB_SER_tx_buf(u8_t *buf, u16_t len);
 s32_t USB_SER_rx_char(u8_t *c);
 s32_t USB_SER_rx_buf(u8_t *buf, u16_t len);
 u16_t USB_SER_rx_avail(void);
+// returns number of received bytes linearly readable at ptr, without copying
+u16_t USB_SER_rx_peek_linear(u8_t **ptr);
+// discards given number of received bytes, e.g. after peeking
+s32_t USB_SER_rx_consume(u16_t len);
 void USB_SER_tx_drain(void);
 void USB_SER_tx_flush(void);
 void USB_SER_set_rx_callback(usb_serial_rx_cb cb, void *arg);
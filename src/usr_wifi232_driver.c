@@ -77,7 +77,7 @@ static struct {
 
 ///////////////////////////////////////////
 
-static void wifi_data_handle_input(u8_t io);
+static void wifi_data_handle_input(u8_t c);
 
 /////////////////////////////////////////// config
 
@@ -444,20 +444,25 @@ static void wifi_cfg_tmo(u32_t arg, void *argp) {
 }
 
 
-// called via uart, len will always be 1
+// called via uart with bytes available, being a whole burst with dma
 static void wifi_io_cb(u8_t io, void *arg, u16_t len) {
+  u8_t buf[8];
   if (wsta.idle) return;
-  if (wsta.config) {
-    // configuration input
-    u8_t buf[8];
-    u16_t ix;
-    IO_get_buf(io, buf, MIN(sizeof(buf), len));
-    for (ix = 0; ix < len; ix++) {
-      wifi_cfg_io_parse(buf[ix]);
+  while (len > 0) {
+    s32_t rd = IO_get_buf(io, buf, MIN(sizeof(buf), len));
+    s32_t ix;
+    if (rd <= 0) break;
+    for (ix = 0; ix < rd; ix++) {
+      // mode may change within a burst
+      if (wsta.config) {
+        // configuration input
+        wifi_cfg_io_parse(buf[ix]);
+      } else {
+        // data input
+        wifi_data_handle_input(buf[ix]);
+      }
     }
-  } else {
-    // data input
-    wifi_data_handle_input(io);
+    len -= rd;
   }
 }
 
@@ -482,8 +487,7 @@ static void wifi_data_timer_task_f(u32_t io, void *vrb) {
   }
 }
 
-static void wifi_data_handle_input(u8_t io) {
-  s32_t c = IO_get_char(io);
+static void wifi_data_handle_input(u8_t c) {
   s32_t res = ringbuf_putc(&wsta.rx_data_rb, c);
   u32_t ringbuf_avail = ringbuf_available(&wsta.rx_data_rb);
 